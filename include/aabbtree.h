@@ -0,0 +1,107 @@
+#ifndef _AABBTREE_H
+#define _AABBTREE_H
+
+#include <vector>
+
+// Árvore dinâmica de caixas alinhadas aos eixos (AABB), uma hierarquia de
+// volumes envolventes (BVH) que é atualizada à medida que objetos são
+// inseridos, removidos e movidos, sem ser reconstruída.
+//
+// Cada folha guarda a caixa de um objeto, aumentada em AABBTREE_MARGIN em
+// cada direção: enquanto o objeto se move dentro dessa caixa, a árvore não
+// muda. Cada nó interno tem exatamente dois filhos e guarda a união das
+// caixas deles.
+//
+// Uma folha nova é colocada ao lado do nó que menos aumenta a soma das áreas
+// das caixas dos nós internos (a "surface area heuristic", SAH: a
+// probabilidade de um raio ou frustum atingir uma caixa é proporcional à sua
+// área). Depois, as caixas dos ancestrais são recalculadas, do pai da folha
+// até a raiz, e em cada ancestral é feita a "rotação" que mais reduz essa
+// área: um filho troca de lugar com um neto do outro lado. Remoções fazem o
+// mesmo a partir do nó que perdeu o filho. Assim a árvore se mantém próxima
+// de uma árvore construída do zero, com custo O(log n) por operação.
+//
+// As consultas percorrem apenas os nós cujas caixas são atingidas, então o
+// custo é proporcional ao número de objetos encontrados, e não ao número de
+// objetos na árvore.
+//
+// Os nós ficam em um vetor, e os nós apagados são reaproveitados. Uma folha
+// é identificada pela posição do seu nó ("proxy"), que não muda enquanto ela
+// estiver na árvore.
+
+// Aumento, em unidades de comprimento, das caixas das folhas em cada
+// direção.
+#define AABBTREE_MARGIN 0.1f
+
+#define AABBTREE_NULL -1
+
+// Número de nós que a pilha de uma consulta guarda na pilha de execução; só
+// árvores mais altas que isso precisam de um std::vector. As consultas não
+// guardam estado entre chamadas e podem ser feitas ao mesmo tempo, de várias
+// threads, sobre a mesma árvore.
+#define AABBTREE_STACK_SIZE 64
+
+struct AabbTreeNode
+{
+    float minimum[3];
+    float maximum[3];
+    int   parent;     // AABBTREE_NULL na raiz; na lista de nós livres, o próximo nó livre
+    int   left;       // AABBTREE_NULL nas folhas
+    int   right;
+    int   height;     // 0 nas folhas; -1 nos nós livres
+    int   data;       // Valor associado a uma folha (por exemplo, a posição do objeto em um vetor)
+};
+
+struct AabbTree
+{
+    std::vector<AabbTreeNode> nodes;
+    int                       root;
+    int                       free_list;  // Primeiro nó livre, ou AABBTREE_NULL
+
+    AabbTree() : root(AABBTREE_NULL), free_list(AABBTREE_NULL) {}
+};
+
+// Folha encontrada por AabbTree_QueryRay().
+struct AabbTreeHit
+{
+    int   data;
+    float distance; // Parâmetro t do ponto em que o raio entra na caixa da folha (0 se a origem está dentro)
+};
+
+// Esvazia a árvore.
+void AabbTree_Clear(AabbTree* tree);
+
+// Insere uma folha com a caixa [minimum, maximum] e o valor "data". Retorna
+// o proxy da folha.
+int AabbTree_Insert(AabbTree* tree, const float minimum[3], const float maximum[3], int data);
+
+// Remove uma folha.
+void AabbTree_Remove(AabbTree* tree, int proxy);
+
+// Atualiza a caixa de uma folha. Se a nova caixa ainda está dentro da caixa
+// aumentada da folha, nada muda e a função retorna false; caso contrário a
+// folha é reinserida e a função retorna true. O proxy não muda.
+bool AabbTree_Move(AabbTree* tree, int proxy, const float minimum[3], const float maximum[3]);
+
+// Valor associado a uma folha.
+int  AabbTree_Data(const AabbTree& tree, int proxy);
+void AabbTree_SetData(AabbTree* tree, int proxy, int data);
+
+// Acrescenta a "out" os valores das folhas cujas caixas não estão
+// inteiramente fora do frustum "planes" (veja "frustumcull.h"). Quando a
+// caixa de um nó está inteiramente dentro de um plano, esse plano não é mais
+// testado nos seus descendentes; quando está dentro de todos, todas as suas
+// folhas são acrescentadas sem novos testes.
+void AabbTree_QueryFrustum(const AabbTree& tree, const float planes[6][4], std::vector<int>* out);
+
+// Acrescenta a "out" as folhas cujas caixas são atingidas pelo raio
+// origin + t*direction, com 0 <= t <= max_distance, em ordem crescente de
+// distância. As caixas são aumentadas (veja AABBTREE_MARGIN), então quem
+// chama deve testar cada folha com a geometria exata do objeto.
+void AabbTree_QueryRay(const AabbTree& tree, const float origin[3], const float direction[3], float max_distance, std::vector<AabbTreeHit>* out);
+
+// Acrescenta a "out" os valores das folhas cujas caixas intersectam a caixa
+// [minimum, maximum] (consultas de proximidade).
+void AabbTree_QueryBox(const AabbTree& tree, const float minimum[3], const float maximum[3], std::vector<int>* out);
+
+#endif // _AABBTREE_H
@@ -0,0 +1,133 @@
+#ifndef _ASSETLOADER_H
+#define _ASSETLOADER_H
+
+#include <string>
+
+#include "meshquant.h"
+#include "texture.h"
+
+struct GLFWwindow;
+
+// Carregamento de modelos em segundo plano, para que a janela comece a ser
+// desenhada imediatamente.
+//
+// Cada pedido (AssetLoader_Request()) passa por três etapas:
+//
+//  1. Uma thread de trabalho executa callbacks.prepare(), que lê e processa o
+//     modelo (cache, ".obj", normais, otimização, LODs) e o converte para o
+//     formato final da GPU (MeshEncodedData), sem usar OpenGL.
+//  2. Os dados são enviados para a GPU. Por padrão isso acontece na thread
+//     principal, dentro de AssetLoader_Update(), em partes de
+//     ASSETLOADER_UPLOAD_CHUNK bytes e limitado a um tempo por quadro. Se um
+//     segundo contexto OpenGL, compartilhado com o da janela, for passado para
+//     AssetLoader_Init(), uma thread de envio dedicada o utiliza, e a thread
+//     principal apenas espera (sem bloquear) por um "fence" de sincronização.
+//  3. Na thread principal, callbacks.ready() recebe os buffers da GPU e
+//     adiciona o modelo à cena (VAOs não são compartilhados entre contextos,
+//     então precisam ser criados aqui).
+//
+// Modelos muito grandes para serem processados em memória (veja
+// "meshstream.h") precisam de OpenGL já na etapa 1: callbacks.prepare() marca
+// needs_gpu_load e callbacks.gpu_load() é executada na etapa 2, na thread que
+// tem um contexto. Sem contexto compartilhado, isso bloqueia a thread
+// principal durante o carregamento.
+//
+// Modelos maiores que a memória (veja "meshtile.h") são divididos em tiles
+// por callbacks.prepare(), que preenche apenas num_tiles: o pedido é
+// entregue a callbacks.ready() sem dados, e cada tile é então pedido
+// separadamente com AssetLoader_RequestTile().
+//
+// Para que a memória ocupada por dados já preparados e ainda não enviados
+// seja limitada, as threads de trabalho só começam um novo pedido enquanto
+// esses dados somam menos que o orçamento de AssetLoader_SetMemoryBudget()
+// (ASSETLOADER_DEFAULT_MEMORY_BUDGET por padrão). O limite pode ser
+// ultrapassado em no máximo um pedido por thread de trabalho.
+//
+// Texturas (AssetLoader_RequestTexture()) seguem as mesmas etapas, com
+// callbacks.prepare_texture() e callbacks.texture_ready(): a decodificação,
+// os mipmaps e a compressão (veja "texture.h") ficam nas threads de
+// trabalho, e o envio pela thread principal também é feito em partes de
+// ASSETLOADER_UPLOAD_CHUNK bytes.
+
+// Número máximo de threads de trabalho (uma por núcleo, deixando um para a
+// thread principal).
+#define ASSETLOADER_MAX_WORKERS 4
+
+// Tamanho de cada envio para a GPU feito pela thread principal.
+#define ASSETLOADER_UPLOAD_CHUNK (1024*1024)
+
+// Tempo máximo por quadro, em segundos, gasto pela thread principal com
+// envios para a GPU.
+#define ASSETLOADER_FRAME_BUDGET 0.002
+
+// Orçamento padrão de memória para dados preparados e ainda não enviados
+// para a GPU.
+#define ASSETLOADER_DEFAULT_MEMORY_BUDGET (512ull*1024*1024)
+
+// Um modelo ou uma textura sendo carregados.
+struct AssetBlob
+{
+    std::string     filename;
+    MeshEncodedData mesh;           // Preenchido por callbacks.prepare()
+    bool            needs_gpu_load; // Se true, o modelo é carregado por callbacks.gpu_load()
+    int             tile;           // Tile pedido com AssetLoader_RequestTile(), ou -1
+    size_t          num_tiles;      // Se > 0, o modelo foi dividido em tiles (veja "meshtile.h")
+    bool            is_texture;     // Pedido por AssetLoader_RequestTexture()
+    TextureData     texture;        // Preenchido por callbacks.prepare_texture()
+    size_t          texture_memory; // Memória reservada com Texture_ReserveMemory()
+    size_t          prepared_bytes; // Memória principal ocupada por "mesh" e "texture"
+    std::string     error;          // Mensagem de erro (vazia se não houve erro)
+
+    AssetBlob() : needs_gpu_load(false), tile(-1), num_tiles(0), is_texture(false), texture_memory(0), prepared_bytes(0) {}
+};
+
+struct AssetLoaderCallbacks
+{
+    // Thread de trabalho. Pode lançar exceções (std::exception).
+    void (*prepare)(AssetBlob* blob);
+
+    // Thread com contexto OpenGL (de envio ou principal). Pode lançar
+    // exceções.
+    void (*gpu_load)(AssetBlob* blob, MeshGpuBuffers* gpu);
+
+    // Thread principal, quando os buffers da GPU estão prontos para uso.
+    void (*ready)(const AssetBlob& blob, const MeshGpuBuffers& gpu);
+
+    // Thread de trabalho: preenche blob->texture. Pode lançar exceções.
+    void (*prepare_texture)(AssetBlob* blob);
+
+    // Thread principal, quando a textura está pronta para uso.
+    void (*texture_ready)(const AssetBlob& blob, GLuint texture_id);
+};
+
+// Inicia as threads. "upload_context" é uma janela (invisível) cujo contexto
+// é compartilhado com o da janela principal, ou NULL para enviar os dados
+// pela thread principal.
+void AssetLoader_Init(const AssetLoaderCallbacks& callbacks, GLFWwindow* upload_context);
+
+// Pede o carregamento de um modelo.
+void AssetLoader_Request(const char* filename);
+
+// Pede o carregamento do tile "tile" de um modelo dividido em tiles.
+void AssetLoader_RequestTile(const char* filename, int tile);
+
+// Pede o carregamento de uma textura.
+void AssetLoader_RequestTexture(const char* filename);
+
+// Limita a memória ocupada por dados preparados e ainda não enviados para a
+// GPU. Pode ser chamada a qualquer momento.
+void AssetLoader_SetMemoryBudget(size_t bytes);
+
+// Executada uma vez por quadro pela thread principal: envia dados para a
+// GPU por até "budget_seconds" segundos e entrega os modelos prontos para
+// callbacks.ready().
+void AssetLoader_Update(double budget_seconds);
+
+// Número de modelos e texturas pedidos que ainda não foram entregues.
+size_t AssetLoader_Pending();
+
+// Termina as threads. Modelos e texturas ainda não entregues são
+// descartados.
+void AssetLoader_Shutdown();
+
+#endif // _ASSETLOADER_H
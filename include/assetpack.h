@@ -0,0 +1,97 @@
+#ifndef _ASSETPACK_H
+#define _ASSETPACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mappedfile.h"
+
+// Pacote de assets: um único arquivo com todos os dados que o programa lê do
+// disco (malhas já processadas, shaders, texturas e fontes), gerado pela
+// ferramenta "tools/assetpack.cpp" ("make pack").
+//
+// O arquivo é mapeado em memória uma única vez (veja "mappedfile.h"). Uma
+// tabela de conteúdo (TOC), ordenada pelo hash do nome de cada asset, permite
+// encontrar um asset por busca binária, sem nenhuma chamada de sistema para
+// abrir ou ler arquivos: AssetPack_Find() retorna um ponteiro para dentro do
+// mapeamento.
+//
+// Os nomes são caminhos relativos à raiz do projeto, como
+// "data/bunny.obj" ou "src/shader_vertex.glsl". Caminhos usados pelo
+// programa, como "../../data/bunny.obj", são convertidos com
+// AssetPack_Name() antes da busca.
+//
+// Malhas são guardadas exatamente no formato de "meshcache.h", já com
+// normais, otimização, níveis de detalhe e clusters; veja
+// MeshCache_LoadFromMemory(). Texturas são guardadas no formato de
+// "texturecache.h", já com mipmaps e comprimidas.
+
+// Incrementar sempre que o formato do arquivo mudar.
+#define ASSETPACK_VERSION 2
+
+// Nome do pacote procurado pelo programa no diretório de execução.
+#define ASSETPACK_DEFAULT_FILENAME "assets.pack"
+
+// Tipo do conteúdo de cada asset.
+enum AssetType
+{
+    ASSET_RAW = 0, // Bytes do arquivo original
+    ASSET_MESH,    // Cache de malha (veja "meshcache.h")
+    ASSET_SHADER,  // Código-fonte GLSL
+    ASSET_TEXTURE, // Textura com mipmaps (veja "texturecache.h")
+    ASSET_FONT     // texture_font_t (veja "dejavufont.h")
+};
+
+struct AssetPack
+{
+    MappedFile  file;
+    const void* entries;     // Tabela de conteúdo, dentro de "file"
+    size_t      num_entries;
+    const char* names;       // Nomes dos assets, concatenados
+
+    AssetPack() : entries(NULL), num_entries(0), names(NULL)
+    {
+        file.data = NULL;
+        file.size = 0;
+        file.handle = NULL;
+    }
+};
+
+// Um asset encontrado por AssetPack_Find(). Aponta para dentro do pacote.
+struct AssetData
+{
+    const unsigned char* data; // Alinhado em 16 bytes
+    size_t               size;
+    AssetType            type;
+};
+
+// Um asset a ser gravado por AssetPack_Write().
+struct AssetPackInput
+{
+    std::string                name; // Já convertido com AssetPack_Name()
+    AssetType                  type;
+    std::vector<unsigned char> data;
+};
+
+// Converte um caminho para o nome usado no pacote: barras invertidas viram
+// "/" e componentes iniciais "./" e "../" são removidos.
+std::string AssetPack_Name(const char* path);
+
+// Mapeia o pacote "filename" em memória e valida sua tabela de conteúdo.
+// Retorna false se o arquivo não existir ou for inválido.
+bool AssetPack_Open(const char* filename, AssetPack* pack);
+
+// Desfaz o mapeamento criado por AssetPack_Open().
+void AssetPack_Close(AssetPack* pack);
+
+// Procura o asset de caminho "path" (veja AssetPack_Name()). Retorna false se
+// o pacote não estiver aberto ou não contiver o asset.
+bool AssetPack_Find(const AssetPack& pack, const char* path, AssetData* asset);
+
+// Grava um pacote com os assets de "assets". Retorna false em caso de erro
+// de escrita ou de nomes repetidos.
+bool AssetPack_Write(const char* filename, const std::vector<AssetPackInput>& assets);
+
+#endif // _ASSETPACK_H
@@ -0,0 +1,55 @@
+#ifndef _FRUSTUMCULL_H
+#define _FRUSTUMCULL_H
+
+#include <cstddef>
+#include <vector>
+
+// Descarte de objetos fora do frustum da câmera ("frustum culling"). Cada
+// objeto é descrito por dois volumes envolventes em coordenadas do mundo:
+// uma esfera e uma caixa alinhada aos eixos (AABB), guardada como centro e
+// meia-extensão. Um objeto é descartado se algum dos dois volumes está
+// inteiramente do lado de fora de algum dos seis planos do frustum. A esfera
+// é invariante à rotação, e a caixa é mais justa para objetos alongados, como
+// o plano do chão.
+//
+// Os volumes de todos os objetos de um quadro são acumulados em um
+// FrustumCullBatch, com cada coordenada em um vetor separado ("structure of
+// arrays"), e testados de uma vez por FrustumCull_Test(). Com SSE, quatro
+// objetos são testados a cada iteração contra um plano; sem SSE (por exemplo,
+// em ARM), o mesmo teste é feito um objeto por vez.
+
+// Volumes envolventes de um quadro. A posição de cada objeto é retornada por
+// FrustumCull_Add().
+struct FrustumCullBatch
+{
+    std::vector<float> sphere_x, sphere_y, sphere_z, sphere_radius;
+    std::vector<float> box_x, box_y, box_z;                    // Centro da AABB
+    std::vector<float> box_extent_x, box_extent_y, box_extent_z; // Meia-extensão da AABB, em cada eixo
+};
+
+// Extrai os planos do frustum de uma matriz que leva para coordenadas de
+// recorte (por exemplo, projection * view), guardada coluna a coluna como em
+// glm::value_ptr(). As normais dos planos apontam para dentro do frustum e
+// são normalizadas, de forma que cada plano (a, b, c, d) dá a distância
+// a*x + b*y + c*z + d de um ponto até ele, no sistema de coordenadas de
+// origem da matriz.
+void FrustumCull_ExtractPlanes(const float clip_from_space[16], float planes[6][4]);
+
+// Esvazia o lote, mantendo a memória já alocada.
+void FrustumCull_Clear(FrustumCullBatch* batch);
+
+// Acrescenta os volumes de um objeto e retorna sua posição no lote.
+size_t FrustumCull_Add(FrustumCullBatch* batch, const float sphere_center[3], float sphere_radius, const float box_center[3], const float box_extent[3]);
+
+// Testa todos os objetos do lote contra "planes" (veja
+// FrustumCull_ExtractPlanes()). Ao fim, (*visible)[i] é 1 se o objeto i
+// pode estar visível e 0 se foi descartado. Retorna o número de objetos
+// visíveis.
+size_t FrustumCull_Test(const FrustumCullBatch& batch, const float planes[6][4], std::vector<unsigned char>* visible);
+
+// O mesmo teste, sempre um objeto por vez, sem SSE. Os dois caminhos fazem
+// as mesmas contas na mesma ordem e devem dar exatamente o mesmo resultado
+// (veja "tools/selfcheck.cpp").
+size_t FrustumCull_TestScalar(const FrustumCullBatch& batch, const float planes[6][4], std::vector<unsigned char>* visible);
+
+#endif // _FRUSTUMCULL_H
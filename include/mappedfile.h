@@ -0,0 +1,43 @@
+#ifndef _MAPPEDFILE_H
+#define _MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Arquivo mapeado em memória (somente leitura). O conteúdo do arquivo fica
+// acessível através do ponteiro "data" sem nenhuma cópia explícita: o sistema
+// operacional carrega as páginas sob demanda. Veja MapFile() e UnmapFile() em
+// "mappedfile.cpp".
+struct MappedFile
+{
+    const unsigned char* data; // Primeiro byte do arquivo (NULL se não mapeado)
+    size_t               size; // Tamanho do arquivo em bytes
+    void*                handle; // Dados específicos do sistema operacional
+};
+
+// Metadados de um arquivo utilizados para invalidar caches.
+struct FileStamp
+{
+    uint64_t size;  // Tamanho em bytes
+    int64_t  mtime; // Data da última modificação (segundos desde 1970)
+};
+
+// Mapeia o arquivo "filename" em memória. Retorna false em caso de erro.
+// Arquivos vazios são "mapeados" com data == NULL e size == 0.
+bool MapFile(const char* filename, MappedFile* file);
+
+// Desfaz o mapeamento criado por MapFile().
+void UnmapFile(MappedFile* file);
+
+// Obtém tamanho e data de modificação de um arquivo. Retorna false caso o
+// arquivo não exista.
+bool GetFileStamp(const char* filename, FileStamp* stamp);
+
+// Muda a data de modificação de um arquivo, sem abri-lo (o arquivo pode
+// estar mapeado por MapFile()). Retorna false em caso de erro.
+bool SetFileMtime(const char* filename, int64_t mtime);
+
+// Hash FNV-1a de 64 bits de um bloco de memória.
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ULL);
+
+#endif // _MAPPEDFILE_H
@@ -0,0 +1,249 @@
+#ifndef _MESH_H
+#define _MESH_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include <glad/glad.h>
+
+#include <tiny_obj_loader.h>
+
+// Diretório de "filename", com a barra final ("" se não houver diretório).
+// Usado para encontrar os arquivos ".mtl" referenciados por um ".obj".
+inline std::string MeshDirectory(const char* filename)
+{
+    std::string path(filename);
+    size_t slash = path.find_last_of("/\\");
+    return (slash == std::string::npos) ? std::string() : path.substr(0, slash + 1);
+}
+
+// Estrutura que representa um modelo geométrico carregado a partir de um
+// arquivo ".obj". Veja https://en.wikipedia.org/wiki/Wavefront_.obj_file .
+struct ObjModel
+{
+    tinyobj::attrib_t                 attrib;
+    std::vector<tinyobj::shape_t>     shapes;
+    std::vector<tinyobj::material_t>  materials;
+
+    // Modelo vazio, preenchido diretamente por quem o cria (veja os tiles de
+    // "meshtile.cpp").
+    ObjModel() {}
+
+    // Este construtor lê o modelo de um arquivo utilizando a biblioteca tinyobjloader.
+    // Veja: https://github.com/syoyo/tinyobjloader
+    // Utilizamos LoadObjParallel(), que divide o arquivo em blocos e os
+    // interpreta em paralelo, uma thread por núcleo do processador.
+    // Se "basepath" for NULL, os arquivos ".mtl" são procurados no diretório
+    // do próprio ".obj".
+    ObjModel(const char* filename, const char* basepath = NULL, bool triangulate = true)
+    {
+        printf("Carregando modelo \"%s\"... ", filename);
+
+        std::string directory;
+        if ( basepath == NULL )
+        {
+            directory = MeshDirectory(filename);
+            basepath = directory.c_str();
+        }
+
+        std::string err;
+        bool ret = tinyobj::LoadObjParallel(&attrib, &shapes, &materials, &err, filename, basepath, triangulate);
+
+        if (!err.empty())
+            fprintf(stderr, "\n%s\n", err.c_str());
+
+        if (!ret)
+            throw std::runtime_error("Erro ao carregar modelo.");
+
+        printf("OK.\n");
+    }
+};
+
+// Nível de detalhe simplificado de uma shape (veja "meshlod.h"): outro
+// intervalo do mesmo vetor de índices, que referencia os mesmos vértices.
+struct MeshLod
+{
+    size_t first_index;
+    size_t num_indices;
+};
+
+// Grupo de triângulos vizinhos de uma shape (veja "meshcluster.h"): um
+// intervalo do vetor de índices, com os limites usados para descartá-lo
+// quando não estiver visível.
+struct MeshCluster
+{
+    size_t first_index;
+    size_t num_indices;
+
+    // Esfera envolvente, em coordenadas do modelo.
+    float  center[3];
+    float  radius;
+
+    // Cone de normais: o cluster está de costas para uma câmera em "p" se
+    // dot(normalize(cone_apex - p), cone_axis) >= cone_cutoff. Com
+    // cone_cutoff = 1 o cluster nunca é descartado por este teste.
+    float  cone_apex[3];
+    float  cone_axis[3];
+    float  cone_cutoff;
+};
+
+// Material de um arquivo ".mtl", com os parâmetros do modelo de iluminação
+// de Phong usados em "shader_fragment.glsl" (veja "meshmaterial.h").
+struct MeshMaterial
+{
+    std::string name;
+    float       ambient[3];      // Ka
+    float       diffuse[3];      // Kd
+    float       specular[3];     // Ks
+    float       shininess;       // Ns (expoente especular q)
+    std::string diffuse_texname; // map_Kd (vazio se não houver)
+
+    MeshMaterial() : shininess(1.0f)
+    {
+        for (int i = 0; i < 3; ++i)
+            ambient[i] = diffuse[i] = specular[i] = 0.0f;
+    }
+};
+
+// Intervalo do vetor de índices que corresponde a uma "shape" do arquivo
+// ".obj" com um único material. Shapes com vários materiais são divididas em
+// várias MeshShape com o mesmo nome, que viram as partes ("submeshes") de um
+// único SceneObject em g_VirtualScene.
+struct MeshShape
+{
+    std::string name;           // Nome do objeto
+    size_t      first_index;    // Posição do primeiro índice dentro de indices[]
+    size_t      num_indices;    // Número de índices do objeto
+    GLenum      rendering_mode; // Modo de rasterização (GL_TRIANGLES, ...)
+    int         material;       // Índice no vetor "materials" da malha, ou -1 (sem material)
+
+    // Esfera e caixa alinhada aos eixos (AABB) envolventes dos vértices da
+    // shape, em coordenadas do modelo.
+    float       bounds_center[3];
+    float       bounds_radius;
+    float       bounds_min[3];
+    float       bounds_max[3];
+
+    // Níveis de detalhe simplificados, do mais detalhado para o menos
+    // detalhado. O nível 0 (completo) é o próprio intervalo acima.
+    std::vector<MeshLod> lods;
+
+    // Clusters do nível completo, em ordem, cobrindo todo o intervalo
+    // [first_index, first_index + num_indices). Vazio se a shape não foi
+    // dividida.
+    std::vector<MeshCluster> clusters;
+
+    MeshShape()
+        : first_index(0), num_indices(0), rendering_mode(GL_TRIANGLES), material(-1), bounds_radius(0.0f)
+    {
+        bounds_center[0] = bounds_center[1] = bounds_center[2] = 0.0f;
+        bounds_min[0] = bounds_min[1] = bounds_min[2] = 0.0f;
+        bounds_max[0] = bounds_max[1] = bounds_max[2] = 0.0f;
+    }
+};
+
+// Malha de triângulos pronta para ser enviada à GPU: atributos de vértices
+// em vetores separados (um VBO para cada) e índices para glDrawElements().
+// Cada vértice (posição, normal e coordenada de textura) aparece uma única
+// vez e é compartilhado, através dos índices, por todos os triângulos que o
+// utilizam.
+struct MeshData
+{
+    std::vector<GLuint>    indices;
+    std::vector<float>     model_coefficients;   // 4 floats por vértice
+    std::vector<float>     normal_coefficients;  // 4 floats por vértice (pode estar vazio)
+    std::vector<float>     texture_coefficients; // 2 floats por vértice (pode estar vazio)
+    std::vector<MeshShape> shapes;
+    std::vector<MeshMaterial> materials;
+};
+
+// Visão (sem cópia) dos mesmos dados de um MeshData. Os ponteiros podem
+// apontar para vetores de um MeshData ou diretamente para um arquivo mapeado
+// em memória (veja "meshcache.h").
+struct MeshBuffers
+{
+    const GLuint* indices;              size_t num_indices;
+    const float*  model_coefficients;   size_t num_model_coefficients;
+    const float*  normal_coefficients;  size_t num_normal_coefficients;
+    const float*  texture_coefficients; size_t num_texture_coefficients;
+    std::vector<MeshShape> shapes;
+    std::vector<MeshMaterial> materials;
+};
+
+// Tipos dos atributos e dos índices de uma malha na GPU. O padrão é o
+// formato de MeshData (4 floats por posição e normal, 2 por coordenada de
+// textura, índices de 32 bits); "meshquant.h" escolhe formatos compactos.
+struct MeshVertexFormat
+{
+    GLenum position_type; // GL_FLOAT (4 floats) ou GL_UNSIGNED_SHORT (4 valores normalizados)
+    GLenum normal_type;   // GL_FLOAT (4 floats) ou GL_INT_2_10_10_10_REV
+    GLenum texture_type;  // GL_FLOAT ou GL_HALF_FLOAT (2 valores)
+    GLenum index_type;    // GL_UNSIGNED_INT ou GL_UNSIGNED_SHORT
+
+    // Transformação que leva as posições armazenadas de volta às coordenadas
+    // do modelo: posição = valor * position_scale + position_offset.
+    float position_scale[3];
+    float position_offset[3];
+
+    // Disposição dos atributos no VBO intercalado (veja MeshGpuBuffers). A
+    // posição fica no início de cada vértice; deslocamentos -1 indicam que o
+    // atributo não existe. stride = 0 indica que cada atributo está em seu
+    // próprio VBO.
+    GLsizei stride;
+    int     normal_offset;
+    int     texture_offset;
+
+    MeshVertexFormat()
+        : position_type(GL_FLOAT), normal_type(GL_FLOAT), texture_type(GL_FLOAT), index_type(GL_UNSIGNED_INT),
+          stride(0), normal_offset(-1), texture_offset(-1)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            position_scale[i]  = 1.0f;
+            position_offset[i] = 0.0f;
+        }
+    }
+};
+
+// Buffers de uma malha já enviados para a GPU. Durante o carregamento cada
+// atributo fica em seu próprio VBO, no formato de MeshData; para desenhar,
+// todos os atributos são intercalados em um único VBO, "vertices_id" (veja
+// "meshquant.h"), e os demais IDs de atributos ficam 0.
+struct MeshGpuBuffers
+{
+    GLuint vertices_id;             // VBO intercalado (0 se os atributos estão separados)
+    GLuint model_coefficients_id;   // VBO de posições
+    GLuint normal_coefficients_id;  // VBO de normais (0 se não existirem)
+    GLuint texture_coefficients_id; // VBO de coordenadas de textura (0 se não existirem)
+    GLuint indices_id;              // Buffer de índices (GL_ELEMENT_ARRAY_BUFFER)
+    size_t num_vertices;
+    size_t num_indices;
+    std::vector<MeshShape> shapes;
+    std::vector<MeshMaterial> materials;
+    MeshVertexFormat format;
+
+    MeshGpuBuffers()
+        : vertices_id(0), model_coefficients_id(0), normal_coefficients_id(0), texture_coefficients_id(0), indices_id(0),
+          num_vertices(0), num_indices(0)
+    {
+    }
+};
+
+// Constrói os vetores de atributos e índices de um ObjModel, unindo vértices
+// repetidos e dividindo cada shape por material. O modelo deve estar
+// triangulado.
+void BuildMeshData(const ObjModel* model, MeshData* mesh);
+
+// Converte os materiais lidos pela tinyobjloader.
+void BuildMeshMaterials(const std::vector<tinyobj::material_t>& materials, std::vector<MeshMaterial>* out);
+
+// Retorna uma visão dos vetores de um MeshData.
+MeshBuffers GetMeshBuffers(const MeshData& mesh);
+
+// Cria os buffers da GPU e copia para eles os dados de "buffers", sem
+// alterar o formato (veja também MeshQuant_UploadMeshBuffers()).
+void UploadMeshBuffers(const MeshBuffers& buffers, MeshGpuBuffers* gpu);
+
+#endif // _MESH_H
@@ -0,0 +1,109 @@
+#ifndef _MESHARENA_H
+#define _MESHARENA_H
+
+#include <vector>
+
+#include "mesh.h"
+
+// Geometria de todas as malhas da cena em poucos buffers compartilhados (uma
+// "arena"), para que objetos diferentes sejam desenhados sem trocar de VAO.
+//
+// Todas as malhas compartilham um único buffer de índices. Os vértices ficam
+// em um VBO por formato de vértice (veja MeshVertexFormat): como
+// "meshquant.h" escolhe o formato de cada malha, uma cena tem poucos
+// formatos diferentes, e cada um tem seu VAO. Uma malha ocupa um intervalo
+// de vértices do VBO do seu formato e um intervalo de bytes do buffer de
+// índices; os índices continuam relativos ao primeiro vértice da malha, que
+// é somado pela GPU com glDrawElementsBaseVertex() (OpenGL 3.2).
+//
+// As malhas chegam à arena já na GPU (veja "assetloader.h" e
+// "meshstream.h"): MeshArena_Add() copia seus buffers com
+// glCopyBufferSubData(), sem passar pela memória principal, e os apaga.
+//
+// Os intervalos livres de cada buffer são guardados em uma lista ordenada
+// por posição ("free list"). Cada alocação usa o menor intervalo livre que a
+// comporte ("best fit"), e um intervalo liberado é unido aos intervalos
+// livres vizinhos, de forma que carregar e descarregar modelos não
+// fragmenta a arena. Quando nenhum intervalo comporta uma alocação, o
+// buffer é substituído por outro com pelo menos o dobro do tamanho, copiado
+// na GPU; as posições já alocadas não mudam.
+//
+// As funções MeshArena_*() usam OpenGL e devem ser chamadas pela thread
+// principal (VAOs não são compartilhados entre contextos).
+
+// Tamanho inicial, em bytes, de cada VBO e do buffer de índices.
+#define MESHARENA_INITIAL_BYTES (16*1024*1024)
+
+// Alinhamento, em bytes, das malhas dentro do buffer de índices (o maior
+// tamanho de índice, veja MeshQuant_IndexSize()).
+#define MESHARENA_INDEX_ALIGNMENT 4
+
+// Intervalo [offset, offset + size) de um buffer, em vértices ou em bytes.
+struct MeshArenaRange
+{
+    size_t offset;
+    size_t size;
+};
+
+// Alocador de intervalos de um buffer com "capacity" unidades. Não usa
+// OpenGL.
+struct MeshArenaAllocator
+{
+    size_t                      capacity;
+    std::vector<MeshArenaRange> free_ranges; // Ordenados por offset; dois intervalos livres nunca são vizinhos
+
+    MeshArenaAllocator() : capacity(0) {}
+};
+
+// Esvazia o alocador, com todas as "capacity" unidades livres.
+void MeshArenaAllocator_Init(MeshArenaAllocator* allocator, size_t capacity);
+
+// Aloca "size" unidades com início múltiplo de "alignment". Retorna false se
+// nenhum intervalo livre as comporta.
+bool MeshArenaAllocator_Alloc(MeshArenaAllocator* allocator, size_t size, size_t alignment, size_t* offset);
+
+// Libera um intervalo retornado por MeshArenaAllocator_Alloc().
+void MeshArenaAllocator_Free(MeshArenaAllocator* allocator, size_t offset, size_t size);
+
+// Aumenta a capacidade para "capacity" unidades; as novas unidades ficam
+// livres.
+void MeshArenaAllocator_Grow(MeshArenaAllocator* allocator, size_t capacity);
+
+// Malha guardada na arena.
+struct MeshArenaMesh
+{
+    int    pool;         // Formato de vértice (veja MeshArena_VertexArray()), ou -1 se a malha foi liberada
+    size_t first_vertex; // Primeiro vértice no VBO do formato ("base vertex")
+    size_t num_vertices;
+    size_t index_offset; // Posição, em bytes, do primeiro índice no buffer de índices
+    size_t index_bytes;
+    int    references;
+};
+
+// Inicializa a arena, ainda sem buffers. "create_vertex_array" cria um VAO
+// para os buffers de um MeshGpuBuffers intercalado (veja
+// CreateMeshVertexArray() em "main.cpp"); é chamada sempre que os buffers de
+// um formato mudam.
+void MeshArena_Init(GLuint (*create_vertex_array)(const MeshGpuBuffers& gpu));
+
+// Copia para a arena os buffers de "gpu", cujos atributos devem estar
+// intercalados em gpu.vertices_id (veja "meshquant.h"), e apaga esses
+// buffers. Retorna a malha, com uma referência.
+int MeshArena_Add(const MeshGpuBuffers& gpu);
+
+// Acrescenta ou remove uma referência a uma malha. Quando a última
+// referência é removida, seus intervalos voltam a ficar livres.
+void MeshArena_AddReference(int mesh);
+void MeshArena_Release(int mesh);
+
+// Dados de uma malha retornada por MeshArena_Add().
+const MeshArenaMesh& MeshArena_Mesh(int mesh);
+
+// VAO do formato de vértice "pool" (veja MeshArenaMesh). Muda quando a arena
+// cresce, então não deve ser guardado.
+GLuint MeshArena_VertexArray(int pool);
+
+// Apaga todos os buffers e VAOs.
+void MeshArena_Shutdown();
+
+#endif // _MESHARENA_H
@@ -0,0 +1,68 @@
+#ifndef _MESHCACHE_H
+#define _MESHCACHE_H
+
+#include <string>
+
+#include "mesh.h"
+#include "mappedfile.h"
+
+// Cache binário de malhas. Para cada arquivo ".obj" carregado guardamos, no
+// arquivo "<nome>.obj.meshcache", os vetores finais de atributos e índices
+// (exatamente como são enviados para a GPU), os intervalos de cada shape e os
+// materiais.
+// O cache é identificado pelo caminho, tamanho, data de modificação e hash do
+// conteúdo do ".obj"; se qualquer um destes mudar, o cache é reconstruído.
+// Alterações apenas no arquivo ".mtl" não são detectadas: nesse caso, basta
+// apagar o arquivo de cache.
+//
+// Quando o cache é válido, o arquivo é mapeado em memória e os ponteiros de
+// MeshCacheEntry::buffers apontam diretamente para o mapeamento, de forma que
+// glBufferData() lê os dados sem nenhuma cópia intermediária.
+
+// Incrementar sempre que o formato do arquivo ou o conteúdo de MeshData mudar.
+#define MESHCACHE_VERSION 7
+
+struct MeshCacheEntry
+{
+    MappedFile  file;    // Arquivo de cache mapeado em memória
+    MeshBuffers buffers; // Ponteiros para dentro de "file"
+};
+
+// Caminho do arquivo de cache correspondente a "source_filename".
+std::string MeshCache_Path(const char* source_filename);
+
+// Tenta abrir o cache de "source_filename". Retorna false caso o cache não
+// exista ou esteja desatualizado.
+bool MeshCache_Load(const char* source_filename, MeshCacheEntry* entry);
+
+// Interpreta um cache que já está em memória (por exemplo, dentro de um
+// pacote de assets; veja "assetpack.h"). Os dados não são comparados com o
+// ".obj" de origem, que pode nem existir. "data" deve estar alinhado em 16
+// bytes e continuar válido enquanto "entry" for usada. Retorna false se o
+// cache for inválido ou de outra versão.
+bool MeshCache_LoadFromMemory(const void* data, size_t size, MeshCacheEntry* entry);
+
+// Libera o mapeamento criado por MeshCache_Load().
+void MeshCache_Close(MeshCacheEntry* entry);
+
+// Grava o cache de "source_filename". Retorna false em caso de erro de escrita
+// (por exemplo, diretório somente leitura); o programa continua funcionando,
+// apenas sem cache.
+bool MeshCache_Store(const char* source_filename, const MeshData& mesh);
+
+// Igual a MeshCache_Store(), mas lê os dados diretamente dos buffers da GPU
+// (em partes, sem copiar a malha inteira para a memória principal). Usada
+// após MeshStream_LoadObj().
+bool MeshCache_StoreFromGpu(const char* source_filename, const MeshGpuBuffers& gpu);
+
+// Grava em "cache_path" um tile de um modelo dividido por "meshtile.h". A
+// validade do tile em relação ao ".obj" é controlada pelo índice de tiles:
+// o cabeçalho guarda apenas "source_hash", o hash do ".obj" registrado no
+// índice.
+bool MeshCache_StoreTile(const char* cache_path, uint64_t source_hash, const MeshData& mesh);
+
+// Abre um tile gravado por MeshCache_StoreTile(). Retorna false se o arquivo
+// não existir, for inválido ou tiver sido gerado a partir de outro ".obj".
+bool MeshCache_LoadTile(const char* cache_path, uint64_t source_hash, MeshCacheEntry* entry);
+
+#endif // _MESHCACHE_H
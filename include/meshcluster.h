@@ -0,0 +1,65 @@
+#ifndef _MESHCLUSTER_H
+#define _MESHCLUSTER_H
+
+#include "mesh.h"
+
+// Divisão de cada shape em clusters ("meshlets") de poucos triângulos
+// vizinhos, para que partes de um modelo que não aparecem na tela não sejam
+// enviadas para a GPU.
+//
+// Os clusters são construídos por crescimento de região: a partir de um
+// triângulo inicial, acrescentamos sempre o triângulo adjacente que adiciona
+// menos vértices novos (com desempate pelos vértices que ficam sem vizinhos e
+// pela distância ao centro do cluster), até atingir MESHCLUSTER_MAX_VERTICES vértices ou
+// MESHCLUSTER_MAX_TRIANGLES triângulos. Os índices da shape são reordenados
+// para que cada cluster seja um intervalo contínuo, e cada cluster é
+// otimizado para o cache de vértices (veja "meshopt.h").
+//
+// Cada cluster guarda uma esfera envolvente e um cone de normais (eixo e
+// abertura que contêm as normais de todos os seus triângulos, como em
+// meshoptimizer). A cada quadro, DrawVirtualObject() (em "main.cpp") descarta
+// os clusters fora do frustum da câmera ou cujos triângulos estão todos de
+// costas para ela, e desenha os restantes com glMultiDrawElements().
+//
+// Apenas o nível de detalhe completo é dividido em clusters; os níveis
+// simplificados (veja "meshlod.h") já têm poucos triângulos.
+
+// Limites de cada cluster (os mesmos recomendados para "mesh shaders").
+#define MESHCLUSTER_MAX_VERTICES  64
+#define MESHCLUSTER_MAX_TRIANGLES 124
+
+// Shapes com menos triângulos que isso não são divididas.
+#define MESHCLUSTER_MIN_TRIANGLES 512
+
+// Câmera em coordenadas do modelo, usada por MeshCluster_IsVisible(). Como
+// tudo é calculado no espaço do modelo, os testes valem para qualquer matriz
+// de modelagem (inclusive com escalas diferentes em cada eixo).
+struct MeshClusterView
+{
+    float planes[6][4];  // Planos do frustum, com normais apontando para dentro
+    float position[3];   // Posição da câmera (projeção perspectiva)
+    float direction[3];  // Direção de visão, normalizada (projeção ortográfica)
+    bool  perspective;
+};
+
+// Divide cada shape de "mesh" em clusters, reordenando seus índices.
+void MeshCluster_GenerateClusters(MeshData* mesh);
+
+// Mesmo que MeshCluster_GenerateClusters(), para uma malha que já está na
+// GPU no formato de MeshData (veja MeshStream_LoadObj()).
+void MeshCluster_GenerateGpuClusters(MeshGpuBuffers* gpu);
+
+// Imprime o número de clusters de cada shape. Assim como em
+// MeshLod_PrintLods(), a geração não imprime nada por conta própria.
+void MeshCluster_PrintClusters(const std::vector<MeshShape>& shapes);
+
+// Extrai os planos do frustum de uma matriz que leva coordenadas do modelo
+// para coordenadas de recorte (projection * view * model), guardada coluna a
+// coluna como em glm::value_ptr().
+void MeshCluster_ExtractPlanes(const float clip_from_model[16], MeshClusterView* view);
+
+// Retorna false se o cluster está fora do frustum ou totalmente de costas
+// para a câmera.
+bool MeshCluster_IsVisible(const MeshCluster& cluster, const MeshClusterView& view);
+
+#endif // _MESHCLUSTER_H
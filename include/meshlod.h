@@ -0,0 +1,55 @@
+#ifndef _MESHLOD_H
+#define _MESHLOD_H
+
+#include "mesh.h"
+
+// Níveis de detalhe (LODs) gerados no carregamento de cada modelo. Cada shape
+// é simplificada com a métrica de erro quádrica de Garland e Heckbert
+// ("Surface Simplification Using Quadric Error Metrics", 1997): arestas são
+// colapsadas, em ordem de menor erro, levando um vértice até um de seus
+// vizinhos. Como nenhum vértice novo é criado, os LODs são apenas novos
+// intervalos do vetor de índices (veja MeshLod em "mesh.h"), e usam o mesmo
+// VBO do modelo completo.
+//
+// Para preservar o contorno e as costuras de atributos, vértices de borda e
+// vértices que compartilham a posição com outro vértice (normal ou
+// coordenada de textura diferentes) nunca são removidos.
+//
+// DrawVirtualObject() (em "main.cpp") escolhe o nível pelo tamanho da esfera
+// envolvente da shape projetada na tela; veja MeshLod_SelectLevel().
+
+// Número máximo de níveis simplificados por shape (além do completo).
+#define MESHLOD_MAX_LEVELS 4
+
+// Cada nível tem cerca de 1/MESHLOD_REDUCTION dos triângulos do anterior.
+#define MESHLOD_REDUCTION 4
+
+// Shapes, ou níveis, com menos triângulos que isso não são simplificados.
+#define MESHLOD_MIN_TRIANGLES 64
+
+// Diâmetro projetado, em pixels, a partir do qual o modelo completo é
+// desenhado. Cada nível seguinte é usado a partir da metade do tamanho do
+// anterior: como a área projetada cai para 1/4 e o número de triângulos
+// também, a densidade de triângulos por pixel se mantém.
+#define MESHLOD_FULL_DETAIL_PIXELS 400.0f
+
+// Calcula a esfera envolvente de cada shape e gera seus níveis de detalhe,
+// acrescentando os índices de cada nível ao final de mesh->indices.
+void MeshLod_GenerateLods(MeshData* mesh);
+
+// Mesmo que MeshLod_GenerateLods(), para uma malha que já está na GPU no
+// formato de MeshData (veja MeshStream_LoadObj()). O buffer de índices é
+// substituído por um maior, que inclui os níveis de detalhe.
+void MeshLod_GenerateGpuLods(MeshGpuBuffers* gpu);
+
+// Imprime o número de triângulos de cada nível de detalhe das shapes. As
+// funções acima não imprimem nada; quem as chama decide se o resumo é útil
+// (por exemplo, não a cada tile nem em benchmarks).
+void MeshLod_PrintLods(const std::vector<MeshShape>& shapes);
+
+// Escolhe o nível de detalhe (0 = completo) para uma shape com "num_lods"
+// níveis simplificados, cuja esfera envolvente ocupa "projected_diameter"
+// pixels na tela.
+int MeshLod_SelectLevel(float projected_diameter, size_t num_lods);
+
+#endif // _MESHLOD_H
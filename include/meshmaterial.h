@@ -0,0 +1,52 @@
+#ifndef _MESHMATERIAL_H
+#define _MESHMATERIAL_H
+
+#include "mesh.h"
+
+// Materiais na GPU. Os parâmetros de todos os materiais dos modelos
+// carregados ficam em um único "uniform buffer object" (UBO), ligado ao
+// bloco "MaterialBlock" de "shader_fragment.glsl". Cada parte de um
+// SceneObject guarda apenas a posição do seu material nesse buffer, enviada
+// ao shader na variável "material_index": trocar de material entre dois
+// desenhos custa um glUniform1i(), sem trocar de buffer nem de programa.
+//
+// As partes de cada objeto são ordenadas por material (veja
+// AddMeshToVirtualScene() em "main.cpp"), e "material_index" só é enviada
+// quando o material muda.
+//
+// As posições do UBO têm contagem de referências, como as malhas de
+// "mesharena.h": cada SceneObject guarda uma referência a cada material que
+// usa, removida quando o objeto é substituído ou descarregado. Posições sem
+// referências voltam para uma lista de posições livres e são reutilizadas por
+// MeshMaterial_Add().
+
+// Número máximo de materiais; deve ser igual a MAX_MATERIALS em
+// "shader_fragment.glsl". 256 materiais ocupam 12 KB, dentro do mínimo de
+// 16 KB por bloco garantido pelo OpenGL 3.3.
+#define MESHMATERIAL_MAX_MATERIALS 256
+
+// Ponto de ligação ("binding point") do UBO de materiais.
+#define MESHMATERIAL_BINDING 0
+
+// Cria o UBO de materiais e o liga a MESHMATERIAL_BINDING.
+void MeshMaterial_Init();
+
+// Liga o bloco "MaterialBlock" de "program_id" a MESHMATERIAL_BINDING. Deve
+// ser chamada sempre que o programa de GPU for recriado.
+void MeshMaterial_BindProgram(GLuint program_id);
+
+// Copia "material" para o UBO e retorna sua posição, com uma referência, ou
+// -1 se o UBO estiver cheio (nesse caso o objeto é desenhado com as cores
+// escolhidas por "object_id").
+int MeshMaterial_Add(const MeshMaterial& material);
+
+// Acrescenta ou remove uma referência a uma posição retornada por
+// MeshMaterial_Add(). Quando a última referência é removida, a posição volta
+// a ficar livre. Posições negativas são ignoradas.
+void MeshMaterial_AddReference(int index);
+void MeshMaterial_Release(int index);
+
+// Apaga o UBO.
+void MeshMaterial_Shutdown();
+
+#endif // _MESHMATERIAL_H
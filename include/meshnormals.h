@@ -0,0 +1,35 @@
+#ifndef _MESHNORMALS_H
+#define _MESHNORMALS_H
+
+#include "mesh.h"
+
+// Cálculo das normais de vértices de modelos ".obj" que não as especificam
+// (sem linhas "vn"). Como proposto por Gouraud, a normal de cada vértice é a
+// média das normais de todos os triângulos que o compartilham; somamos os
+// produtos vetoriais sem normalizá-los, então triângulos maiores têm mais
+// peso.
+//
+// Os triângulos são divididos entre threads, e cada thread acumula as normais
+// em um buffer próprio (evitando conflitos de escrita entre threads). Os
+// buffers são então somados e normalizados, também em paralelo, com cada
+// thread responsável por um intervalo de vértices. Com SSE, os produtos
+// vetoriais são calculados para 4 triângulos de uma vez e a normalização é
+// feita para 4 vértices de uma vez; em outras arquiteturas o mesmo código é
+// executado um elemento por vez.
+
+// Número máximo de threads. Cada thread precisa de um buffer com 3 floats por
+// vértice.
+#define MESHNORMALS_MAX_THREADS 8
+
+// Número mínimo de triângulos por thread: modelos pequenos usam menos threads
+// (ou apenas a thread atual), já que criar threads também tem um custo.
+#define MESHNORMALS_MIN_TRIANGLES_PER_THREAD 65536
+
+// Computa as normais de "model", caso não existam: preenche
+// model->attrib.normals, com uma normal por posição, e faz o normal_index de
+// cada índice apontar para a normal da sua posição. Vértices que não fazem
+// parte de nenhum triângulo (ou só de triângulos degenerados) recebem a
+// normal nula.
+void MeshNormals_Compute(ObjModel* model);
+
+#endif // _MESHNORMALS_H
@@ -0,0 +1,63 @@
+#ifndef _MESHOPT_H
+#define _MESHOPT_H
+
+#include "mesh.h"
+
+// Otimização de malhas indexadas, executada entre o carregamento e o envio
+// para a GPU (veja LoadModelAndAddToVirtualScene() em "main.cpp"). Três
+// etapas são aplicadas, separadamente para cada shape:
+//
+//  1. Reordenação dos triângulos para o cache de vértices pós-transformação
+//     da GPU, com o algoritmo de Tom Forsyth ("Linear-Speed Vertex Cache
+//     Optimisation", 2006). Vértices que acabaram de ser processados pelo
+//     vertex shader são reaproveitados, reduzindo o número de invocações.
+//  2. Reordenação para reduzir overdraw, independente do ponto de vista
+//     (Sander, Nehab e Barczak, "Fast Triangle Reordering for Vertex Locality
+//     and Reduced Overdraw", 2007): a sequência de triângulos é dividida em
+//     grupos que mantêm a eficiência do cache, e os grupos voltados para fora
+//     do modelo são desenhados primeiro.
+//  3. Reordenação dos vértices na ordem em que são usados pelos índices, para
+//     que a leitura dos atributos pela GPU seja sequencial.
+
+// Tamanho do cache FIFO simulado para calcular ACMR e ATVR.
+#define MESHOPT_ANALYSIS_CACHE_SIZE 16
+
+// Tamanho do cache LRU usado pelo algoritmo de Forsyth.
+#define MESHOPT_FORSYTH_CACHE_SIZE 32
+
+// Quanto o ACMR de cada grupo pode piorar, relativo ao ACMR após a etapa 1,
+// em troca de uma ordem melhor para overdraw.
+#define MESHOPT_OVERDRAW_THRESHOLD 1.05f
+
+// Métricas de eficiência do cache de vértices.
+struct MeshOptStats
+{
+    float acmr; // Average Cache Miss Ratio: execuções do vertex shader por triângulo (0.5 a 3.0)
+    float atvr; // Average Transformed Vertex Ratio: execuções por vértice referenciado (1.0 é o ideal)
+};
+
+struct MeshOptReport
+{
+    MeshOptStats before;
+    MeshOptStats after;
+};
+
+// Simula um cache FIFO de "cache_size" vértices e calcula ACMR e ATVR.
+MeshOptStats MeshOpt_AnalyzeVertexCache(const GLuint* indices, size_t num_indices, size_t num_vertices, unsigned int cache_size = MESHOPT_ANALYSIS_CACHE_SIZE);
+
+// Aplica apenas a etapa 1 em uma lista de triângulos (usada também pelos
+// níveis de detalhe, veja "meshlod.h").
+void MeshOpt_OptimizeVertexCache(GLuint* indices, size_t num_indices, size_t num_vertices);
+
+// Aplica as três etapas em um MeshData.
+void MeshOpt_OptimizeMesh(MeshData* mesh, MeshOptReport* report);
+
+// Aplica as três etapas em uma malha que já está na GPU (veja
+// MeshStream_LoadObj()). Os índices e as posições são lidos para a memória
+// principal; os demais atributos são reordenados um de cada vez.
+void MeshOpt_OptimizeGpuMesh(MeshGpuBuffers* gpu, MeshOptReport* report);
+
+// Imprime o ACMR e o ATVR antes e depois da otimização.
+void MeshOpt_PrintReport(const MeshOptReport& report);
+
+#endif // _MESHOPT_H
@@ -0,0 +1,75 @@
+#ifndef _MESHQUANT_H
+#define _MESHQUANT_H
+
+#include "mesh.h"
+
+// Formato compacto e intercalado de vértices. Com floats em VBOs separados,
+// cada vértice ocupa 40 bytes (posição e normal com 4 floats, coordenada de
+// textura com 2); no formato final, todos os atributos de um vértice ficam
+// lado a lado em um único VBO por malha, ocupando 16 bytes:
+//
+//  - posição: 4 x GL_UNSIGNED_SHORT normalizados (o quarto é enchimento, para
+//    manter o alinhamento de 4 bytes), relativos à caixa envolvente da malha.
+//    O vertex shader reconstrói a posição com os uniforms "position_scale" e
+//    "position_offset" (veja MeshVertexFormat em "mesh.h");
+//  - normal: GL_INT_2_10_10_10_REV normalizado, 10 bits com sinal por eixo;
+//  - coordenada de textura: 2 x GL_HALF_FLOAT.
+//
+// Atributos ausentes não ocupam espaço. Além disso, malhas com até 65536
+// vértices usam índices de 16 bits. O formato é escolhido separadamente para
+// cada malha e cada atributo: as coordenadas de textura só são convertidas
+// se o erro do half float não passar de MESHQUANT_MAX_TEXTURE_ERROR.
+// Posições não precisam de teste: o erro de 16 bits é de 1/131070 do tamanho
+// da malha em cada eixo.
+
+// Maior erro aceito ao converter coordenadas de textura para half float
+// (equivale a coordenadas entre -4 e 4).
+#define MESHQUANT_MAX_TEXTURE_ERROR (1.0f/1024.0f)
+
+// Escolhe o formato de cada atributo de "buffers" e a disposição do VBO
+// intercalado.
+MeshVertexFormat MeshQuant_ChooseFormat(const MeshBuffers& buffers);
+
+// Malha já convertida para o formato compacto, em memória principal: o
+// conteúdo exato do VBO intercalado e do buffer de índices. Pode ser
+// preparada em qualquer thread (veja "assetloader.h").
+struct MeshEncodedData
+{
+    std::vector<unsigned char> vertices; // num_vertices * format.stride bytes
+    std::vector<unsigned char> indices;  // num_indices * MeshQuant_IndexSize(format.index_type) bytes
+    size_t                     num_vertices;
+    size_t                     num_indices;
+    std::vector<MeshShape>     shapes;
+    std::vector<MeshMaterial>  materials;
+    MeshVertexFormat           format;
+
+    MeshEncodedData() : num_vertices(0), num_indices(0) {}
+};
+
+// Escolhe o formato com MeshQuant_ChooseFormat() e converte os atributos e
+// índices de "buffers". Não usa OpenGL.
+void MeshQuant_EncodeMesh(const MeshBuffers& buffers, MeshEncodedData* encoded);
+
+// Cria os buffers da GPU para "encoded", sem copiar os dados (que podem ser
+// enviados em partes com glBufferSubData()).
+void MeshQuant_CreateGpuBuffers(const MeshEncodedData& encoded, MeshGpuBuffers* gpu);
+
+// Cria os buffers da GPU e copia para eles os dados de "encoded".
+void MeshQuant_UploadEncoded(const MeshEncodedData& encoded, MeshGpuBuffers* gpu);
+
+// MeshQuant_EncodeMesh() seguido de MeshQuant_UploadEncoded(): o resultado
+// fica em um único VBO, "gpu->vertices_id". Substitui UploadMeshBuffers().
+void MeshQuant_UploadMeshBuffers(const MeshBuffers& buffers, MeshGpuBuffers* gpu);
+
+// Converte para o formato compacto uma malha que já está na GPU com o
+// formato de MeshData (veja MeshStream_LoadObj()). Os VBOs separados de
+// cada atributo são lidos, convertidos para o VBO intercalado e apagados.
+void MeshQuant_QuantizeGpuMesh(MeshGpuBuffers* gpu);
+
+// Número de bytes de cada índice.
+size_t MeshQuant_IndexSize(GLenum index_type);
+
+// Imprime o formato escolhido e a redução de tamanho.
+void MeshQuant_PrintFormat(const MeshGpuBuffers& gpu);
+
+#endif // _MESHQUANT_H
@@ -0,0 +1,35 @@
+#ifndef _MESHSTREAM_H
+#define _MESHSTREAM_H
+
+#include "mesh.h"
+
+// Carregamento de modelos ".obj" diretamente para a GPU, sem construir um
+// ObjModel nem um MeshData completos em memória.
+//
+// O arquivo é lido linha a linha com tinyobj::LoadObjWithCallback(). Cada
+// face é triangulada e seus vértices são escritos, já no formato final de
+// MeshData, em buffers intermediários de tamanho fixo que são enviados para a
+// GPU com glBufferSubData() sempre que enchem. Em memória principal ficam
+// apenas os atributos "v", "vn" e "vt" do arquivo (necessários porque as faces
+// podem referenciar qualquer vértice anterior), uma tabela hash com a tupla de
+// índices de cada vértice já emitido (para que vértices repetidos sejam
+// compartilhados) e, quando o arquivo não tem normais, o índice da posição de
+// cada vértice emitido, usado para calcular as normais ao final (veja
+// MeshNormals_Compute() em "meshnormals.h").
+
+// Arquivos ".obj" a partir deste tamanho são carregados com
+// MeshStream_LoadObj(); os menores usam ObjModel, que é mais rápido mas
+// mantém várias cópias do modelo em memória.
+#define MESHSTREAM_MIN_FILE_SIZE (64ull*1024*1024)
+
+// Número de vértices acumulados antes de cada envio para a GPU.
+#define MESHSTREAM_STAGING_VERTICES 65536
+
+// Carrega "filename" para buffers da GPU. O resultado é equivalente a
+// ObjModel + MeshNormals_Compute() + BuildMeshData() + UploadMeshBuffers(),
+// exceto que os triângulos não são reagrupados por material: cada sequência
+// de faces após um "usemtl" vira uma MeshShape, na ordem do arquivo.
+// Lança std::runtime_error em caso de erro.
+void MeshStream_LoadObj(const char* filename, MeshGpuBuffers* gpu);
+
+#endif // _MESHSTREAM_H
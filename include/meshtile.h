@@ -0,0 +1,97 @@
+#ifndef _MESHTILE_H
+#define _MESHTILE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "mesh.h"
+#include "meshcache.h"
+
+// Carregamento "out-of-core" de arquivos ".obj" maiores que a memória
+// principal (por exemplo, nuvens de pontos trianguladas de LiDAR ou
+// fotogrametria). Nem ObjModel nem MeshStream_LoadObj() (veja
+// "meshstream.h") servem para estes arquivos: ambos mantêm em memória todos
+// os atributos do arquivo.
+//
+// O modelo é dividido em tiles espaciais, cada um processado e guardado
+// separadamente, em duas leituras do arquivo:
+//
+//  1. Os atributos "v", "vn" e "vt" são copiados, em binário, para arquivos
+//     temporários em disco, e calculamos a caixa envolvente das posições.
+//     Com um histograma das posições em uma grade de MESHTILE_GRID_SIZE
+//     células por eixo, a caixa é dividida recursivamente (como em uma
+//     kd-tree, na mediana do eixo mais longo) até que cada região tenha
+//     triângulos suficientes para caber no orçamento de memória.
+//  2. Cada face é triangulada e cada triângulo (apenas os índices dos seus
+//     atributos) é colocado no tile que contém seu centroide. Os triângulos
+//     são acumulados em memória e, quando o espaço reservado acaba, escritos
+//     em um arquivo temporário, em blocos de um único tile.
+//
+// Por fim, os triângulos de cada tile são lidos de volta e convertidos em
+// um ObjModel (com os atributos lidos dos arquivos temporários), que passa
+// pelo mesmo processamento dos demais modelos (normais, BuildMeshData() e a
+// função "process") e é gravado como um cache de malha próprio (veja
+// MeshCache_StoreTile()). O índice "<nome>.obj.tiles" guarda a caixa de cada
+// tile e identifica o ".obj" como em "meshcache.h". Cada tile é depois
+// carregado como um modelo independente, com no máximo alguns milhões de
+// triângulos.
+//
+// Os arquivos temporários são lidos com MapFile(): suas páginas pertencem
+// ao cache de arquivos do sistema operacional, que as descarta quando
+// necessário, e não contam para o orçamento. Se o arquivo não tiver normais,
+// elas são calculadas em cada tile separadamente; nas bordas entre tiles a
+// normal considera apenas os triângulos do próprio tile.
+
+// Arquivos ".obj" a partir deste tamanho são carregados em tiles.
+#define MESHTILE_MIN_FILE_SIZE (1024ull*1024*1024)
+
+// Memória principal usada por padrão durante a divisão em tiles.
+#define MESHTILE_DEFAULT_MEMORY_BUDGET (512ull*1024*1024)
+
+// Número de células do histograma de posições no eixo mais longo da caixa
+// envolvente. Os tiles são uniões de células.
+#define MESHTILE_GRID_SIZE 64
+
+// Estimativa da memória necessária para processar cada triângulo de um tile
+// (ObjModel, MeshData, otimização e níveis de detalhe).
+#define MESHTILE_BYTES_PER_TRIANGLE 256
+
+// Incrementar sempre que o formato do índice ou a divisão em tiles mudar.
+#define MESHTILE_VERSION 1
+
+struct MeshTileInfo
+{
+    float    bounds_min[3]; // Caixa envolvente das posições do tile
+    float    bounds_max[3];
+    uint64_t num_triangles;
+};
+
+struct MeshTileIndex
+{
+    uint64_t                  source_hash; // Hash do ".obj" (veja MeshCache_LoadTile())
+    std::vector<MeshTileInfo> tiles;
+};
+
+// Caminho do índice de tiles de "source_filename".
+std::string MeshTile_IndexPath(const char* source_filename);
+
+// Caminho do cache de malha do tile "tile" de "source_filename".
+std::string MeshTile_TilePath(const char* source_filename, size_t tile);
+
+// Lê o índice de tiles de "source_filename". Retorna false caso o índice não
+// exista ou esteja desatualizado.
+bool MeshTile_LoadIndex(const char* source_filename, MeshTileIndex* index);
+
+// Divide "source_filename" em tiles, usando no máximo "memory_budget" bytes
+// de memória principal, e grava os tiles e o índice. "process" é aplicada à
+// malha de cada tile antes de ela ser gravada (otimização, níveis de
+// detalhe, ...). Apenas uma divisão é executada por vez, mesmo que seja
+// chamada por várias threads. Lança std::runtime_error em caso de erro.
+void MeshTile_Build(const char* source_filename, size_t memory_budget, void (*process)(MeshData* mesh), MeshTileIndex* index);
+
+// Abre o cache do tile "tile" de "source_filename", cujo índice deve estar
+// atualizado. Retorna false se o tile não existir ou for inválido.
+bool MeshTile_LoadTile(const char* source_filename, size_t tile, MeshCacheEntry* entry);
+
+#endif // _MESHTILE_H
@@ -0,0 +1,82 @@
+#ifndef _OCCLUSIONCULL_H
+#define _OCCLUSIONCULL_H
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+// Descarte de objetos escondidos atrás de outros ("occlusion culling") com
+// consultas de oclusão da GPU (GL_ANY_SAMPLES_PASSED, OpenGL 3.3). Para
+// consultar um objeto, a sua caixa envolvente é desenhada depois da cena,
+// sem escrever cor nem profundidade: se nenhum fragmento da caixa passa no
+// teste de profundidade, o objeto está inteiramente escondido.
+//
+// Os resultados não são esperados no quadro em que as consultas são feitas,
+// o que pararia a CPU até a GPU terminar o quadro. Como no algoritmo CHC++
+// (Mattausch, Bittner e Wimmer, 2008), cada objeto guarda o último resultado
+// lido, e a visibilidade de um quadro para o seguinte muda pouco
+// ("coerência temporal"):
+//
+//   - Um objeto visível é desenhado normalmente e só é consultado de novo
+//     depois de OCCLUSIONCULL_VISIBLE_FRAMES quadros, sozinho. As primeiras
+//     consultas são espalhadas entre os quadros, para não serem feitas todas
+//     juntas.
+//   - Os objetos escondidos são consultados a cada quadro em grupos: uma
+//     única consulta ("multiquery") desenha as caixas de todos os objetos de
+//     um grupo, e os objetos são desenhados com glBeginConditionalRender()
+//     sobre essa consulta. A própria GPU descarta os desenhos se nenhuma
+//     caixa passou, sem que a CPU espere o resultado, e um objeto que
+//     reaparece é desenhado no mesmo quadro. Se um grupo de vários objetos
+//     fica visível, cada um deles é consultado sozinho no quadro seguinte.
+//
+// Todas as caixas de um quadro são enviadas em um único buffer, e cada
+// consulta é um único desenho com instâncias, uma por caixa.
+//
+// Os resultados são lidos no início do quadro seguinte, em ordem, até a
+// primeira consulta que ainda não terminou (GL_QUERY_RESULT_AVAILABLE).
+// Enquanto um objeto visível tem consulta sem resultado, ele não é
+// consultado de novo.
+//
+// Os objetos são identificados por posições 0, 1, 2, ... escolhidas por quem
+// chama (em "main.cpp", as colocações da cena). As funções OcclusionCull_*()
+// usam OpenGL e devem ser chamadas pela thread principal.
+
+// Número de quadros em que um objeto visível continua visível sem ser
+// consultado.
+#define OCCLUSIONCULL_VISIBLE_FRAMES 8
+
+// Cria o programa de GPU, o VAO e o buffer usados para desenhar as caixas.
+void OcclusionCull_Init();
+
+// Começa um quadro com "num_objects" objetos: os objetos novos começam
+// visíveis, e os resultados já disponíveis das consultas anteriores são
+// lidos.
+void OcclusionCull_BeginFrame(size_t num_objects);
+
+// Último resultado lido para um objeto. Objetos nunca consultados são
+// visíveis.
+bool OcclusionCull_IsVisible(size_t object);
+
+// Retorna true se o objeto deve ser consultado neste quadro: ele está
+// escondido, ou está visível há OCCLUSIONCULL_VISIBLE_FRAMES quadros e não
+// tem consulta sem resultado.
+bool OcclusionCull_NeedsQuery(size_t object);
+
+// Acrescenta a caixa [minimum, maximum] de um objeto, em coordenadas do
+// mundo, ao grupo atual.
+void OcclusionCull_AddBox(size_t object, const float minimum[3], const float maximum[3]);
+
+// Fecha o grupo atual, com as caixas acrescentadas desde a última chamada, e
+// retorna a consulta do grupo, para glBeginConditionalRender() depois de
+// OcclusionCull_IssueQueries(), ou 0 se o grupo está vazio.
+GLuint OcclusionCull_EndGroup();
+
+// Desenha as caixas dos grupos fechados no quadro, uma consulta por grupo,
+// sem escrever cor nem profundidade. "clip_from_world" é a matriz
+// projection * view, coluna a coluna. O programa e o VAO ficam desligados.
+void OcclusionCull_IssueQueries(const float clip_from_world[16]);
+
+// Apaga as consultas, o programa, o VAO e o buffer.
+void OcclusionCull_Shutdown();
+
+#endif // _OCCLUSIONCULL_H
@@ -0,0 +1,65 @@
+#ifndef _RENDERQUEUE_H
+#define _RENDERQUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fila de desenhos. Em vez de desenhar cada objeto na ordem em que aparece no
+// código, a cena envia um "pacote" por desenho, com uma chave de 64 bits que
+// descreve o estado de OpenGL de que ele precisa. A cada quadro a fila é
+// ordenada pelas chaves e executada em ordem (veja DrawSceneQueue() em
+// "main.cpp"), de forma que desenhos com o mesmo estado ficam juntos e cada
+// troca de estado é feita uma única vez.
+//
+// Os campos da chave, do mais significativo para o menos significativo:
+//
+//     passo (4 bits) | programa (8) | VAO (8) | material (12) | profundidade (32)
+//
+// Trocar de programa é a mudança mais cara, seguida do VAO e do material.
+// Dentro de um mesmo estado, os desenhos vão da frente para trás, para que o
+// teste de profundidade descarte o máximo de fragmentos.
+//
+// A fila ordena apenas as chaves e a posição de cada pacote (16 bytes por
+// desenho), com "radix sort": o custo é linear no número de desenhos, e os
+// pacotes, maiores, ficam onde estão.
+
+#define RENDERQUEUE_PASS_BITS         4
+#define RENDERQUEUE_PROGRAM_BITS      8
+#define RENDERQUEUE_VERTEX_ARRAY_BITS 8
+#define RENDERQUEUE_MATERIAL_BITS     12
+#define RENDERQUEUE_DEPTH_BITS        32
+
+// Desenho na fila: a chave e a posição do pacote no vetor de quem o enviou.
+struct RenderQueueItem
+{
+    uint64_t key;
+    size_t   packet;
+};
+
+struct RenderQueue
+{
+    std::vector<RenderQueueItem> items;
+    std::vector<RenderQueueItem> scratch; // Destino de cada passada da ordenação, reaproveitado entre quadros
+};
+
+// Monta uma chave. Valores maiores que o campo são truncados; "material" é
+// uma posição de "meshmaterial.h" ou -1, que fica antes de todos os
+// materiais. "depth" é a distância até a câmera, ao longo da direção de
+// visão; valores negativos (atrás da câmera) contam como 0.
+// "program" e "vertex_array" devem ser posições pequenas (por exemplo, de
+// um vetor de programas e das pools de "mesharena.h"), e não os nomes dados
+// pelo OpenGL.
+uint64_t RenderQueue_MakeKey(unsigned int pass, unsigned int program, unsigned int vertex_array, int material, float depth);
+
+// Esvazia a fila, mantendo a memória já alocada.
+void RenderQueue_Clear(RenderQueue* queue);
+
+// Acrescenta o pacote "packet" com a chave "key".
+void RenderQueue_Submit(RenderQueue* queue, uint64_t key, size_t packet);
+
+// Ordena os desenhos pela chave. A ordenação é estável: pacotes com chaves
+// iguais ficam na ordem em que foram enviados.
+void RenderQueue_Sort(RenderQueue* queue);
+
+#endif // _RENDERQUEUE_H
@@ -0,0 +1,150 @@
+#ifndef _TEXTURE_H
+#define _TEXTURE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Texturas de imagens, usadas pelos materiais dos modelos (veja
+// MeshMaterial::diffuse_texname em "mesh.h").
+//
+// Uma imagem passa por três etapas, todas sem OpenGL exceto a última, de
+// modo que as duas primeiras são executadas pelas threads de trabalho de
+// "assetloader.h":
+//
+//  1. Texture_Decode() lê o arquivo (TGA, BMP ou PPM/PGM binários) para
+//     pixels RGBA de 8 bits.
+//  2. Texture_Build() gera a cadeia completa de mipmaps com um filtro de
+//     caixa 2x2 em cores lineares (com SSE2, as médias de 2 pixels de saída
+//     são calculadas de uma vez) e, se a imagem não tiver transparência,
+//     comprime cada nível no formato BC1 (S3TC DXT1, 8:1 em relação a
+//     RGBA8). O resultado, TextureData, já está no formato final da GPU e
+//     é guardado em disco por "texturecache.h".
+//  3. Texture_CreateGpuTexture() e Texture_UploadChunk() enviam os níveis
+//     para a GPU, em partes de tamanho limitado.
+//
+// BC1 só é usado se a GPU oferecer GL_EXT_texture_compression_s3tc (veja
+// Texture_Init()); caso contrário, texturas comprimidas do cache são
+// descomprimidas para RGBA8 por Texture_Decompress(), ainda na thread de
+// trabalho.
+//
+// Para que o uso de memória seja previsível, imagens maiores que
+// TEXTURE_MAX_SIZE são reduzidas ao gerar os mipmaps, e o total de memória de
+// textura é limitado a TEXTURE_MEMORY_BUDGET: uma textura que não cabe no
+// restante do orçamento perde seus níveis mais detalhados (veja
+// Texture_ReserveMemory()).
+
+// Maior largura ou altura do nível 0 de uma textura.
+#define TEXTURE_MAX_SIZE 2048
+
+// Número máximo de níveis de mipmap (1 + log2(TEXTURE_MAX_SIZE)).
+#define TEXTURE_MAX_LEVELS 12
+
+// Memória total, em bytes, reservada para texturas na GPU.
+#define TEXTURE_MEMORY_BUDGET (256u*1024*1024)
+
+// Formato BC1 com cores sRGB, de GL_EXT_texture_compression_s3tc e
+// GL_EXT_texture_sRGB, que não fazem parte do OpenGL 3.3 (e portanto não
+// estão em "glad.h"). Os pixels das imagens estão em sRGB, e o fragment
+// shader trabalha com cores lineares; texturas RGBA8 usam GL_SRGB8_ALPHA8.
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+
+// Formato dos níveis de uma textura.
+enum TextureFormat
+{
+    TEXTURE_FORMAT_RGBA8 = 0, // 4 bytes por pixel
+    TEXTURE_FORMAT_BC1        // 8 bytes por bloco de 4x4 pixels
+};
+
+// Imagem decodificada: pixels RGBA de 8 bits, com as linhas de baixo para
+// cima (a primeira linha corresponde a t = 0, como espera o OpenGL).
+struct TextureImage
+{
+    int                        width;
+    int                        height;
+    std::vector<unsigned char> pixels;
+    bool                       has_alpha; // Algum pixel tem alpha < 255
+
+    TextureImage() : width(0), height(0), has_alpha(false) {}
+};
+
+// Um nível de mipmap, dentro de TextureData::data.
+struct TextureLevel
+{
+    int    width;
+    int    height;
+    size_t offset; // Posição do nível em TextureData::data, em bytes
+    size_t size;   // Tamanho do nível em bytes
+};
+
+// Textura no formato final da GPU: todos os níveis, do mais detalhado ao
+// 1x1, concatenados em "data".
+struct TextureData
+{
+    TextureFormat              format;
+    std::vector<TextureLevel>  levels;
+    std::vector<unsigned char> data;
+
+    TextureData() : format(TEXTURE_FORMAT_RGBA8) {}
+};
+
+// Estado do envio de uma textura em partes (veja Texture_UploadChunk()).
+struct TextureUpload
+{
+    size_t level; // Nível sendo enviado
+    int    row;   // Próxima linha (em pixels) do nível a ser enviada
+
+    TextureUpload() : level(0), row(0) {}
+};
+
+// Verifica se a GPU suporta texturas BC1. Deve ser chamada na thread
+// principal, com o contexto OpenGL atual, antes de qualquer carregamento.
+void Texture_Init();
+
+// Retorna true se a GPU suporta texturas BC1 (depois de Texture_Init()).
+bool Texture_SupportsBC1();
+
+// Decodifica uma imagem TGA (sem compressão ou RLE), BMP (24 ou 32 bits, sem
+// compressão) ou PPM/PGM binário. "filename" é usado apenas nas mensagens de
+// erro. Lança std::runtime_error se o formato não for suportado.
+void Texture_Decode(const unsigned char* data, size_t size, const char* filename, TextureImage* image);
+
+// Gera os mipmaps de "image" e, se "compress" for true e a imagem não tiver
+// transparência, os comprime em BC1.
+void Texture_Build(const TextureImage& image, bool compress, TextureData* texture);
+
+// Tamanho, em bytes, de um nível de "width" x "height" pixels.
+size_t Texture_LevelSize(TextureFormat format, int width, int height);
+
+// Converte uma textura BC1 para RGBA8.
+void Texture_Decompress(TextureData* texture);
+
+// Reserva memória de GPU para "texture" dentro de TEXTURE_MEMORY_BUDGET,
+// descartando os níveis mais detalhados que não couberem (sempre resta ao
+// menos o nível 1x1). Retorna o número de bytes reservados, que devem ser
+// devolvidos com Texture_ReleaseMemory() quando a textura for apagada. Pode
+// ser chamada por qualquer thread.
+size_t Texture_ReserveMemory(TextureData* texture);
+
+// Devolve memória reservada por Texture_ReserveMemory().
+void Texture_ReleaseMemory(size_t size);
+
+// Memória de textura reservada no momento, em bytes.
+size_t Texture_MemoryUsed();
+
+// Cria a textura na GPU, com todos os níveis alocados mas ainda sem dados.
+GLuint Texture_CreateGpuTexture(const TextureData& texture);
+
+// Envia para a GPU até "max_bytes" bytes (ao menos uma linha de pixels ou de
+// blocos) de "texture", continuando de onde "upload" parou. Retorna true
+// quando todos os níveis tiverem sido enviados.
+bool Texture_UploadChunk(const TextureData& texture, GLuint texture_id, TextureUpload* upload, size_t max_bytes);
+
+// Cria a textura na GPU e envia todos os níveis de uma vez.
+GLuint Texture_Upload(const TextureData& texture);
+
+#endif // _TEXTURE_H
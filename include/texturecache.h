@@ -0,0 +1,35 @@
+#ifndef _TEXTURECACHE_H
+#define _TEXTURECACHE_H
+
+#include <string>
+
+#include "texture.h"
+
+// Cache binário de texturas, ao lado do cache de malhas (veja
+// "meshcache.h"). Para cada imagem carregada guardamos, no arquivo
+// "<nome>.texcache", a textura já no formato final da GPU: todos os níveis
+// de mipmap, comprimidos em BC1 quando possível (veja "texture.h"). Assim a
+// imagem só é decodificada, filtrada e comprimida na primeira execução.
+//
+// Como no cache de malhas, o cache é identificado pelo caminho, tamanho,
+// data de modificação e hash do conteúdo da imagem. O mesmo formato é usado
+// pelos assets ASSET_TEXTURE do pacote de assets (veja "assetpack.h").
+
+// Incrementar sempre que o formato do arquivo ou a geração dos níveis mudar.
+#define TEXTURECACHE_VERSION 2
+
+// Caminho do arquivo de cache correspondente a "source_filename".
+std::string TextureCache_Path(const char* source_filename);
+
+// Lê o cache de "source_filename" para "texture". Retorna false caso o cache
+// não exista ou esteja desatualizado.
+bool TextureCache_Load(const char* source_filename, TextureData* texture);
+
+// Lê uma textura no formato do cache que já está em memória (por exemplo,
+// dentro do pacote de assets), sem verificar a imagem original.
+bool TextureCache_LoadFromMemory(const void* data, size_t size, TextureData* texture);
+
+// Grava o cache de "source_filename". Retorna false em caso de erro.
+bool TextureCache_Store(const char* source_filename, const TextureData& texture);
+
+#endif // _TEXTURECACHE_H
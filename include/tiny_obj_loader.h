@@ -192,6 +192,17 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
              const char *filename, const char *mtl_basepath = NULL,
              bool triangulate = true);
 
+/// Loads .obj from a file using multiple threads.
+/// The file is split into line-aligned chunks which are parsed in parallel
+/// into per-chunk arrays. Relative (negative) indices are fixed up and
+/// shapes are assembled in a serial merge pass, so the output is the same as
+/// LoadObj().
+/// 'num_threads' is optional; 0 means std::thread::hardware_concurrency().
+bool LoadObjParallel(attrib_t *attrib, std::vector<shape_t> *shapes,
+                     std::vector<material_t> *materials, std::string *err,
+                     const char *filename, const char *mtl_basepath = NULL,
+                     bool triangulate = true, unsigned int num_threads = 0);
+
 /// Loads .obj from a file with custom user callback.
 /// .mtl is loaded as usual and parsed material_t data will be passed to
 /// `callback.mtllib_cb`.
@@ -225,10 +236,25 @@ void LoadMtl(std::map<std::string, int> *material_map,
 #include <cstddef>
 #include <cstdlib>
 #include <cstring>
+#include <stdint.h>
 #include <utility>
 
 #include <fstream>
 #include <sstream>
+#include <thread>
+
+#include "mappedfile.h"
+
+// Define TINYOBJLOADER_USE_SSE2 to scan runs of digits 16 bytes at a time
+// and convert 8 digits at once in tryParseFloat(). Numbers in .obj files are
+// usually shorter than 16 characters, where the scalar loop is just as fast
+// (see tools/objbench.cpp), so the portable code is the default.
+#ifdef TINYOBJLOADER_USE_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
 
 namespace tinyobj {
 
@@ -393,7 +419,7 @@ static bool tryParseDouble(const char *s, const char *s_end, double *result) {
     if (end_not_reached && (*curr == '+' || *curr == '-')) {
       exp_sign = *curr;
       curr++;
-    } else if (IS_DIGIT(*curr)) { /* Pass through. */
+    } else if (end_not_reached && IS_DIGIT(*curr)) { /* Pass through. */
     } else {
       // Empty E is not allowed.
       goto fail;
@@ -420,12 +446,174 @@ fail:
   return false;
 }
 
+#ifdef TINYOBJLOADER_USE_SSE2
+static inline unsigned int countTrailingZeros(unsigned int x) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, x);
+  return static_cast<unsigned int>(index);
+#else
+  return static_cast<unsigned int>(__builtin_ctz(x));
+#endif
+}
+
+// Converts 8 ASCII digits (little endian, first digit in the lowest byte)
+// into their value with three multiplications (SWAR).
+static inline uint32_t parseEightDigits(uint64_t v) {
+  v -= 0x3030303030303030ULL;
+  v = (v * 10) + (v >> 8);
+  v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+       (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >>
+      32;
+  return static_cast<uint32_t>(v);
+}
+#endif
+
+// Returns the number of consecutive decimal digits at p, never reading past
+// end.
+static inline size_t countDigits(const char *p, const char *end) {
+  const char *begin = p;
+#ifdef TINYOBJLOADER_USE_SSE2
+  const __m128i zero = _mm_set1_epi8('0');
+  const __m128i nine = _mm_set1_epi8(9);
+  while (end - p >= 16) {
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    // (c - '0') <= 9 as unsigned bytes <=> min(c - '0', 9) == c - '0'
+    __m128i d = _mm_sub_epi8(c, zero);
+    __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(d, nine), d);
+    unsigned int mask =
+        static_cast<unsigned int>(_mm_movemask_epi8(is_digit)) ^ 0xFFFFu;
+    if (mask != 0) {
+      return static_cast<size_t>(p - begin) + countTrailingZeros(mask);
+    }
+    p += 16;
+  }
+#endif
+  while (p < end && IS_DIGIT((*p))) p++;
+  return static_cast<size_t>(p - begin);
+}
+
+// Appends n digits at p to value. The caller guarantees that the result fits
+// in 64 bits (at most 19 digits in total).
+static inline uint64_t accumulateDigits(const char *p, size_t n,
+                                        uint64_t value) {
+#ifdef TINYOBJLOADER_USE_SSE2
+  while (n >= 8) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    value = value * 100000000ULL + parseEightDigits(v);
+    p += 8;
+    n -= 8;
+  }
+#endif
+  for (; n > 0; n--, p++) {
+    value = value * 10 + static_cast<uint64_t>((*p) - '0');
+  }
+  return value;
+}
+
+// Parses the same grammar as tryParseDouble() directly into a float.
+//
+// The digits are accumulated in a 64 bit integer m and the number is
+// m * 10^e. When m and 10^|e| are both exactly representable in a float
+// (m <= 2^24 and |e| <= 10) a single float multiplication or division gives
+// the correctly rounded result (Clinger's fast path). That covers the
+// numbers written by most modelling tools ("-0.123456", "1.5e-3", ...).
+// Anything else (more significant digits, larger exponents) goes to strtof():
+// rounding to double first and then to float could round twice.
+static bool tryParseFloat(const char *s, const char *s_end, float *result) {
+  static const float kPow10f[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f,
+                                  1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+  if (s >= s_end) {
+    return false;
+  }
+
+  const char *curr = s;
+  bool negative = false;
+  if (*curr == '+' || *curr == '-') {
+    negative = (*curr == '-');
+    curr++;
+  }
+
+  const char *int_begin = curr;
+  size_t int_digits = countDigits(curr, s_end);
+  // We must make sure we actually got something.
+  if (int_digits == 0) return false;
+  curr += int_digits;
+
+  const char *frac_begin = curr;
+  size_t frac_digits = 0;
+  if (curr < s_end && *curr == '.') {
+    curr++;
+    frac_begin = curr;
+    frac_digits = countDigits(curr, s_end);
+    curr += frac_digits;
+  }
+
+  int exponent = 0;
+  if (curr < s_end && (*curr == 'e' || *curr == 'E')) {
+    curr++;
+    bool exp_negative = false;
+    if (curr < s_end && (*curr == '+' || *curr == '-')) {
+      exp_negative = (*curr == '-');
+      curr++;
+    }
+    size_t exp_digits = countDigits(curr, s_end);
+    // Empty E is not allowed.
+    if (exp_digits == 0) return false;
+    if (exp_digits > 4) goto fallback;
+    exponent = static_cast<int>(accumulateDigits(curr, exp_digits, 0));
+    if (exp_negative) exponent = -exponent;
+  }
+
+  if (int_digits + frac_digits > 19) goto fallback;
+
+  {
+    uint64_t mantissa = accumulateDigits(int_begin, int_digits, 0);
+    mantissa = accumulateDigits(frac_begin, frac_digits, mantissa);
+    exponent -= static_cast<int>(frac_digits);
+
+    float value;
+    if (mantissa == 0) {
+      value = 0.0f;
+    } else if (mantissa <= (1ULL << 24) && exponent >= -10 &&
+               exponent <= 10) {
+      float m = static_cast<float>(mantissa);
+      value = (exponent < 0) ? m / kPow10f[-exponent] : m * kPow10f[exponent];
+    } else {
+      goto fallback;
+    }
+
+    *result = negative ? -value : value;
+    return true;
+  }
+
+fallback:
+  // The token is not NUL-terminated (the file is parsed in place), so it is
+  // copied before calling strtof().
+  {
+    const size_t length = static_cast<size_t>(s_end - s);
+    char buffer[64];
+    std::string long_token;
+    const char *token = buffer;
+    if (length < sizeof(buffer)) {
+      memcpy(buffer, s, length);
+      buffer[length] = '\0';
+    } else {
+      long_token.assign(s, length);
+      token = long_token.c_str();
+    }
+    *result = strtof(token, NULL);
+  }
+  return true;
+}
+
 static inline float parseFloat(const char **token, double default_value = 0.0) {
   (*token) += strspn((*token), " \t");
   const char *end = (*token) + strcspn((*token), " \t\r");
-  double val = default_value;
-  tryParseDouble((*token), end, &val);
-  float f = static_cast<float>(val);
+  float f = static_cast<float>(default_value);
+  tryParseFloat((*token), end, &f);
   (*token) = end;
   return f;
 }
@@ -507,6 +695,106 @@ static vertex_index parseTriple(const char **token, int vsize, int vnsize,
   return vi;
 }
 
+// Line-bounded tokenizer used by LoadObjParallel(). `end` points one past
+// the last character of the line (without the trailing '\r\n'), so the
+// parsers never need a NUL terminator and can walk the bytes of a memory
+// mapped file in place, without copying each line into a std::string.
+static inline void skipSpaceBounded(const char **token, const char *end) {
+  while ((*token) < end && IS_SPACE((**token))) (*token)++;
+}
+
+static inline const char *findTokenEnd(const char *token, const char *end) {
+  while (token < end && !IS_SPACE((*token))) token++;
+  return token;
+}
+
+// Same as strcspn((*token), "/ \t\r"), bounded by `end`.
+static inline void skipToIndexDelimiter(const char **token, const char *end) {
+  while ((*token) < end && (**token) != '/' && !IS_SPACE((**token)))
+    (*token)++;
+}
+
+static inline std::string parseStringBounded(const char **token,
+                                             const char *end) {
+  skipSpaceBounded(token, end);
+  const char *e = findTokenEnd((*token), end);
+  std::string s((*token), e);
+  (*token) = e;
+  return s;
+}
+
+// Same as atoi(), bounded by `end`.
+static inline int parseIntBounded(const char **token, const char *end) {
+  const char *p = (*token);
+  int sign = 1;
+  if (p < end && ((*p) == '+' || (*p) == '-')) {
+    if ((*p) == '-') sign = -1;
+    p++;
+  }
+  size_t n = countDigits(p, end);
+  uint64_t i = accumulateDigits(p, (n < 19) ? n : 19, 0);
+  (*token) = p + n;
+  return sign * static_cast<int>(i);
+}
+
+static inline float parseFloatBounded(const char **token, const char *end,
+                                      double default_value = 0.0) {
+  skipSpaceBounded(token, end);
+  const char *e = findTokenEnd((*token), end);
+  float f = static_cast<float>(default_value);
+  tryParseFloat((*token), e, &f);
+  (*token) = e;
+  return f;
+}
+
+// Parse triples for LoadObjParallel(): i, i/j/k, i//k, i/j
+// Absolute indices are made zero-based. Relative (negative) indices can only
+// be resolved against the attributes seen so far in the current chunk; they
+// are flagged in `relative` (1 = v, 2 = vt, 4 = vn) so the merge pass can add
+// the number of attributes parsed by the previous chunks.
+static vertex_index parseChunkTriple(const char **token, const char *end,
+                                     int vsize, int vnsize, int vtsize,
+                                     unsigned char *relative) {
+  vertex_index vi(-1);
+  int idx;
+
+  idx = parseIntBounded(token, end);
+  if (idx < 0) (*relative) |= 1;
+  vi.v_idx = fixIndex(idx, vsize);
+  skipToIndexDelimiter(token, end);
+  if ((*token) >= end || (*token)[0] != '/') {
+    return vi;
+  }
+  (*token)++;
+
+  // i//k
+  if ((*token) < end && (*token)[0] == '/') {
+    (*token)++;
+    idx = parseIntBounded(token, end);
+    if (idx < 0) (*relative) |= 4;
+    vi.vn_idx = fixIndex(idx, vnsize);
+    skipToIndexDelimiter(token, end);
+    return vi;
+  }
+
+  // i/j/k or i/j
+  idx = parseIntBounded(token, end);
+  if (idx < 0) (*relative) |= 2;
+  vi.vt_idx = fixIndex(idx, vtsize);
+  skipToIndexDelimiter(token, end);
+  if ((*token) >= end || (*token)[0] != '/') {
+    return vi;
+  }
+
+  // i/j/k
+  (*token)++;  // skip '/'
+  idx = parseIntBounded(token, end);
+  if (idx < 0) (*relative) |= 4;
+  vi.vn_idx = fixIndex(idx, vnsize);
+  skipToIndexDelimiter(token, end);
+  return vi;
+}
+
 // Parse raw triples: i, i/j/k, i//k, i/j
 static vertex_index parseRawTriple(const char **token) {
   vertex_index vi(static_cast<int>(0));  // 0 is an invalid index in OBJ
@@ -577,6 +865,52 @@ static void InitMaterial(material_t *material) {
   material->unknown_parameter.clear();
 }
 
+static void exportFaceToShape(shape_t *shape, const vertex_index *face,
+                              size_t npolys, const int material_id,
+                              bool triangulate) {
+  vertex_index i0 = face[0];
+  vertex_index i1(-1);
+  vertex_index i2 = face[1];
+
+  if (triangulate) {
+    // Polygon -> triangle fan conversion
+    for (size_t k = 2; k < npolys; k++) {
+      i1 = i2;
+      i2 = face[k];
+
+      index_t idx0, idx1, idx2;
+      idx0.vertex_index = i0.v_idx;
+      idx0.normal_index = i0.vn_idx;
+      idx0.texcoord_index = i0.vt_idx;
+      idx1.vertex_index = i1.v_idx;
+      idx1.normal_index = i1.vn_idx;
+      idx1.texcoord_index = i1.vt_idx;
+      idx2.vertex_index = i2.v_idx;
+      idx2.normal_index = i2.vn_idx;
+      idx2.texcoord_index = i2.vt_idx;
+
+      shape->mesh.indices.push_back(idx0);
+      shape->mesh.indices.push_back(idx1);
+      shape->mesh.indices.push_back(idx2);
+
+      shape->mesh.num_face_vertices.push_back(3);
+      shape->mesh.material_ids.push_back(material_id);
+    }
+  } else {
+    for (size_t k = 0; k < npolys; k++) {
+      index_t idx;
+      idx.vertex_index = face[k].v_idx;
+      idx.normal_index = face[k].vn_idx;
+      idx.texcoord_index = face[k].vt_idx;
+      shape->mesh.indices.push_back(idx);
+    }
+
+    shape->mesh.num_face_vertices.push_back(
+        static_cast<unsigned char>(npolys));
+    shape->mesh.material_ids.push_back(material_id);  // per face
+  }
+}
+
 static bool exportFaceGroupToShape(
     shape_t *shape, const std::vector<std::vector<vertex_index> > &faceGroup,
     const std::vector<tag_t> &tags, const int material_id,
@@ -588,50 +922,7 @@ static bool exportFaceGroupToShape(
   // Flatten vertices and indices
   for (size_t i = 0; i < faceGroup.size(); i++) {
     const std::vector<vertex_index> &face = faceGroup[i];
-
-    vertex_index i0 = face[0];
-    vertex_index i1(-1);
-    vertex_index i2 = face[1];
-
-    size_t npolys = face.size();
-
-    if (triangulate) {
-      // Polygon -> triangle fan conversion
-      for (size_t k = 2; k < npolys; k++) {
-        i1 = i2;
-        i2 = face[k];
-
-        index_t idx0, idx1, idx2;
-        idx0.vertex_index = i0.v_idx;
-        idx0.normal_index = i0.vn_idx;
-        idx0.texcoord_index = i0.vt_idx;
-        idx1.vertex_index = i1.v_idx;
-        idx1.normal_index = i1.vn_idx;
-        idx1.texcoord_index = i1.vt_idx;
-        idx2.vertex_index = i2.v_idx;
-        idx2.normal_index = i2.vn_idx;
-        idx2.texcoord_index = i2.vt_idx;
-
-        shape->mesh.indices.push_back(idx0);
-        shape->mesh.indices.push_back(idx1);
-        shape->mesh.indices.push_back(idx2);
-
-        shape->mesh.num_face_vertices.push_back(3);
-        shape->mesh.material_ids.push_back(material_id);
-      }
-    } else {
-      for (size_t k = 0; k < npolys; k++) {
-        index_t idx;
-        idx.vertex_index = face[k].v_idx;
-        idx.normal_index = face[k].vn_idx;
-        idx.texcoord_index = face[k].vt_idx;
-        shape->mesh.indices.push_back(idx);
-      }
-
-      shape->mesh.num_face_vertices.push_back(
-          static_cast<unsigned char>(npolys));
-      shape->mesh.material_ids.push_back(material_id);  // per face
-    }
+    exportFaceToShape(shape, &face[0], face.size(), material_id, triangulate);
   }
 
   shape->name = name;
@@ -1229,7 +1520,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
     if (token[0] == 't' && IS_SPACE(token[1])) {
       tag_t tag;
 
-      char namebuf[4096];
+      char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
       token += 2;
 #ifdef _MSC_VER
       sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
@@ -1257,7 +1548,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
       tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
       for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
-        char stringValueBuffer[4096];
+        char stringValueBuffer[TINYOBJ_SSCANF_BUFFER_SIZE];
 
 #ifdef _MSC_VER
         sscanf_s(token, "%s", stringValueBuffer,
@@ -1293,6 +1584,485 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   return true;
 }
 
+// Read-only memory mapping of a whole file (see mappedfile.h), used by
+// LoadObjParallel() to parse the .obj in place instead of copying it into a
+// buffer first. Unmapped on every return path.
+struct scoped_mapped_file {
+  MappedFile file;
+
+  scoped_mapped_file() {
+    file.data = NULL;
+    file.size = 0;
+    file.handle = NULL;
+  }
+  ~scoped_mapped_file() { UnmapFile(&file); }
+
+ private:
+  scoped_mapped_file(const scoped_mapped_file &);
+  scoped_mapped_file &operator=(const scoped_mapped_file &);
+};
+
+// Commands recorded while parsing a chunk in LoadObjParallel(). They are
+// replayed in file order by the merge pass, which owns all the state that
+// depends on previous lines (current material, group name, tags, ...).
+enum chunk_command_type {
+  COMMAND_FACES = 0,  // run of consecutive faces
+  COMMAND_USEMTL,
+  COMMAND_MTLLIB,
+  COMMAND_GROUP,
+  COMMAND_OBJECT,
+  COMMAND_TAG
+};
+
+struct chunk_command {
+  chunk_command_type type;
+  size_t first_face;  // COMMAND_FACES: first face of the run
+  size_t num_faces;   // COMMAND_FACES: number of faces in the run
+  size_t tag;         // COMMAND_TAG: index into obj_chunk::tags
+  std::string name;   // usemtl, mtllib, group and object name
+};
+
+struct obj_chunk {
+  const char *begin;
+  const char *end;
+
+  std::vector<float> v;
+  std::vector<float> vn;
+  std::vector<float> vt;
+
+  // Indices of all faces, flattened. Face `i` is made of the entries
+  // [face_offsets[i], face_offsets[i + 1]).
+  std::vector<vertex_index> indices;
+  std::vector<size_t> face_offsets;
+
+  // Entries of `indices` holding relative components which still have to
+  // be offset by the number of attributes in the previous chunks.
+  std::vector<size_t> relative_indices;
+  std::vector<unsigned char> relative_masks;
+
+  std::vector<tag_t> tags;
+  std::vector<chunk_command> commands;
+};
+
+// Faces of a chunk which have not been exported to a shape yet.
+struct face_segment {
+  const obj_chunk *chunk;
+  size_t first_face;
+  size_t num_faces;
+};
+
+static void parseObjChunk(obj_chunk *chunk) {
+  chunk->face_offsets.push_back(0);
+
+  const char *p = chunk->begin;
+  while (p < chunk->end) {
+    const char *line_end = static_cast<const char *>(
+        memchr(p, '\n', static_cast<size_t>(chunk->end - p)));
+    if (line_end == NULL) line_end = chunk->end;
+
+    const char *token = p;
+    p = (line_end < chunk->end) ? line_end + 1 : chunk->end;
+
+    // Trim newline '\r\n'
+    if (line_end > token && line_end[-1] == '\r') line_end--;
+
+    // Skip leading space.
+    skipSpaceBounded(&token, line_end);
+
+    if (token == line_end) continue;  // empty line
+
+    if (token[0] == '#') continue;  // comment line
+
+    const size_t len = static_cast<size_t>(line_end - token);
+
+    // vertex
+    if (len > 1 && token[0] == 'v' && IS_SPACE((token[1]))) {
+      token += 2;
+      chunk->v.push_back(parseFloatBounded(&token, line_end));
+      chunk->v.push_back(parseFloatBounded(&token, line_end));
+      chunk->v.push_back(parseFloatBounded(&token, line_end));
+      continue;
+    }
+
+    // normal
+    if (len > 2 && token[0] == 'v' && token[1] == 'n' &&
+        IS_SPACE((token[2]))) {
+      token += 3;
+      chunk->vn.push_back(parseFloatBounded(&token, line_end));
+      chunk->vn.push_back(parseFloatBounded(&token, line_end));
+      chunk->vn.push_back(parseFloatBounded(&token, line_end));
+      continue;
+    }
+
+    // texcoord
+    if (len > 2 && token[0] == 'v' && token[1] == 't' &&
+        IS_SPACE((token[2]))) {
+      token += 3;
+      chunk->vt.push_back(parseFloatBounded(&token, line_end));
+      chunk->vt.push_back(parseFloatBounded(&token, line_end));
+      continue;
+    }
+
+    // face
+    if (len > 1 && token[0] == 'f' && IS_SPACE((token[1]))) {
+      token += 2;
+      skipSpaceBounded(&token, line_end);
+
+      size_t first = chunk->indices.size();
+      while (token < line_end) {
+        unsigned char relative = 0;
+        vertex_index vi = parseChunkTriple(
+            &token, line_end, static_cast<int>(chunk->v.size() / 3),
+            static_cast<int>(chunk->vn.size() / 3),
+            static_cast<int>(chunk->vt.size() / 2), &relative);
+        if (relative) {
+          chunk->relative_indices.push_back(chunk->indices.size());
+          chunk->relative_masks.push_back(relative);
+        }
+        chunk->indices.push_back(vi);
+        skipSpaceBounded(&token, line_end);
+      }
+
+      if (chunk->indices.size() == first) continue;  // "f" without indices
+
+      chunk->face_offsets.push_back(chunk->indices.size());
+
+      size_t face = chunk->face_offsets.size() - 2;
+      if (!chunk->commands.empty() &&
+          chunk->commands.back().type == COMMAND_FACES) {
+        chunk->commands.back().num_faces++;
+      } else {
+        chunk_command command;
+        command.type = COMMAND_FACES;
+        command.first_face = face;
+        command.num_faces = 1;
+        command.tag = 0;
+        chunk->commands.push_back(command);
+      }
+
+      continue;
+    }
+
+    chunk_command command;
+    command.first_face = 0;
+    command.num_faces = 0;
+    command.tag = 0;
+
+    // use mtl, load mtl
+    if (len > 6 &&
+        ((0 == strncmp(token, "usemtl", 6)) ||
+         (0 == strncmp(token, "mtllib", 6))) &&
+        IS_SPACE((token[6]))) {
+      command.type = (token[0] == 'u') ? COMMAND_USEMTL : COMMAND_MTLLIB;
+      token += 7;
+      command.name = parseStringBounded(&token, line_end);
+      chunk->commands.push_back(command);
+      continue;
+    }
+
+    // group name
+    if (len > 1 && token[0] == 'g' && IS_SPACE((token[1]))) {
+      // Only the first name is used, see LoadObj().
+      token += 2;
+      command.type = COMMAND_GROUP;
+      command.name = parseStringBounded(&token, line_end);
+      chunk->commands.push_back(command);
+      continue;
+    }
+
+    // object name
+    if (len > 1 && token[0] == 'o' && IS_SPACE((token[1]))) {
+      // @todo { multiple object name? }
+      token += 2;
+      command.type = COMMAND_OBJECT;
+      command.name = parseStringBounded(&token, line_end);
+      chunk->commands.push_back(command);
+      continue;
+    }
+
+    // Tags are rare, so they are parsed from a NUL-terminated copy of the
+    // line with the same code as LoadObj().
+    if (len > 1 && token[0] == 't' && IS_SPACE(token[1])) {
+      std::string linebuf(token, line_end);
+      token = linebuf.c_str();
+
+      tag_t tag;
+
+      char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+      namebuf[0] = '\0';
+      token += 2;
+#ifdef _MSC_VER
+      sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
+#else
+      sscanf(token, "%s", namebuf);
+#endif
+      tag.name = std::string(namebuf);
+
+      token += tag.name.size() + 1;
+
+      tag_sizes ts = parseTagTriple(&token);
+
+      tag.intValues.resize(static_cast<size_t>(ts.num_ints));
+
+      for (size_t i = 0; i < static_cast<size_t>(ts.num_ints); ++i) {
+        tag.intValues[i] = atoi(token);
+        token += strcspn(token, "/ \t\r") + 1;
+      }
+
+      tag.floatValues.resize(static_cast<size_t>(ts.num_floats));
+      for (size_t i = 0; i < static_cast<size_t>(ts.num_floats); ++i) {
+        tag.floatValues[i] = parseFloat(&token);
+        token += strcspn(token, "/ \t\r") + 1;
+      }
+
+      tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
+      for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
+        char stringValueBuffer[TINYOBJ_SSCANF_BUFFER_SIZE];
+        stringValueBuffer[0] = '\0';
+
+#ifdef _MSC_VER
+        sscanf_s(token, "%s", stringValueBuffer,
+                 (unsigned)_countof(stringValueBuffer));
+#else
+        sscanf(token, "%s", stringValueBuffer);
+#endif
+        tag.stringValues[i] = stringValueBuffer;
+        token += tag.stringValues[i].size() + 1;
+      }
+
+      command.type = COMMAND_TAG;
+      command.tag = chunk->tags.size();
+      chunk->tags.push_back(tag);
+      chunk->commands.push_back(command);
+    }
+
+    // Ignore unknown command.
+  }
+}
+
+static bool exportFaceSegmentsToShape(
+    shape_t *shape, const std::vector<face_segment> &segments,
+    const std::vector<tag_t> &tags, const int material_id,
+    const std::string &name, bool triangulate) {
+  if (segments.empty()) {
+    return false;
+  }
+
+  for (size_t s = 0; s < segments.size(); s++) {
+    const obj_chunk *chunk = segments[s].chunk;
+    for (size_t f = segments[s].first_face;
+         f < segments[s].first_face + segments[s].num_faces; f++) {
+      size_t begin = chunk->face_offsets[f];
+      size_t end = chunk->face_offsets[f + 1];
+      exportFaceToShape(shape, &chunk->indices[begin], end - begin,
+                        material_id, triangulate);
+    }
+  }
+
+  shape->name = name;
+  shape->mesh.tags = tags;
+
+  return true;
+}
+
+// Adds to the relative indices of a chunk the number of attributes parsed
+// by the chunks before it.
+static void fixChunkRelativeIndices(obj_chunk *chunk, int v_offset,
+                                    int vn_offset, int vt_offset) {
+  for (size_t i = 0; i < chunk->relative_indices.size(); i++) {
+    vertex_index &vi = chunk->indices[chunk->relative_indices[i]];
+    unsigned char mask = chunk->relative_masks[i];
+    if (mask & 1) vi.v_idx += v_offset;
+    if (mask & 2) vi.vt_idx += vt_offset;
+    if (mask & 4) vi.vn_idx += vn_offset;
+  }
+}
+
+template <typename T>
+static void appendAndRelease(std::vector<T> *dst, std::vector<T> *src) {
+  dst->insert(dst->end(), src->begin(), src->end());
+  std::vector<T>().swap(*src);
+}
+
+bool LoadObjParallel(attrib_t *attrib, std::vector<shape_t> *shapes,
+                     std::vector<material_t> *materials, std::string *err,
+                     const char *filename, const char *mtl_basepath,
+                     bool triangulate, unsigned int num_threads) {
+  attrib->vertices.clear();
+  attrib->normals.clear();
+  attrib->texcoords.clear();
+  shapes->clear();
+
+  std::stringstream errss;
+
+  // The file is mapped read-only and parsed in place.
+  scoped_mapped_file mapping;
+  if (!MapFile(filename, &mapping.file)) {
+    errss << "Cannot open file [" << filename << "]" << std::endl;
+    if (err) {
+      (*err) = errss.str();
+    }
+    return false;
+  }
+
+  const size_t size = mapping.file.size;
+  const char *data = reinterpret_cast<const char *>(mapping.file.data);
+  const char *data_end = data + size;
+
+  // Split the file into line-aligned chunks. Small files are not worth the
+  // cost of starting threads.
+  const size_t kMinChunkSize = 1024 * 1024;
+  if (num_threads == 0) {
+    num_threads = std::thread::hardware_concurrency();
+  }
+  size_t num_chunks = size / kMinChunkSize + 1;
+  if (num_chunks > num_threads) num_chunks = num_threads;
+  if (num_chunks == 0) num_chunks = 1;
+
+  std::vector<obj_chunk> chunks(num_chunks);
+  const char *p = data;
+  for (size_t i = 0; i < num_chunks; i++) {
+    const char *e = data_end;
+    if (i + 1 < num_chunks) {
+      e = data + (size / num_chunks) * (i + 1);
+      if (e < p) e = p;
+      e = static_cast<const char *>(
+          memchr(e, '\n', static_cast<size_t>(data_end - e)));
+      e = (e == NULL) ? data_end : e + 1;
+    }
+    chunks[i].begin = p;
+    chunks[i].end = e;
+    p = e;
+  }
+
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < num_chunks; i++) {
+    workers.push_back(std::thread(parseObjChunk, &chunks[i]));
+  }
+  parseObjChunk(&chunks[0]);
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+
+  // Merge pass: fix relative indices and concatenate the attributes.
+  size_t num_v = 0, num_vn = 0, num_vt = 0;
+  for (size_t i = 0; i < num_chunks; i++) {
+    fixChunkRelativeIndices(&chunks[i], static_cast<int>(num_v / 3),
+                            static_cast<int>(num_vn / 3),
+                            static_cast<int>(num_vt / 2));
+    num_v += chunks[i].v.size();
+    num_vn += chunks[i].vn.size();
+    num_vt += chunks[i].vt.size();
+  }
+
+  attrib->vertices.reserve(num_v);
+  attrib->normals.reserve(num_vn);
+  attrib->texcoords.reserve(num_vt);
+  for (size_t i = 0; i < num_chunks; i++) {
+    appendAndRelease(&attrib->vertices, &chunks[i].v);
+    appendAndRelease(&attrib->normals, &chunks[i].vn);
+    appendAndRelease(&attrib->texcoords, &chunks[i].vt);
+  }
+
+  // Replay the commands of every chunk in file order, exactly as LoadObj()
+  // does while reading lines.
+  std::string basePath;
+  if (mtl_basepath) {
+    basePath = mtl_basepath;
+  }
+  MaterialFileReader matFileReader(basePath);
+
+  std::vector<tag_t> tags;
+  std::vector<face_segment> faceGroup;
+  std::string name;
+
+  // material
+  std::map<std::string, int> material_map;
+  int material = -1;
+
+  shape_t shape;
+
+  for (size_t i = 0; i < num_chunks; i++) {
+    const obj_chunk &chunk = chunks[i];
+
+    for (size_t c = 0; c < chunk.commands.size(); c++) {
+      const chunk_command &command = chunk.commands[c];
+
+      switch (command.type) {
+        case COMMAND_FACES: {
+          face_segment segment;
+          segment.chunk = &chunk;
+          segment.first_face = command.first_face;
+          segment.num_faces = command.num_faces;
+          faceGroup.push_back(segment);
+          break;
+        }
+
+        case COMMAND_USEMTL: {
+          int newMaterialId = -1;
+          if (material_map.find(command.name) != material_map.end()) {
+            newMaterialId = material_map[command.name];
+          }
+
+          if (newMaterialId != material) {
+            // Create per-face material
+            exportFaceSegmentsToShape(&shape, faceGroup, tags, material, name,
+                                      triangulate);
+            faceGroup.clear();
+            material = newMaterialId;
+          }
+          break;
+        }
+
+        case COMMAND_MTLLIB: {
+          std::string err_mtl;
+          bool ok =
+              matFileReader(command.name, materials, &material_map, &err_mtl);
+          if (err) {
+            (*err) += err_mtl;
+          }
+
+          if (!ok) {
+            return false;
+          }
+          break;
+        }
+
+        case COMMAND_GROUP:
+        case COMMAND_OBJECT: {
+          // flush previous face group.
+          bool ret = exportFaceSegmentsToShape(&shape, faceGroup, tags,
+                                               material, name, triangulate);
+          if (ret) {
+            shapes->push_back(shape);
+          }
+
+          shape = shape_t();
+          faceGroup.clear();
+          name = command.name;
+          break;
+        }
+
+        case COMMAND_TAG:
+          tags.push_back(chunk.tags[command.tag]);
+          break;
+      }
+    }
+  }
+
+  bool ret = exportFaceSegmentsToShape(&shape, faceGroup, tags, material, name,
+                                       triangulate);
+  if (ret) {
+    shapes->push_back(shape);
+  }
+
+  if (err) {
+    (*err) += errss.str();
+  }
+
+  return true;
+}
+
 bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
                          void *user_data /*= NULL*/,
                          MaterialReader *readMatFn /*= NULL*/,
@@ -1518,7 +2288,7 @@ bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
     if (token[0] == 't' && IS_SPACE(token[1])) {
       tag_t tag;
 
-      char namebuf[4096];
+      char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
       token += 2;
 #ifdef _MSC_VER
       sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
@@ -1546,7 +2316,7 @@ bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
 
       tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
       for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
-        char stringValueBuffer[4096];
+        char stringValueBuffer[TINYOBJ_SSCANF_BUFFER_SIZE];
 
 #ifdef _MSC_VER
         sscanf_s(token, "%s", stringValueBuffer,
@@ -0,0 +1,525 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "aabbtree.h"
+
+// Metade da área da superfície da caixa [minimum, maximum]. O fator 2 não
+// muda nenhuma comparação.
+static float HalfArea(const float minimum[3], const float maximum[3])
+{
+    const float dx = maximum[0] - minimum[0];
+    const float dy = maximum[1] - minimum[1];
+    const float dz = maximum[2] - minimum[2];
+    return dx*dy + dy*dz + dz*dx;
+}
+
+static float NodeArea(const AabbTreeNode& node)
+{
+    return HalfArea(node.minimum, node.maximum);
+}
+
+// Área da união das caixas de dois nós.
+static float UnionArea(const AabbTreeNode& a, const AabbTreeNode& b)
+{
+    float minimum[3], maximum[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        minimum[k] = std::min(a.minimum[k], b.minimum[k]);
+        maximum[k] = std::max(a.maximum[k], b.maximum[k]);
+    }
+    return HalfArea(minimum, maximum);
+}
+
+static bool IsLeaf(const AabbTreeNode& node)
+{
+    return node.left == AABBTREE_NULL;
+}
+
+static int AllocateNode(AabbTree* tree)
+{
+    int index;
+    if ( tree->free_list != AABBTREE_NULL )
+    {
+        index = tree->free_list;
+        tree->free_list = tree->nodes[index].parent;
+    }
+    else
+    {
+        index = (int)tree->nodes.size();
+        tree->nodes.push_back(AabbTreeNode());
+    }
+
+    AabbTreeNode& node = tree->nodes[index];
+    node.parent = AABBTREE_NULL;
+    node.left   = AABBTREE_NULL;
+    node.right  = AABBTREE_NULL;
+    node.height = 0;
+    node.data   = -1;
+    return index;
+}
+
+static void FreeNode(AabbTree* tree, int index)
+{
+    tree->nodes[index].parent = tree->free_list;
+    tree->nodes[index].height = -1;
+    tree->free_list = index;
+}
+
+// Recalcula a caixa e a altura de um nó interno a partir dos filhos.
+static void Refit(AabbTree* tree, int index)
+{
+    AabbTreeNode& node = tree->nodes[index];
+    const AabbTreeNode& left  = tree->nodes[node.left];
+    const AabbTreeNode& right = tree->nodes[node.right];
+    for (int k = 0; k < 3; ++k)
+    {
+        node.minimum[k] = std::min(left.minimum[k], right.minimum[k]);
+        node.maximum[k] = std::max(left.maximum[k], right.maximum[k]);
+    }
+    node.height = 1 + std::max(left.height, right.height);
+}
+
+// Troca o filho "child" de "a" pelo neto "grandchild", filho de "other" (o
+// outro filho de "a"), e recalcula "other".
+static void SwapWithGrandchild(AabbTree* tree, int a, int child, int other, int grandchild)
+{
+    AabbTreeNode& node_a     = tree->nodes[a];
+    AabbTreeNode& node_other = tree->nodes[other];
+
+    if ( node_a.left == child )
+        node_a.left = grandchild;
+    else
+        node_a.right = grandchild;
+
+    if ( node_other.left == grandchild )
+        node_other.left = child;
+    else
+        node_other.right = child;
+
+    tree->nodes[child].parent      = other;
+    tree->nodes[grandchild].parent = a;
+    Refit(tree, other);
+}
+
+// Rotações de Bittner et al. ("Fast Insertion-Based Optimization of
+// Bounding Volume Hierarchies"): um filho B de "a" pode trocar de lugar com
+// um filho de C, o outro filho de "a". A caixa de "a" não muda; muda apenas a
+// de C, que passa a envolver B e o neto que ficou. Das até quatro trocas
+// possíveis, fazemos a que mais reduz a área de C, se alguma reduzir.
+static void Rotate(AabbTree* tree, int a)
+{
+    const AabbTreeNode& node = tree->nodes[a];
+    if ( IsLeaf(node) )
+        return;
+
+    const int children[2] = { node.left, node.right };
+
+    float best_benefit = 0.0f;
+    int   best_child = AABBTREE_NULL, best_other = AABBTREE_NULL, best_grandchild = AABBTREE_NULL;
+    for (int i = 0; i < 2; ++i)
+    {
+        const int b = children[i];
+        const int c = children[1 - i];
+        const AabbTreeNode& node_c = tree->nodes[c];
+        if ( IsLeaf(node_c) )
+            continue;
+
+        const float area_c = NodeArea(node_c);
+        const int grandchildren[2] = { node_c.left, node_c.right };
+        for (int j = 0; j < 2; ++j)
+        {
+            // B troca com grandchildren[j]; C passa a envolver B e o outro neto.
+            const float benefit = area_c - UnionArea(tree->nodes[b], tree->nodes[grandchildren[1 - j]]);
+            if ( benefit > best_benefit )
+            {
+                best_benefit    = benefit;
+                best_child      = b;
+                best_other      = c;
+                best_grandchild = grandchildren[j];
+            }
+        }
+    }
+
+    if ( best_child != AABBTREE_NULL )
+    {
+        SwapWithGrandchild(tree, a, best_child, best_other, best_grandchild);
+        Refit(tree, a);
+    }
+}
+
+// Recalcula as caixas de "index" e de seus ancestrais, rotacionando cada um.
+static void RefitAncestors(AabbTree* tree, int index)
+{
+    while ( index != AABBTREE_NULL )
+    {
+        Refit(tree, index);
+        Rotate(tree, index);
+        index = tree->nodes[index].parent;
+    }
+}
+
+// Escolhe o irmão de uma nova folha: descemos a partir da raiz enquanto
+// descer for mais barato que colocar a folha ao lado do nó atual. O custo de
+// colocá-la ao lado de um nó é a área do novo nó interno mais o aumento das
+// caixas de todos os ancestrais ("herança").
+static int FindBestSibling(const AabbTree& tree, const AabbTreeNode& leaf)
+{
+    int index = tree.root;
+    while ( !IsLeaf(tree.nodes[index]) )
+    {
+        const AabbTreeNode& node = tree.nodes[index];
+        const float area          = NodeArea(node);
+        const float combined_area = UnionArea(node, leaf);
+
+        // Custo de criar um novo pai para este nó e a folha.
+        const float cost = 2.0f * combined_area;
+
+        // Aumento mínimo das caixas ao descer para um dos filhos.
+        const float inheritance = 2.0f * (combined_area - area);
+
+        float child_cost[2];
+        const int children[2] = { node.left, node.right };
+        for (int i = 0; i < 2; ++i)
+        {
+            const AabbTreeNode& child = tree.nodes[children[i]];
+            if ( IsLeaf(child) )
+                child_cost[i] = UnionArea(child, leaf) + inheritance;
+            else
+                child_cost[i] = UnionArea(child, leaf) - NodeArea(child) + inheritance;
+        }
+
+        if ( cost < child_cost[0] && cost < child_cost[1] )
+            break;
+
+        index = (child_cost[0] < child_cost[1]) ? children[0] : children[1];
+    }
+    return index;
+}
+
+static void InsertLeaf(AabbTree* tree, int leaf)
+{
+    if ( tree->root == AABBTREE_NULL )
+    {
+        tree->root = leaf;
+        tree->nodes[leaf].parent = AABBTREE_NULL;
+        return;
+    }
+
+    const int sibling    = FindBestSibling(*tree, tree->nodes[leaf]);
+    const int old_parent = tree->nodes[sibling].parent;
+    const int new_parent = AllocateNode(tree); // Pode realocar "nodes"
+
+    AabbTreeNode& parent = tree->nodes[new_parent];
+    parent.parent = old_parent;
+    parent.left   = sibling;
+    parent.right  = leaf;
+
+    if ( old_parent == AABBTREE_NULL )
+        tree->root = new_parent;
+    else if ( tree->nodes[old_parent].left == sibling )
+        tree->nodes[old_parent].left = new_parent;
+    else
+        tree->nodes[old_parent].right = new_parent;
+
+    tree->nodes[sibling].parent = new_parent;
+    tree->nodes[leaf].parent    = new_parent;
+
+    RefitAncestors(tree, new_parent);
+}
+
+static void RemoveLeaf(AabbTree* tree, int leaf)
+{
+    if ( leaf == tree->root )
+    {
+        tree->root = AABBTREE_NULL;
+        return;
+    }
+
+    // O irmão da folha toma o lugar do pai, que é apagado.
+    const int parent      = tree->nodes[leaf].parent;
+    const int grandparent = tree->nodes[parent].parent;
+    const int sibling     = (tree->nodes[parent].left == leaf) ? tree->nodes[parent].right : tree->nodes[parent].left;
+
+    if ( grandparent == AABBTREE_NULL )
+    {
+        tree->root = sibling;
+        tree->nodes[sibling].parent = AABBTREE_NULL;
+        FreeNode(tree, parent);
+        return;
+    }
+
+    if ( tree->nodes[grandparent].left == parent )
+        tree->nodes[grandparent].left = sibling;
+    else
+        tree->nodes[grandparent].right = sibling;
+    tree->nodes[sibling].parent = grandparent;
+    FreeNode(tree, parent);
+
+    RefitAncestors(tree, grandparent);
+}
+
+static void SetFatBox(AabbTreeNode* node, const float minimum[3], const float maximum[3])
+{
+    for (int k = 0; k < 3; ++k)
+    {
+        node->minimum[k] = minimum[k] - AABBTREE_MARGIN;
+        node->maximum[k] = maximum[k] + AABBTREE_MARGIN;
+    }
+}
+
+void AabbTree_Clear(AabbTree* tree)
+{
+    tree->nodes.clear();
+    tree->root      = AABBTREE_NULL;
+    tree->free_list = AABBTREE_NULL;
+}
+
+int AabbTree_Insert(AabbTree* tree, const float minimum[3], const float maximum[3], int data)
+{
+    const int leaf = AllocateNode(tree);
+    SetFatBox(&tree->nodes[leaf], minimum, maximum);
+    tree->nodes[leaf].data = data;
+    InsertLeaf(tree, leaf);
+    return leaf;
+}
+
+void AabbTree_Remove(AabbTree* tree, int proxy)
+{
+    RemoveLeaf(tree, proxy);
+    FreeNode(tree, proxy);
+}
+
+bool AabbTree_Move(AabbTree* tree, int proxy, const float minimum[3], const float maximum[3])
+{
+    AabbTreeNode& node = tree->nodes[proxy];
+    bool inside = true;
+    for (int k = 0; k < 3; ++k)
+        inside = inside && node.minimum[k] <= minimum[k] && maximum[k] <= node.maximum[k];
+    if ( inside )
+        return false;
+
+    RemoveLeaf(tree, proxy);
+    SetFatBox(&tree->nodes[proxy], minimum, maximum);
+    InsertLeaf(tree, proxy);
+    return true;
+}
+
+int AabbTree_Data(const AabbTree& tree, int proxy)
+{
+    return tree.nodes[proxy].data;
+}
+
+void AabbTree_SetData(AabbTree* tree, int proxy, int data)
+{
+    tree->nodes[proxy].data = data;
+}
+
+// Pilha de nós a visitar em uma consulta. Os primeiros AABBTREE_STACK_SIZE
+// elementos ficam em um vetor local; se a árvore for mais alta, os
+// elementos passam para um std::vector, que dobra de tamanho quando enche.
+template <typename T>
+struct TraversalStack
+{
+    T              local[AABBTREE_STACK_SIZE];
+    std::vector<T> heap;
+    T*             items;
+    size_t         count;
+    size_t         capacity;
+
+    TraversalStack() : items(local), count(0), capacity(AABBTREE_STACK_SIZE) {}
+
+    bool empty() const { return count == 0; }
+    const T& back() const { return items[count - 1]; }
+    void pop_back() { --count; }
+
+    void push_back(const T& item)
+    {
+        if ( count == capacity )
+        {
+            capacity *= 2;
+            heap.resize(capacity);
+            if ( items == local )
+                std::copy(local, local + count, heap.begin());
+            items = &heap[0];
+        }
+        items[count++] = item;
+    }
+};
+
+// Acrescenta a "out" os valores de todas as folhas abaixo de "index".
+static void CollectLeaves(const AabbTree& tree, int index, std::vector<int>* out)
+{
+    TraversalStack<int> stack;
+    stack.push_back(index);
+    while ( !stack.empty() )
+    {
+        const AabbTreeNode& node = tree.nodes[stack.back()];
+        stack.pop_back();
+        if ( IsLeaf(node) )
+        {
+            out->push_back(node.data);
+        }
+        else
+        {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+}
+
+void AabbTree_QueryFrustum(const AabbTree& tree, const float planes[6][4], std::vector<int>* out)
+{
+    if ( tree.root == AABBTREE_NULL )
+        return;
+
+    // Cada posição da pilha guarda um nó e os planos que ainda precisam ser
+    // testados (um bit por plano).
+    TraversalStack<std::pair<int, unsigned int> > stack;
+    stack.push_back(std::make_pair(tree.root, 0x3Fu));
+
+    while ( !stack.empty() )
+    {
+        const int    index = stack.back().first;
+        unsigned int mask  = stack.back().second;
+        stack.pop_back();
+
+        const AabbTreeNode& node = tree.nodes[index];
+        bool outside = false;
+        for (int p = 0; p < 6 && !outside; ++p)
+        {
+            if ( !(mask & (1u << p)) )
+                continue;
+
+            // Distância do centro da caixa ao plano e projeção da caixa na
+            // normal do plano (veja "frustumcull.cpp").
+            const float* plane = planes[p];
+            float distance = plane[3];
+            float radius   = 0.0f;
+            for (int k = 0; k < 3; ++k)
+            {
+                distance += plane[k] * 0.5f * (node.minimum[k] + node.maximum[k]);
+                radius   += std::fabs(plane[k]) * 0.5f * (node.maximum[k] - node.minimum[k]);
+            }
+
+            if ( distance < -radius )
+                outside = true;
+            else if ( distance >= radius )
+                mask &= ~(1u << p); // Inteiramente dentro deste plano
+        }
+
+        if ( outside )
+            continue;
+
+        if ( IsLeaf(node) )
+        {
+            out->push_back(node.data);
+        }
+        else if ( mask == 0 )
+        {
+            CollectLeaves(tree, index, out);
+        }
+        else
+        {
+            stack.push_back(std::make_pair(node.left, mask));
+            stack.push_back(std::make_pair(node.right, mask));
+        }
+    }
+}
+
+// Intervalo [t_enter, t_exit] do raio dentro da caixa de um nó ("slab
+// test"), com "inverse" = 1/direction. Retorna false se o raio não atinge a
+// caixa dentro de [0, max_distance].
+static bool RayHitsBox(const AabbTreeNode& node, const float origin[3], const float inverse[3], float max_distance, float* t_enter)
+{
+    float t_min = 0.0f;
+    float t_max = max_distance;
+    for (int k = 0; k < 3; ++k)
+    {
+        float t0 = (node.minimum[k] - origin[k]) * inverse[k];
+        float t1 = (node.maximum[k] - origin[k]) * inverse[k];
+        if ( t0 > t1 )
+            std::swap(t0, t1);
+        // Com direction[k] == 0, t0 e t1 são infinitos (ou NaN, se a origem
+        // está sobre a face); nesta ordem dos argumentos, std::max() e
+        // std::min() mantêm t_min e t_max quando t0 ou t1 é NaN.
+        t_min = std::max(t_min, t0);
+        t_max = std::min(t_max, t1);
+        if ( t_min > t_max )
+            return false;
+    }
+    *t_enter = t_min;
+    return true;
+}
+
+static bool HitCloser(const AabbTreeHit& a, const AabbTreeHit& b)
+{
+    return a.distance < b.distance;
+}
+
+void AabbTree_QueryRay(const AabbTree& tree, const float origin[3], const float direction[3], float max_distance, std::vector<AabbTreeHit>* out)
+{
+    if ( tree.root == AABBTREE_NULL )
+        return;
+
+    float inverse[3];
+    for (int k = 0; k < 3; ++k)
+        inverse[k] = (direction[k] != 0.0f) ? 1.0f / direction[k] : std::numeric_limits<float>::infinity();
+
+    const size_t first = out->size();
+
+    TraversalStack<int> stack;
+    stack.push_back(tree.root);
+    while ( !stack.empty() )
+    {
+        const AabbTreeNode& node = tree.nodes[stack.back()];
+        stack.pop_back();
+
+        float t_enter;
+        if ( !RayHitsBox(node, origin, inverse, max_distance, &t_enter) )
+            continue;
+
+        if ( IsLeaf(node) )
+        {
+            AabbTreeHit hit = { node.data, t_enter };
+            out->push_back(hit);
+        }
+        else
+        {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+
+    std::sort(out->begin() + first, out->end(), HitCloser);
+}
+
+void AabbTree_QueryBox(const AabbTree& tree, const float minimum[3], const float maximum[3], std::vector<int>* out)
+{
+    if ( tree.root == AABBTREE_NULL )
+        return;
+
+    TraversalStack<int> stack;
+    stack.push_back(tree.root);
+    while ( !stack.empty() )
+    {
+        const AabbTreeNode& node = tree.nodes[stack.back()];
+        stack.pop_back();
+
+        bool overlaps = true;
+        for (int k = 0; k < 3; ++k)
+            overlaps = overlaps && node.minimum[k] <= maximum[k] && minimum[k] <= node.maximum[k];
+        if ( !overlaps )
+            continue;
+
+        if ( IsLeaf(node) )
+        {
+            out->push_back(node.data);
+        }
+        else
+        {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+}
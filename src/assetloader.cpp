@@ -0,0 +1,440 @@
+#include <cstdio>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <condition_variable>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "assetloader.h"
+
+// Modelo ou textura sendo enviados para a GPU, em partes, pela thread
+// principal.
+struct MainThreadUpload
+{
+    AssetBlob*     blob;
+    MeshGpuBuffers gpu;
+    size_t         vertices_sent; // Bytes já enviados de blob->mesh.vertices
+    size_t         indices_sent;  // Bytes já enviados de blob->mesh.indices
+    GLuint         texture_id;
+    TextureUpload  texture_upload; // Níveis já enviados de blob->texture
+};
+
+// Modelo ou textura enviados para a GPU pela thread de envio. Os comandos já
+// foram submetidos, mas só podem ser usados quando "fence" for sinalizado.
+struct UploadedAsset
+{
+    AssetBlob*     blob;
+    MeshGpuBuffers gpu;
+    GLuint         texture_id;
+    GLsync         fence; // NULL se houve erro
+};
+
+// Estado do carregador. Tudo que é acessado por mais de uma thread é
+// protegido por "mutex".
+struct AssetLoaderState
+{
+    AssetLoaderCallbacks     callbacks;
+    GLFWwindow*              upload_context;
+    std::vector<std::thread> workers;
+    std::thread              upload_thread;
+
+    std::mutex               mutex;
+    std::condition_variable  requests_available; // Acorda as threads de trabalho
+    std::condition_variable  prepared_available; // Acorda a thread de envio
+    std::deque<AssetBlob*>   requests;           // Aguardando callbacks.prepare()
+    std::deque<AssetBlob*>   prepared;           // Aguardando envio para a GPU
+    std::deque<UploadedAsset> uploaded;          // Aguardando o fence (com contexto de envio)
+    bool                     stopping;
+    size_t                   memory_budget;      // Veja AssetLoader_SetMemoryBudget()
+    size_t                   prepared_bytes;     // Soma de AssetBlob::prepared_bytes
+
+    // Acessados somente pela thread principal
+    size_t                   pending;
+    bool                     uploading;
+    MainThreadUpload         upload;
+    std::vector<UploadedAsset> waiting; // Fences ainda não sinalizados
+
+    AssetLoaderState()
+        : upload_context(NULL), stopping(false), memory_budget(ASSETLOADER_DEFAULT_MEMORY_BUDGET), prepared_bytes(0),
+          pending(0), uploading(false)
+    {
+    }
+};
+
+static AssetLoaderState g_AssetLoader;
+
+static double ElapsedSeconds(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Desconta a memória de um pedido do orçamento de dados preparados,
+// liberando as threads de trabalho que esperam por espaço.
+static void ReleasePreparedBytes(AssetBlob* blob)
+{
+    if ( blob->prepared_bytes == 0 )
+        return;
+
+    std::lock_guard<std::mutex> lock(g_AssetLoader.mutex);
+    g_AssetLoader.prepared_bytes -= blob->prepared_bytes;
+    blob->prepared_bytes = 0;
+    g_AssetLoader.requests_available.notify_all();
+}
+
+// Libera a cópia em memória principal de um modelo ou de uma textura que já
+// está na GPU.
+static void ReleaseEncodedData(AssetBlob* blob)
+{
+    MeshEncodedData empty;
+    std::swap(blob->mesh, empty);
+    TextureData empty_texture;
+    std::swap(blob->texture, empty_texture);
+    ReleasePreparedBytes(blob);
+}
+
+static void WorkerThread()
+{
+    AssetLoaderState& loader = g_AssetLoader;
+    for (;;)
+    {
+        AssetBlob* blob;
+        {
+            std::unique_lock<std::mutex> lock(loader.mutex);
+            loader.requests_available.wait(lock, [&]{
+                return loader.stopping || (!loader.requests.empty() && loader.prepared_bytes < loader.memory_budget);
+            });
+            if ( loader.stopping )
+                return;
+            blob = loader.requests.front();
+            loader.requests.pop_front();
+        }
+
+        try
+        {
+            if ( blob->is_texture )
+                loader.callbacks.prepare_texture(blob);
+            else
+                loader.callbacks.prepare(blob);
+        }
+        catch ( const std::exception& e )
+        {
+            blob->error = e.what();
+        }
+
+        blob->prepared_bytes = blob->mesh.vertices.size() + blob->mesh.indices.size() + blob->texture.data.size();
+
+        std::lock_guard<std::mutex> lock(loader.mutex);
+        loader.prepared_bytes += blob->prepared_bytes;
+        loader.prepared.push_back(blob);
+        loader.prepared_available.notify_one();
+    }
+}
+
+static void UploadThread()
+{
+    AssetLoaderState& loader = g_AssetLoader;
+    glfwMakeContextCurrent(loader.upload_context);
+
+    for (;;)
+    {
+        UploadedAsset asset;
+        {
+            std::unique_lock<std::mutex> lock(loader.mutex);
+            loader.prepared_available.wait(lock, [&]{ return loader.stopping || !loader.prepared.empty(); });
+            if ( loader.stopping )
+                break;
+            asset.blob = loader.prepared.front();
+            loader.prepared.pop_front();
+        }
+        asset.texture_id = 0;
+        asset.fence = NULL;
+
+        // Modelos divididos em tiles não têm dados a enviar.
+        if ( asset.blob->error.empty() && asset.blob->num_tiles == 0 )
+        {
+            try
+            {
+                if ( asset.blob->is_texture )
+                    asset.texture_id = Texture_Upload(asset.blob->texture);
+                else if ( asset.blob->needs_gpu_load )
+                    loader.callbacks.gpu_load(asset.blob, &asset.gpu);
+                else
+                    MeshQuant_UploadEncoded(asset.blob->mesh, &asset.gpu);
+
+                // O fence só é sinalizado quando todos os comandos acima
+                // terminarem; glFlush() garante que eles sejam submetidos,
+                // já que ninguém mais usa este contexto.
+                asset.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                glFlush();
+            }
+            catch ( const std::exception& e )
+            {
+                asset.blob->error = e.what();
+            }
+            ReleaseEncodedData(asset.blob);
+        }
+
+        std::lock_guard<std::mutex> lock(loader.mutex);
+        loader.uploaded.push_back(asset);
+    }
+
+    glfwMakeContextCurrent(NULL);
+}
+
+// Entrega um modelo ou uma textura (ou seu erro) na thread principal.
+static void FinishAsset(AssetBlob* blob, const MeshGpuBuffers& gpu, GLuint texture_id = 0)
+{
+    if ( blob->error.empty() && blob->is_texture )
+        g_AssetLoader.callbacks.texture_ready(*blob, texture_id);
+    else if ( blob->error.empty() )
+        g_AssetLoader.callbacks.ready(*blob, gpu);
+    else
+    {
+        fprintf(stderr, "ERROR: Cannot load %s \"%s\": %s\n", blob->is_texture ? "texture" : "model",
+                blob->filename.c_str(), blob->error.c_str());
+        Texture_ReleaseMemory(blob->texture_memory);
+    }
+
+    ReleasePreparedBytes(blob);
+    delete blob;
+    g_AssetLoader.pending -= 1;
+}
+
+void AssetLoader_Init(const AssetLoaderCallbacks& callbacks, GLFWwindow* upload_context)
+{
+    AssetLoaderState& loader = g_AssetLoader;
+    loader.callbacks      = callbacks;
+    loader.upload_context = upload_context;
+    loader.stopping       = false;
+
+    // Deixamos um núcleo para a thread principal.
+    unsigned int num_workers = std::thread::hardware_concurrency();
+    num_workers = (num_workers > 1) ? num_workers - 1 : 1;
+    if ( num_workers > ASSETLOADER_MAX_WORKERS )
+        num_workers = ASSETLOADER_MAX_WORKERS;
+
+    for (unsigned int i = 0; i < num_workers; ++i)
+        loader.workers.push_back(std::thread(WorkerThread));
+
+    if ( upload_context != NULL )
+        loader.upload_thread = std::thread(UploadThread);
+
+    printf("Loading assets with %u worker thread(s), uploading from %s.\n",
+           num_workers, upload_context ? "a shared context" : "the main thread");
+}
+
+// Coloca um pedido na fila das threads de trabalho.
+static void PushRequest(AssetBlob* blob)
+{
+    std::lock_guard<std::mutex> lock(g_AssetLoader.mutex);
+    g_AssetLoader.requests.push_back(blob);
+    g_AssetLoader.pending += 1;
+    g_AssetLoader.requests_available.notify_one();
+}
+
+void AssetLoader_Request(const char* filename)
+{
+    AssetBlob* blob = new AssetBlob();
+    blob->filename = filename;
+    PushRequest(blob);
+}
+
+void AssetLoader_RequestTile(const char* filename, int tile)
+{
+    AssetBlob* blob = new AssetBlob();
+    blob->filename = filename;
+    blob->tile     = tile;
+    PushRequest(blob);
+}
+
+void AssetLoader_RequestTexture(const char* filename)
+{
+    AssetBlob* blob = new AssetBlob();
+    blob->filename   = filename;
+    blob->is_texture = true;
+    PushRequest(blob);
+}
+
+// Com contexto de envio: entrega os modelos cujo fence já foi sinalizado,
+// sem bloquear.
+static void UpdateSharedContext()
+{
+    AssetLoaderState& loader = g_AssetLoader;
+    {
+        std::lock_guard<std::mutex> lock(loader.mutex);
+        loader.waiting.insert(loader.waiting.end(), loader.uploaded.begin(), loader.uploaded.end());
+        loader.uploaded.clear();
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < loader.waiting.size(); ++i)
+    {
+        UploadedAsset& asset = loader.waiting[i];
+        if ( asset.fence != NULL )
+        {
+            GLenum status = glClientWaitSync(asset.fence, 0, 0);
+            if ( status == GL_TIMEOUT_EXPIRED )
+            {
+                loader.waiting[kept++] = asset;
+                continue;
+            }
+            glDeleteSync(asset.fence);
+        }
+        FinishAsset(asset.blob, asset.gpu, asset.texture_id);
+    }
+    loader.waiting.resize(kept);
+}
+
+// Sem contexto de envio: a thread principal envia os dados em partes de
+// ASSETLOADER_UPLOAD_CHUNK bytes até esgotar o tempo do quadro.
+static void UpdateMainThread(double budget_seconds)
+{
+    AssetLoaderState& loader = g_AssetLoader;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    while ( ElapsedSeconds(start) < budget_seconds )
+    {
+        if ( !loader.uploading )
+        {
+            AssetBlob* blob;
+            {
+                std::lock_guard<std::mutex> lock(loader.mutex);
+                if ( loader.prepared.empty() )
+                    return;
+                blob = loader.prepared.front();
+                loader.prepared.pop_front();
+            }
+
+            if ( blob->error.empty() && blob->needs_gpu_load )
+            {
+                MeshGpuBuffers gpu;
+                try
+                {
+                    loader.callbacks.gpu_load(blob, &gpu);
+                }
+                catch ( const std::exception& e )
+                {
+                    blob->error = e.what();
+                }
+                FinishAsset(blob, gpu);
+                continue;
+            }
+            if ( !blob->error.empty() || blob->num_tiles > 0 )
+            {
+                FinishAsset(blob, MeshGpuBuffers());
+                continue;
+            }
+
+            loader.upload = MainThreadUpload();
+            loader.upload.blob = blob;
+            if ( blob->is_texture )
+                loader.upload.texture_id = Texture_CreateGpuTexture(blob->texture);
+            else
+                MeshQuant_CreateGpuBuffers(blob->mesh, &loader.upload.gpu);
+            loader.uploading = true;
+        }
+
+        MainThreadUpload& upload = loader.upload;
+        const MeshEncodedData& mesh = upload.blob->mesh;
+        if ( upload.blob->is_texture )
+        {
+            if ( Texture_UploadChunk(upload.blob->texture, upload.texture_id, &upload.texture_upload, ASSETLOADER_UPLOAD_CHUNK) )
+            {
+                loader.uploading = false;
+                FinishAsset(upload.blob, upload.gpu, upload.texture_id);
+            }
+        }
+        else if ( upload.vertices_sent < mesh.vertices.size() )
+        {
+            size_t size = std::min(mesh.vertices.size() - upload.vertices_sent, (size_t)ASSETLOADER_UPLOAD_CHUNK);
+            glBindBuffer(GL_ARRAY_BUFFER, upload.gpu.vertices_id);
+            glBufferSubData(GL_ARRAY_BUFFER, upload.vertices_sent, size, mesh.vertices.data() + upload.vertices_sent);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            upload.vertices_sent += size;
+        }
+        else if ( upload.indices_sent < mesh.indices.size() )
+        {
+            // GL_ELEMENT_ARRAY_BUFFER depende do VAO ligado; usamos
+            // GL_COPY_WRITE_BUFFER para não alterar o estado de nenhum VAO.
+            size_t size = std::min(mesh.indices.size() - upload.indices_sent, (size_t)ASSETLOADER_UPLOAD_CHUNK);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, upload.gpu.indices_id);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, upload.indices_sent, size, mesh.indices.data() + upload.indices_sent);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            upload.indices_sent += size;
+        }
+        else
+        {
+            loader.uploading = false;
+            FinishAsset(upload.blob, upload.gpu);
+        }
+    }
+}
+
+void AssetLoader_SetMemoryBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(g_AssetLoader.mutex);
+    g_AssetLoader.memory_budget = bytes;
+    g_AssetLoader.requests_available.notify_all();
+}
+
+void AssetLoader_Update(double budget_seconds)
+{
+    if ( g_AssetLoader.pending == 0 )
+        return;
+
+    if ( g_AssetLoader.upload_context != NULL )
+        UpdateSharedContext();
+    else
+        UpdateMainThread(budget_seconds);
+}
+
+size_t AssetLoader_Pending()
+{
+    return g_AssetLoader.pending;
+}
+
+void AssetLoader_Shutdown()
+{
+    AssetLoaderState& loader = g_AssetLoader;
+    {
+        std::lock_guard<std::mutex> lock(loader.mutex);
+        loader.stopping = true;
+    }
+    loader.requests_available.notify_all();
+    loader.prepared_available.notify_all();
+
+    for (size_t i = 0; i < loader.workers.size(); ++i)
+        loader.workers[i].join();
+    loader.workers.clear();
+    if ( loader.upload_thread.joinable() )
+        loader.upload_thread.join();
+
+    // Buffers já criados na GPU são liberados junto com o contexto.
+    for (size_t i = 0; i < loader.requests.size(); ++i)
+        delete loader.requests[i];
+    for (size_t i = 0; i < loader.prepared.size(); ++i)
+        delete loader.prepared[i];
+    for (size_t i = 0; i < loader.uploaded.size(); ++i)
+        loader.waiting.push_back(loader.uploaded[i]);
+    for (size_t i = 0; i < loader.waiting.size(); ++i)
+    {
+        if ( loader.waiting[i].fence != NULL )
+            glDeleteSync(loader.waiting[i].fence);
+        delete loader.waiting[i].blob;
+    }
+    if ( loader.uploading )
+        delete loader.upload.blob;
+
+    loader.requests.clear();
+    loader.prepared.clear();
+    loader.uploaded.clear();
+    loader.waiting.clear();
+    loader.uploading = false;
+    loader.pending   = 0;
+    loader.prepared_bytes = 0;
+}
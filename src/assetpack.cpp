@@ -0,0 +1,255 @@
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include "assetpack.h"
+
+// Formato do arquivo:
+//
+//   AssetPackHeader
+//   AssetPackEntry[num_entries]  (ordenadas por name_hash e depois por nome)
+//   nomes concatenados
+//   dados de cada asset, alinhados em ASSETPACK_ALIGNMENT bytes
+
+struct AssetPackHeader
+{
+    char     magic[8];     // "FCGPACK"
+    uint32_t version;      // ASSETPACK_VERSION
+    uint32_t header_size;  // sizeof(AssetPackHeader)
+    uint64_t file_size;    // Tamanho total do arquivo
+    uint64_t entries_offset;
+    uint64_t num_entries;
+    uint64_t names_offset;
+    uint64_t names_size;
+    uint64_t reserved;     // Mantém o cabeçalho com tamanho múltiplo de 16 bytes
+};
+
+struct AssetPackEntry
+{
+    uint64_t name_hash;
+    uint32_t name_offset; // Posição do nome dentro do bloco de nomes
+    uint32_t name_length;
+    uint32_t type;        // AssetType
+    uint32_t reserved;
+    uint64_t offset;      // Posição dos dados dentro do arquivo
+    uint64_t size;
+};
+
+static const char   ASSETPACK_MAGIC[8] = "FCGPACK";
+static const size_t ASSETPACK_ALIGNMENT = 16;
+
+static_assert(sizeof(AssetPackHeader) % ASSETPACK_ALIGNMENT == 0, "AssetPackHeader deve ser alinhado");
+
+static uint64_t HashName(const char* name, size_t length)
+{
+    return HashBytes(name, length);
+}
+
+std::string AssetPack_Name(const char* path)
+{
+    std::string name(path);
+    std::replace(name.begin(), name.end(), '\\', '/');
+
+    size_t start = 0;
+    for (;;)
+    {
+        if ( name.compare(start, 2, "./") == 0 )
+            start += 2;
+        else if ( name.compare(start, 3, "../") == 0 )
+            start += 3;
+        else
+            break;
+    }
+    return name.substr(start);
+}
+
+bool AssetPack_Open(const char* filename, AssetPack* pack)
+{
+    *pack = AssetPack();
+    if ( !MapFile(filename, &pack->file) )
+        return false;
+
+    const unsigned char* base = pack->file.data;
+    const size_t         size = pack->file.size;
+    const AssetPackHeader* header = reinterpret_cast<const AssetPackHeader*>(base);
+
+    if (    size < sizeof(AssetPackHeader)
+         || memcmp(header->magic, ASSETPACK_MAGIC, sizeof(ASSETPACK_MAGIC)) != 0
+         || header->version        != ASSETPACK_VERSION
+         || header->header_size    != sizeof(AssetPackHeader)
+         || header->file_size      != size
+         || header->entries_offset % ASSETPACK_ALIGNMENT != 0
+         || header->entries_offset > size
+         || header->num_entries    > (size - header->entries_offset) / sizeof(AssetPackEntry)
+         || header->names_offset   > size
+         || header->names_size     > size - header->names_offset )
+    {
+        AssetPack_Close(pack);
+        return false;
+    }
+
+    const AssetPackEntry* entries = reinterpret_cast<const AssetPackEntry*>(base + header->entries_offset);
+    for (size_t i = 0; i < header->num_entries; ++i)
+    {
+        const AssetPackEntry& e = entries[i];
+        if (    e.name_offset > header->names_size
+             || e.name_length > header->names_size - e.name_offset
+             || e.offset % ASSETPACK_ALIGNMENT != 0
+             || e.offset > size
+             || e.size > size - e.offset
+             || (i > 0 && entries[i-1].name_hash > e.name_hash) )
+        {
+            AssetPack_Close(pack);
+            return false;
+        }
+    }
+
+    pack->entries     = entries;
+    pack->num_entries = header->num_entries;
+    pack->names       = reinterpret_cast<const char*>(base + header->names_offset);
+    return true;
+}
+
+void AssetPack_Close(AssetPack* pack)
+{
+    UnmapFile(&pack->file);
+    *pack = AssetPack();
+}
+
+bool AssetPack_Find(const AssetPack& pack, const char* path, AssetData* asset)
+{
+    if ( pack.num_entries == 0 )
+        return false;
+
+    const std::string name = AssetPack_Name(path);
+    const uint64_t    hash = HashName(name.data(), name.size());
+
+    // Busca binária pelo hash; nomes diferentes com o mesmo hash ficam em
+    // entradas consecutivas.
+    const AssetPackEntry* begin = static_cast<const AssetPackEntry*>(pack.entries);
+    const AssetPackEntry* end   = begin + pack.num_entries;
+    const AssetPackEntry* e = std::lower_bound(begin, end, hash,
+        [](const AssetPackEntry& entry, uint64_t h) { return entry.name_hash < h; });
+
+    for (; e != end && e->name_hash == hash; ++e)
+    {
+        if ( e->name_length == name.size() && memcmp(pack.names + e->name_offset, name.data(), name.size()) == 0 )
+        {
+            asset->data = pack.file.data + e->offset;
+            asset->size = e->size;
+            asset->type = static_cast<AssetType>(e->type);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Escreve "size" bytes seguidos de zeros até o próximo múltiplo de
+// ASSETPACK_ALIGNMENT.
+static bool WriteAligned(FILE* f, const void* data, size_t size, uint64_t* offset)
+{
+    static const unsigned char zeros[ASSETPACK_ALIGNMENT] = {0};
+
+    if ( size > 0 && fwrite(data, 1, size, f) != size )
+        return false;
+
+    size_t padding = (ASSETPACK_ALIGNMENT - size % ASSETPACK_ALIGNMENT) % ASSETPACK_ALIGNMENT;
+    if ( padding > 0 && fwrite(zeros, 1, padding, f) != padding )
+        return false;
+
+    *offset += size + padding;
+    return true;
+}
+
+bool AssetPack_Write(const char* filename, const std::vector<AssetPackInput>& assets)
+{
+    // Ordenamos os assets pela chave da busca binária de AssetPack_Find().
+    std::vector<size_t> order(assets.size());
+    std::vector<uint64_t> hashes(assets.size());
+    for (size_t i = 0; i < assets.size(); ++i)
+    {
+        order[i]  = i;
+        hashes[i] = HashName(assets[i].name.data(), assets[i].name.size());
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return hashes[a] != hashes[b] ? hashes[a] < hashes[b] : assets[a].name < assets[b].name;
+    });
+
+    for (size_t i = 1; i < order.size(); ++i)
+    {
+        if ( assets[order[i]].name == assets[order[i-1]].name )
+        {
+            fprintf(stderr, "ERROR: Asset \"%s\" added twice.\n", assets[order[i]].name.c_str());
+            return false;
+        }
+    }
+
+    std::vector<AssetPackEntry> entries(assets.size());
+    std::string names;
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        const AssetPackInput& asset = assets[order[i]];
+        memset(&entries[i], 0, sizeof(AssetPackEntry));
+        entries[i].name_hash   = hashes[order[i]];
+        entries[i].name_offset = names.size();
+        entries[i].name_length = asset.name.size();
+        entries[i].type        = asset.type;
+        entries[i].size        = asset.data.size();
+        names += asset.name;
+    }
+
+    AssetPackHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ASSETPACK_MAGIC, sizeof(ASSETPACK_MAGIC));
+    header.version     = ASSETPACK_VERSION;
+    header.header_size = sizeof(AssetPackHeader);
+    header.num_entries = entries.size();
+    header.names_size  = names.size();
+
+    // As posições dos dados só são conhecidas depois de escrever a tabela e
+    // os nomes; como o tamanho de ambos já é conhecido, calculamos tudo antes.
+    uint64_t offset = sizeof(AssetPackHeader);
+    header.entries_offset = offset;
+    offset += entries.size() * sizeof(AssetPackEntry);
+    offset += (ASSETPACK_ALIGNMENT - offset % ASSETPACK_ALIGNMENT) % ASSETPACK_ALIGNMENT;
+    header.names_offset = offset;
+    offset += names.size();
+    offset += (ASSETPACK_ALIGNMENT - offset % ASSETPACK_ALIGNMENT) % ASSETPACK_ALIGNMENT;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        entries[i].offset = offset;
+        offset += entries[i].size;
+        offset += (ASSETPACK_ALIGNMENT - offset % ASSETPACK_ALIGNMENT) % ASSETPACK_ALIGNMENT;
+    }
+    header.file_size = offset;
+
+    // Assim como em "meshcache.cpp", escrevemos em um arquivo temporário e o
+    // renomeamos ao final.
+    std::string temp_path = std::string(filename) + ".tmp";
+    FILE* f = fopen(temp_path.c_str(), "wb");
+    if ( f == NULL )
+        return false;
+
+    uint64_t written = 0;
+    bool ok = WriteAligned(f, &header, sizeof(header), &written);
+    ok = ok && WriteAligned(f, entries.data(), entries.size() * sizeof(AssetPackEntry), &written);
+    ok = ok && WriteAligned(f, names.data(), names.size(), &written);
+    for (size_t i = 0; ok && i < order.size(); ++i)
+    {
+        const std::vector<unsigned char>& data = assets[order[i]].data;
+        ok = WriteAligned(f, data.data(), data.size(), &written);
+    }
+    ok = ok && written == header.file_size;
+    ok = (fclose(f) == 0) && ok;
+
+    if ( ok )
+    {
+        remove(filename); // rename() não sobrescreve arquivos no Windows
+        ok = rename(temp_path.c_str(), filename) == 0;
+    }
+
+    if ( !ok )
+        remove(temp_path.c_str());
+
+    return ok;
+}
@@ -0,0 +1,166 @@
+#include <cmath>
+
+#include "frustumcull.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUMCULL_SSE
+#include <xmmintrin.h>
+#endif
+
+void FrustumCull_ExtractPlanes(const float clip_from_space[16], float planes[6][4])
+{
+    // Método de Gribb e Hartmann: cada plano é a soma ou a diferença entre a
+    // quarta linha da matriz e uma das outras três. A matriz está guardada
+    // coluna a coluna, então a linha i é m[i], m[4+i], m[8+i], m[12+i].
+    const float* m = clip_from_space;
+    for (int p = 0; p < 6; ++p)
+    {
+        const int   row  = p / 2;
+        const float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+        float* plane = planes[p];
+        for (int j = 0; j < 4; ++j)
+            plane[j] = m[4*j + 3] + sign * m[4*j + row];
+
+        const float length = std::sqrt(plane[0]*plane[0] + plane[1]*plane[1] + plane[2]*plane[2]);
+        if ( length > 0.0f )
+            for (int j = 0; j < 4; ++j)
+                plane[j] /= length;
+    }
+}
+
+void FrustumCull_Clear(FrustumCullBatch* batch)
+{
+    batch->sphere_x.clear();
+    batch->sphere_y.clear();
+    batch->sphere_z.clear();
+    batch->sphere_radius.clear();
+    batch->box_x.clear();
+    batch->box_y.clear();
+    batch->box_z.clear();
+    batch->box_extent_x.clear();
+    batch->box_extent_y.clear();
+    batch->box_extent_z.clear();
+}
+
+size_t FrustumCull_Add(FrustumCullBatch* batch, const float sphere_center[3], float sphere_radius, const float box_center[3], const float box_extent[3])
+{
+    batch->sphere_x.push_back(sphere_center[0]);
+    batch->sphere_y.push_back(sphere_center[1]);
+    batch->sphere_z.push_back(sphere_center[2]);
+    batch->sphere_radius.push_back(sphere_radius);
+    batch->box_x.push_back(box_center[0]);
+    batch->box_y.push_back(box_center[1]);
+    batch->box_z.push_back(box_center[2]);
+    batch->box_extent_x.push_back(box_extent[0]);
+    batch->box_extent_y.push_back(box_extent[1]);
+    batch->box_extent_z.push_back(box_extent[2]);
+    return batch->sphere_x.size() - 1;
+}
+
+// Testa o objeto "i" sem SSE. A AABB está fora de um plano (a, b, c, d) se a
+// distância do centro ao plano é menor que -(|a|*ex + |b|*ey + |c|*ez): a
+// projeção da caixa na normal do plano.
+static bool IsVisible(const FrustumCullBatch& batch, const float planes[6][4], size_t i)
+{
+    for (int p = 0; p < 6; ++p)
+    {
+        const float* plane = planes[p];
+        const float sphere_distance = plane[0]*batch.sphere_x[i] + plane[1]*batch.sphere_y[i] + plane[2]*batch.sphere_z[i] + plane[3];
+        if ( sphere_distance < -batch.sphere_radius[i] )
+            return false;
+
+        const float box_distance = plane[0]*batch.box_x[i] + plane[1]*batch.box_y[i] + plane[2]*batch.box_z[i] + plane[3];
+        const float box_radius   = std::fabs(plane[0])*batch.box_extent_x[i] + std::fabs(plane[1])*batch.box_extent_y[i] + std::fabs(plane[2])*batch.box_extent_z[i];
+        if ( box_distance < -box_radius )
+            return false;
+    }
+    return true;
+}
+
+size_t FrustumCull_Test(const FrustumCullBatch& batch, const float planes[6][4], std::vector<unsigned char>* visible)
+{
+    const size_t count = batch.sphere_x.size();
+    visible->resize(count);
+
+    size_t i = 0;
+    size_t num_visible = 0;
+
+#ifdef FRUSTUMCULL_SSE
+    // Quatro objetos por iteração, com as mesmas contas de IsVisible(), na
+    // mesma ordem, para que o arredondamento e portanto o resultado sejam
+    // iguais aos de FrustumCull_TestScalar(). Os coeficientes de cada plano
+    // são replicados nas quatro posições de um registrador; as condições dos
+    // seis planos são acumuladas em uma máscara.
+    __m128 plane_a[6], plane_b[6], plane_c[6], plane_d[6];
+    __m128 abs_a[6], abs_b[6], abs_c[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        plane_a[p] = _mm_set1_ps(planes[p][0]);
+        plane_b[p] = _mm_set1_ps(planes[p][1]);
+        plane_c[p] = _mm_set1_ps(planes[p][2]);
+        plane_d[p] = _mm_set1_ps(planes[p][3]);
+        abs_a[p]   = _mm_set1_ps(std::fabs(planes[p][0]));
+        abs_b[p]   = _mm_set1_ps(std::fabs(planes[p][1]));
+        abs_c[p]   = _mm_set1_ps(std::fabs(planes[p][2]));
+    }
+    const __m128 zero = _mm_setzero_ps();
+
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 sx = _mm_loadu_ps(&batch.sphere_x[i]);
+        const __m128 sy = _mm_loadu_ps(&batch.sphere_y[i]);
+        const __m128 sz = _mm_loadu_ps(&batch.sphere_z[i]);
+        const __m128 sr = _mm_sub_ps(zero, _mm_loadu_ps(&batch.sphere_radius[i]));
+        const __m128 bx = _mm_loadu_ps(&batch.box_x[i]);
+        const __m128 by = _mm_loadu_ps(&batch.box_y[i]);
+        const __m128 bz = _mm_loadu_ps(&batch.box_z[i]);
+        const __m128 ex = _mm_loadu_ps(&batch.box_extent_x[i]);
+        const __m128 ey = _mm_loadu_ps(&batch.box_extent_y[i]);
+        const __m128 ez = _mm_loadu_ps(&batch.box_extent_z[i]);
+
+        __m128 inside = _mm_cmpeq_ps(zero, zero); // Todos os bits em 1
+        for (int p = 0; p < 6; ++p)
+        {
+            __m128 sphere_distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(plane_a[p], sx), _mm_mul_ps(plane_b[p], sy)),
+                                                           _mm_mul_ps(plane_c[p], sz)), plane_d[p]);
+            __m128 box_distance    = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(plane_a[p], bx), _mm_mul_ps(plane_b[p], by)),
+                                                           _mm_mul_ps(plane_c[p], bz)), plane_d[p]);
+            __m128 box_radius      = _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs_a[p], ex), _mm_mul_ps(abs_b[p], ey)), _mm_mul_ps(abs_c[p], ez));
+
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(sphere_distance, sr));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(box_distance, _mm_sub_ps(zero, box_radius)));
+        }
+
+        const int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            const unsigned char lane_visible = (mask >> lane) & 1;
+            (*visible)[i + lane] = lane_visible;
+            num_visible += lane_visible;
+        }
+    }
+#endif
+
+    // Objetos restantes (ou todos, sem SSE).
+    for (; i < count; ++i)
+    {
+        (*visible)[i] = IsVisible(batch, planes, i) ? 1 : 0;
+        num_visible += (*visible)[i];
+    }
+
+    return num_visible;
+}
+
+size_t FrustumCull_TestScalar(const FrustumCullBatch& batch, const float planes[6][4], std::vector<unsigned char>* visible)
+{
+    const size_t count = batch.sphere_x.size();
+    visible->resize(count);
+
+    size_t num_visible = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        (*visible)[i] = IsVisible(batch, planes, i) ? 1 : 0;
+        num_visible += (*visible)[i];
+    }
+    return num_visible;
+}
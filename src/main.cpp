@@ -1,6 +1,9 @@
+#include <cassert>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <cstddef>
 
 // Headers abaixo so especficos de C++
 #include <map>
@@ -20,6 +23,7 @@
 // Headers da biblioteca GLM: criao de matrizes e vetores.
 #include <glm/mat4x4.hpp>
 #include <glm/vec4.hpp>
+#include <glm/matrix.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 // Headers da biblioteca para carregar modelos obj
@@ -28,34 +32,25 @@
 // Headers locais, definidos na pasta "include/"
 #include "utils.h"
 #include "matrices.h"
-
-// Estrutura que representa um modelo geomtrico carregado a partir de um
-// arquivo ".obj". Veja https://en.wikipedia.org/wiki/Wavefront_.obj_file .
-struct ObjModel
-{
-    tinyobj::attrib_t                 attrib;
-    std::vector<tinyobj::shape_t>     shapes;
-    std::vector<tinyobj::material_t>  materials;
-
-    // Este construtor l o modelo de um arquivo utilizando a biblioteca tinyobjloader.
-    // Veja: https://github.com/syoyo/tinyobjloader
-    ObjModel(const char* filename, const char* basepath = NULL, bool triangulate = true)
-    {
-        printf("Carregando modelo \"%s\"... ", filename);
-
-        std::string err;
-        bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filename, basepath, triangulate);
-
-        if (!err.empty())
-            fprintf(stderr, "\n%s\n", err.c_str());
-
-        if (!ret)
-            throw std::runtime_error("Erro ao carregar modelo.");
-
-        printf("OK.\n");
-    }
-};
-
+#include "mesh.h"
+#include "meshcache.h"
+#include "meshstream.h"
+#include "meshopt.h"
+#include "meshquant.h"
+#include "meshlod.h"
+#include "meshnormals.h"
+#include "meshcluster.h"
+#include "meshmaterial.h"
+#include "mesharena.h"
+#include "renderqueue.h"
+#include "frustumcull.h"
+#include "aabbtree.h"
+#include "occlusioncull.h"
+#include "meshtile.h"
+#include "texture.h"
+#include "texturecache.h"
+#include "assetloader.h"
+#include "assetpack.h"
 
 // Declarao de funes utilizadas para pilha de matrizes de modelagem.
 void PushMatrix(glm::mat4 M);
@@ -64,9 +59,21 @@ void PopMatrix(glm::mat4& M);
 // Declarao de vrias funes utilizadas em main().  Essas esto definidas
 // logo aps a definio de main() neste arquivo.
 void BuildTrianglesAndAddToVirtualScene(ObjModel*); // Constri representao de um ObjModel como malha de tringulos para renderizao
-void ComputeNormals(ObjModel* model); // Computa normais de um ObjModel, caso no existam.
+void UploadMeshAndAddToVirtualScene(const MeshBuffers& buffers); // Envia uma malha para a GPU e a adiciona em g_VirtualScene
+void AddMeshToVirtualScene(const MeshGpuBuffers& gpu, const std::string& directory); // Copia uma malha j na GPU para a arena e a adiciona em g_VirtualScene
+GLuint CreateMeshVertexArray(const MeshGpuBuffers& gpu); // Cria o VAO de uma malha j na GPU
+void LoadModelAndAddToVirtualScene(const char* filename); // Carrega um ".obj" (ou seu cache) e o adiciona em g_VirtualScene
+void PrepareModel(AssetBlob* blob); // L e processa um modelo, sem usar OpenGL (veja "assetloader.h")
+void ProcessMeshData(MeshData* mesh); // Otimiza uma malha e gera seus nveis de detalhe e clusters
+void LoadModelToGpu(AssetBlob* blob, MeshGpuBuffers* gpu); // Carrega um modelo grande diretamente para a GPU
+void AddLoadedModelToVirtualScene(const AssetBlob& blob, const MeshGpuBuffers& gpu); // Adiciona um modelo carregado em g_VirtualScene
+void PrepareTexture(AssetBlob* blob); // L uma textura do pacote, do cache ou da imagem, sem usar OpenGL
+void AddLoadedTexture(const AssetBlob& blob, GLuint texture_id); // Torna disponvel uma textura carregada
+int RequestSceneTexture(const std::string& filename); // Pede o carregamento de uma textura, caso ainda no tenha sido pedido
+void CreatePlaceholderObject(); // Cria o objeto desenhado no lugar de modelos ainda no carregados
 void LoadShadersFromFiles(); // Carrega os shaders de vrtice e fragmento, criando um programa de GPU
-void DrawVirtualObject(const char* object_name); // Desenha um objeto armazenado em g_VirtualScene
+void DrawVirtualObject(int object_handle, const glm::mat4& model); // Desenha um objeto armazenado em g_VirtualScene
+void CreateInstanceBuffer(); // Cria o buffer de atributos por instncia, compartilhado por todos os VAOs
 GLuint LoadShader_Vertex(const char* filename);   // Carrega um vertex shader
 GLuint LoadShader_Fragment(const char* filename); // Carrega um fragment shader
 void LoadShader(const char* filename, GLuint shader_id); // Funo utilizada pelas duas acima
@@ -101,24 +108,207 @@ void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 void CursorPosCallback(GLFWwindow* window, double xpos, double ypos);
 void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 
+// Nvel de detalhe de uma parte de um SceneObject: outro intervalo do mesmo
+// buffer de ndices. Veja "meshlod.h".
+struct SceneObjectLod
+{
+    void*        first_index;
+    int          num_indices;
+};
+
+// Parte de um SceneObject desenhada com um nico material: uma MeshShape da
+// malha (veja BuildMeshData() em "mesh.cpp").
+struct SceneObjectSubmesh
+{
+    void*        first_index; // Posio, em bytes, do primeiro ndice dentro do buffer de ndices
+    int          num_indices; // Nmero de ndices da parte
+    std::vector<SceneObjectLod> lods; // Nveis de detalhe simplificados (veja "meshlod.h")
+    std::vector<MeshCluster> clusters; // Clusters do nvel 0, com first_index em bytes (veja "meshcluster.h")
+    int          material;    // Posio do material no UBO de materiais (veja "meshmaterial.h"), ou -1
+    int          texture;     // Posio da textura difusa do material em g_SceneTextures, ou -1
+};
+
 // Definimos uma estrutura que armazenar dados necessrios para renderizar
 // cada objeto da cena virtual.
 struct SceneObject
 {
     std::string  name;        // Nome do objeto
-    void*        first_index; // ndice do primeiro vrtice dentro do vetor indices[] definido em BuildTrianglesAndAddToVirtualScene()
-    int          num_indices; // Nmero de ndices do objeto dentro do vetor indices[] definido em BuildTrianglesAndAddToVirtualScene()
+    std::vector<SceneObjectSubmesh> submeshes; // Partes do objeto, uma por material, ordenadas por material
+    std::vector<int> materials; // Posies no UBO de materiais usadas pelas partes, sem repeties; o objeto tem uma referncia a cada uma
     GLenum       rendering_mode; // Modo de rasterizao (GL_TRIANGLES, GL_TRIANGLE_STRIP, etc.)
-    GLuint       vertex_array_object_id; // ID do VAO onde esto armazenados os atributos do modelo
+    int          arena_mesh;  // Malha em "mesharena.h" com os vrtices e ndices (compartilhada pelas shapes de uma malha), ou -1 se o objeto no foi carregado
+    float        bounds_center[3]; // Esfera envolvente de todas as partes, em coordenadas do modelo
+    float        bounds_radius;
+    float        bounds_min[3];    // Caixa alinhada aos eixos (AABB) envolvente de todas as partes, idem
+    float        bounds_max[3];
+    GLenum       index_type;  // Tipo dos ndices (GL_UNSIGNED_INT ou GL_UNSIGNED_SHORT)
+    float        position_scale[3];  // Transformao das posies quantizadas (veja "meshquant.h")
+    float        position_offset[3];
+};
+
+SceneObject BuildSceneObject(const MeshGpuBuffers& gpu, const std::string& name, int arena_mesh); // Constri um SceneObject, ainda sem partes, de uma malha j na arena
+void AddSubmeshToSceneObject(SceneObject* object, const MeshGpuBuffers& gpu, size_t shape, int material, int texture); // Acrescenta uma shape da malha como parte do objeto
+void UnloadSceneObject(const std::string& name); // Remove um objeto de g_VirtualScene, liberando sua geometria
+
+// Instncia de um objeto desenhada por DrawVirtualObjectInstanced(): os
+// atributos por instncia de "shader_vertex.glsl" (posies 3 a 7).
+struct SceneInstance
+{
+    float model[16]; // Matriz de modelagem, coluna por coluna (como glm::value_ptr())
+    int   object_id; // Identificador do objeto em "shader_fragment.glsl" (SPHERE, BUNNY, ...)
+};
+
+void DrawVirtualObjectInstanced(int object_handle, const SceneInstance* instances, size_t num_instances); // Desenha vrias instncias de um objeto
+
+// Desenho enviado  fila da cena (veja "renderqueue.h"): um objeto com sua
+// matriz de modelagem e identificador, ou vrias instncias de um objeto.
+struct ScenePacket
+{
+    int                  object_handle;
+    GLuint               program;       // Programa de GPU usado no desenho
+    glm::mat4            model;         // No usada por desenhos com instncias
+    int                  object_id;     // Identificador do objeto em "shader_fragment.glsl" (SPHERE, BUNNY, ...)
+    const SceneInstance* instances;     // NULL se o desenho no usa instncias; deve continuar vlido at DrawSceneQueue()
+    size_t               num_instances;
+    size_t               first_bounds;  // Posio em g_SceneBounds dos volumes do objeto, ou da primeira instncia
+};
+
+// Passos da cena, o campo mais significativo da chave de ordenao.
+#define SCENE_PASS_OPAQUE 0
+
+void SubmitVirtualObject(int object_handle, const glm::mat4& model, int object_id); // Envia o desenho de um objeto  fila da cena
+void SubmitVirtualObjectInstanced(int object_handle, const SceneInstance* instances, size_t num_instances); // Envia o desenho de vrias instncias de um objeto
+void DrawSceneQueue(); // Ordena e executa os desenhos enviados no quadro
+
+// Objeto colocado na cena (veja PlaceSceneObject()): fica em g_SceneTree e 
+// enviado  fila da cena por SubmitPlacedObjects() sempre que pode estar
+// visvel.
+struct ScenePlacement
+{
+    int           object_handle;
+    SceneInstance instance;  // Matriz de modelagem e identificador do objeto
+    bool          instanced; // Desenhado junto com as demais colocaes do mesmo objeto, com instncias
+    int           proxy;     // Folha em g_SceneTree
 };
 
+int  PlaceSceneObject(int object_handle, const glm::mat4& model, int object_id, bool instanced); // Coloca um objeto na cena e retorna a posio da colocao
+void MoveSceneObject(int placement, const glm::mat4& model); // Muda a matriz de modelagem de uma colocao
+void RefitScenePlacements(int object_handle); // Atualiza g_SceneTree depois que os volumes envolventes de um objeto mudam
+void SubmitPlacedObjects(); // Envia  fila da cena as colocaes que podem estar visveis
+int  PickScenePlacement(GLFWwindow* window, double x, double y); // Colocao sob o cursor, ou -1
+void DrawOccludedPlacements(); // Consulta a ocluso das colocaes e desenha as escondidas com glBeginConditionalRender()
+int GetSceneObjectHandle(const std::string& name); // Posio de um objeto em g_VirtualScene, reservada caso ainda no exista
+void ReportMissingSceneObjects(); // Avisa sobre objetos pedidos que no foram carregados
+
 // Abaixo definimos variveis globais utilizadas em vrias funes do cdigo.
 
-// A cena virtual  uma lista de objetos nomeados, guardados em um dicionrio
-// (map).  Veja dentro da funo BuildTrianglesAndAddToVirtualScene() como que so includos
-// objetos dentro da varivel g_VirtualScene, e veja na funo main() como
-// estes so acessados.
-std::map<std::string, SceneObject> g_VirtualScene;
+// A cena virtual  uma lista de objetos guardados em um vetor contnuo. Cada
+// nome de objeto corresponde a uma posio fixa do vetor (o "handle" do
+// objeto), obtida uma nica vez com GetSceneObjectHandle(), de forma que
+// DrawVirtualObject() acessa o objeto diretamente, sem comparar strings a
+// cada quadro. Veja dentro da funo AddMeshToVirtualScene() como que so
+// includos objetos dentro da varivel g_VirtualScene, e veja na funo
+// main() como estes so acessados. Um objeto cujo handle j foi pedido, mas
+// que ainda no foi carregado, tem arena_mesh == -1.
+std::vector<SceneObject>   g_VirtualScene;
+std::map<std::string, int> g_VirtualSceneIndices; // Posio de cada nome em g_VirtualScene
+
+// Objeto desenhado por DrawVirtualObject() no lugar de objetos que ainda no
+// esto em g_VirtualScene, por estarem sendo carregados em segundo plano.
+// Veja CreatePlaceholderObject().
+SceneObject g_PlaceholderObject;
+
+// Texturas dos materiais (veja "texture.h"), carregadas em segundo plano. Uma
+// textura ainda no carregada tem texture_id == 0, e as partes que a usam so
+// desenhadas apenas com as cores do material.
+struct SceneTexture
+{
+    std::string filename;
+    GLuint      texture_id;
+    size_t      memory;     // Memria reservada com Texture_ReserveMemory()
+};
+std::vector<SceneTexture>  g_SceneTextures;
+std::map<std::string, int> g_SceneTextureIndices; // Posio de cada arquivo em g_SceneTextures
+
+// Pacote de assets (veja "assetpack.h"). Se o arquivo ASSETPACK_DEFAULT_FILENAME
+// existir no diretrio de execuo, modelos, shaders e a fonte so lidos dele
+// em vez de arquivos separados.
+AssetPack g_AssetPack;
+
+// Memria principal, em bytes, usada para dividir modelos grandes em tiles
+// (veja "meshtile.h") e para dados  espera de envio para a GPU (veja
+// AssetLoader_SetMemoryBudget()). Definida com "--memory-budget <MB>".
+size_t g_MemoryBudget = MESHTILE_DEFAULT_MEMORY_BUDGET;
+
+// Buffer com os atributos por instncia (veja SceneInstance), ligado a todos
+// os VAOs e reescrito a cada chamada de DrawVirtualObjectInstanced(). Seu
+// tamanho, em instncias, s aumenta. Veja CreateInstanceBuffer().
+GLuint g_InstanceBufferId = 0;
+size_t g_InstanceBufferCapacity = 0;
+
+// VAO da arena ligado por BindSceneVertexArray(), para no chamar
+// glBindVertexArray() quando objetos consecutivos usam o mesmo formato de
+// vrtice. Zerado quando outro cdigo liga um VAO (por exemplo, o texto).
+GLuint g_BoundVertexArrayId = 0;
+
+// Material e textura enviados por BindSubmeshMaterial() (-2 se nenhum). Como
+// g_BoundVertexArrayId, valem entre objetos e so zerados por
+// DrawSceneQueue() ao fim da cena.
+int g_BoundMaterial = -2;
+int g_BoundTexture  = -2;
+
+// Fila de desenhos da cena, preenchida a cada quadro (veja "renderqueue.h").
+// g_ScenePackets guarda os pacotes; a fila guarda as chaves e as posies
+// dos pacotes neste vetor.
+std::vector<ScenePacket> g_ScenePackets;
+RenderQueue              g_SceneQueue;
+
+// Programas de GPU usados pelos pacotes do quadro. O campo de programa da
+// chave guarda a posio do programa neste vetor, e no o nome dado pelo
+// OpenGL, que pode ser maior que o campo (veja GetSceneProgramIndex()).
+std::vector<GLuint>      g_ScenePrograms;
+
+// Volumes envolventes, em coordenadas do mundo, de cada objeto e de cada
+// instncia enviados no quadro, testados de uma vez contra g_CameraFrustum
+// antes de os desenhos entrarem na fila (veja "frustumcull.h").
+// g_VisibleInstances guarda as instncias que passaram no teste.
+FrustumCullBatch           g_SceneBounds;
+std::vector<unsigned char> g_SceneVisible;
+std::vector<SceneInstance> g_VisibleInstances;
+
+// Objetos colocados na cena e a rvore de caixas envolventes, em coordenadas
+// do mundo, com uma folha por colocao (veja "aabbtree.h"). A rvore  usada
+// no culling, na seleo com o mouse e em consultas de proximidade, de forma
+// que o custo por quadro depende do nmero de objetos visveis, e no do
+// nmero de objetos na cena. Cada folha guarda a posio da colocao em
+// g_ScenePlacements.
+std::vector<ScenePlacement> g_ScenePlacements;
+AabbTree                    g_SceneTree;
+
+// Descarte por ocluso (veja "occlusioncull.h"), ligado com a tecla C ou com
+// "--occlusion". As colocaes so os objetos de "occlusioncull.h". A cada
+// quadro, SubmitPlacedObjects() separa as colocaes escondidas, que no vo
+// para a fila da cena, e as visveis que devem ser consultadas de novo;
+// DrawOccludedPlacements() as consulta depois da cena e desenha as
+// escondidas em grupos.
+bool             g_UseOcclusionCulling = false;
+std::vector<int> g_OccludedPlacements;
+std::vector<int> g_OcclusionTests;
+
+// Uma colocao cuja caixa, aumentada por esta distncia, contm a cmera 
+// sempre desenhada: a caixa seria cortada pelo plano near e a consulta
+// poderia falhar. Maior que a distncia at o plano near.
+#define OCCLUSION_CAMERA_MARGIN 0.2f
+
+// Nmero mximo de colocaes escondidas em um grupo de
+// DrawOccludedPlacements(). Grupos maiores fazem menos consultas e desenhos,
+// mas, se uma nica colocao de um grupo reaparece, todas so desenhadas
+// at serem consultadas sozinhas.
+#define OCCLUSION_MAX_GROUP_PLACEMENTS 32
+
+// Nmero de coelhos extras desenhados com instncias, em uma grade abaixo da
+// cena. Definido com "--bunnies <N>".
+size_t g_NumInstancedBunnies = 0;
 
 // Pilha que guardar as matrizes de modelagem.
 std::stack<glm::mat4>  g_MatrixStack;
@@ -126,6 +316,17 @@ std::stack<glm::mat4>  g_MatrixStack;
 // Razo de proporo da janela (largura/altura). Veja funo FramebufferSizeCallback().
 float g_ScreenRatio = 1.0f;
 
+// Altura da janela em pixels. Veja funo FramebufferSizeCallback().
+float g_ScreenHeight = 600.0f;
+
+// Parmetros da cmera usados por DrawVirtualObject() para escolher o nvel
+// de detalhe de cada objeto e descartar clusters invisveis. Atualizados a
+// cada quadro, junto com as matrizes "view" e "projection".
+glm::mat4 g_CameraView;
+glm::mat4 g_CameraProjection;
+float     g_CameraFrustum[6][4]; // Planos do frustum em coordenadas do mundo (veja "frustumcull.h")
+float     g_PixelsPerUnit = 1.0f; // Pixels por unidade de comprimento a distncia 1 da cmera (perspectiva) ou a qualquer distncia (ortogrfica)
+
 // ngulos de Euler que controlam a rotao de um dos cubos da cena virtual
 float g_AngleX = 0.0f;
 float g_AngleY = 0.0f;
@@ -167,6 +368,11 @@ GLint model_uniform;
 GLint view_uniform;
 GLint projection_uniform;
 GLint object_id_uniform;
+GLint position_scale_uniform;
+GLint position_offset_uniform;
+GLint material_index_uniform;
+GLint texture_enabled_uniform;
+GLint instanced_uniform;
 
 int main(int argc, char* argv[])
 {
@@ -235,30 +441,73 @@ int main(int argc, char* argv[])
 
     printf("GPU: %s, %s, OpenGL %s, GLSL %s\n", vendor, renderer, glversion, glslversion);
 
+    // Abrimos o pacote de assets, caso exista. Veja "assetpack.h".
+    if ( AssetPack_Open(ASSETPACK_DEFAULT_FILENAME, &g_AssetPack) )
+        printf("Usando pacote de assets \"%s\" (%zu assets).\n", ASSETPACK_DEFAULT_FILENAME, g_AssetPack.num_entries);
+
     // Carregamos os shaders de vrtices e de fragmentos que sero utilizados
     // para renderizao. Veja slides 217-219 do documento "Aula_03_Rendering_Pipeline_Grafico.pdf".
     //
+    MeshMaterial_Init();
+    Texture_Init();
     LoadShadersFromFiles();
 
-    // Construmos a representao de objetos geomtricos atravs de malhas de tringulos
-    ObjModel spheremodel("../../data/sphere.obj");
-    ComputeNormals(&spheremodel);
-    BuildTrianglesAndAddToVirtualScene(&spheremodel);
-
-    ObjModel bunnymodel("../../data/bunny.obj");
-    ComputeNormals(&bunnymodel);
-    BuildTrianglesAndAddToVirtualScene(&bunnymodel);
-
-    ObjModel planemodel("../../data/plane.obj");
-    ComputeNormals(&planemodel);
-    BuildTrianglesAndAddToVirtualScene(&planemodel);
+    // Construmos a representao de objetos geomtricos atravs de malhas de
+    // tringulos. Os modelos so carregados em segundo plano (veja
+    // "assetloader.h"), e at que cheguem  desenhado um cubo no lugar de
+    // cada um. Veja PrepareModel() e "meshcache.h": a partir da segunda
+    // execuo os modelos so lidos do cache binrio.
+    CreateInstanceBuffer();
+    MeshArena_Init(CreateMeshVertexArray);
+    CreatePlaceholderObject();
+    OcclusionCull_Init();
+
+    // Com "--upload-context", os dados so enviados para a GPU por uma thread
+    // com um segundo contexto OpenGL, compartilhado com o da janela. Para
+    // isso criamos uma janela invisvel, que nunca  mostrada. Os demais
+    // argumentos, exceto "--memory-budget <MB>", "--bunnies <N>" e
+    // "--occlusion", so modelos a carregar.
+    bool use_upload_context = false;
+    std::vector<const char*> model_filenames;
+    for (int i = 1; i < argc; ++i)
+    {
+        if ( strcmp(argv[i], "--upload-context") == 0 )
+            use_upload_context = true;
+        else if ( strcmp(argv[i], "--memory-budget") == 0 && i + 1 < argc )
+            g_MemoryBudget = (size_t)std::max(1L, strtol(argv[++i], NULL, 10)) * 1024 * 1024;
+        else if ( strcmp(argv[i], "--bunnies") == 0 && i + 1 < argc )
+            g_NumInstancedBunnies = (size_t)std::max(0L, strtol(argv[++i], NULL, 10));
+        else if ( strcmp(argv[i], "--occlusion") == 0 )
+            g_UseOcclusionCulling = true;
+        else
+            model_filenames.push_back(argv[i]);
+    }
 
-    if ( argc > 1 )
+    GLFWwindow* upload_window = NULL;
+    if ( use_upload_context )
     {
-        ObjModel model(argv[1]);
-        BuildTrianglesAndAddToVirtualScene(&model);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        upload_window = glfwCreateWindow(1, 1, "", NULL, window);
+        if ( !upload_window )
+            fprintf(stderr, "WARNING: Cannot create upload context; uploading from the main thread.\n");
     }
 
+    AssetLoaderCallbacks callbacks;
+    callbacks.prepare  = PrepareModel;
+    callbacks.gpu_load = LoadModelToGpu;
+    callbacks.ready    = AddLoadedModelToVirtualScene;
+    callbacks.prepare_texture = PrepareTexture;
+    callbacks.texture_ready   = AddLoadedTexture;
+    AssetLoader_Init(callbacks, upload_window);
+    AssetLoader_SetMemoryBudget(g_MemoryBudget);
+
+    AssetLoader_Request("../../data/sphere.obj");
+    AssetLoader_Request("../../data/bunny.obj");
+    AssetLoader_Request("../../data/plane.obj");
+
+    for (size_t i = 0; i < model_filenames.size(); ++i)
+        AssetLoader_Request(model_filenames[i]);
+
     // Inicializamos o cdigo para renderizao de texto.
     TextRendering_Init();
 
@@ -276,9 +525,51 @@ int main(int argc, char* argv[])
     glm::mat4 the_model;
     glm::mat4 the_view;
 
+    // Objetos desenhados a cada quadro. Os nomes so resolvidos uma nica vez,
+    // antes mesmo de os modelos terminarem de ser carregados.
+    int sphere_object = GetSceneObjectHandle("sphere");
+    int bunny_object  = GetSceneObjectHandle("bunny");
+    int plane_object  = GetSceneObjectHandle("plane");
+    bool reported_missing_objects = false;
+
+    #define SPHERE 0
+    #define BUNNY  1
+    #define PLANE  2
+
+    // Colocamos os objetos na cena (veja PlaceSceneObject()). O coelho 
+    // movido a cada quadro, conforme os ngulos de Euler.
+    PlaceSceneObject(sphere_object, Matrix_Translate(-1.0f,0.0f,0.0f), SPHERE, false);
+    int bunny_placement = PlaceSceneObject(bunny_object, Matrix_Translate(1.0f,0.0f,0.0f), BUNNY, false);
+    PlaceSceneObject(plane_object, Matrix_Translate(0.0f,-1.0f,0.0f) * Matrix_Scale(2.0f, 1.0f, 2.0f), PLANE, false);
+
+    // Coelhos extras, todos desenhados com uma nica chamada por parte e
+    // nvel de detalhe (veja DrawVirtualObjectInstanced()). Ficam em uma
+    // grade quadrada no plano y = -2, cada um girado em torno de y.
+    size_t grid_size = (size_t)ceil(sqrt((double)g_NumInstancedBunnies));
+    for (size_t i = 0; i < g_NumInstancedBunnies; ++i)
+    {
+        float x = (float)(i % grid_size) - 0.5f*(grid_size - 1);
+        float z = (float)(i / grid_size) - 0.5f*(grid_size - 1);
+        PlaceSceneObject(bunny_object, Matrix_Translate(x, -2.0f, z) * Matrix_Rotate_Y(0.7f * i), BUNNY, true);
+    }
+
     // Ficamos em loop, renderizando, at que o usurio feche a janela
     while (!glfwWindowShouldClose(window))
     {
+        // Adicionamos  cena os modelos que terminaram de ser carregados,
+        // enviando dados para a GPU por no mximo ASSETLOADER_FRAME_BUDGET
+        // segundos (veja "assetloader.h").
+        AssetLoader_Update(ASSETLOADER_FRAME_BUDGET);
+
+        // Quando no h mais nada sendo carregado, avisamos uma nica vez
+        // sobre objetos que nunca apareceram em nenhum modelo (por exemplo,
+        // por um erro de digitao no nome).
+        if ( !reported_missing_objects && AssetLoader_Pending() == 0 )
+        {
+            ReportMissingSceneObjects();
+            reported_missing_objects = true;
+        }
+
         // Aqui executamos as operaes de renderizao
 
         // Definimos a cor do "fundo" do framebuffer como branco.  Tal cor 
@@ -331,6 +622,10 @@ int main(int argc, char* argv[])
             // Para definio do field of view (FOV), veja slide 227 do documento "Aula_09_Projecoes.pdf".
             float field_of_view = 3.141592 / 3.0f;
             projection = Matrix_Perspective(field_of_view, g_ScreenRatio, nearplane, farplane);
+
+            // A distncia d da cmera, a altura da janela corresponde a
+            // 2*d*tan(fov/2) unidades.
+            g_PixelsPerUnit = g_ScreenHeight / (2.0f * tanf(field_of_view / 2.0f));
         }
         else
         {
@@ -344,8 +639,15 @@ int main(int argc, char* argv[])
             float r = t*g_ScreenRatio;
             float l = -r;
             projection = Matrix_Orthographic(l, r, b, t, nearplane, farplane);
+
+            // A altura da janela corresponde a (t - b) unidades.
+            g_PixelsPerUnit = g_ScreenHeight / (t - b);
         }
 
+        g_CameraView = view;
+        g_CameraProjection = projection;
+        FrustumCull_ExtractPlanes(glm::value_ptr(projection * view), g_CameraFrustum);
+
         glm::mat4 model = Matrix_Identity(); // Transformao identidade de modelagem
 
         // Enviamos as matrizes "view" e "projection" para a placa de vdeo
@@ -354,31 +656,28 @@ int main(int argc, char* argv[])
         glUniformMatrix4fv(view_uniform       , 1 , GL_FALSE , glm::value_ptr(view));
         glUniformMatrix4fv(projection_uniform , 1 , GL_FALSE , glm::value_ptr(projection));
 
-        #define SPHERE 0
-        #define BUNNY  1
-        #define PLANE  2
-
-        // Desenhamos o modelo da esfera
-        model = Matrix_Translate(-1.0f,0.0f,0.0f);
-        glUniformMatrix4fv(model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(object_id_uniform, SPHERE);
-        DrawVirtualObject("sphere");
+        // Os objetos no so desenhados imediatamente: os objetos colocados
+        // na cena que podem estar visveis, encontrados em g_SceneTree, so
+        // enviados  fila da cena, que descarta os que esto fora do
+        // frustum, ordena os demais por estado de OpenGL e os desenha em
+        // DrawSceneQueue(). Veja "aabbtree.h", "frustumcull.h" e
+        // "renderqueue.h".
 
-        // Desenhamos o modelo do coelho
+        // Movemos o coelho
         model = Matrix_Translate(1.0f,0.0f,0.0f)
               * Matrix_Rotate_Z(g_AngleZ)
               * Matrix_Rotate_Y(g_AngleY)
               * Matrix_Rotate_X(g_AngleX);
-        glUniformMatrix4fv(model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(object_id_uniform, BUNNY);
-        DrawVirtualObject("bunny");
+        MoveSceneObject(bunny_placement, model);
 
-        // Desenhamos o modelo do plano
-        model = Matrix_Translate(0.0f,-1.0f,0.0f)
-              * Matrix_Scale(2.0f, 1.0f, 2.0f);
-        glUniformMatrix4fv(model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(object_id_uniform, PLANE);
-        DrawVirtualObject("plane");
+        // Enviamos os objetos colocados na cena.
+        SubmitPlacedObjects();
+
+        // Desenhamos a cena, antes de escrever o texto. Com o descarte por
+        // ocluso, as colocaes escondidas so consultadas depois dos
+        // objetos visveis, que preenchem o buffer de profundidade.
+        DrawSceneQueue();
+        DrawOccludedPlacements();
 
         // Pegamos um vrtice com coordenadas de modelo (0.5, 0.5, 0.5, 1) e o
         // passamos por todos os sistemas de coordenadas armazenados nas
@@ -413,6 +712,20 @@ int main(int argc, char* argv[])
         glfwPollEvents();
     }
 
+    // Terminamos as threads de carregamento antes de destruir os contextos
+    AssetLoader_Shutdown();
+    if ( upload_window )
+        glfwDestroyWindow(upload_window);
+    AssetPack_Close(&g_AssetPack);
+    MeshMaterial_Shutdown();
+    MeshArena_Shutdown();
+    OcclusionCull_Shutdown();
+    for (size_t i = 0; i < g_SceneTextures.size(); ++i)
+    {
+        glDeleteTextures(1, &g_SceneTextures[i].texture_id);
+        Texture_ReleaseMemory(g_SceneTextures[i].memory);
+    }
+
     // Finalizamos o uso dos recursos do sistema operacional
     glfwTerminate();
 
@@ -420,30 +733,855 @@ int main(int argc, char* argv[])
     return 0;
 }
 
-// Funo que desenha um objeto armazenado em g_VirtualScene. Veja definio
-// dos objetos na funo BuildTrianglesAndAddToVirtualScene().
-void DrawVirtualObject(const char* object_name)
+// Escolhe o nvel de detalhe de um objeto pelo dimetro, em pixels, de sua
+// esfera envolvente projetada na tela. Veja "meshlod.h".
+int SelectLevelOfDetail(const SceneObject& object, const glm::mat4& model)
+{
+    // Cada parte tem seus prprios nveis; o nvel escolhido  limitado ao
+    // nmero de nveis de cada parte em DrawVirtualObject().
+    size_t num_lods = 0;
+    for (size_t i = 0; i < object.submeshes.size(); ++i)
+        num_lods = std::max(num_lods, object.submeshes[i].lods.size());
+    if ( num_lods == 0 )
+        return 0;
+
+    // O raio  multiplicado pela maior escala da matriz de modelagem.
+    float scale = std::max(norm(model[0]), std::max(norm(model[1]), norm(model[2])));
+    float radius = object.bounds_radius * scale;
+
+    glm::vec4 center = g_CameraView * model * glm::vec4(object.bounds_center[0], object.bounds_center[1], object.bounds_center[2], 1.0f);
+
+    float diameter = 2.0f * radius * g_PixelsPerUnit;
+    if ( g_UsePerspectiveProjection )
+    {
+        // A cmera olha para -z. Usamos a distncia at o ponto mais prximo
+        // da esfera; se a cmera estiver dentro dela, o objeto  completo.
+        float distance = -center.z - radius;
+        if ( distance <= 0.0f )
+            return 0;
+        diameter /= distance;
+    }
+
+    return MeshLod_SelectLevel(diameter, num_lods);
+}
+
+// Calcula a cmera em coordenadas do modelo usada no culling de clusters
+// (veja "meshcluster.h").
+void BuildClusterView(const glm::mat4& model, MeshClusterView* out)
+{
+    MeshClusterView& view = *out;
+    glm::mat4 clip_from_model = g_CameraProjection * g_CameraView * model;
+    MeshCluster_ExtractPlanes(glm::value_ptr(clip_from_model), &view);
+
+    glm::mat4 model_from_world = glm::inverse(model);
+    glm::mat4 world_from_camera = glm::inverse(g_CameraView);
+    glm::vec4 position = model_from_world * world_from_camera * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    glm::vec4 direction = model_from_world * world_from_camera * glm::vec4(0.0f, 0.0f, -1.0f, 0.0f);
+    direction = direction / norm(direction);
+
+    view.perspective = g_UsePerspectiveProjection;
+    for (int i = 0; i < 3; ++i)
+    {
+        view.position[i]  = position[i] / position.w;
+        view.direction[i] = direction[i];
+    }
+}
+
+// Desenha os clusters de uma parte de um objeto que esto dentro do frustum
+// da cmera e no esto totalmente de costas para ela. Os testes so feitos
+// em coordenadas do modelo; clusters visveis consecutivos no buffer de
+// ndices so unidos em um nico intervalo de glMultiDrawElements().
+void DrawVisibleClusters(const SceneObject& object, const SceneObjectSubmesh& submesh, const MeshClusterView& view)
+{
+    // Vetores reaproveitados entre chamadas, para no alocar memria a cada
+    // quadro.
+    static std::vector<GLsizei>     counts;
+    static std::vector<const void*> offsets;
+    static std::vector<GLint>       base_vertices;
+    counts.clear();
+    offsets.clear();
+
+    const size_t index_size = MeshQuant_IndexSize(object.index_type);
+    for (size_t c = 0; c < submesh.clusters.size(); ++c)
+    {
+        const MeshCluster& cluster = submesh.clusters[c];
+        if ( !MeshCluster_IsVisible(cluster, view) )
+            continue;
+
+        if ( !counts.empty() && (const char*)offsets.back() + counts.back() * index_size == (const char*)cluster.first_index )
+        {
+            counts.back() += cluster.num_indices;
+        }
+        else
+        {
+            counts.push_back(cluster.num_indices);
+            offsets.push_back((const void*)cluster.first_index);
+        }
+    }
+
+    const GLint base_vertex = (GLint)MeshArena_Mesh(object.arena_mesh).first_vertex;
+    if ( counts.size() == 1 )
+    {
+        glDrawElementsBaseVertex(object.rendering_mode, counts[0], object.index_type, (void*)offsets[0], base_vertex);
+    }
+    else if ( !counts.empty() )
+    {
+        base_vertices.assign(counts.size(), base_vertex);
+        glMultiDrawElementsBaseVertex(object.rendering_mode, counts.data(), object.index_type, (void* const*)offsets.data(), counts.size(), base_vertices.data());
+    }
+}
+
+// Liga o VAO da arena usado por um objeto (veja "mesharena.h"), se ele j
+// no estiver ligado. O VAO fica ligado entre objetos e  "desligado" uma
+// nica vez, depois de desenhada a cena.
+static void BindSceneVertexArray(const SceneObject& object)
 {
+    GLuint vertex_array_object_id = MeshArena_VertexArray(MeshArena_Mesh(object.arena_mesh).pool);
+    if ( vertex_array_object_id != g_BoundVertexArrayId )
+    {
+        glBindVertexArray(vertex_array_object_id);
+        g_BoundVertexArrayId = vertex_array_object_id;
+    }
+}
+
+// Envia o material e liga a textura de uma parte de um objeto. As partes
+// esto ordenadas por material, e os desenhos da fila da cena tambm (veja
+// DrawSceneQueue()), ento s enviamos o que mudou desde a parte anterior,
+// mesmo que ela seja de outro objeto: g_BoundMaterial e g_BoundTexture
+// guardam os ltimos valores enviados. Veja "meshmaterial.h".
+static void BindSubmeshMaterial(const SceneObjectSubmesh& submesh)
+{
+    if ( submesh.material != g_BoundMaterial )
+    {
+        g_BoundMaterial = submesh.material;
+        glUniform1i(material_index_uniform, g_BoundMaterial);
+    }
+
+    // A textura difusa  ligada  unidade de textura 0.
+    if ( submesh.texture != g_BoundTexture )
+    {
+        g_BoundTexture = submesh.texture;
+        GLuint texture_id = (g_BoundTexture >= 0) ? g_SceneTextures[g_BoundTexture].texture_id : 0;
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+        glUniform1i(texture_enabled_uniform, texture_id != 0);
+    }
+}
+
+// Funo que desenha um objeto armazenado em g_VirtualScene, dado seu handle
+// (veja GetSceneObjectHandle()). Veja definio dos objetos na funo
+// BuildTrianglesAndAddToVirtualScene(). O nvel de detalhe  escolhido a
+// partir da matriz de modelagem "model". Objetos que ainda esto sendo
+// carregados so substitudos por g_PlaceholderObject.
+void DrawVirtualObject(int object_handle, const glm::mat4& model)
+{
+    const SceneObject& stored = g_VirtualScene[object_handle];
+    const SceneObject& object = (stored.arena_mesh >= 0) ? stored : g_PlaceholderObject;
+
     // "Ligamos" o VAO. Informamos que queremos utilizar os atributos de
-    // vrtices apontados pelo VAO criado pela funo BuildTrianglesAndAddToVirtualScene(). Veja
-    // comentrios detalhados dentro da definio de BuildTrianglesAndAddToVirtualScene().
-    glBindVertexArray(g_VirtualScene[object_name].vertex_array_object_id);
+    // vrtices apontados pelo VAO da arena que guarda este objeto. Veja
+    // "mesharena.h" e CreateMeshVertexArray(). Objetos com o mesmo formato
+    // de vrtice compartilham o VAO, e cada um  desenhado a partir do seu
+    // primeiro vrtice ("base vertex").
+    BindSceneVertexArray(object);
+    const GLint base_vertex = (GLint)MeshArena_Mesh(object.arena_mesh).first_vertex;
+
+    // Enviamos a transformao que reconstri as posies do modelo, que
+    // podem estar quantizadas. Veja "meshquant.h".
+    glUniform3fv(position_scale_uniform, 1, object.position_scale);
+    glUniform3fv(position_offset_uniform, 1, object.position_offset);
 
     // Pedimos para a GPU rasterizar os vrtices dos eixos XYZ
     // apontados pelo VAO como linhas. Veja a definio de
     // g_VirtualScene[""] dentro da funo BuildTrianglesAndAddToVirtualScene(), e veja
-    // a documentao da funo glDrawElements() em
-    // http://docs.gl/gl3/glDrawElements.
-    glDrawElements(
-        g_VirtualScene[object_name].rendering_mode,
-        g_VirtualScene[object_name].num_indices,
-        GL_UNSIGNED_INT,
-        (void*)g_VirtualScene[object_name].first_index
-    );
+    // a documentao da funo glDrawElementsBaseVertex() em
+    // http://docs.gl/gl3/glDrawElementsBaseVertex.
+    //
+    // O nvel 0  o objeto completo; os demais so verses simplificadas,
+    // guardadas em outros intervalos do mesmo buffer de ndices. No nvel 0,
+    // partes divididas em clusters desenham apenas os clusters visveis.
+    int level = SelectLevelOfDetail(object, model);
 
-    // "Desligamos" o VAO, evitando assim que operaes posteriores venham a
-    // alterar o mesmo. Isso evita bugs.
+    MeshClusterView view;
+    bool has_view = false;
+
+    for (size_t i = 0; i < object.submeshes.size(); ++i)
+    {
+        const SceneObjectSubmesh& submesh = object.submeshes[i];
+        BindSubmeshMaterial(submesh);
+
+        int submesh_level = std::min(level, (int)submesh.lods.size());
+        if ( submesh_level == 0 && !submesh.clusters.empty() )
+        {
+            if ( !has_view )
+            {
+                BuildClusterView(model, &view);
+                has_view = true;
+            }
+            DrawVisibleClusters(object, submesh, view);
+        }
+        else
+        {
+            glDrawElementsBaseVertex(
+                object.rendering_mode,
+                (submesh_level == 0) ? submesh.num_indices : submesh.lods[submesh_level-1].num_indices,
+                object.index_type,
+                (submesh_level == 0) ? submesh.first_index : submesh.lods[submesh_level-1].first_index,
+                base_vertex
+            );
+        }
+    }
+}
+
+// Cria g_InstanceBufferId, inicialmente com uma nica instncia: todo VAO l
+// os atributos por instncia deste buffer (veja CreateMeshVertexArray()),
+// mesmo quando desenhado sem instncias, ento ele nunca pode estar vazio.
+void CreateInstanceBuffer()
+{
+    SceneInstance identity;
+    glm::mat4 identity_model = Matrix_Identity();
+    memcpy(identity.model, glm::value_ptr(identity_model), sizeof(identity.model));
+    identity.object_id = -1;
+
+    glGenBuffers(1, &g_InstanceBufferId);
+    glBindBuffer(GL_ARRAY_BUFFER, g_InstanceBufferId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(SceneInstance), &identity, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    g_InstanceBufferCapacity = 1;
+}
+
+// Aponta os atributos por instncia do VAO ligado para g_InstanceBufferId, a
+// partir da instncia "first_instance". Sem glDrawElementsInstancedBaseInstance()
+// (OpenGL 4.2),  assim que cada desenho instanciado escolhe seu trecho do
+// buffer.
+static void SetInstanceAttributes(size_t first_instance)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, g_InstanceBufferId);
+
+    const size_t base = first_instance * sizeof(SceneInstance);
+    for (GLuint column = 0; column < 4; ++column)
+    {
+        GLuint location = 3 + column; // "(location = 3)" em "shader_vertex.glsl", uma posio por coluna
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(SceneInstance), (void*)(base + offsetof(SceneInstance, model) + column*4*sizeof(float)));
+    }
+
+    GLuint location = 7; // "(location = 7)" em "shader_vertex.glsl"
+    glVertexAttribIPointer(location, 1, GL_INT, sizeof(SceneInstance), (void*)(base + offsetof(SceneInstance, object_id)));
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Desenha "num_instances" instncias de um objeto de g_VirtualScene, cada uma
+// com sua matriz de modelagem e seu identificador (veja SceneInstance), com
+// uma chamada a glDrawElementsInstancedBaseVertex() por parte do objeto e nvel de
+// detalhe, em vez de uma chamada por instncia.
+//
+// O nvel de detalhe  escolhido para cada instncia, como em
+// DrawVirtualObject(), e as instncias so agrupadas por nvel antes de
+// serem copiadas para g_InstanceBufferId. No nvel 0 a parte  desenhada
+// inteira: o descarte de clusters depende da posio de cada instncia e
+// no pode ser compartilhado entre elas.
+void DrawVirtualObjectInstanced(int object_handle, const SceneInstance* instances, size_t num_instances)
+{
+    const SceneObject& stored = g_VirtualScene[object_handle];
+    const SceneObject& object = (stored.arena_mesh >= 0) ? stored : g_PlaceholderObject;
+
+    // Instncias agrupadas por nvel de detalhe. Os vetores so reaproveitados
+    // entre chamadas, para no alocar memria a cada quadro.
+    static std::vector<SceneInstance> by_level[MESHLOD_MAX_LEVELS + 1];
+    for (int level = 0; level <= MESHLOD_MAX_LEVELS; ++level)
+        by_level[level].clear();
+
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        int level = SelectLevelOfDetail(object, glm::make_mat4(instances[i].model));
+        by_level[std::min(level, MESHLOD_MAX_LEVELS)].push_back(instances[i]);
+    }
+
+    // Reescrevemos o buffer inteiro. Com glBufferData(NULL) o driver nos d
+    // uma nova rea de memria ("orphaning") em vez de esperar a GPU
+    // terminar os desenhos que ainda leem a rea anterior.
+    glBindBuffer(GL_ARRAY_BUFFER, g_InstanceBufferId);
+    g_InstanceBufferCapacity = std::max(g_InstanceBufferCapacity, num_instances);
+    glBufferData(GL_ARRAY_BUFFER, g_InstanceBufferCapacity * sizeof(SceneInstance), NULL, GL_STREAM_DRAW);
+
+    size_t first_instance[MESHLOD_MAX_LEVELS + 1];
+    size_t offset = 0;
+    for (int level = 0; level <= MESHLOD_MAX_LEVELS; ++level)
+    {
+        first_instance[level] = offset;
+        if ( !by_level[level].empty() )
+            glBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(SceneInstance), by_level[level].size() * sizeof(SceneInstance), by_level[level].data());
+        offset += by_level[level].size();
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    BindSceneVertexArray(object);
+    const GLint base_vertex = (GLint)MeshArena_Mesh(object.arena_mesh).first_vertex;
+    glUniform3fv(position_scale_uniform, 1, object.position_scale);
+    glUniform3fv(position_offset_uniform, 1, object.position_offset);
+    glUniform1i(instanced_uniform, 1);
+
+    for (int level = 0; level <= MESHLOD_MAX_LEVELS; ++level)
+    {
+        if ( by_level[level].empty() )
+            continue;
+
+        SetInstanceAttributes(first_instance[level]);
+
+        for (size_t i = 0; i < object.submeshes.size(); ++i)
+        {
+            const SceneObjectSubmesh& submesh = object.submeshes[i];
+            BindSubmeshMaterial(submesh);
+
+            int submesh_level = std::min(level, (int)submesh.lods.size());
+            glDrawElementsInstancedBaseVertex(
+                object.rendering_mode,
+                (submesh_level == 0) ? submesh.num_indices : submesh.lods[submesh_level-1].num_indices,
+                object.index_type,
+                (submesh_level == 0) ? submesh.first_index : submesh.lods[submesh_level-1].first_index,
+                (GLsizei)by_level[level].size(),
+                base_vertex
+            );
+        }
+    }
+
+    // Voltamos ao incio do buffer, que sempre tem ao menos uma instncia,
+    // para os desenhos sem instncias.
+    SetInstanceAttributes(0);
+    glUniform1i(instanced_uniform, 0);
+}
+
+// Esfera e caixa envolventes de um objeto transformado por "model", em
+// coordenadas do mundo. O raio da esfera  multiplicado pela maior escala da
+// matriz; a caixa transformada  envolvida por outra caixa alinhada aos
+// eixos, cuja meia-extenso em cada eixo soma as meias-extenses originais
+// multiplicadas pelo valor absoluto dos coeficientes da matriz (mtodo de
+// Arvo).
+static void ComputeWorldBounds(const SceneObject& object, const glm::mat4& model, float sphere_center[3], float* sphere_radius, float box_center[3], float box_extent[3])
+{
+    glm::vec4 center = model * glm::vec4(object.bounds_center[0], object.bounds_center[1], object.bounds_center[2], 1.0f);
+    float scale = std::max(norm(model[0]), std::max(norm(model[1]), norm(model[2])));
+    *sphere_radius = object.bounds_radius * scale;
+
+    glm::vec4 box_center_model(0.0f, 0.0f, 0.0f, 1.0f);
+    float     box_extent_model[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        box_center_model[k] = 0.5f * (object.bounds_min[k] + object.bounds_max[k]);
+        box_extent_model[k] = 0.5f * (object.bounds_max[k] - object.bounds_min[k]);
+    }
+    glm::vec4 box_center_world = model * box_center_model;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        sphere_center[i] = center[i];
+        box_center[i]    = box_center_world[i];
+        box_extent[i]    = 0.0f;
+        for (int j = 0; j < 3; ++j)
+            box_extent[i] += fabsf(model[j][i]) * box_extent_model[j];
+    }
+}
+
+// Acrescenta a g_SceneBounds a esfera e a caixa envolventes de um objeto
+// transformado por "model" (veja ComputeWorldBounds()) e retorna sua posio.
+static size_t AddSceneObjectBounds(const SceneObject& object, const glm::mat4& model)
+{
+    float sphere_center[3], sphere_radius, box_center[3], box_extent[3];
+    ComputeWorldBounds(object, model, sphere_center, &sphere_radius, box_center, box_extent);
+    return FrustumCull_Add(&g_SceneBounds, sphere_center, sphere_radius, box_center, box_extent);
+}
+
+// Distncia, ao longo da direo de viso, do centro da esfera envolvente
+// "bounds" de g_SceneBounds at a cmera. Usada para ordenar os desenhos da
+// frente para trs.
+static float SceneBoundsDepth(size_t bounds)
+{
+    glm::vec4 center(g_SceneBounds.sphere_x[bounds], g_SceneBounds.sphere_y[bounds], g_SceneBounds.sphere_z[bounds], 1.0f);
+    return -(g_CameraView * center).z;
+}
+
+// Posio de "program" em g_ScenePrograms, acrescentando-o se ainda no foi
+// usado no quadro. Como as posies das pools de VAOs (veja "mesharena.h"),
+// as posies so pequenas e consecutivas e cabem no campo de programa da
+// chave.
+static unsigned int GetSceneProgramIndex(GLuint program)
+{
+    for (size_t i = 0; i < g_ScenePrograms.size(); ++i)
+        if ( g_ScenePrograms[i] == program )
+            return (unsigned int)i;
+
+    g_ScenePrograms.push_back(program);
+    return (unsigned int)(g_ScenePrograms.size() - 1);
+}
+
+// Envia o pacote "packet" de g_ScenePackets  fila da cena, com a chave
+// montada a partir do estado de que o objeto precisa.
+static void SubmitScenePacket(size_t packet, float depth)
+{
+    const SceneObject& stored = g_VirtualScene[g_ScenePackets[packet].object_handle];
+    const SceneObject& object = (stored.arena_mesh >= 0) ? stored : g_PlaceholderObject;
+
+    // O material da primeira parte representa o objeto: as partes esto
+    // ordenadas por material, ento  com ele que o desenho comea.
+    int material = object.submeshes.empty() ? -1 : object.submeshes[0].material;
+    int pool     = MeshArena_Mesh(object.arena_mesh).pool;
+    unsigned int program = GetSceneProgramIndex(g_ScenePackets[packet].program);
+    assert(program < (1u << RENDERQUEUE_PROGRAM_BITS));
+    assert(pool >= 0 && pool < (1 << RENDERQUEUE_VERTEX_ARRAY_BITS));
+
+    uint64_t key = RenderQueue_MakeKey(SCENE_PASS_OPAQUE, program, pool, material, depth);
+    RenderQueue_Submit(&g_SceneQueue, key, packet);
+}
+
+// Envia  fila da cena o desenho de um objeto de g_VirtualScene com a matriz
+// de modelagem "model" e o identificador "object_id". O objeto  desenhado
+// por DrawSceneQueue(), com DrawVirtualObject(), se estiver dentro do
+// frustum.
+void SubmitVirtualObject(int object_handle, const glm::mat4& model, int object_id)
+{
+    const SceneObject& stored = g_VirtualScene[object_handle];
+    const SceneObject& object = (stored.arena_mesh >= 0) ? stored : g_PlaceholderObject;
+
+    ScenePacket packet;
+    packet.object_handle = object_handle;
+    packet.program       = program_id;
+    packet.model         = model;
+    packet.object_id     = object_id;
+    packet.instances     = NULL;
+    packet.num_instances = 0;
+    packet.first_bounds  = AddSceneObjectBounds(object, model);
+    g_ScenePackets.push_back(packet);
+}
+
+// Envia  fila da cena o desenho de vrias instncias de um objeto (veja
+// DrawVirtualObjectInstanced()). O vetor "instances" no  copiado; apenas as
+// instncias dentro do frustum so desenhadas.
+void SubmitVirtualObjectInstanced(int object_handle, const SceneInstance* instances, size_t num_instances)
+{
+    if ( num_instances == 0 )
+        return;
+
+    const SceneObject& stored = g_VirtualScene[object_handle];
+    const SceneObject& object = (stored.arena_mesh >= 0) ? stored : g_PlaceholderObject;
+
+    ScenePacket packet;
+    packet.object_handle = object_handle;
+    packet.program       = program_id;
+    packet.model         = Matrix_Identity();
+    packet.object_id     = -1;
+    packet.instances     = instances;
+    packet.num_instances = num_instances;
+    packet.first_bounds  = g_SceneBounds.sphere_x.size();
+    for (size_t i = 0; i < num_instances; ++i)
+        AddSceneObjectBounds(object, glm::make_mat4(instances[i].model));
+    g_ScenePackets.push_back(packet);
+}
+
+// Caixa envolvente, em coordenadas do mundo, de uma colocao. Objetos que
+// ainda esto sendo carregados usam a caixa de g_PlaceholderObject.
+static void ScenePlacementBox(const ScenePlacement& placement, float minimum[3], float maximum[3])
+{
+    const SceneObject& stored = g_VirtualScene[placement.object_handle];
+    const SceneObject& object = (stored.arena_mesh >= 0) ? stored : g_PlaceholderObject;
+
+    float sphere_center[3], sphere_radius, box_center[3], box_extent[3];
+    ComputeWorldBounds(object, glm::make_mat4(placement.instance.model), sphere_center, &sphere_radius, box_center, box_extent);
+    for (int k = 0; k < 3; ++k)
+    {
+        minimum[k] = box_center[k] - box_extent[k];
+        maximum[k] = box_center[k] + box_extent[k];
+    }
+}
+
+// Coloca o objeto "object_handle" na cena, com a matriz de modelagem "model"
+// e o identificador "object_id" de "shader_fragment.glsl". Com "instanced",
+// todas as colocaes visveis do mesmo objeto so desenhadas juntas por
+// DrawVirtualObjectInstanced(). Retorna a posio da colocao em
+// g_ScenePlacements, que no muda.
+int PlaceSceneObject(int object_handle, const glm::mat4& model, int object_id, bool instanced)
+{
+    ScenePlacement placement;
+    placement.object_handle = object_handle;
+    memcpy(placement.instance.model, glm::value_ptr(model), sizeof(placement.instance.model));
+    placement.instance.object_id = object_id;
+    placement.instanced = instanced;
+
+    float minimum[3], maximum[3];
+    ScenePlacementBox(placement, minimum, maximum);
+
+    int index = (int)g_ScenePlacements.size();
+    placement.proxy = AabbTree_Insert(&g_SceneTree, minimum, maximum, index);
+    g_ScenePlacements.push_back(placement);
+    return index;
+}
+
+// Muda a matriz de modelagem de uma colocao. A rvore s muda se a nova
+// caixa sair da caixa aumentada da folha (veja AabbTree_Move()).
+void MoveSceneObject(int placement, const glm::mat4& model)
+{
+    ScenePlacement& moved = g_ScenePlacements[placement];
+    memcpy(moved.instance.model, glm::value_ptr(model), sizeof(moved.instance.model));
+
+    float minimum[3], maximum[3];
+    ScenePlacementBox(moved, minimum, maximum);
+    AabbTree_Move(&g_SceneTree, moved.proxy, minimum, maximum);
+}
+
+// Atualiza as folhas das colocaes de um objeto cujos volumes envolventes
+// mudaram, por exemplo porque o modelo terminou de ser carregado e deixou de
+// ser desenhado como g_PlaceholderObject.
+void RefitScenePlacements(int object_handle)
+{
+    for (size_t i = 0; i < g_ScenePlacements.size(); ++i)
+    {
+        const ScenePlacement& placement = g_ScenePlacements[i];
+        if ( placement.object_handle != object_handle )
+            continue;
+
+        // A caixa pode ter diminudo, ento a folha  reinserida mesmo que
+        // a nova caixa esteja dentro da anterior.
+        float minimum[3], maximum[3];
+        ScenePlacementBox(placement, minimum, maximum);
+        AabbTree_Remove(&g_SceneTree, placement.proxy);
+        g_ScenePlacements[i].proxy = AabbTree_Insert(&g_SceneTree, minimum, maximum, (int)i);
+    }
+}
+
+static bool PlacementObjectLess(int a, int b)
+{
+    return g_ScenePlacements[a].object_handle < g_ScenePlacements[b].object_handle;
+}
+
+// Envia  fila da cena as colocaes cujas folhas em g_SceneTree no esto
+// fora do frustum da cmera. O teste na rvore usa caixas aumentadas e
+// descarta sub-rvores inteiras; as colocaes que sobram so testadas com
+// seus volumes exatos por DrawSceneQueue() (veja CullScenePackets()). As
+// colocaes com instncias so agrupadas por objeto, com um nico desenho
+// por objeto.
+void SubmitPlacedObjects()
+{
+    static std::vector<int> candidates;
+    candidates.clear();
+    AabbTree_QueryFrustum(g_SceneTree, g_CameraFrustum, &candidates);
+
+    g_OccludedPlacements.clear();
+    g_OcclusionTests.clear();
+    if ( g_UseOcclusionCulling )
+    {
+        OcclusionCull_BeginFrame(g_ScenePlacements.size());
+        glm::vec4 camera_position = glm::inverse(g_CameraView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+        // S as colocaes visveis continuam em "candidates".
+        size_t kept = 0;
+        for (size_t i = 0; i < candidates.size(); ++i)
+        {
+            const AabbTreeNode& leaf = g_SceneTree.nodes[g_ScenePlacements[candidates[i]].proxy];
+            bool camera_inside = true;
+            for (int k = 0; k < 3; ++k)
+                if ( camera_position[k] < leaf.minimum[k] - OCCLUSION_CAMERA_MARGIN || camera_position[k] > leaf.maximum[k] + OCCLUSION_CAMERA_MARGIN )
+                    camera_inside = false;
+
+            if ( camera_inside )
+                candidates[kept++] = candidates[i];
+            else if ( !OcclusionCull_IsVisible(candidates[i]) )
+                g_OccludedPlacements.push_back(candidates[i]);
+            else
+            {
+                if ( OcclusionCull_NeedsQuery(candidates[i]) )
+                    g_OcclusionTests.push_back(candidates[i]);
+                candidates[kept++] = candidates[i];
+            }
+        }
+        candidates.resize(kept);
+    }
+
+    // As instncias ficam em um vetor reservado antes de ser preenchido,
+    // para que os ponteiros enviados  fila continuem vlidos at
+    // DrawSceneQueue().
+    static std::vector<SceneInstance> instances;
+    instances.clear();
+    instances.reserve(candidates.size());
+
+    std::sort(candidates.begin(), candidates.end(), PlacementObjectLess);
+    for (size_t i = 0; i < candidates.size(); )
+    {
+        const ScenePlacement& placement = g_ScenePlacements[candidates[i]];
+        if ( !placement.instanced )
+        {
+            SubmitVirtualObject(placement.object_handle, glm::make_mat4(placement.instance.model), placement.instance.object_id);
+            ++i;
+            continue;
+        }
+
+        // Todas as colocaes com instncias deste objeto, que esto juntas
+        // depois da ordenao.
+        const size_t first = instances.size();
+        for (; i < candidates.size() && g_ScenePlacements[candidates[i]].object_handle == placement.object_handle; ++i)
+        {
+            const ScenePlacement& other = g_ScenePlacements[candidates[i]];
+            if ( other.instanced )
+                instances.push_back(other.instance);
+            else
+                SubmitVirtualObject(other.object_handle, glm::make_mat4(other.instance.model), other.instance.object_id);
+        }
+        SubmitVirtualObjectInstanced(placement.object_handle, &instances[first], instances.size() - first);
+    }
+}
+
+// Retorna a colocao sob o cursor, na posio (x, y) da janela, ou -1. O
+// raio que sai da cmera e passa pelo cursor  testado primeiro contra
+// g_SceneTree, que retorna as folhas atingidas em ordem de distncia, e
+// depois contra a esfera envolvente de cada colocao, at que as folhas
+// restantes estejam mais longe que a esfera mais prxima j atingida.
+int PickScenePlacement(GLFWwindow* window, double x, double y)
+{
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+    if ( width <= 0 || height <= 0 )
+        return -1;
+
+    // Pontos sob o cursor nos planos near e far, em coordenadas do mundo.
+    float ndc_x = 2.0f * (float)x / width - 1.0f;
+    float ndc_y = 1.0f - 2.0f * (float)y / height;
+    glm::mat4 world_from_clip = glm::inverse(g_CameraProjection * g_CameraView);
+    glm::vec4 near_point = world_from_clip * glm::vec4(ndc_x, ndc_y, -1.0f, 1.0f);
+    glm::vec4 far_point  = world_from_clip * glm::vec4(ndc_x, ndc_y,  1.0f, 1.0f);
+    near_point /= near_point.w;
+    far_point  /= far_point.w;
+
+    // Raio origin + t*direction, com t entre 0 (near) e 1 (far).
+    glm::vec3 origin(near_point);
+    glm::vec3 direction = glm::vec3(far_point) - origin;
+
+    static std::vector<AabbTreeHit> hits;
+    hits.clear();
+    AabbTree_QueryRay(g_SceneTree, glm::value_ptr(origin), glm::value_ptr(direction), 1.0f, &hits);
+
+    int   picked = -1;
+    float picked_t = std::numeric_limits<float>::max();
+    for (size_t i = 0; i < hits.size() && hits[i].distance < picked_t; ++i)
+    {
+        const ScenePlacement& placement = g_ScenePlacements[hits[i].data];
+        const SceneObject& stored = g_VirtualScene[placement.object_handle];
+        const SceneObject& object = (stored.arena_mesh >= 0) ? stored : g_PlaceholderObject;
+
+        float center[3], radius, box_center[3], box_extent[3];
+        ComputeWorldBounds(object, glm::make_mat4(placement.instance.model), center, &radius, box_center, box_extent);
+
+        // Menor t com |origin + t*direction - center| = radius.
+        glm::vec3 oc = origin - glm::vec3(center[0], center[1], center[2]);
+        float a = glm::dot(direction, direction);
+        float b = glm::dot(oc, direction);
+        float c = glm::dot(oc, oc) - radius*radius;
+        float discriminant = b*b - a*c;
+        if ( discriminant < 0.0f )
+            continue;
+
+        float root = sqrtf(discriminant);
+        if ( (-b + root) / a < 0.0f )
+            continue; // Esfera atrs do plano near
+        float t = std::max((-b - root) / a, 0.0f); // 0 se o plano near corta a esfera
+        if ( t <= 1.0f && t < picked_t )
+        {
+            picked   = hits[i].data;
+            picked_t = t;
+        }
+    }
+    return picked;
+}
+
+// Consulta a ocluso das colocaes separadas por SubmitPlacedObjects(),
+// desenhando suas caixas aumentadas (as folhas de g_SceneTree), que ficam 
+// frente das superfcies do prprio objeto. As colocaes visveis so
+// consultadas uma a uma. As escondidas so agrupadas por objeto, em grupos de
+// at OCCLUSION_MAX_GROUP_PLACEMENTS: cada grupo tem uma nica consulta e 
+// desenhado com um nico glBeginConditionalRender(), e as colocaes com
+// instncias de um grupo so desenhadas juntas por
+// DrawVirtualObjectInstanced(). A GPU descarta os desenhos de um grupo se
+// nenhuma de suas caixas passou, sem que a CPU espere o resultado; com
+// GL_QUERY_WAIT  a GPU, e no a CPU, que espera a consulta terminar.
+void DrawOccludedPlacements()
+{
+    if ( g_OccludedPlacements.empty() && g_OcclusionTests.empty() )
+        return;
+
+    for (size_t i = 0; i < g_OcclusionTests.size(); ++i)
+    {
+        const AabbTreeNode& leaf = g_SceneTree.nodes[g_ScenePlacements[g_OcclusionTests[i]].proxy];
+        OcclusionCull_AddBox(g_OcclusionTests[i], leaf.minimum, leaf.maximum);
+        OcclusionCull_EndGroup();
+    }
+
+    // As colocaes de "candidates" em SubmitPlacedObjects() esto na ordem
+    // em que foram encontradas em g_SceneTree, ento colocaes vizinhas na
+    // rvore tambm so vizinhas no espao. A ordenao estvel mantm essa
+    // ordem dentro de cada objeto, e cada grupo rene colocaes prximas.
+    struct OccludedGroup
+    {
+        size_t first;
+        size_t count;
+        GLuint query;
+    };
+    static std::vector<OccludedGroup> groups;
+    groups.clear();
+
+    std::stable_sort(g_OccludedPlacements.begin(), g_OccludedPlacements.end(), PlacementObjectLess);
+    for (size_t i = 0; i < g_OccludedPlacements.size(); )
+    {
+        OccludedGroup group;
+        group.first = i;
+        const int object_handle = g_ScenePlacements[g_OccludedPlacements[i]].object_handle;
+        for (; i < g_OccludedPlacements.size() && i - group.first < OCCLUSION_MAX_GROUP_PLACEMENTS
+               && g_ScenePlacements[g_OccludedPlacements[i]].object_handle == object_handle; ++i)
+        {
+            const AabbTreeNode& leaf = g_SceneTree.nodes[g_ScenePlacements[g_OccludedPlacements[i]].proxy];
+            OcclusionCull_AddBox(g_OccludedPlacements[i], leaf.minimum, leaf.maximum);
+        }
+        group.count = i - group.first;
+        group.query = OcclusionCull_EndGroup();
+        groups.push_back(group);
+    }
+
+    OcclusionCull_IssueQueries(glm::value_ptr(g_CameraProjection * g_CameraView));
+
+    static std::vector<SceneInstance> instances;
+    glUseProgram(program_id);
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+        const OccludedGroup& group = groups[g];
+        const int object_handle = g_ScenePlacements[g_OccludedPlacements[group.first]].object_handle;
+
+        glBeginConditionalRender(group.query, GL_QUERY_WAIT);
+        instances.clear();
+        for (size_t i = group.first; i < group.first + group.count; ++i)
+        {
+            const ScenePlacement& placement = g_ScenePlacements[g_OccludedPlacements[i]];
+            if ( placement.instanced )
+            {
+                instances.push_back(placement.instance);
+                continue;
+            }
+
+            glm::mat4 model = glm::make_mat4(placement.instance.model);
+            glUniformMatrix4fv(model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
+            glUniform1i(object_id_uniform, placement.instance.object_id);
+            DrawVirtualObject(placement.object_handle, model);
+        }
+        if ( !instances.empty() )
+            DrawVirtualObjectInstanced(object_handle, &instances[0], instances.size());
+        glEndConditionalRender();
+    }
+
+    // Como em DrawSceneQueue(), "desligamos" o VAO da arena no fim.
     glBindVertexArray(0);
+    g_BoundVertexArrayId = 0;
+    g_BoundMaterial = -2;
+    g_BoundTexture  = -2;
+}
+
+// Descarta os objetos e instncias enviados no quadro que esto fora do
+// frustum da cmera, com um nico teste de todos os volumes de
+// g_SceneBounds, e envia os demais  fila da cena. As instncias visveis de
+// cada desenho so copiadas, em ordem, para g_VisibleInstances, e a
+// profundidade do desenho  a da instncia visvel mais prxima da cmera.
+static void CullScenePackets()
+{
+    FrustumCull_Test(g_SceneBounds, g_CameraFrustum, &g_SceneVisible);
+
+    // Reservamos espao para todas as instncias, para que os ponteiros
+    // guardados nos pacotes continuem vlidos enquanto o vetor cresce.
+    size_t total_instances = 0;
+    for (size_t p = 0; p < g_ScenePackets.size(); ++p)
+        total_instances += g_ScenePackets[p].num_instances;
+    g_VisibleInstances.clear();
+    g_VisibleInstances.reserve(total_instances);
+
+    for (size_t p = 0; p < g_ScenePackets.size(); ++p)
+    {
+        ScenePacket& packet = g_ScenePackets[p];
+        if ( packet.instances == NULL )
+        {
+            if ( g_SceneVisible[packet.first_bounds] )
+                SubmitScenePacket(p, SceneBoundsDepth(packet.first_bounds));
+            continue;
+        }
+
+        const size_t first_visible = g_VisibleInstances.size();
+        float depth = std::numeric_limits<float>::max();
+        for (size_t i = 0; i < packet.num_instances; ++i)
+        {
+            if ( !g_SceneVisible[packet.first_bounds + i] )
+                continue;
+            g_VisibleInstances.push_back(packet.instances[i]);
+            depth = std::min(depth, SceneBoundsDepth(packet.first_bounds + i));
+        }
+
+        packet.num_instances = g_VisibleInstances.size() - first_visible;
+        if ( packet.num_instances == 0 )
+            continue;
+        packet.instances = &g_VisibleInstances[first_visible];
+        SubmitScenePacket(p, depth);
+    }
+}
+
+// Descarta os desenhos fora do frustum (veja CullScenePackets()), ordena os
+// demais pela chave (veja "renderqueue.h") e os executa, enviando o
+// programa, a matriz de modelagem e o identificador do objeto apenas quando
+// mudam. O VAO, o material e a textura so enviados
+// apenas quando mudam por DrawVirtualObject() e DrawVirtualObjectInstanced().
+// Ao fim, a fila  esvaziada e o estado guardado  descartado, pois o cdigo
+// seguinte (por exemplo, o texto) muda o estado de OpenGL.
+void DrawSceneQueue()
+{
+    CullScenePackets();
+    RenderQueue_Sort(&g_SceneQueue);
+
+    GLuint    program   = 0;
+    int       object_id = -1;
+    glm::mat4 model;
+    bool      has_model = false;
+
+    for (size_t i = 0; i < g_SceneQueue.items.size(); ++i)
+    {
+        const ScenePacket& packet = g_ScenePackets[g_SceneQueue.items[i].packet];
+
+        if ( packet.program != program )
+        {
+            program = packet.program;
+            glUseProgram(program);
+        }
+
+        if ( packet.instances != NULL )
+        {
+            DrawVirtualObjectInstanced(packet.object_handle, packet.instances, packet.num_instances);
+            continue;
+        }
+
+        if ( !has_model || packet.model != model )
+        {
+            model = packet.model;
+            has_model = true;
+            glUniformMatrix4fv(model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
+        }
+        if ( packet.object_id != object_id )
+        {
+            object_id = packet.object_id;
+            glUniform1i(object_id_uniform, object_id);
+        }
+        DrawVirtualObject(packet.object_handle, packet.model);
+    }
+
+    RenderQueue_Clear(&g_SceneQueue);
+    g_ScenePackets.clear();
+    g_ScenePrograms.clear();
+    FrustumCull_Clear(&g_SceneBounds);
+
+    // "Desligamos" o VAO da arena s depois de todos os objetos (veja
+    // BindSceneVertexArray()).
+    glBindVertexArray(0);
+    g_BoundVertexArrayId = 0;
+    g_BoundMaterial = -2;
+    g_BoundTexture  = -2;
 }
 
 // Funo que carrega os shaders de vrtices e de fragmentos que sero
@@ -485,7 +1623,20 @@ void LoadShadersFromFiles()
     model_uniform           = glGetUniformLocation(program_id, "model"); // Varivel da matriz "model"
     view_uniform            = glGetUniformLocation(program_id, "view"); // Varivel da matriz "view" em shader_vertex.glsl
     projection_uniform      = glGetUniformLocation(program_id, "projection"); // Varivel da matriz "projection" em shader_vertex.glsl
-    object_id_uniform       = glGetUniformLocation(program_id, "object_id"); // Varivel "object_id" em shader_fragment.glsl
+    object_id_uniform       = glGetUniformLocation(program_id, "object_id"); // Varivel "object_id" em shader_vertex.glsl
+    position_scale_uniform  = glGetUniformLocation(program_id, "position_scale"); // Varivel "position_scale" em shader_vertex.glsl
+    position_offset_uniform = glGetUniformLocation(program_id, "position_offset"); // Varivel "position_offset" em shader_vertex.glsl
+    material_index_uniform  = glGetUniformLocation(program_id, "material_index"); // Varivel "material_index" em shader_fragment.glsl
+    texture_enabled_uniform = glGetUniformLocation(program_id, "texture_enabled"); // Varivel "texture_enabled" em shader_fragment.glsl
+    instanced_uniform       = glGetUniformLocation(program_id, "instanced"); // Varivel "instanced" em shader_vertex.glsl
+
+    // A textura difusa  sempre lida da unidade de textura 0.
+    glUseProgram(program_id);
+    glUniform1i(glGetUniformLocation(program_id, "diffuse_texture"), 0);
+    glUseProgram(0);
+
+    // Ligamos o bloco de materiais do programa ao UBO de materiais. Veja "meshmaterial.h".
+    MeshMaterial_BindProgram(program_id);
 }
 
 // Funo que pega a matriz M e guarda a mesma no topo da pilha
@@ -508,197 +1659,626 @@ void PopMatrix(glm::mat4& M)
     }
 }
 
-// Funo que computa as normais de um ObjModel, caso elas no tenham sido
-// especificadas dentro do arquivo ".obj"
-void ComputeNormals(ObjModel* model)
+// Carrega um modelo ".obj", computa suas normais (caso necessrio) e o
+// adiciona em g_VirtualScene, bloqueando at o fim do carregamento. Faz o
+// mesmo que o carregamento em segundo plano (veja "assetloader.h"), em uma
+// nica thread.
+void LoadModelAndAddToVirtualScene(const char* filename)
 {
-    if ( !model->attrib.normals.empty() )
+    AssetBlob blob;
+    blob.filename = filename;
+    PrepareModel(&blob);
+
+    // Modelos divididos em tiles so carregados um tile por vez.
+    for (size_t tile = 0; tile < blob.num_tiles; ++tile)
+    {
+        AssetBlob tile_blob;
+        tile_blob.filename = filename;
+        tile_blob.tile     = (int)tile;
+        PrepareModel(&tile_blob);
+
+        MeshGpuBuffers gpu;
+        MeshQuant_UploadEncoded(tile_blob.mesh, &gpu);
+        AddLoadedModelToVirtualScene(tile_blob, gpu);
+    }
+    if ( blob.num_tiles > 0 )
         return;
 
-    // Primeiro computamos as normais para todos os TRINGULOS.
-    // Segundo, computamos as normais dos VRTICES atravs do mtodo proposto
-    // por Gouraud, onde a normal de cada vrtice vai ser a mdia das normais de
-    // todas as faces que compartilham este vrtice.
+    MeshGpuBuffers gpu;
+    if ( blob.needs_gpu_load )
+        LoadModelToGpu(&blob, &gpu);
+    else
+        MeshQuant_UploadEncoded(blob.mesh, &gpu);
 
-    size_t num_vertices = model->attrib.vertices.size() / 3;
+    AddLoadedModelToVirtualScene(blob, gpu);
+}
+
+// L um modelo ".obj", computa suas normais (caso necessrio) e o converte
+// para o formato da GPU em blob->mesh. Executada pelas threads de trabalho de
+// "assetloader.h", portanto no usa OpenGL. Se o modelo estiver no pacote de
+// assets (veja "assetpack.h"), ou se existir um cache vlido do modelo (veja
+// "meshcache.h"), o arquivo ".obj" no  lido: os dados j prontos so
+// mapeados em memria. Antes de ser salva no cache, a malha 
+// otimizada para o cache de vrtices da GPU (veja "meshopt.h") e recebe seus
+// nveis de detalhe (veja "meshlod.h") e clusters (veja "meshcluster.h"). Arquivos grandes so deixados para
+// LoadModelToGpu(), e arquivos maiores que a memria so divididos em tiles
+// (veja "meshtile.h"), carregados depois com um pedido para cada tile.
+void PrepareModel(AssetBlob* blob)
+{
+    const char* filename = blob->filename.c_str();
+
+    MeshCacheEntry cached;
+    if ( blob->tile >= 0 )
+    {
+        if ( !MeshTile_LoadTile(filename, blob->tile, &cached) )
+            throw std::runtime_error("Cannot open tile " + std::to_string(blob->tile));
+
+        MeshQuant_EncodeMesh(cached.buffers, &blob->mesh);
+        MeshCache_Close(&cached);
+        return;
+    }
+
+    AssetData asset;
+    if (    AssetPack_Find(g_AssetPack, filename, &asset) && asset.type == ASSET_MESH
+         && MeshCache_LoadFromMemory(asset.data, asset.size, &cached) )
+    {
+        printf("Carregando modelo \"%s\" do pacote de assets... OK.\n", filename);
+        MeshQuant_EncodeMesh(cached.buffers, &blob->mesh);
+        MeshCache_Close(&cached);
+        return;
+    }
+
+    if ( MeshCache_Load(filename, &cached) )
+    {
+        printf("Carregando modelo \"%s\" do cache... OK.\n", filename);
+        MeshQuant_EncodeMesh(cached.buffers, &blob->mesh);
+        MeshCache_Close(&cached);
+        return;
+    }
+
+    FileStamp stamp;
+    const uint64_t file_size = GetFileStamp(filename, &stamp) ? stamp.size : 0;
+    if ( file_size >= MESHTILE_MIN_FILE_SIZE )
+    {
+        MeshTileIndex index;
+        if ( !MeshTile_LoadIndex(filename, &index) )
+            MeshTile_Build(filename, g_MemoryBudget, ProcessMeshData, &index);
+        blob->num_tiles = index.tiles.size();
+        return;
+    }
+
+    if ( file_size >= MESHSTREAM_MIN_FILE_SIZE )
+    {
+        blob->needs_gpu_load = true;
+        return;
+    }
+
+    ObjModel model(filename);
+    MeshNormals_Compute(&model);
+
+    MeshData mesh;
+    BuildMeshData(&model, &mesh);
+    ProcessMeshData(&mesh);
+    MeshLod_PrintLods(mesh.shapes);
+    MeshCluster_PrintClusters(mesh.shapes);
+
+    if ( !MeshCache_Store(filename, mesh) )
+        fprintf(stderr, "WARNING: Cannot write mesh cache \"%s\".\n", MeshCache_Path(filename).c_str());
+
+    MeshQuant_EncodeMesh(GetMeshBuffers(mesh), &blob->mesh);
+}
 
-    std::vector<int> num_triangles_per_vertex(num_vertices, 0);
-    std::vector<glm::vec4> vertex_normals(num_vertices, glm::vec4(0.0f,0.0f,0.0f,0.0f));
+// Prepara uma malha para o cache: otimizao para o cache de vrtices da GPU
+// (veja "meshopt.h"), nveis de detalhe (veja "meshlod.h") e clusters (veja
+// "meshcluster.h"). Usada por PrepareModel() e para cada tile de
+// MeshTile_Build().
+void ProcessMeshData(MeshData* mesh)
+{
+    MeshOptReport report;
+    MeshOpt_OptimizeMesh(mesh, &report);
+    MeshOpt_PrintReport(report);
+    MeshLod_GenerateLods(mesh);
+    MeshCluster_GenerateClusters(mesh);
+}
+
+// Carrega um arquivo grande enviando-o para a GPU  medida que  lido (veja
+// "meshstream.h"), sem manter cpias completas do modelo em memria. Precisa
+// de um contexto OpenGL, mas no cria VAOs: pode ser executada pela thread de
+// envio de "assetloader.h".
+void LoadModelToGpu(AssetBlob* blob, MeshGpuBuffers* gpu)
+{
+    const char* filename = blob->filename.c_str();
+    MeshStream_LoadObj(filename, gpu);
+
+    MeshOptReport report;
+    MeshOpt_OptimizeGpuMesh(gpu, &report);
+    MeshOpt_PrintReport(report);
+    MeshLod_GenerateGpuLods(gpu);
+    MeshCluster_GenerateGpuClusters(gpu);
+    MeshLod_PrintLods(gpu->shapes);
+    MeshCluster_PrintClusters(gpu->shapes);
+
+    if ( !MeshCache_StoreFromGpu(filename, *gpu) )
+        fprintf(stderr, "WARNING: Cannot write mesh cache \"%s\".\n", MeshCache_Path(filename).c_str());
+
+    MeshQuant_QuantizeGpuMesh(gpu);
+}
 
-    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
+// Adiciona em g_VirtualScene um modelo que j est na GPU.
+void AddLoadedModelToVirtualScene(const AssetBlob& blob, const MeshGpuBuffers& gpu)
+{
+    // Um modelo dividido em tiles chega sem dados: pedimos cada tile.
+    if ( blob.num_tiles > 0 )
     {
-        size_t num_triangles = model->shapes[shape].mesh.num_face_vertices.size();
+        printf("Modelo \"%s\" dividido em %zu tiles.\n", blob.filename.c_str(), blob.num_tiles);
+        for (size_t tile = 0; tile < blob.num_tiles; ++tile)
+            AssetLoader_RequestTile(blob.filename.c_str(), (int)tile);
+        return;
+    }
 
-        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
+    if ( blob.tile >= 0 )
+        printf("Tile %d do modelo \"%s\" carregado.\n", blob.tile, blob.filename.c_str());
+    else
+        printf("Modelo \"%s\" carregado.\n", blob.filename.c_str());
+    MeshQuant_PrintFormat(gpu);
+    AddMeshToVirtualScene(gpu, MeshDirectory(blob.filename.c_str()));
+}
+
+// Pede o carregamento em segundo plano de uma textura, caso ela ainda no
+// tenha sido pedida, e retorna sua posio em g_SceneTextures.
+int RequestSceneTexture(const std::string& filename)
+{
+    std::map<std::string, int>::const_iterator it = g_SceneTextureIndices.find(filename);
+    if ( it != g_SceneTextureIndices.end() )
+        return it->second;
+
+    SceneTexture texture;
+    texture.filename   = filename;
+    texture.texture_id = 0;
+    texture.memory     = 0;
+
+    int index = g_SceneTextures.size();
+    g_SceneTextures.push_back(texture);
+    g_SceneTextureIndices[filename] = index;
+    AssetLoader_RequestTexture(filename.c_str());
+    return index;
+}
+
+// L uma textura para blob->texture. Executada pelas threads de trabalho de
+// "assetloader.h". Como os modelos em PrepareModel(), a textura  lida do
+// pacote de assets ou do cache (veja "texturecache.h") se possvel; caso
+// contrrio a imagem  decodificada, seus mipmaps so gerados e comprimidos
+// (veja "texture.h") e o resultado  salvo no cache.
+void PrepareTexture(AssetBlob* blob)
+{
+    const char* filename = blob->filename.c_str();
+    TextureData& texture = blob->texture;
+
+    AssetData asset;
+    if (    AssetPack_Find(g_AssetPack, filename, &asset) && asset.type == ASSET_TEXTURE
+         && TextureCache_LoadFromMemory(asset.data, asset.size, &texture) )
+    {
+        printf("Carregando textura \"%s\" do pacote de assets... OK.\n", filename);
+    }
+    else if ( TextureCache_Load(filename, &texture) )
+    {
+        printf("Carregando textura \"%s\" do cache... OK.\n", filename);
+    }
+    else
+    {
+        MappedFile file;
+        if ( !MapFile(filename, &file) )
+            throw std::runtime_error("Cannot open file");
+
+        TextureImage image;
+        try
         {
-            assert(model->shapes[shape].mesh.num_face_vertices[triangle] == 3);
+            Texture_Decode(file.data, file.size, filename, &image);
+        }
+        catch ( const std::exception& )
+        {
+            UnmapFile(&file);
+            throw;
+        }
+        UnmapFile(&file);
 
-            glm::vec4  vertices[3];
-            for (size_t vertex = 0; vertex < 3; ++vertex)
-            {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
-                const float vx = model->attrib.vertices[3*idx.vertex_index + 0];
-                const float vy = model->attrib.vertices[3*idx.vertex_index + 1];
-                const float vz = model->attrib.vertices[3*idx.vertex_index + 2];
-                vertices[vertex] = glm::vec4(vx,vy,vz,1.0);
-            }
+        Texture_Build(image, true, &texture);
+        if ( !TextureCache_Store(filename, texture) )
+            fprintf(stderr, "WARNING: Cannot write texture cache \"%s\".\n", TextureCache_Path(filename).c_str());
+    }
+
+    // O cache guarda BC1 sempre que possvel; GPUs sem S3TC recebem RGBA8.
+    if ( texture.format == TEXTURE_FORMAT_BC1 && !Texture_SupportsBC1() )
+        Texture_Decompress(&texture);
 
-            const glm::vec4  a = vertices[0];
-            const glm::vec4  b = vertices[1];
-            const glm::vec4  c = vertices[2];
+    blob->texture_memory = Texture_ReserveMemory(&texture);
+}
 
-            // PREENCHA AQUI o clculo da normal de um tringulo cujos vrtices
-            // esto nos pontos "a", "b", e "c", definidos no sentido anti-horrio.
-            const glm::vec4  n = crossproduct(b - a, c - a);
+// Torna disponvel para DrawVirtualObject() uma textura que j est na GPU.
+void AddLoadedTexture(const AssetBlob& blob, GLuint texture_id)
+{
+    std::map<std::string, int>::const_iterator it = g_SceneTextureIndices.find(blob.filename);
+    if ( it == g_SceneTextureIndices.end() )
+    {
+        glDeleteTextures(1, &texture_id);
+        Texture_ReleaseMemory(blob.texture_memory);
+        return;
+    }
+
+    SceneTexture& texture = g_SceneTextures[it->second];
+    texture.texture_id = texture_id;
+    texture.memory     = blob.texture_memory;
+
+    printf("Textura \"%s\" carregada (%.1f KB; total de %.1f MB).\n", blob.filename.c_str(),
+           blob.texture_memory / 1024.0, Texture_MemoryUsed() / (1024.0 * 1024.0));
+}
+
+// Cria g_PlaceholderObject: um cubo de lado 1 centrado na origem, com normais
+// por face.
+void CreatePlaceholderObject()
+{
+    MeshData mesh;
+    for (int face = 0; face < 6; ++face)
+    {
+        int   axis = face / 2; // Eixo perpendicular  face
+        float sign = (face % 2 == 0) ? 1.0f : -1.0f;
+        int   u = (axis + 1) % 3;
+        int   v = (axis + 2) % 3;
 
-            for (size_t vertex = 0; vertex < 3; ++vertex)
+        GLuint first_vertex = mesh.model_coefficients.size() / 4;
+        for (int corner = 0; corner < 4; ++corner)
+        {
+            float position[3];
+            position[axis] = 0.5f * sign;
+            position[u]    = (corner == 1 || corner == 2) ? 0.5f : -0.5f;
+            position[v]    = (corner >= 2) ? 0.5f : -0.5f;
+            for (int i = 0; i < 3; ++i)
             {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
-                num_triangles_per_vertex[idx.vertex_index] += 1;
-                vertex_normals[idx.vertex_index] += n;
-                model->shapes[shape].mesh.indices[3*triangle + vertex].normal_index = idx.vertex_index;
+                mesh.model_coefficients.push_back(position[i]);
+                mesh.normal_coefficients.push_back((i == axis) ? sign : 0.0f);
             }
+            mesh.model_coefficients.push_back(1.0f);
+            mesh.normal_coefficients.push_back(0.0f);
         }
-    }
 
-    model->attrib.normals.resize( 3*num_vertices );
+        // Os cantos percorrem a face no sentido anti-horrio quando vistos
+        // do lado +axis; para as faces do lado -axis, invertemos a ordem.
+        static const GLuint positive[6] = { 0, 1, 2, 0, 2, 3 };
+        static const GLuint negative[6] = { 0, 2, 1, 0, 3, 2 };
+        for (int i = 0; i < 6; ++i)
+            mesh.indices.push_back(first_vertex + ((sign > 0.0f) ? positive[i] : negative[i]));
+    }
 
-    for (size_t i = 0; i < vertex_normals.size(); ++i)
+    MeshShape shape;
+    shape.name           = "placeholder";
+    shape.first_index    = 0;
+    shape.num_indices    = mesh.indices.size();
+    shape.rendering_mode = GL_TRIANGLES;
+    shape.bounds_radius  = 0.5f * sqrtf(3.0f);
+    for (int i = 0; i < 3; ++i)
     {
-        glm::vec4 n = vertex_normals[i] / (float)num_triangles_per_vertex[i];
-        n /= norm(n);
-        model->attrib.normals[3*i + 0] = n.x;
-        model->attrib.normals[3*i + 1] = n.y;
-        model->attrib.normals[3*i + 2] = n.z;
+        shape.bounds_min[i] = -0.5f;
+        shape.bounds_max[i] =  0.5f;
     }
+    mesh.shapes.push_back(shape);
+
+    MeshGpuBuffers gpu;
+    MeshQuant_UploadMeshBuffers(GetMeshBuffers(mesh), &gpu);
+
+    // O cubo tambm fica na arena, com uma referncia que nunca  removida.
+    int arena_mesh = MeshArena_Add(gpu);
+    g_PlaceholderObject = BuildSceneObject(gpu, shape.name, arena_mesh);
+    AddSubmeshToSceneObject(&g_PlaceholderObject, gpu, 0, -1, -1);
 }
 
 // Constri tringulos para futura renderizao a partir de um ObjModel.
 void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
 {
-    GLuint vertex_array_object_id;
-    glGenVertexArrays(1, &vertex_array_object_id);
-    glBindVertexArray(vertex_array_object_id);
+    MeshData mesh;
+    BuildMeshData(model, &mesh);
+    UploadMeshAndAddToVirtualScene(GetMeshBuffers(mesh));
+}
 
-    std::vector<GLuint> indices;
-    std::vector<float>  model_coefficients;
-    std::vector<float>  normal_coefficients;
-    std::vector<float>  texture_coefficients;
+// Envia os atributos e ndices de uma malha para a GPU e adiciona cada uma de
+// suas shapes em g_VirtualScene. Veja BuildMeshData() em "mesh.cpp". Como o
+// nome do arquivo no  conhecido, texturas so procuradas a partir do
+// diretrio de execuo.
+void UploadMeshAndAddToVirtualScene(const MeshBuffers& buffers)
+{
+    MeshGpuBuffers gpu;
+    MeshQuant_UploadMeshBuffers(buffers, &gpu);
+    MeshQuant_PrintFormat(gpu);
+    AddMeshToVirtualScene(gpu, std::string());
+}
 
-    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
+// Libera as referncias de um objeto de g_VirtualScene  sua malha da arena
+// e aos seus materiais no UBO de materiais.
+static void ReleaseSceneObjectResources(const SceneObject& object)
+{
+    if ( object.arena_mesh >= 0 )
+        MeshArena_Release(object.arena_mesh);
+    for (size_t m = 0; m < object.materials.size(); ++m)
+        MeshMaterial_Release(object.materials[m]);
+}
+
+// Ordena as partes de um objeto por material e textura, para que
+// DrawVirtualObject() troque de material o menor nmero de vezes.
+static bool SubmeshMaterialLess(const SceneObjectSubmesh& a, const SceneObjectSubmesh& b)
+{
+    if ( a.material != b.material )
+        return a.material < b.material;
+    return a.texture < b.texture;
+}
+
+// Copia os buffers de uma malha para a arena (veja "mesharena.h"), apagando
+// os originais, e adiciona cada uma de suas shapes em g_VirtualScene. Shapes
+// com o mesmo nome (uma por material, veja BuildMeshData() em "mesh.cpp")
+// formam um nico objeto. As texturas dos materiais, relativas a
+// "directory", so pedidas a "assetloader.h".
+void AddMeshToVirtualScene(const MeshGpuBuffers& gpu, const std::string& directory)
+{
+    int arena_mesh = MeshArena_Add(gpu);
+
+    // Posio de cada material da malha no UBO de materiais, e de sua
+    // textura em g_SceneTextures.
+    std::vector<int> material_slots(gpu.materials.size());
+    std::vector<int> material_textures(gpu.materials.size(), -1);
+    for (size_t m = 0; m < gpu.materials.size(); ++m)
     {
-        size_t first_index = indices.size();
-        size_t num_triangles = model->shapes[shape].mesh.num_face_vertices.size();
+        material_slots[m] = MeshMaterial_Add(gpu.materials[m]);
+        if ( !gpu.materials[m].diffuse_texname.empty() )
+            material_textures[m] = RequestSceneTexture(directory + gpu.materials[m].diffuse_texname);
+    }
 
-        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
-        {
-            assert(model->shapes[shape].mesh.num_face_vertices[triangle] == 3);
+    std::map<std::string, SceneObject> objects;
+    for (size_t shape = 0; shape < gpu.shapes.size(); ++shape)
+    {
+        const std::string& name = gpu.shapes[shape].name;
+        if ( objects.find(name) == objects.end() )
+            objects[name] = BuildSceneObject(gpu, name, arena_mesh);
 
-            for (size_t vertex = 0; vertex < 3; ++vertex)
-            {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
+        int material = gpu.shapes[shape].material;
+        bool valid = (material >= 0 && material < (int)material_slots.size());
+        AddSubmeshToSceneObject(&objects[name], gpu, shape, valid ? material_slots[material] : -1, valid ? material_textures[material] : -1);
+    }
 
-                indices.push_back(first_index + 3*triangle + vertex);
+    // Cada objeto tem uma referncia  malha da arena e a cada um de seus
+    // materiais. Um objeto que j existia (por exemplo, um modelo carregado
+    // de novo)  substitudo, e a sua malha e os seus materiais anteriores
+    // so liberados quando nenhum outro objeto os usa.
+    for (std::map<std::string, SceneObject>::iterator it = objects.begin(); it != objects.end(); ++it)
+    {
+        std::stable_sort(it->second.submeshes.begin(), it->second.submeshes.end(), SubmeshMaterialLess);
+
+        SceneObject& stored = g_VirtualScene[GetSceneObjectHandle(it->first)];
+        ReleaseSceneObjectResources(stored);
+        MeshArena_AddReference(arena_mesh);
+        for (size_t m = 0; m < it->second.materials.size(); ++m)
+            MeshMaterial_AddReference(it->second.materials[m]);
+        stored = it->second;
+        RefitScenePlacements(GetSceneObjectHandle(it->first));
+    }
 
-                const float vx = model->attrib.vertices[3*idx.vertex_index + 0];
-                const float vy = model->attrib.vertices[3*idx.vertex_index + 1];
-                const float vz = model->attrib.vertices[3*idx.vertex_index + 2];
-                //printf("tri %d vert %d = (%.2f, %.2f, %.2f)\n", (int)triangle, (int)vertex, vx, vy, vz);
-                model_coefficients.push_back( vx ); // X
-                model_coefficients.push_back( vy ); // Y
-                model_coefficients.push_back( vz ); // Z
-                model_coefficients.push_back( 1.0f ); // W
+    // As referncias retornadas por MeshArena_Add() e MeshMaterial_Add() no
+    // pertencem a nenhum objeto. Materiais que nenhuma shape usa voltam a
+    // ficar livres aqui.
+    MeshArena_Release(arena_mesh);
+    for (size_t m = 0; m < material_slots.size(); ++m)
+        MeshMaterial_Release(material_slots[m]);
+}
 
-                // Inspecionando o cdigo da tinyobjloader, o aluno Bernardo
-                // Sulzbach (2017/1) apontou que a maneira correta de testar se
-                // existem normais e coordenadas de textura no ObjModel 
-                // comparando se o ndice retornado  -1. Fazemos isso abaixo.
+// Retorna a posio do objeto "name" em g_VirtualScene. Se o nome ainda no
+//  conhecido, reservamos uma posio vazia (arena_mesh == -1),
+// preenchida quando um modelo com esse objeto for carregado. As posies
+// nunca mudam, ento podem ser guardadas e usadas a cada quadro.
+int GetSceneObjectHandle(const std::string& name)
+{
+    std::map<std::string, int>::iterator it = g_VirtualSceneIndices.find(name);
+    if ( it != g_VirtualSceneIndices.end() )
+        return it->second;
+
+    SceneObject empty;
+    empty.name = name;
+    empty.arena_mesh = -1;
+    empty.bounds_radius = -1.0f;
+
+    int handle = (int)g_VirtualScene.size();
+    g_VirtualScene.push_back(empty);
+    g_VirtualSceneIndices[name] = handle;
+    return handle;
+}
 
-                if ( idx.normal_index != -1 )
-                {
-                    const float nx = model->attrib.normals[3*idx.normal_index + 0];
-                    const float ny = model->attrib.normals[3*idx.normal_index + 1];
-                    const float nz = model->attrib.normals[3*idx.normal_index + 2];
-                    normal_coefficients.push_back( nx ); // X
-                    normal_coefficients.push_back( ny ); // Y
-                    normal_coefficients.push_back( nz ); // Z
-                    normal_coefficients.push_back( 0.0f ); // W
-                }
+// Avisa sobre os objetos de g_VirtualScene cujas posies foram reservadas
+// mas que no foram encontrados em nenhum modelo carregado.
+void ReportMissingSceneObjects()
+{
+    for (size_t i = 0; i < g_VirtualScene.size(); ++i)
+        if ( g_VirtualScene[i].arena_mesh < 0 )
+            fprintf(stderr, "WARNING: Object \"%s\" was not found in any loaded model.\n", g_VirtualScene[i].name.c_str());
+}
 
-                if ( idx.texcoord_index != -1 )
-                {
-                    const float u = model->attrib.texcoords[2*idx.texcoord_index + 0];
-                    const float v = model->attrib.texcoords[2*idx.texcoord_index + 1];
-                    texture_coefficients.push_back( u );
-                    texture_coefficients.push_back( v );
-                }
-            }
-        }
+// Remove o objeto "name" de g_VirtualScene, que volta a ser desenhado como
+// g_PlaceholderObject, e libera suas referncias  malha da arena e aos
+// materiais. O handle
+// do objeto continua vlido e  preenchido de novo se o modelo for
+// carregado outra vez.
+void UnloadSceneObject(const std::string& name)
+{
+    std::map<std::string, int>::iterator it = g_VirtualSceneIndices.find(name);
+    if ( it == g_VirtualSceneIndices.end() || g_VirtualScene[it->second].arena_mesh < 0 )
+        return;
 
-        size_t last_index = indices.size() - 1;
+    SceneObject& stored = g_VirtualScene[it->second];
+    ReleaseSceneObjectResources(stored);
 
-        SceneObject theobject;
-        theobject.name           = model->shapes[shape].name;
-        theobject.first_index    = (void*)first_index; // Primeiro ndice
-        theobject.num_indices    = last_index - first_index + 1; // Nmero de indices
-        theobject.rendering_mode = GL_TRIANGLES;       // ndices correspondem ao tipo de rasterizao GL_TRIANGLES.
-        theobject.vertex_array_object_id = vertex_array_object_id;
+    SceneObject empty;
+    empty.name = name;
+    empty.arena_mesh = -1;
+    empty.bounds_radius = -1.0f;
+    stored = empty;
+    RefitScenePlacements(it->second);
+}
 
-        g_VirtualScene[model->shapes[shape].name] = theobject;
+// Constri um SceneObject, ainda sem partes, que usa a malha "arena_mesh" de
+// "mesharena.h", copiada de "gpu". As posies dos ndices de cada parte
+// (veja AddSubmeshToSceneObject()) j incluem a posio da malha no buffer
+// de ndices da arena.
+SceneObject BuildSceneObject(const MeshGpuBuffers& gpu, const std::string& name, int arena_mesh)
+{
+    SceneObject theobject;
+    theobject.name           = name;
+    theobject.rendering_mode = GL_TRIANGLES; // ndices correspondem ao tipo de rasterizao GL_TRIANGLES.
+    theobject.arena_mesh     = arena_mesh;
+    theobject.index_type     = gpu.format.index_type;
+    for (int i = 0; i < 3; ++i)
+    {
+        theobject.position_scale[i]  = gpu.format.position_scale[i];
+        theobject.position_offset[i] = gpu.format.position_offset[i];
+        theobject.bounds_center[i]   = 0.0f;
+        theobject.bounds_min[i]      = 0.0f;
+        theobject.bounds_max[i]      = 0.0f;
     }
+    theobject.bounds_radius  = -1.0f; // Nenhuma parte ainda
+
+    return theobject;
+}
+
+// Acrescenta a shape "shape" da malha como uma parte do objeto, desenhada com
+// o material "material" do UBO de materiais e a textura "texture" de
+// g_SceneTextures (ou -1), e aumenta a esfera envolvente do objeto para
+// conter a esfera da shape.
+void AddSubmeshToSceneObject(SceneObject* object, const MeshGpuBuffers& gpu, size_t shape, int material, int texture)
+{
+    const MeshShape& theshape = gpu.shapes[shape];
+    const size_t index_size = MeshQuant_IndexSize(gpu.format.index_type);
+    const size_t base = MeshArena_Mesh(object->arena_mesh).index_offset; // Incio da malha no buffer de ndices da arena
+
+    SceneObjectSubmesh submesh;
+    submesh.first_index = (void*)(base + theshape.first_index * index_size); // Primeiro ndice, em bytes
+    submesh.num_indices = theshape.num_indices; // Nmero de indices
+    submesh.material    = material;
+    submesh.texture     = texture;
+
+    for (size_t level = 0; level < theshape.lods.size(); ++level)
+    {
+        SceneObjectLod lod;
+        lod.first_index = (void*)(base + theshape.lods[level].first_index * index_size);
+        lod.num_indices = theshape.lods[level].num_indices;
+        submesh.lods.push_back(lod);
+    }
+
+    // Guardamos a posio de cada cluster em bytes, como em first_index,
+    // para pass-la diretamente para glMultiDrawElements().
+    submesh.clusters = theshape.clusters;
+    for (size_t c = 0; c < submesh.clusters.size(); ++c)
+        submesh.clusters[c].first_index = base + submesh.clusters[c].first_index * index_size;
+
+    object->rendering_mode = theshape.rendering_mode;
+    object->submeshes.push_back(submesh);
+    if ( material >= 0 && std::find(object->materials.begin(), object->materials.end(), material) == object->materials.end() )
+        object->materials.push_back(material);
+
+    // Unio das caixas envolventes (antes das esferas, que indicam se o
+    // objeto ainda no tem partes).
+    for (int i = 0; i < 3; ++i)
+    {
+        bool empty = (object->bounds_radius < 0.0f);
+        object->bounds_min[i] = empty ? theshape.bounds_min[i] : std::min(object->bounds_min[i], theshape.bounds_min[i]);
+        object->bounds_max[i] = empty ? theshape.bounds_max[i] : std::max(object->bounds_max[i], theshape.bounds_max[i]);
+    }
+
+    // Unio das esferas envolventes.
+    glm::vec3 c1(object->bounds_center[0], object->bounds_center[1], object->bounds_center[2]);
+    glm::vec3 c2(theshape.bounds_center[0], theshape.bounds_center[1], theshape.bounds_center[2]);
+    float r1 = object->bounds_radius;
+    float r2 = theshape.bounds_radius;
+    float d  = glm::length(c2 - c1);
+
+    glm::vec3 center;
+    float radius;
+    if ( r1 < 0.0f || d + r2 <= r1 ) // Objeto vazio, ou a shape j est dentro da esfera
+    {
+        center = (r1 < 0.0f) ? c2 : c1;
+        radius = (r1 < 0.0f) ? r2 : r1;
+    }
+    else if ( d + r1 <= r2 ) // A esfera do objeto est dentro da esfera da shape
+    {
+        center = c2;
+        radius = r2;
+    }
+    else
+    {
+        radius = 0.5f * (d + r1 + r2);
+        center = c1 + (c2 - c1) * ((radius - r1) / d);
+    }
+
+    for (int i = 0; i < 3; ++i)
+        object->bounds_center[i] = center[i];
+    object->bounds_radius = radius;
+}
+
+// Cria um VAO com os buffers de uma malha. VAOs no so compartilhados entre
+// contextos OpenGL, ento esta funo sempre  executada na thread principal.
+GLuint CreateMeshVertexArray(const MeshGpuBuffers& gpu)
+{
+    GLuint vertex_array_object_id;
+    glGenVertexArrays(1, &vertex_array_object_id);
+    glBindVertexArray(vertex_array_object_id);
+
+    // Todos os atributos esto intercalados em um nico VBO: cada vrtice
+    // ocupa gpu.format.stride bytes, e cada atributo comea em um
+    // deslocamento fixo dentro do vrtice. Veja "meshquant.h".
+    glBindBuffer(GL_ARRAY_BUFFER, gpu.vertices_id);
+    const GLsizei stride = gpu.format.stride;
 
-    GLuint VBO_model_coefficients_id;
-    glGenBuffers(1, &VBO_model_coefficients_id);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_model_coefficients_id);
-    glBufferData(GL_ARRAY_BUFFER, model_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, model_coefficients.size() * sizeof(float), model_coefficients.data());
     GLuint location = 0; // "(location = 0)" em "shader_vertex.glsl"
     GLint  number_of_dimensions = 4; // vec4 em "shader_vertex.glsl"
-    glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
+    // Posies quantizadas so inteiros sem sinal normalizados para [0,1];
+    // floats so usados diretamente.
+    GLboolean normalized = (gpu.format.position_type != GL_FLOAT);
+    glVertexAttribPointer(location, number_of_dimensions, gpu.format.position_type, normalized, stride, (void*)0);
     glEnableVertexAttribArray(location);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    if ( !normal_coefficients.empty() )
+    if ( gpu.format.normal_offset >= 0 )
     {
-        GLuint VBO_normal_coefficients_id;
-        glGenBuffers(1, &VBO_normal_coefficients_id);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_normal_coefficients_id);
-        glBufferData(GL_ARRAY_BUFFER, normal_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, normal_coefficients.size() * sizeof(float), normal_coefficients.data());
         location = 1; // "(location = 1)" em "shader_vertex.glsl"
         number_of_dimensions = 4; // vec4 em "shader_vertex.glsl"
-        glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
+        normalized = (gpu.format.normal_type != GL_FLOAT);
+        glVertexAttribPointer(location, number_of_dimensions, gpu.format.normal_type, normalized, stride, (void*)(size_t)gpu.format.normal_offset);
         glEnableVertexAttribArray(location);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
-    if ( !texture_coefficients.empty() )
+    if ( gpu.format.texture_offset >= 0 )
     {
-        GLuint VBO_texture_coefficients_id;
-        glGenBuffers(1, &VBO_texture_coefficients_id);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_texture_coefficients_id);
-        glBufferData(GL_ARRAY_BUFFER, texture_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, texture_coefficients.size() * sizeof(float), texture_coefficients.data());
-        location = 2; // "(location = 1)" em "shader_vertex.glsl"
+        location = 2; // "(location = 2)" em "shader_vertex.glsl"
         number_of_dimensions = 2; // vec2 em "shader_vertex.glsl"
-        glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
+        glVertexAttribPointer(location, number_of_dimensions, gpu.format.texture_type, GL_FALSE, stride, (void*)(size_t)gpu.format.texture_offset);
         glEnableVertexAttribArray(location);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
-    GLuint indices_id;
-    glGenBuffers(1, &indices_id);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Atributos por instncia (veja DrawVirtualObjectInstanced()), lidos de
+    // g_InstanceBufferId. Com divisor 1 eles avanam uma vez por instncia,
+    // em vez de uma vez por vrtice.
+    SetInstanceAttributes(0);
+    for (location = 3; location <= 7; ++location)
+    {
+        glVertexAttribDivisor(location, 1);
+        glEnableVertexAttribArray(location);
+    }
 
-    // "Ligamos" o buffer. Note que o tipo agora  GL_ELEMENT_ARRAY_BUFFER.
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_id);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), NULL, GL_STATIC_DRAW);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indices.size() * sizeof(GLuint), indices.data());
+    // "Ligamos" o buffer de ndices. Note que o tipo agora 
+    // GL_ELEMENT_ARRAY_BUFFER.
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu.indices_id);
     // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); // XXX Errado!
     //
 
     // "Desligamos" o VAO, evitando assim que operaes posteriores venham a
     // alterar o mesmo. Isso evita bugs.
     glBindVertexArray(0);
+
+    return vertex_array_object_id;
 }
 
 // Carrega um Vertex Shader de um arquivo GLSL. Veja definio de LoadShader() abaixo.
@@ -735,18 +2315,28 @@ void LoadShader(const char* filename, GLuint shader_id)
 {
     // Lemos o arquivo de texto indicado pela varivel "filename"
     // e colocamos seu contedo em memria, apontado pela varivel
-    // "shader_string".
-    std::ifstream file;
-    try {
-        file.exceptions(std::ifstream::failbit);
-        file.open(filename);
-    } catch ( std::exception& e ) {
-        fprintf(stderr, "ERROR: Cannot open file \"%s\".\n", filename);
-        std::exit(EXIT_FAILURE);
+    // "shader_string". Se o shader estiver no pacote de assets, o
+    // arquivo no  aberto.
+    std::string str;
+    AssetData asset;
+    if ( AssetPack_Find(g_AssetPack, filename, &asset) && asset.type == ASSET_SHADER )
+    {
+        str.assign(reinterpret_cast<const char*>(asset.data), asset.size);
+    }
+    else
+    {
+        std::ifstream file;
+        try {
+            file.exceptions(std::ifstream::failbit);
+            file.open(filename);
+        } catch ( std::exception& e ) {
+            fprintf(stderr, "ERROR: Cannot open file \"%s\".\n", filename);
+            std::exit(EXIT_FAILURE);
+        }
+        std::stringstream shader;
+        shader << file.rdbuf();
+        str = shader.str();
     }
-    std::stringstream shader;
-    shader << file.rdbuf();
-    std::string str = shader.str();
     const GLchar* shader_string = str.c_str();
     const GLint   shader_string_length = static_cast<GLint>( str.length() );
 
@@ -869,6 +2459,7 @@ void FramebufferSizeCallback(GLFWwindow* window, int width, int height)
     // O cast para float  necessrio pois nmeros inteiros so arredondados ao
     // serem divididos!
     g_ScreenRatio = (float)width / height;
+    g_ScreenHeight = (float)height;
 }
 
 // Variveis globais que armazenam a ltima posio do cursor do mouse, para
@@ -876,6 +2467,12 @@ void FramebufferSizeCallback(GLFWwindow* window, int width, int height)
 // de tempo. Utilizadas no callback CursorPosCallback() abaixo.
 double g_LastCursorPosX, g_LastCursorPosY;
 
+// Posio do cursor quando o boto esquerdo foi pressionado. Se o cursor
+// quase no se moveu at o boto ser solto, o clique seleciona o objeto sob o
+// cursor (veja PickScenePlacement()) em vez de girar a cmera.
+double g_LeftPressCursorPosX, g_LeftPressCursorPosY;
+#define PICK_MAX_CURSOR_DISTANCE 3.0
+
 // Funo callback chamada sempre que o usurio aperta algum dos botes do mouse
 void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
 {
@@ -887,6 +2484,8 @@ void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
         // g_LeftMouseButtonPressed como true, para saber que o usurio est
         // com o boto esquerdo pressionado.
         glfwGetCursorPos(window, &g_LastCursorPosX, &g_LastCursorPosY);
+        g_LeftPressCursorPosX = g_LastCursorPosX;
+        g_LeftPressCursorPosY = g_LastCursorPosY;
         g_LeftMouseButtonPressed = true;
     }
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE)
@@ -894,6 +2493,36 @@ void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
         // Quando o usurio soltar o boto esquerdo do mouse, atualizamos a
         // varivel abaixo para false.
         g_LeftMouseButtonPressed = false;
+
+        // Um clique sem arrasto seleciona o objeto sob o cursor. Tambm
+        // contamos as colocaes prximas dele, a at 1 unidade da sua
+        // caixa envolvente, consultando g_SceneTree.
+        double x, y;
+        glfwGetCursorPos(window, &x, &y);
+        double dx = x - g_LeftPressCursorPosX;
+        double dy = y - g_LeftPressCursorPosY;
+        if ( dx*dx + dy*dy <= PICK_MAX_CURSOR_DISTANCE*PICK_MAX_CURSOR_DISTANCE )
+        {
+            int picked = PickScenePlacement(window, x, y);
+            if ( picked >= 0 )
+            {
+                float minimum[3], maximum[3];
+                ScenePlacementBox(g_ScenePlacements[picked], minimum, maximum);
+                for (int k = 0; k < 3; ++k)
+                {
+                    minimum[k] -= 1.0f;
+                    maximum[k] += 1.0f;
+                }
+
+                static std::vector<int> nearby;
+                nearby.clear();
+                AabbTree_QueryBox(g_SceneTree, minimum, maximum, &nearby);
+
+                const ScenePlacement& placement = g_ScenePlacements[picked];
+                printf("Selecionado: \"%s\" (colocao %d), %d objetos prximos\n",
+                       g_VirtualScene[placement.object_handle].name.c_str(), picked, (int)nearby.size() - 1);
+            }
+        }
     }
     if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS)
     {
@@ -1079,12 +2708,30 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mod)
         g_UsePerspectiveProjection = false;
     }
 
+    // Se o usurio apertar a tecla C, ligamos ou desligamos o descarte de
+    // objetos escondidos por outros. Veja "occlusioncull.h".
+    if (key == GLFW_KEY_C && action == GLFW_PRESS)
+    {
+        g_UseOcclusionCulling = !g_UseOcclusionCulling;
+        fprintf(stdout, "Descarte por ocluso %s.\n", g_UseOcclusionCulling ? "ligado" : "desligado");
+        fflush(stdout);
+    }
+
     // Se o usurio apertar a tecla H, fazemos um "toggle" do texto informativo mostrado na tela.
     if (key == GLFW_KEY_H && action == GLFW_PRESS)
     {
         g_ShowInfoText = !g_ShowInfoText;
     }
 
+    // Se o usurio apertar a tecla M, descarregamos o coelho e o pedimos de
+    // novo a "assetloader.h": sua geometria volta para os intervalos livres
+    // da arena, que so reaproveitados quando ele chega.
+    if (key == GLFW_KEY_M && action == GLFW_PRESS)
+    {
+        UnloadSceneObject("bunny");
+        AssetLoader_Request("../../data/bunny.obj");
+    }
+
     // Se o usurio apertar a tecla R, recarregamos os shaders dos arquivos "shader_fragment.glsl" e "shader_vertex.glsl".
     if (key == GLFW_KEY_R && action == GLFW_PRESS)
     {
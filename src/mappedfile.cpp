@@ -0,0 +1,143 @@
+#include <cstdio>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "mappedfile.h"
+
+bool MapFile(const char* filename, MappedFile* file)
+{
+    file->data   = NULL;
+    file->size   = 0;
+    file->handle = NULL;
+
+#ifdef _WIN32
+    HANDLE fh = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if ( fh == INVALID_HANDLE_VALUE )
+        return false;
+
+    LARGE_INTEGER size;
+    if ( !GetFileSizeEx(fh, &size) )
+    {
+        CloseHandle(fh);
+        return false;
+    }
+
+    if ( size.QuadPart == 0 )
+    {
+        CloseHandle(fh);
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(fh);
+    if ( mapping == NULL )
+        return false;
+
+    void* ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if ( ptr == NULL )
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    file->data   = static_cast<const unsigned char*>(ptr);
+    file->size   = static_cast<size_t>(size.QuadPart);
+    file->handle = mapping;
+#else
+    int fd = open(filename, O_RDONLY);
+    if ( fd < 0 )
+        return false;
+
+    struct stat st;
+    if ( fstat(fd, &st) != 0 )
+    {
+        close(fd);
+        return false;
+    }
+
+    if ( st.st_size == 0 )
+    {
+        close(fd);
+        return true;
+    }
+
+    void* ptr = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // O mapeamento continua válido após fechar o descritor
+    if ( ptr == MAP_FAILED )
+        return false;
+
+    // Os arquivos que mapeamos são lidos do início ao fim.
+    madvise(ptr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+    file->data = static_cast<const unsigned char*>(ptr);
+    file->size = static_cast<size_t>(st.st_size);
+#endif
+
+    return true;
+}
+
+void UnmapFile(MappedFile* file)
+{
+    if ( file->data != NULL )
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(file->data);
+        CloseHandle(static_cast<HANDLE>(file->handle));
+#else
+        munmap(const_cast<unsigned char*>(file->data), file->size);
+#endif
+    }
+
+    file->data   = NULL;
+    file->size   = 0;
+    file->handle = NULL;
+}
+
+bool GetFileStamp(const char* filename, FileStamp* stamp)
+{
+    struct stat st;
+    if ( stat(filename, &st) != 0 )
+        return false;
+
+    stamp->size  = static_cast<uint64_t>(st.st_size);
+    stamp->mtime = static_cast<int64_t>(st.st_mtime);
+    return true;
+}
+
+bool SetFileMtime(const char* filename, int64_t mtime)
+{
+    // A data de acesso também é definida por utime(); usamos a mesma.
+#ifdef _WIN32
+    struct _utimbuf times;
+    times.actime  = (time_t)mtime;
+    times.modtime = (time_t)mtime;
+    return _utime(filename, &times) == 0;
+#else
+    struct utimbuf times;
+    times.actime  = (time_t)mtime;
+    times.modtime = (time_t)mtime;
+    return utime(filename, &times) == 0;
+#endif
+}
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
@@ -0,0 +1,285 @@
+#include <cassert>
+#include <cstring>
+#include <stdint.h>
+
+#include "mesh.h"
+
+// Número máximo de floats de um vértice: posição (3), normal (3) e
+// coordenadas de textura (2).
+static const int MAX_VERTEX_FLOATS = 8;
+
+// Hash dos bits dos floats de um vértice (mistura do MurmurHash3).
+static uint32_t HashVertex(const float* attributes, int count)
+{
+    uint32_t h = 0x9747b28c;
+    for (int i = 0; i < count; ++i)
+    {
+        uint32_t k;
+        memcpy(&k, &attributes[i], sizeof(k));
+        k *= 0xcc9e2d51;
+        k = (k << 15) | (k >> 17);
+        k *= 0x1b873593;
+        h ^= k;
+        h = (h << 13) | (h >> 19);
+        h = h * 5 + 0xe6546b64;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+// Material do triângulo "triangle" de uma shape, ou -1 se o triângulo não
+// tiver material (ou se o índice do material for inválido).
+static int TriangleMaterial(const tinyobj::mesh_t& mesh, size_t triangle, int num_materials)
+{
+    if ( triangle >= mesh.material_ids.size() )
+        return -1;
+
+    int material = mesh.material_ids[triangle];
+    return (material >= 0 && material < num_materials) ? material : -1;
+}
+
+void BuildMeshMaterials(const std::vector<tinyobj::material_t>& materials, std::vector<MeshMaterial>* out)
+{
+    out->resize(materials.size());
+    for (size_t m = 0; m < materials.size(); ++m)
+    {
+        MeshMaterial& material = (*out)[m];
+        material.name            = materials[m].name;
+        material.shininess       = materials[m].shininess;
+        material.diffuse_texname = materials[m].diffuse_texname;
+        for (int i = 0; i < 3; ++i)
+        {
+            material.ambient[i]  = materials[m].ambient[i];
+            material.diffuse[i]  = materials[m].diffuse[i];
+            material.specular[i] = materials[m].specular[i];
+        }
+    }
+}
+
+// Constrói os vetores de atributos e índices que serão enviados para a GPU a
+// partir de um ObjModel. Veja BuildTrianglesAndAddToVirtualScene() em "main.cpp".
+//
+// Vértices de triângulos diferentes com a mesma posição, normal e coordenada
+// de textura são unidos ("welding") em um único vértice, referenciado por
+// vários índices. Para encontrar os vértices repetidos usamos uma tabela hash
+// de endereçamento aberto indexada pelos bits dos atributos do vértice.
+//
+// Os triângulos de cada shape são agrupados por material: cada material
+// usado pela shape gera uma MeshShape (com o mesmo nome) cujos índices são
+// um intervalo contínuo, de modo que cada parte pode ser desenhada com uma
+// única chamada e um único conjunto de parâmetros de material.
+void BuildMeshData(const ObjModel* model, MeshData* mesh)
+{
+    std::vector<GLuint>& indices              = mesh->indices;
+    std::vector<float>&  model_coefficients   = mesh->model_coefficients;
+    std::vector<float>&  normal_coefficients  = mesh->normal_coefficients;
+    std::vector<float>&  texture_coefficients = mesh->texture_coefficients;
+
+    // Inspecionando o código da tinyobjloader, o aluno Bernardo Sulzbach
+    // (2017/1) apontou que a maneira correta de testar se existem normais e
+    // coordenadas de textura no ObjModel é comparando se o índice retornado é
+    // -1. Como os vértices são compartilhados, todos precisam ter os mesmos
+    // atributos: se algum vértice tiver normal (ou coordenada de textura), os
+    // que não tiverem recebem zeros.
+    size_t num_corners = 0;
+    bool has_normals  = false;
+    bool has_texcoords = false;
+    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
+    {
+        const std::vector<tinyobj::index_t>& shape_indices = model->shapes[shape].mesh.indices;
+        num_corners += shape_indices.size();
+        for (size_t i = 0; i < shape_indices.size(); ++i)
+        {
+            has_normals   = has_normals   || shape_indices[i].normal_index != -1;
+            has_texcoords = has_texcoords || shape_indices[i].texcoord_index != -1;
+        }
+    }
+
+    // Tabela hash com pelo menos o dobro de posições do número máximo de
+    // vértices, para que as sequências de colisões sejam curtas.
+    const GLuint EMPTY = 0xFFFFFFFFu;
+    size_t table_size = 16;
+    while (table_size < 2*num_corners)
+        table_size *= 2;
+    std::vector<GLuint> table(table_size, EMPTY);
+
+    indices.reserve(indices.size() + num_corners);
+
+    const int num_materials = model->materials.size();
+    BuildMeshMaterials(model->materials, &mesh->materials);
+
+    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
+    {
+        const tinyobj::mesh_t& shape_mesh = model->shapes[shape].mesh;
+        size_t num_triangles = shape_mesh.num_face_vertices.size();
+
+        // Ordenamos os triângulos por material com um counting sort estável:
+        // os triângulos do material m (ou -1) ficam em
+        // order[offsets[m+1] .. offsets[m+2]).
+        std::vector<size_t> offsets(num_materials + 2, 0);
+        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
+            offsets[TriangleMaterial(shape_mesh, triangle, num_materials) + 2] += 1;
+        for (size_t m = 1; m < offsets.size(); ++m)
+            offsets[m] += offsets[m-1];
+
+        std::vector<size_t> order(num_triangles);
+        std::vector<size_t> next(offsets);
+        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
+            order[next[TriangleMaterial(shape_mesh, triangle, num_materials) + 1]++] = triangle;
+
+        for (int material = -1; material < num_materials; ++material)
+        {
+            const size_t begin = offsets[material + 1];
+            const size_t end   = offsets[material + 2];
+            if ( begin == end )
+                continue;
+
+            size_t first_index = indices.size();
+
+            for (size_t k = begin; k < end; ++k)
+            {
+                const size_t triangle = order[k];
+                assert(shape_mesh.num_face_vertices[triangle] == 3);
+
+                for (size_t vertex = 0; vertex < 3; ++vertex)
+                {
+                    tinyobj::index_t idx = shape_mesh.indices[3*triangle + vertex];
+
+                    // Atributos do vértice, na ordem: posição, normal, textura.
+                    float attributes[MAX_VERTEX_FLOATS];
+                    int count = 0;
+
+                    attributes[count++] = model->attrib.vertices[3*idx.vertex_index + 0];
+                    attributes[count++] = model->attrib.vertices[3*idx.vertex_index + 1];
+                    attributes[count++] = model->attrib.vertices[3*idx.vertex_index + 2];
+
+                    if ( has_normals )
+                    {
+                        bool valid = idx.normal_index != -1;
+                        attributes[count++] = valid ? model->attrib.normals[3*idx.normal_index + 0] : 0.0f;
+                        attributes[count++] = valid ? model->attrib.normals[3*idx.normal_index + 1] : 0.0f;
+                        attributes[count++] = valid ? model->attrib.normals[3*idx.normal_index + 2] : 0.0f;
+                    }
+
+                    if ( has_texcoords )
+                    {
+                        bool valid = idx.texcoord_index != -1;
+                        attributes[count++] = valid ? model->attrib.texcoords[2*idx.texcoord_index + 0] : 0.0f;
+                        attributes[count++] = valid ? model->attrib.texcoords[2*idx.texcoord_index + 1] : 0.0f;
+                    }
+
+                    // Procuramos o vértice na tabela (sondagem linear).
+                    size_t slot = HashVertex(attributes, count) & (table_size - 1);
+                    GLuint found = EMPTY;
+                    while (table[slot] != EMPTY)
+                    {
+                        const GLuint candidate = table[slot];
+                        const float* p = &model_coefficients[4*candidate];
+                        const float* n = has_normals ? &normal_coefficients[4*candidate] : NULL;
+                        const float* t = has_texcoords ? &texture_coefficients[2*candidate] : NULL;
+
+                        // Comparamos os bits, como em HashVertex().
+                        if (    memcmp(p, &attributes[0], 3*sizeof(float)) == 0
+                             && (n == NULL || memcmp(n, &attributes[3], 3*sizeof(float)) == 0)
+                             && (t == NULL || memcmp(t, &attributes[has_normals ? 6 : 3], 2*sizeof(float)) == 0) )
+                        {
+                            found = candidate;
+                            break;
+                        }
+                        slot = (slot + 1) & (table_size - 1);
+                    }
+
+                    if ( found == EMPTY )
+                    {
+                        found = model_coefficients.size() / 4;
+                        table[slot] = found;
+
+                        count = 0;
+                        model_coefficients.push_back( attributes[count++] ); // X
+                        model_coefficients.push_back( attributes[count++] ); // Y
+                        model_coefficients.push_back( attributes[count++] ); // Z
+                        model_coefficients.push_back( 1.0f ); // W
+
+                        if ( has_normals )
+                        {
+                            normal_coefficients.push_back( attributes[count++] ); // X
+                            normal_coefficients.push_back( attributes[count++] ); // Y
+                            normal_coefficients.push_back( attributes[count++] ); // Z
+                            normal_coefficients.push_back( 0.0f ); // W
+                        }
+
+                        if ( has_texcoords )
+                        {
+                            texture_coefficients.push_back( attributes[count++] ); // U
+                            texture_coefficients.push_back( attributes[count++] ); // V
+                        }
+                    }
+
+                    indices.push_back(found);
+                }
+            }
+
+            size_t last_index = indices.size() - 1;
+
+            MeshShape theshape;
+            theshape.name           = model->shapes[shape].name;
+            theshape.first_index    = first_index; // Primeiro índice
+            theshape.num_indices    = last_index - first_index + 1; // Número de indices
+            theshape.rendering_mode = GL_TRIANGLES; // Índices correspondem ao tipo de rasterização GL_TRIANGLES.
+            theshape.material       = material;
+
+            mesh->shapes.push_back(theshape);
+        }
+    }
+}
+
+MeshBuffers GetMeshBuffers(const MeshData& mesh)
+{
+    MeshBuffers buffers;
+    buffers.indices                  = mesh.indices.data();
+    buffers.num_indices              = mesh.indices.size();
+    buffers.model_coefficients       = mesh.model_coefficients.data();
+    buffers.num_model_coefficients   = mesh.model_coefficients.size();
+    buffers.normal_coefficients      = mesh.normal_coefficients.data();
+    buffers.num_normal_coefficients  = mesh.normal_coefficients.size();
+    buffers.texture_coefficients     = mesh.texture_coefficients.data();
+    buffers.num_texture_coefficients = mesh.texture_coefficients.size();
+    buffers.shapes                   = mesh.shapes;
+    buffers.materials                = mesh.materials;
+    return buffers;
+}
+
+// Cria um buffer com "size" bytes de "data". Retorna 0 se size == 0.
+// Usamos GL_COPY_WRITE_BUFFER para não alterar o GL_ARRAY_BUFFER nem o
+// GL_ELEMENT_ARRAY_BUFFER do VAO que estiver ligado no momento; o tipo do
+// buffer só importa quando ele for associado a um VAO.
+static GLuint CreateBuffer(const void* data, size_t size)
+{
+    if ( size == 0 )
+        return 0;
+
+    GLuint buffer_id;
+    glGenBuffers(1, &buffer_id);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_id);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, 0, size, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return buffer_id;
+}
+
+void UploadMeshBuffers(const MeshBuffers& buffers, MeshGpuBuffers* gpu)
+{
+    gpu->model_coefficients_id   = CreateBuffer(buffers.model_coefficients, buffers.num_model_coefficients * sizeof(float));
+    gpu->normal_coefficients_id  = CreateBuffer(buffers.normal_coefficients, buffers.num_normal_coefficients * sizeof(float));
+    gpu->texture_coefficients_id = CreateBuffer(buffers.texture_coefficients, buffers.num_texture_coefficients * sizeof(float));
+    gpu->indices_id              = CreateBuffer(buffers.indices, buffers.num_indices * sizeof(GLuint));
+    gpu->num_vertices            = buffers.num_model_coefficients / 4;
+    gpu->num_indices             = buffers.num_indices;
+    gpu->shapes                  = buffers.shapes;
+    gpu->materials               = buffers.materials;
+    gpu->format                  = MeshVertexFormat();
+}
@@ -0,0 +1,356 @@
+#include <cstdio>
+#include <algorithm>
+
+#include "mesharena.h"
+
+void MeshArenaAllocator_Init(MeshArenaAllocator* allocator, size_t capacity)
+{
+    allocator->capacity = capacity;
+    allocator->free_ranges.clear();
+    if ( capacity > 0 )
+    {
+        MeshArenaRange all = { 0, capacity };
+        allocator->free_ranges.push_back(all);
+    }
+}
+
+bool MeshArenaAllocator_Alloc(MeshArenaAllocator* allocator, size_t size, size_t alignment, size_t* offset)
+{
+    if ( size == 0 )
+    {
+        *offset = 0;
+        return true;
+    }
+
+    std::vector<MeshArenaRange>& ranges = allocator->free_ranges;
+
+    // Menor intervalo livre que comporta a alocação, já alinhada.
+    size_t best = ranges.size();
+    size_t best_start = 0;
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+        size_t start = (ranges[i].offset + alignment - 1) / alignment * alignment;
+        if ( start + size > ranges[i].offset + ranges[i].size )
+            continue;
+        if ( best == ranges.size() || ranges[i].size < ranges[best].size )
+        {
+            best = i;
+            best_start = start;
+        }
+    }
+
+    if ( best == ranges.size() )
+        return false;
+
+    // O intervalo escolhido é dividido em até dois intervalos livres: o
+    // espaço perdido com o alinhamento, antes, e o que sobra, depois.
+    MeshArenaRange before = { ranges[best].offset, best_start - ranges[best].offset };
+    MeshArenaRange after  = { best_start + size, ranges[best].offset + ranges[best].size - (best_start + size) };
+
+    ranges.erase(ranges.begin() + best);
+    if ( after.size > 0 )
+        ranges.insert(ranges.begin() + best, after);
+    if ( before.size > 0 )
+        ranges.insert(ranges.begin() + best, before);
+
+    *offset = best_start;
+    return true;
+}
+
+static bool RangeOffsetLess(const MeshArenaRange& a, const MeshArenaRange& b)
+{
+    return a.offset < b.offset;
+}
+
+void MeshArenaAllocator_Free(MeshArenaAllocator* allocator, size_t offset, size_t size)
+{
+    if ( size == 0 )
+        return;
+
+    std::vector<MeshArenaRange>& ranges = allocator->free_ranges;
+
+    MeshArenaRange freed = { offset, size };
+    std::vector<MeshArenaRange>::iterator it = std::lower_bound(ranges.begin(), ranges.end(), freed, RangeOffsetLess);
+    it = ranges.insert(it, freed);
+
+    // Unimos o intervalo aos vizinhos livres.
+    std::vector<MeshArenaRange>::iterator next = it + 1;
+    if ( next != ranges.end() && it->offset + it->size == next->offset )
+    {
+        it->size += next->size;
+        it = ranges.erase(next) - 1;
+    }
+    if ( it != ranges.begin() )
+    {
+        std::vector<MeshArenaRange>::iterator previous = it - 1;
+        if ( previous->offset + previous->size == it->offset )
+        {
+            previous->size += it->size;
+            ranges.erase(it);
+        }
+    }
+}
+
+void MeshArenaAllocator_Grow(MeshArenaAllocator* allocator, size_t capacity)
+{
+    if ( capacity <= allocator->capacity )
+        return;
+
+    size_t old_capacity = allocator->capacity;
+    allocator->capacity = capacity;
+    MeshArenaAllocator_Free(allocator, old_capacity, capacity - old_capacity);
+}
+
+// Os buffers de vértices de um formato.
+struct MeshArenaPool
+{
+    MeshVertexFormat   format;                 // Apenas os tipos e a disposição dos atributos são usados
+    GLuint             vertex_buffer_id;
+    GLuint             vertex_array_object_id;
+    MeshArenaAllocator vertices;               // Em vértices
+};
+
+struct MeshArenaState
+{
+    GLuint (*create_vertex_array)(const MeshGpuBuffers& gpu);
+    GLuint                     index_buffer_id;
+    MeshArenaAllocator         indices;        // Em bytes
+    std::vector<MeshArenaPool> pools;
+    std::vector<MeshArenaMesh> meshes;
+    std::vector<int>           free_meshes;    // Posições de "meshes" que podem ser reaproveitadas
+};
+
+static MeshArenaState g_MeshArena;
+
+void MeshArena_Init(GLuint (*create_vertex_array)(const MeshGpuBuffers& gpu))
+{
+    g_MeshArena.create_vertex_array = create_vertex_array;
+    g_MeshArena.index_buffer_id = 0;
+    MeshArenaAllocator_Init(&g_MeshArena.indices, 0);
+    g_MeshArena.pools.clear();
+    g_MeshArena.meshes.clear();
+    g_MeshArena.free_meshes.clear();
+}
+
+// Dois formatos são iguais se os atributos são lidos da mesma forma; a
+// transformação das posições é de cada malha.
+static bool SameVertexLayout(const MeshVertexFormat& a, const MeshVertexFormat& b)
+{
+    return a.position_type == b.position_type && a.normal_type == b.normal_type && a.texture_type == b.texture_type
+        && a.stride == b.stride && a.normal_offset == b.normal_offset && a.texture_offset == b.texture_offset;
+}
+
+// Recria o VAO de um formato, que referencia o VBO do formato e o buffer de
+// índices.
+static void RebuildVertexArray(MeshArenaPool* pool)
+{
+    if ( pool->vertex_array_object_id != 0 )
+        glDeleteVertexArrays(1, &pool->vertex_array_object_id);
+    pool->vertex_array_object_id = 0;
+
+    if ( pool->vertex_buffer_id == 0 || g_MeshArena.index_buffer_id == 0 )
+        return;
+
+    MeshGpuBuffers gpu;
+    gpu.vertices_id = pool->vertex_buffer_id;
+    gpu.indices_id  = g_MeshArena.index_buffer_id;
+    gpu.format      = pool->format;
+    pool->vertex_array_object_id = g_MeshArena.create_vertex_array(gpu);
+}
+
+// Substitui "*buffer_id" por um buffer de "new_bytes" bytes, com os
+// primeiros "old_bytes" bytes copiados do buffer anterior.
+static void ReallocateBuffer(GLuint* buffer_id, size_t old_bytes, size_t new_bytes)
+{
+    GLuint grown;
+    glGenBuffers(1, &grown);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, new_bytes, NULL, GL_STATIC_DRAW);
+
+    if ( *buffer_id != 0 )
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, *buffer_id);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_bytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, buffer_id);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    *buffer_id = grown;
+}
+
+// Nova capacidade de um alocador que não comporta "size" unidades: pelo
+// menos o dobro da atual (ou "initial", se vazio).
+static size_t GrownCapacity(const MeshArenaAllocator& allocator, size_t size, size_t alignment, size_t initial)
+{
+    return std::max(std::max(initial, 2 * allocator.capacity), allocator.capacity + size + alignment);
+}
+
+// Aloca "size" bytes no buffer de índices, aumentando-o se necessário.
+static size_t AllocateIndices(size_t size)
+{
+    size_t offset;
+    if ( MeshArenaAllocator_Alloc(&g_MeshArena.indices, size, MESHARENA_INDEX_ALIGNMENT, &offset) )
+        return offset;
+
+    size_t old_bytes = g_MeshArena.indices.capacity;
+    size_t new_bytes = GrownCapacity(g_MeshArena.indices, size, MESHARENA_INDEX_ALIGNMENT, MESHARENA_INITIAL_BYTES);
+    ReallocateBuffer(&g_MeshArena.index_buffer_id, old_bytes, new_bytes);
+    MeshArenaAllocator_Grow(&g_MeshArena.indices, new_bytes);
+    printf("Arena: buffer de índices com %.1f MB.\n", new_bytes / (1024.0*1024.0));
+
+    // Todos os VAOs referenciam o buffer de índices.
+    for (size_t p = 0; p < g_MeshArena.pools.size(); ++p)
+        RebuildVertexArray(&g_MeshArena.pools[p]);
+
+    MeshArenaAllocator_Alloc(&g_MeshArena.indices, size, MESHARENA_INDEX_ALIGNMENT, &offset);
+    return offset;
+}
+
+// Aloca "count" vértices no VBO de um formato, aumentando-o se necessário.
+static size_t AllocateVertices(MeshArenaPool* pool, size_t count)
+{
+    size_t first;
+    if ( MeshArenaAllocator_Alloc(&pool->vertices, count, 1, &first) )
+        return first;
+
+    const size_t stride = pool->format.stride;
+    size_t old_capacity = pool->vertices.capacity;
+    size_t new_capacity = GrownCapacity(pool->vertices, count, 1, MESHARENA_INITIAL_BYTES / stride);
+    ReallocateBuffer(&pool->vertex_buffer_id, old_capacity * stride, new_capacity * stride);
+    MeshArenaAllocator_Grow(&pool->vertices, new_capacity);
+    printf("Arena: VBO de %d bytes por vértice com %.1f MB.\n", (int)stride, new_capacity * stride / (1024.0*1024.0));
+
+    RebuildVertexArray(pool);
+
+    MeshArenaAllocator_Alloc(&pool->vertices, count, 1, &first);
+    return first;
+}
+
+static int FindPool(const MeshVertexFormat& format)
+{
+    for (size_t p = 0; p < g_MeshArena.pools.size(); ++p)
+        if ( SameVertexLayout(g_MeshArena.pools[p].format, format) )
+            return (int)p;
+
+    MeshArenaPool pool;
+    pool.format = format;
+    pool.vertex_buffer_id = 0;
+    pool.vertex_array_object_id = 0;
+    g_MeshArena.pools.push_back(pool);
+    return (int)g_MeshArena.pools.size() - 1;
+}
+
+static size_t BufferSize(GLuint buffer_id)
+{
+    if ( buffer_id == 0 )
+        return 0;
+
+    GLint size = 0;
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer_id);
+    glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    return (size_t)size;
+}
+
+static void CopyBuffer(GLuint source_id, GLuint destination_id, size_t destination_offset, size_t size)
+{
+    if ( size == 0 )
+        return;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, source_id);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, destination_id);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, destination_offset, size);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+int MeshArena_Add(const MeshGpuBuffers& gpu)
+{
+    const size_t stride = gpu.format.stride;
+    const size_t vertex_bytes = BufferSize(gpu.vertices_id);
+    const size_t index_bytes  = BufferSize(gpu.indices_id);
+
+    MeshArenaMesh mesh;
+    mesh.pool         = FindPool(gpu.format);
+    mesh.num_vertices = vertex_bytes / stride;
+    mesh.index_bytes  = index_bytes;
+    mesh.references   = 1;
+
+    // Os índices primeiro: se o buffer de índices crescer, todos os VAOs são
+    // recriados, inclusive o de um formato novo, que ainda não tem VBO.
+    mesh.index_offset = AllocateIndices(index_bytes);
+
+    MeshArenaPool& pool = g_MeshArena.pools[mesh.pool];
+    mesh.first_vertex = AllocateVertices(&pool, mesh.num_vertices);
+    if ( pool.vertex_array_object_id == 0 )
+        RebuildVertexArray(&pool);
+
+    CopyBuffer(gpu.vertices_id, pool.vertex_buffer_id, mesh.first_vertex * stride, mesh.num_vertices * stride);
+    CopyBuffer(gpu.indices_id, g_MeshArena.index_buffer_id, mesh.index_offset, index_bytes);
+
+    // Os buffers da malha não são mais necessários.
+    GLuint buffers[5] = { gpu.vertices_id, gpu.model_coefficients_id, gpu.normal_coefficients_id, gpu.texture_coefficients_id, gpu.indices_id };
+    glDeleteBuffers(5, buffers);
+
+    int index;
+    if ( !g_MeshArena.free_meshes.empty() )
+    {
+        index = g_MeshArena.free_meshes.back();
+        g_MeshArena.free_meshes.pop_back();
+        g_MeshArena.meshes[index] = mesh;
+    }
+    else
+    {
+        index = (int)g_MeshArena.meshes.size();
+        g_MeshArena.meshes.push_back(mesh);
+    }
+    return index;
+}
+
+void MeshArena_AddReference(int mesh)
+{
+    g_MeshArena.meshes[mesh].references += 1;
+}
+
+void MeshArena_Release(int mesh)
+{
+    MeshArenaMesh& m = g_MeshArena.meshes[mesh];
+    if ( --m.references > 0 )
+        return;
+
+    MeshArenaAllocator_Free(&g_MeshArena.pools[m.pool].vertices, m.first_vertex, m.num_vertices);
+    MeshArenaAllocator_Free(&g_MeshArena.indices, m.index_offset, m.index_bytes);
+    m.pool = -1;
+    g_MeshArena.free_meshes.push_back(mesh);
+}
+
+const MeshArenaMesh& MeshArena_Mesh(int mesh)
+{
+    return g_MeshArena.meshes[mesh];
+}
+
+GLuint MeshArena_VertexArray(int pool)
+{
+    return g_MeshArena.pools[pool].vertex_array_object_id;
+}
+
+void MeshArena_Shutdown()
+{
+    for (size_t p = 0; p < g_MeshArena.pools.size(); ++p)
+    {
+        MeshArenaPool& pool = g_MeshArena.pools[p];
+        if ( pool.vertex_array_object_id != 0 )
+            glDeleteVertexArrays(1, &pool.vertex_array_object_id);
+        if ( pool.vertex_buffer_id != 0 )
+            glDeleteBuffers(1, &pool.vertex_buffer_id);
+    }
+    if ( g_MeshArena.index_buffer_id != 0 )
+        glDeleteBuffers(1, &g_MeshArena.index_buffer_id);
+
+    g_MeshArena.index_buffer_id = 0;
+    MeshArenaAllocator_Init(&g_MeshArena.indices, 0);
+    g_MeshArena.pools.clear();
+    g_MeshArena.meshes.clear();
+    g_MeshArena.free_meshes.clear();
+}
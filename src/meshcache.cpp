@@ -0,0 +1,637 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#include "meshcache.h"
+
+// Identificadores dos blocos de dados guardados no arquivo de cache. Cada
+// bloco é um vetor contínuo alinhado em 16 bytes.
+enum MeshCacheStreamId
+{
+    MESHCACHE_STREAM_SHAPES = 0,  // Vetor de MeshCacheShape
+    MESHCACHE_STREAM_NAMES,       // Nomes das shapes e dos materiais, concatenados
+    MESHCACHE_STREAM_INDICES,     // GLuint indices[]
+    MESHCACHE_STREAM_MODEL,       // float model_coefficients[]
+    MESHCACHE_STREAM_NORMAL,      // float normal_coefficients[]
+    MESHCACHE_STREAM_TEXTURE,     // float texture_coefficients[]
+    MESHCACHE_STREAM_LODS,        // Vetor de MeshCacheLod, de todas as shapes
+    MESHCACHE_STREAM_CLUSTERS,    // Vetor de MeshCacheCluster, de todas as shapes
+    MESHCACHE_STREAM_MATERIALS,   // Vetor de MeshCacheMaterial
+    MESHCACHE_NUM_STREAMS
+};
+
+struct MeshCacheStream
+{
+    uint64_t offset; // Posição do bloco dentro do arquivo, em bytes
+    uint64_t size;   // Tamanho do bloco, em bytes
+};
+
+struct MeshCacheHeader
+{
+    char            magic[8];     // "FCGMESH"
+    uint32_t        version;      // MESHCACHE_VERSION
+    uint32_t        header_size;  // sizeof(MeshCacheHeader)
+    uint64_t        path_hash;    // Hash do caminho do ".obj"
+    uint64_t        source_size;  // Tamanho do ".obj" em bytes
+    int64_t         source_mtime; // Data de modificação do ".obj" ao gravar o cache, que também a recebe
+    uint64_t        source_hash;  // Hash do conteúdo do ".obj"
+    uint64_t        file_size;    // Tamanho total do arquivo de cache
+    uint64_t        reserved;     // Mantém o cabeçalho com tamanho múltiplo de 16 bytes
+    MeshCacheStream streams[MESHCACHE_NUM_STREAMS];
+};
+
+struct MeshCacheShape
+{
+    uint64_t first_index;
+    uint64_t num_indices;
+    uint32_t rendering_mode;
+    uint32_t name_offset; // Posição do nome dentro de MESHCACHE_STREAM_NAMES
+    uint32_t name_length;
+    uint32_t first_lod;   // Posição do primeiro nível de detalhe em MESHCACHE_STREAM_LODS
+    uint32_t num_lods;
+    float    bounds_center[3];
+    float    bounds_radius;
+    float    bounds_min[3];
+    float    bounds_max[3];
+    uint32_t first_cluster; // Posição do primeiro cluster em MESHCACHE_STREAM_CLUSTERS
+    uint32_t num_clusters;
+    int32_t  material;      // Posição em MESHCACHE_STREAM_MATERIALS, ou -1
+};
+
+struct MeshCacheLod
+{
+    uint64_t first_index;
+    uint64_t num_indices;
+};
+
+struct MeshCacheCluster
+{
+    uint64_t first_index;
+    uint64_t num_indices;
+    float    center[3];
+    float    radius;
+    float    cone_apex[3];
+    float    cone_axis[3];
+    float    cone_cutoff;
+    float    reserved;    // Mantém a estrutura com 64 bytes
+};
+
+struct MeshCacheMaterial
+{
+    uint32_t name_offset;    // Posição do nome dentro de MESHCACHE_STREAM_NAMES
+    uint32_t name_length;
+    uint32_t texname_offset; // Idem, para MeshMaterial::diffuse_texname
+    uint32_t texname_length;
+    float    ambient[3];
+    float    shininess;
+    float    diffuse[3];
+    float    reserved0;
+    float    specular[3];
+    float    reserved1;
+};
+
+static const char   MESHCACHE_MAGIC[8] = "FCGMESH";
+static const size_t MESHCACHE_ALIGNMENT = 16;
+
+static_assert(sizeof(MeshCacheHeader) % MESHCACHE_ALIGNMENT == 0, "MeshCacheHeader deve ser alinhado");
+
+static uint64_t HashString(const char* str)
+{
+    return HashBytes(str, strlen(str));
+}
+
+// Computa o hash do conteúdo de um arquivo. Retorna false se o arquivo não
+// puder ser lido.
+static bool HashFileContents(const char* filename, uint64_t* hash)
+{
+    MappedFile source;
+    if ( !MapFile(filename, &source) )
+        return false;
+
+    *hash = HashBytes(source.data, source.size);
+    UnmapFile(&source);
+    return true;
+}
+
+std::string MeshCache_Path(const char* source_filename)
+{
+    return std::string(source_filename) + ".meshcache";
+}
+
+// Confere se "base" contém um cache completo, da versão atual, e com todos os
+// blocos dentro do arquivo.
+static bool ValidateCacheData(const unsigned char* base, size_t size)
+{
+    if ( size < sizeof(MeshCacheHeader) )
+        return false;
+
+    const MeshCacheHeader* header = reinterpret_cast<const MeshCacheHeader*>(base);
+
+    if (    memcmp(header->magic, MESHCACHE_MAGIC, sizeof(MESHCACHE_MAGIC)) != 0
+         || header->version     != MESHCACHE_VERSION
+         || header->header_size != sizeof(MeshCacheHeader)
+         || header->file_size   != size )
+        return false;
+
+    for (int i = 0; i < MESHCACHE_NUM_STREAMS; ++i)
+    {
+        const MeshCacheStream& s = header->streams[i];
+        if ( s.offset % MESHCACHE_ALIGNMENT != 0 || s.offset > size || s.size > size - s.offset )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Preenche "out" com ponteiros para os blocos de um cache já validado por
+// ValidateCacheData(). Retorna false se as shapes, LODs, clusters ou
+// materiais forem inválidos.
+static bool ParseCacheData(const unsigned char* base, MeshBuffers* out)
+{
+    const MeshCacheHeader* header = reinterpret_cast<const MeshCacheHeader*>(base);
+    const MeshCacheStream* streams = header->streams;
+
+    MeshBuffers& buffers = *out;
+    buffers.indices                  = reinterpret_cast<const GLuint*>(base + streams[MESHCACHE_STREAM_INDICES].offset);
+    buffers.num_indices              = streams[MESHCACHE_STREAM_INDICES].size / sizeof(GLuint);
+    buffers.model_coefficients       = reinterpret_cast<const float*>(base + streams[MESHCACHE_STREAM_MODEL].offset);
+    buffers.num_model_coefficients   = streams[MESHCACHE_STREAM_MODEL].size / sizeof(float);
+    buffers.normal_coefficients      = reinterpret_cast<const float*>(base + streams[MESHCACHE_STREAM_NORMAL].offset);
+    buffers.num_normal_coefficients  = streams[MESHCACHE_STREAM_NORMAL].size / sizeof(float);
+    buffers.texture_coefficients     = reinterpret_cast<const float*>(base + streams[MESHCACHE_STREAM_TEXTURE].offset);
+    buffers.num_texture_coefficients = streams[MESHCACHE_STREAM_TEXTURE].size / sizeof(float);
+
+    // Os atributos devem ter o mesmo número de vértices, e todos os índices
+    // devem apontar para um deles: um cache truncado ou antigo com o mesmo
+    // hash faria a GPU ler fora dos buffers.
+    const size_t num_vertices = buffers.num_model_coefficients / 4;
+    if (    buffers.num_model_coefficients % 4 != 0
+         || (buffers.num_normal_coefficients != 0 && buffers.num_normal_coefficients != num_vertices*4)
+         || (buffers.num_texture_coefficients != 0 && buffers.num_texture_coefficients != num_vertices*2) )
+    {
+        return false;
+    }
+    for (size_t i = 0; i < buffers.num_indices; ++i)
+    {
+        if ( buffers.indices[i] >= num_vertices )
+            return false;
+    }
+
+    const MeshCacheShape* shapes = reinterpret_cast<const MeshCacheShape*>(base + streams[MESHCACHE_STREAM_SHAPES].offset);
+    const char*           names  = reinterpret_cast<const char*>(base + streams[MESHCACHE_STREAM_NAMES].offset);
+    const size_t          num_shapes = streams[MESHCACHE_STREAM_SHAPES].size / sizeof(MeshCacheShape);
+    const size_t          names_size = streams[MESHCACHE_STREAM_NAMES].size;
+    const MeshCacheLod*   lods   = reinterpret_cast<const MeshCacheLod*>(base + streams[MESHCACHE_STREAM_LODS].offset);
+    const size_t          num_lods = streams[MESHCACHE_STREAM_LODS].size / sizeof(MeshCacheLod);
+    const MeshCacheCluster* clusters = reinterpret_cast<const MeshCacheCluster*>(base + streams[MESHCACHE_STREAM_CLUSTERS].offset);
+    const size_t          num_clusters = streams[MESHCACHE_STREAM_CLUSTERS].size / sizeof(MeshCacheCluster);
+    const MeshCacheMaterial* materials = reinterpret_cast<const MeshCacheMaterial*>(base + streams[MESHCACHE_STREAM_MATERIALS].offset);
+    const size_t          num_materials = streams[MESHCACHE_STREAM_MATERIALS].size / sizeof(MeshCacheMaterial);
+
+    buffers.materials.clear();
+    for (size_t i = 0; i < num_materials; ++i)
+    {
+        if (    materials[i].name_offset > names_size
+             || materials[i].name_length > names_size - materials[i].name_offset
+             || materials[i].texname_offset > names_size
+             || materials[i].texname_length > names_size - materials[i].texname_offset )
+        {
+            return false;
+        }
+
+        MeshMaterial material;
+        material.name            = std::string(names + materials[i].name_offset, materials[i].name_length);
+        material.diffuse_texname = std::string(names + materials[i].texname_offset, materials[i].texname_length);
+        material.shininess       = materials[i].shininess;
+        for (int k = 0; k < 3; ++k)
+        {
+            material.ambient[k]  = materials[i].ambient[k];
+            material.diffuse[k]  = materials[i].diffuse[k];
+            material.specular[k] = materials[i].specular[k];
+        }
+        buffers.materials.push_back(material);
+    }
+
+    buffers.shapes.clear();
+    for (size_t i = 0; i < num_shapes; ++i)
+    {
+        if (    shapes[i].name_offset > names_size
+             || shapes[i].name_length > names_size - shapes[i].name_offset
+             || shapes[i].first_index + shapes[i].num_indices > buffers.num_indices
+             || shapes[i].first_lod > num_lods
+             || shapes[i].num_lods > num_lods - shapes[i].first_lod
+             || shapes[i].first_cluster > num_clusters
+             || shapes[i].num_clusters > num_clusters - shapes[i].first_cluster
+             || shapes[i].material < -1
+             || shapes[i].material >= (int64_t)num_materials )
+        {
+            return false;
+        }
+
+        MeshShape shape;
+        shape.name           = std::string(names + shapes[i].name_offset, shapes[i].name_length);
+        shape.first_index    = shapes[i].first_index;
+        shape.num_indices    = shapes[i].num_indices;
+        shape.rendering_mode = shapes[i].rendering_mode;
+        shape.material       = shapes[i].material;
+        shape.bounds_radius  = shapes[i].bounds_radius;
+        for (int k = 0; k < 3; ++k)
+        {
+            shape.bounds_center[k] = shapes[i].bounds_center[k];
+            shape.bounds_min[k]    = shapes[i].bounds_min[k];
+            shape.bounds_max[k]    = shapes[i].bounds_max[k];
+        }
+
+        for (uint32_t l = shapes[i].first_lod; l < shapes[i].first_lod + shapes[i].num_lods; ++l)
+        {
+            if ( lods[l].first_index + lods[l].num_indices > buffers.num_indices )
+            {
+                return false;
+            }
+
+            MeshLod lod;
+            lod.first_index = lods[l].first_index;
+            lod.num_indices = lods[l].num_indices;
+            shape.lods.push_back(lod);
+        }
+
+        for (uint32_t c = shapes[i].first_cluster; c < shapes[i].first_cluster + shapes[i].num_clusters; ++c)
+        {
+            if ( clusters[c].first_index + clusters[c].num_indices > buffers.num_indices )
+            {
+                return false;
+            }
+
+            MeshCluster cluster;
+            cluster.first_index = clusters[c].first_index;
+            cluster.num_indices = clusters[c].num_indices;
+            cluster.radius      = clusters[c].radius;
+            cluster.cone_cutoff = clusters[c].cone_cutoff;
+            for (int k = 0; k < 3; ++k)
+            {
+                cluster.center[k]    = clusters[c].center[k];
+                cluster.cone_apex[k] = clusters[c].cone_apex[k];
+                cluster.cone_axis[k] = clusters[c].cone_axis[k];
+            }
+            shape.clusters.push_back(cluster);
+        }
+
+        buffers.shapes.push_back(shape);
+    }
+
+    return true;
+}
+
+bool MeshCache_Load(const char* source_filename, MeshCacheEntry* entry)
+{
+    FileStamp stamp;
+    if ( !GetFileStamp(source_filename, &stamp) )
+        return false;
+
+    std::string cache_path = MeshCache_Path(source_filename);
+    if ( !MapFile(cache_path.c_str(), &entry->file) )
+        return false;
+
+    const unsigned char* base = entry->file.data;
+    const size_t         size = entry->file.size;
+
+    if ( !ValidateCacheData(base, size) )
+    {
+        MeshCache_Close(entry);
+        return false;
+    }
+
+    const MeshCacheHeader* header = reinterpret_cast<const MeshCacheHeader*>(base);
+
+    if (    header->path_hash   != HashString(source_filename)
+         || header->source_size != stamp.size )
+    {
+        MeshCache_Close(entry);
+        return false;
+    }
+
+    // O cache recebe a data de modificação do ".obj" ao ser gravado (veja
+    // WriteCacheFile()). Se as datas diferem (por exemplo, após um "git
+    // checkout"), conferimos o conteúdo do arquivo. Se o conteúdo for o
+    // mesmo, o cache continua válido e apenas atualizamos sua data, sem
+    // escrever no arquivo que está mapeado.
+    FileStamp cache_stamp;
+    if ( !GetFileStamp(cache_path.c_str(), &cache_stamp) || cache_stamp.mtime != stamp.mtime )
+    {
+        uint64_t hash;
+        if ( !HashFileContents(source_filename, &hash) || hash != header->source_hash )
+        {
+            MeshCache_Close(entry);
+            return false;
+        }
+
+        SetFileMtime(cache_path.c_str(), stamp.mtime);
+    }
+
+    if ( !ParseCacheData(base, &entry->buffers) )
+    {
+        MeshCache_Close(entry);
+        return false;
+    }
+
+    return true;
+}
+
+bool MeshCache_LoadTile(const char* cache_path, uint64_t source_hash, MeshCacheEntry* entry)
+{
+    if ( !MapFile(cache_path, &entry->file) )
+        return false;
+
+    const unsigned char* base = entry->file.data;
+    const size_t         size = entry->file.size;
+
+    const MeshCacheHeader* header = reinterpret_cast<const MeshCacheHeader*>(base);
+    if (    !ValidateCacheData(base, size)
+         || header->path_hash   != HashString(cache_path)
+         || header->source_hash != source_hash
+         || !ParseCacheData(base, &entry->buffers) )
+    {
+        MeshCache_Close(entry);
+        return false;
+    }
+
+    return true;
+}
+
+bool MeshCache_LoadFromMemory(const void* data, size_t size, MeshCacheEntry* entry)
+{
+    // Nada a desmapear em MeshCache_Close(): a memória pertence a quem chama.
+    entry->file.data   = NULL;
+    entry->file.size   = 0;
+    entry->file.handle = NULL;
+
+    const unsigned char* base = static_cast<const unsigned char*>(data);
+    if ( !ValidateCacheData(base, size) || !ParseCacheData(base, &entry->buffers) )
+    {
+        MeshCache_Close(entry);
+        return false;
+    }
+    return true;
+}
+
+void MeshCache_Close(MeshCacheEntry* entry)
+{
+    UnmapFile(&entry->file);
+    entry->buffers = MeshBuffers();
+}
+
+// Origem dos dados de um bloco do cache: memória principal (data != NULL) ou
+// um buffer da GPU (buffer != 0), lido em partes com glGetBufferSubData().
+struct MeshCacheSource
+{
+    const void* data;
+    GLuint      buffer;
+    size_t      size;
+};
+
+static MeshCacheSource MemorySource(const void* data, size_t size)
+{
+    MeshCacheSource source = { data, 0, size };
+    return source;
+}
+
+static MeshCacheSource GpuSource(GLuint buffer, size_t size)
+{
+    MeshCacheSource source = { NULL, buffer, size };
+    return source;
+}
+
+// Escreve um bloco no arquivo, preenchendo com zeros até o próximo múltiplo
+// de MESHCACHE_ALIGNMENT, e registra sua posição em "stream".
+static bool WriteStream(FILE* f, const MeshCacheSource& source, uint64_t* offset, MeshCacheStream* stream)
+{
+    static const unsigned char zeros[MESHCACHE_ALIGNMENT] = {0};
+
+    const size_t size = source.size;
+    stream->offset = *offset;
+    stream->size   = size;
+
+    if ( source.buffer != 0 )
+    {
+        // Lemos o buffer da GPU em partes de 1 MB, para não precisar de uma
+        // cópia completa em memória.
+        std::vector<unsigned char> chunk(std::min(size, (size_t)(1024*1024)));
+        glBindBuffer(GL_COPY_READ_BUFFER, source.buffer);
+        for (size_t done = 0; done < size; done += chunk.size())
+        {
+            size_t n = std::min(chunk.size(), size - done);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, done, n, chunk.data());
+            if ( fwrite(chunk.data(), 1, n, f) != n )
+            {
+                glBindBuffer(GL_COPY_READ_BUFFER, 0);
+                return false;
+            }
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    else if ( size > 0 && fwrite(source.data, 1, size, f) != size )
+    {
+        return false;
+    }
+
+    size_t padding = (MESHCACHE_ALIGNMENT - size % MESHCACHE_ALIGNMENT) % MESHCACHE_ALIGNMENT;
+    if ( padding > 0 && fwrite(zeros, 1, padding, f) != padding )
+        return false;
+
+    *offset += size + padding;
+    return true;
+}
+
+// Preenche os campos do cabeçalho que identificam o ".obj" de origem.
+static bool SetSourceIdentity(const char* source_filename, MeshCacheHeader* header)
+{
+    header->path_hash = HashString(source_filename);
+
+    FileStamp stamp;
+    if ( !GetFileStamp(source_filename, &stamp) || !HashFileContents(source_filename, &header->source_hash) )
+        return false;
+    header->source_size  = stamp.size;
+    header->source_mtime = stamp.mtime;
+    return true;
+}
+
+// Grava o arquivo de cache "cache_path" com as shapes, os materiais e os
+// blocos INDICES, MODEL, NORMAL e TEXTURE (nesta ordem) de "sources". Os
+// campos de origem do cabeçalho são copiados de "identity".
+static bool WriteCacheFile(const std::string& cache_path, const MeshCacheHeader& identity, const std::vector<MeshShape>& mesh_shapes,
+                           const std::vector<MeshMaterial>& mesh_materials, const MeshCacheSource sources[4])
+{
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESHCACHE_MAGIC, sizeof(MESHCACHE_MAGIC));
+    header.version      = MESHCACHE_VERSION;
+    header.header_size  = sizeof(MeshCacheHeader);
+    header.path_hash    = identity.path_hash;
+    header.source_size  = identity.source_size;
+    header.source_mtime = identity.source_mtime;
+    header.source_hash  = identity.source_hash;
+
+    std::vector<MeshCacheShape> shapes(mesh_shapes.size());
+    std::vector<MeshCacheLod> lods;
+    std::vector<MeshCacheCluster> clusters;
+    std::string names;
+    for (size_t i = 0; i < mesh_shapes.size(); ++i)
+    {
+        shapes[i].first_index    = mesh_shapes[i].first_index;
+        shapes[i].num_indices    = mesh_shapes[i].num_indices;
+        shapes[i].rendering_mode = mesh_shapes[i].rendering_mode;
+        shapes[i].name_offset    = names.size();
+        shapes[i].name_length    = mesh_shapes[i].name.size();
+        shapes[i].first_lod      = lods.size();
+        shapes[i].num_lods       = mesh_shapes[i].lods.size();
+        shapes[i].first_cluster  = clusters.size();
+        shapes[i].num_clusters   = mesh_shapes[i].clusters.size();
+        shapes[i].material       = mesh_shapes[i].material;
+        shapes[i].bounds_radius  = mesh_shapes[i].bounds_radius;
+        for (int k = 0; k < 3; ++k)
+        {
+            shapes[i].bounds_center[k] = mesh_shapes[i].bounds_center[k];
+            shapes[i].bounds_min[k]    = mesh_shapes[i].bounds_min[k];
+            shapes[i].bounds_max[k]    = mesh_shapes[i].bounds_max[k];
+        }
+        names += mesh_shapes[i].name;
+
+        for (size_t l = 0; l < mesh_shapes[i].lods.size(); ++l)
+        {
+            MeshCacheLod lod = { mesh_shapes[i].lods[l].first_index, mesh_shapes[i].lods[l].num_indices };
+            lods.push_back(lod);
+        }
+
+        for (size_t c = 0; c < mesh_shapes[i].clusters.size(); ++c)
+        {
+            const MeshCluster& source = mesh_shapes[i].clusters[c];
+            MeshCacheCluster cluster;
+            memset(&cluster, 0, sizeof(cluster));
+            cluster.first_index = source.first_index;
+            cluster.num_indices = source.num_indices;
+            cluster.radius      = source.radius;
+            cluster.cone_cutoff = source.cone_cutoff;
+            for (int k = 0; k < 3; ++k)
+            {
+                cluster.center[k]    = source.center[k];
+                cluster.cone_apex[k] = source.cone_apex[k];
+                cluster.cone_axis[k] = source.cone_axis[k];
+            }
+            clusters.push_back(cluster);
+        }
+    }
+
+    std::vector<MeshCacheMaterial> materials(mesh_materials.size());
+    for (size_t i = 0; i < mesh_materials.size(); ++i)
+    {
+        const MeshMaterial& source = mesh_materials[i];
+        materials[i].name_offset    = names.size();
+        materials[i].name_length    = source.name.size();
+        names += source.name;
+        materials[i].texname_offset = names.size();
+        materials[i].texname_length = source.diffuse_texname.size();
+        names += source.diffuse_texname;
+        materials[i].shininess      = source.shininess;
+        for (int k = 0; k < 3; ++k)
+        {
+            materials[i].ambient[k]  = source.ambient[k];
+            materials[i].diffuse[k]  = source.diffuse[k];
+            materials[i].specular[k] = source.specular[k];
+        }
+    }
+
+    // Escrevemos em um arquivo temporário e o renomeamos ao final, para que
+    // uma execução interrompida nunca deixe um cache incompleto.
+    std::string temp_path = cache_path + ".tmp";
+
+    FILE* f = fopen(temp_path.c_str(), "wb");
+    if ( f == NULL )
+        return false;
+
+    uint64_t offset = sizeof(MeshCacheHeader);
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1; // Reescrito ao final
+
+    MeshCacheStream* streams = header.streams;
+    ok = ok && WriteStream(f, MemorySource(shapes.data(), shapes.size()*sizeof(MeshCacheShape)), &offset, &streams[MESHCACHE_STREAM_SHAPES]);
+    ok = ok && WriteStream(f, MemorySource(names.data(), names.size()), &offset, &streams[MESHCACHE_STREAM_NAMES]);
+    ok = ok && WriteStream(f, sources[0], &offset, &streams[MESHCACHE_STREAM_INDICES]);
+    ok = ok && WriteStream(f, sources[1], &offset, &streams[MESHCACHE_STREAM_MODEL]);
+    ok = ok && WriteStream(f, sources[2], &offset, &streams[MESHCACHE_STREAM_NORMAL]);
+    ok = ok && WriteStream(f, sources[3], &offset, &streams[MESHCACHE_STREAM_TEXTURE]);
+    ok = ok && WriteStream(f, MemorySource(lods.data(), lods.size()*sizeof(MeshCacheLod)), &offset, &streams[MESHCACHE_STREAM_LODS]);
+    ok = ok && WriteStream(f, MemorySource(clusters.data(), clusters.size()*sizeof(MeshCacheCluster)), &offset, &streams[MESHCACHE_STREAM_CLUSTERS]);
+    ok = ok && WriteStream(f, MemorySource(materials.data(), materials.size()*sizeof(MeshCacheMaterial)), &offset, &streams[MESHCACHE_STREAM_MATERIALS]);
+
+    header.file_size = offset;
+    ok = ok && fseek(f, 0, SEEK_SET) == 0;
+    ok = ok && fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = (fclose(f) == 0) && ok;
+
+    // A data de modificação do cache é a do ".obj", conferida por
+    // MeshCache_Load(). Os tiles não têm ".obj" próprio (source_mtime == 0).
+    if ( ok && header.source_mtime != 0 )
+        SetFileMtime(temp_path.c_str(), header.source_mtime);
+
+    if ( ok )
+    {
+        remove(cache_path.c_str()); // rename() não sobrescreve arquivos no Windows
+        ok = rename(temp_path.c_str(), cache_path.c_str()) == 0;
+    }
+
+    if ( !ok )
+        remove(temp_path.c_str());
+
+    return ok;
+}
+
+bool MeshCache_Store(const char* source_filename, const MeshData& mesh)
+{
+    const MeshCacheSource sources[4] = {
+        MemorySource(mesh.indices.data(), mesh.indices.size()*sizeof(GLuint)),
+        MemorySource(mesh.model_coefficients.data(), mesh.model_coefficients.size()*sizeof(float)),
+        MemorySource(mesh.normal_coefficients.data(), mesh.normal_coefficients.size()*sizeof(float)),
+        MemorySource(mesh.texture_coefficients.data(), mesh.texture_coefficients.size()*sizeof(float)),
+    };
+    MeshCacheHeader identity;
+    memset(&identity, 0, sizeof(identity));
+    if ( !SetSourceIdentity(source_filename, &identity) )
+        return false;
+    return WriteCacheFile(MeshCache_Path(source_filename), identity, mesh.shapes, mesh.materials, sources);
+}
+
+bool MeshCache_StoreFromGpu(const char* source_filename, const MeshGpuBuffers& gpu)
+{
+    const MeshCacheSource sources[4] = {
+        GpuSource(gpu.indices_id, gpu.num_indices*sizeof(GLuint)),
+        GpuSource(gpu.model_coefficients_id, gpu.num_vertices*4*sizeof(float)),
+        GpuSource(gpu.normal_coefficients_id, gpu.normal_coefficients_id != 0 ? gpu.num_vertices*4*sizeof(float) : 0),
+        GpuSource(gpu.texture_coefficients_id, gpu.texture_coefficients_id != 0 ? gpu.num_vertices*2*sizeof(float) : 0),
+    };
+    MeshCacheHeader identity;
+    memset(&identity, 0, sizeof(identity));
+    if ( !SetSourceIdentity(source_filename, &identity) )
+        return false;
+    return WriteCacheFile(MeshCache_Path(source_filename), identity, gpu.shapes, gpu.materials, sources);
+}
+
+bool MeshCache_StoreTile(const char* cache_path, uint64_t source_hash, const MeshData& mesh)
+{
+    const MeshCacheSource sources[4] = {
+        MemorySource(mesh.indices.data(), mesh.indices.size()*sizeof(GLuint)),
+        MemorySource(mesh.model_coefficients.data(), mesh.model_coefficients.size()*sizeof(float)),
+        MemorySource(mesh.normal_coefficients.data(), mesh.normal_coefficients.size()*sizeof(float)),
+        MemorySource(mesh.texture_coefficients.data(), mesh.texture_coefficients.size()*sizeof(float)),
+    };
+
+    // O tamanho e a data do ".obj" são conferidos pelo índice de tiles;
+    // aqui guardamos apenas o hash, para ligar o tile ao índice.
+    MeshCacheHeader identity;
+    memset(&identity, 0, sizeof(identity));
+    identity.path_hash   = HashString(cache_path);
+    identity.source_hash = source_hash;
+    return WriteCacheFile(cache_path, identity, mesh.shapes, mesh.materials, sources);
+}
@@ -0,0 +1,393 @@
+#include <cstdio>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#include "meshcluster.h"
+#include "meshopt.h"
+#include "frustumcull.h"
+
+// Adjacência vértice -> triângulos de uma shape: os triângulos que usam o
+// vértice v ficam em triangles[offsets[v] .. offsets[v] + counts[v]).
+// Triângulos já colocados em um cluster são removidos da lista (trocando com
+// o último), de modo que counts[v] é o número de triângulos restantes.
+struct TriangleAdjacency
+{
+    std::vector<unsigned int> offsets;
+    std::vector<unsigned int> counts;
+    std::vector<unsigned int> triangles;
+};
+
+static void BuildAdjacency(const GLuint* indices, size_t num_triangles, size_t num_vertices, TriangleAdjacency* adjacency)
+{
+    adjacency->offsets.assign(num_vertices + 1, 0);
+    adjacency->counts.assign(num_vertices, 0);
+    adjacency->triangles.resize(3 * num_triangles);
+
+    for (size_t i = 0; i < 3 * num_triangles; ++i)
+        adjacency->offsets[indices[i] + 1] += 1;
+    for (size_t v = 0; v < num_vertices; ++v)
+        adjacency->offsets[v + 1] += adjacency->offsets[v];
+
+    for (size_t t = 0; t < num_triangles; ++t)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            const GLuint v = indices[3*t + k];
+            adjacency->triangles[adjacency->offsets[v] + adjacency->counts[v]++] = t;
+        }
+    }
+}
+
+static void RemoveTriangle(TriangleAdjacency* adjacency, const GLuint* indices, size_t triangle)
+{
+    for (int k = 0; k < 3; ++k)
+    {
+        const GLuint  v    = indices[3*triangle + k];
+        unsigned int* list = &adjacency->triangles[adjacency->offsets[v]];
+        unsigned int& n    = adjacency->counts[v];
+        for (unsigned int i = 0; i < n; ++i)
+        {
+            if ( list[i] == triangle )
+            {
+                list[i] = list[n - 1];
+                n -= 1;
+                break;
+            }
+        }
+    }
+}
+
+// Otimiza a ordem dos triângulos de um cluster para o cache de vértices. Os
+// índices são renumerados localmente antes de chamar
+// MeshOpt_OptimizeVertexCache(), que aloca vetores do tamanho do número de
+// vértices.
+static void OptimizeCluster(GLuint* indices, size_t num_indices)
+{
+    std::vector<GLuint> vertices;
+    std::vector<GLuint> local(num_indices);
+    for (size_t i = 0; i < num_indices; ++i)
+    {
+        std::vector<GLuint>::iterator it = std::find(vertices.begin(), vertices.end(), indices[i]);
+        local[i] = it - vertices.begin();
+        if ( it == vertices.end() )
+            vertices.push_back(indices[i]);
+    }
+
+    MeshOpt_OptimizeVertexCache(local.data(), num_indices, vertices.size());
+
+    for (size_t i = 0; i < num_indices; ++i)
+        indices[i] = vertices[local[i]];
+}
+
+// Calcula a esfera envolvente e o cone de normais de um cluster, como em
+// meshopt_computeMeshletBounds() da biblioteca meshoptimizer.
+static void ComputeClusterBounds(const GLuint* indices, size_t num_indices, const float* positions, MeshCluster* cluster)
+{
+    float bbox_min[3] = {  FLT_MAX,  FLT_MAX,  FLT_MAX };
+    float bbox_max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (size_t i = 0; i < num_indices; ++i)
+    {
+        const float* p = &positions[4*indices[i]];
+        for (int j = 0; j < 3; ++j)
+        {
+            bbox_min[j] = std::min(bbox_min[j], p[j]);
+            bbox_max[j] = std::max(bbox_max[j], p[j]);
+        }
+    }
+
+    float radius2 = 0.0f;
+    for (int j = 0; j < 3; ++j)
+        cluster->center[j] = 0.5f * (bbox_min[j] + bbox_max[j]);
+    for (size_t i = 0; i < num_indices; ++i)
+    {
+        const float* p = &positions[4*indices[i]];
+        const float dx = p[0] - cluster->center[0];
+        const float dy = p[1] - cluster->center[1];
+        const float dz = p[2] - cluster->center[2];
+        radius2 = std::max(radius2, dx*dx + dy*dy + dz*dz);
+    }
+    cluster->radius = std::sqrt(radius2);
+
+    // Cone que nunca é descartado, usado se as normais não permitirem um
+    // cone com abertura menor que 90 graus.
+    for (int j = 0; j < 3; ++j)
+    {
+        cluster->cone_apex[j] = cluster->center[j];
+        cluster->cone_axis[j] = 0.0f;
+    }
+    cluster->cone_cutoff = 1.0f;
+
+    // Normais unitárias dos triângulos não degenerados.
+    std::vector<float> normals;
+    std::vector<size_t> corners;
+    float axis[3] = { 0.0f, 0.0f, 0.0f };
+    for (size_t i = 0; i + 2 < num_indices; i += 3)
+    {
+        const float* a = &positions[4*indices[i]];
+        const float* b = &positions[4*indices[i+1]];
+        const float* c = &positions[4*indices[i+2]];
+        const float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        const float v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        float n[3] = { u[1]*v[2] - u[2]*v[1], u[2]*v[0] - u[0]*v[2], u[0]*v[1] - u[1]*v[0] };
+        const float length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if ( length == 0.0f )
+            continue;
+
+        for (int j = 0; j < 3; ++j)
+        {
+            n[j] /= length;
+            axis[j] += n[j];
+            normals.push_back(n[j]);
+        }
+        corners.push_back(indices[i]);
+    }
+
+    const float axis_length = std::sqrt(axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2]);
+    if ( normals.empty() || axis_length == 0.0f )
+        return;
+    for (int j = 0; j < 3; ++j)
+        axis[j] /= axis_length;
+
+    // A abertura do cone é dada pela normal mais distante do eixo.
+    float min_dot = 1.0f;
+    for (size_t t = 0; t < corners.size(); ++t)
+    {
+        const float* n = &normals[3*t];
+        min_dot = std::min(min_dot, n[0]*axis[0] + n[1]*axis[1] + n[2]*axis[2]);
+    }
+    if ( min_dot <= 0.0f )
+        return;
+
+    // O vértice do cone fica atrás de todos os planos dos triângulos, ao longo
+    // do eixo: assim, uma câmera dentro do cone (a partir do vértice) está
+    // atrás de todos eles.
+    float max_t = 0.0f;
+    for (size_t t = 0; t < corners.size(); ++t)
+    {
+        const float* n = &normals[3*t];
+        const float* p = &positions[4*corners[t]];
+        const float dc = (cluster->center[0] - p[0])*n[0] + (cluster->center[1] - p[1])*n[1] + (cluster->center[2] - p[2])*n[2];
+        const float dn = axis[0]*n[0] + axis[1]*n[1] + axis[2]*n[2];
+        max_t = std::max(max_t, dc / dn);
+    }
+
+    for (int j = 0; j < 3; ++j)
+    {
+        cluster->cone_apex[j] = cluster->center[j] - axis[j] * max_t;
+        cluster->cone_axis[j] = axis[j];
+    }
+    cluster->cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+}
+
+// Divide a shape em clusters, reordenando seus índices (nível 0) em
+// "indices". "positions" tem 4 floats por vértice.
+static void GenerateShapeClusters(std::vector<GLuint>* indices, MeshShape* shape, const float* positions, size_t num_vertices)
+{
+    shape->clusters.clear();
+
+    const size_t num_triangles = shape->num_indices / 3;
+    if ( shape->rendering_mode != GL_TRIANGLES || num_triangles < MESHCLUSTER_MIN_TRIANGLES )
+        return;
+
+    GLuint* shape_indices = &(*indices)[shape->first_index];
+
+    TriangleAdjacency adjacency;
+    BuildAdjacency(shape_indices, num_triangles, num_vertices, &adjacency);
+
+    // vertex_cluster[v] é o último cluster que usou o vértice v.
+    const unsigned int NO_CLUSTER = ~0u;
+    std::vector<unsigned int>  vertex_cluster(num_vertices, NO_CLUSTER);
+    std::vector<unsigned char> emitted(num_triangles, 0);
+    std::vector<GLuint>        output;
+    std::vector<GLuint>        cluster_vertices;
+    output.reserve(3 * num_triangles);
+
+    size_t seed = 0;
+    size_t num_emitted = 0;
+    while ( num_emitted < num_triangles )
+    {
+        // Cada cluster começa no primeiro triângulo restante na ordem atual,
+        // que já foi otimizada para o cache de vértices e é localmente coerente.
+        while ( emitted[seed] )
+            ++seed;
+
+        const unsigned int cluster_id = shape->clusters.size();
+        MeshCluster cluster;
+        cluster.first_index = shape->first_index + output.size();
+        cluster_vertices.clear();
+
+        float  centroid_sum[3] = { 0.0f, 0.0f, 0.0f };
+        size_t cluster_triangles = 0;
+        size_t triangle = seed;
+        for (;;)
+        {
+            const GLuint* tri = &shape_indices[3*triangle];
+            for (int k = 0; k < 3; ++k)
+            {
+                output.push_back(tri[k]);
+                if ( vertex_cluster[tri[k]] != cluster_id )
+                {
+                    vertex_cluster[tri[k]] = cluster_id;
+                    cluster_vertices.push_back(tri[k]);
+                }
+                for (int j = 0; j < 3; ++j)
+                    centroid_sum[j] += positions[4*tri[k] + j] / 3.0f;
+            }
+            RemoveTriangle(&adjacency, shape_indices, triangle);
+            emitted[triangle] = 1;
+            num_emitted += 1;
+            cluster_triangles += 1;
+
+            if ( cluster_triangles == MESHCLUSTER_MAX_TRIANGLES )
+                break;
+
+            // Próximo triângulo: o vizinho que acrescenta menos vértices ao
+            // cluster; em caso de empate, o de menor valência restante e,
+            // por fim, o mais próximo do centro do cluster.
+            float centroid[3];
+            for (int j = 0; j < 3; ++j)
+                centroid[j] = centroid_sum[j] / cluster_triangles;
+
+            size_t best = num_triangles;
+            int    best_new_vertices = 4;
+            unsigned int best_valence = ~0u;
+            float  best_distance = FLT_MAX;
+            for (size_t i = 0; i < cluster_vertices.size(); ++i)
+            {
+                const GLuint v = cluster_vertices[i];
+                const unsigned int* list = &adjacency.triangles[adjacency.offsets[v]];
+                for (unsigned int a = 0; a < adjacency.counts[v]; ++a)
+                {
+                    const GLuint* candidate = &shape_indices[3*list[a]];
+                    int new_vertices = 0;
+                    for (int k = 0; k < 3; ++k)
+                        new_vertices += (vertex_cluster[candidate[k]] != cluster_id);
+
+                    if (    cluster_vertices.size() + new_vertices > MESHCLUSTER_MAX_VERTICES
+                         || new_vertices > best_new_vertices )
+                        continue;
+
+                    // Triângulos cujos vértices têm poucos vizinhos restantes
+                    // "fecham" esses vértices, que não precisarão ser
+                    // repetidos em outros clusters.
+                    const unsigned int valence = adjacency.counts[candidate[0]] + adjacency.counts[candidate[1]] + adjacency.counts[candidate[2]];
+                    if ( new_vertices == best_new_vertices && valence > best_valence )
+                        continue;
+
+                    float distance = 0.0f;
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        const float c = (positions[4*candidate[0] + j] + positions[4*candidate[1] + j] + positions[4*candidate[2] + j]) / 3.0f;
+                        distance += (c - centroid[j]) * (c - centroid[j]);
+                    }
+
+                    if ( new_vertices < best_new_vertices || valence < best_valence || distance < best_distance )
+                    {
+                        best = list[a];
+                        best_new_vertices = new_vertices;
+                        best_valence = valence;
+                        best_distance = distance;
+                    }
+                }
+            }
+
+            if ( best == num_triangles )
+                break;
+            triangle = best;
+        }
+
+        cluster.num_indices = 3 * cluster_triangles;
+        shape->clusters.push_back(cluster);
+    }
+
+    std::copy(output.begin(), output.end(), shape_indices);
+
+    for (size_t c = 0; c < shape->clusters.size(); ++c)
+    {
+        MeshCluster& cluster = shape->clusters[c];
+        GLuint* cluster_indices = &(*indices)[cluster.first_index];
+        OptimizeCluster(cluster_indices, cluster.num_indices);
+        ComputeClusterBounds(cluster_indices, cluster.num_indices, positions, &cluster);
+    }
+}
+
+void MeshCluster_PrintClusters(const std::vector<MeshShape>& shapes)
+{
+    for (size_t s = 0; s < shapes.size(); ++s)
+    {
+        const MeshShape& shape = shapes[s];
+        if ( shape.clusters.empty() )
+            continue;
+
+        printf("Clusters de \"%s\": %zu (média de %.1f triângulos).\n", shape.name.c_str(), shape.clusters.size(),
+               shape.num_indices / 3.0 / shape.clusters.size());
+    }
+}
+
+void MeshCluster_GenerateClusters(MeshData* mesh)
+{
+    const size_t num_vertices = mesh->model_coefficients.size() / 4;
+    for (size_t s = 0; s < mesh->shapes.size(); ++s)
+        GenerateShapeClusters(&mesh->indices, &mesh->shapes[s], mesh->model_coefficients.data(), num_vertices);
+}
+
+void MeshCluster_GenerateGpuClusters(MeshGpuBuffers* gpu)
+{
+    const size_t num_vertices = gpu->num_vertices;
+
+    std::vector<GLuint> indices(gpu->num_indices);
+    glBindBuffer(GL_COPY_READ_BUFFER, gpu->indices_id);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, indices.size() * sizeof(GLuint), indices.data());
+
+    std::vector<float> positions(4 * num_vertices);
+    glBindBuffer(GL_COPY_READ_BUFFER, gpu->model_coefficients_id);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, positions.size() * sizeof(float), positions.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    for (size_t s = 0; s < gpu->shapes.size(); ++s)
+        GenerateShapeClusters(&indices, &gpu->shapes[s], positions.data(), num_vertices);
+
+    // Os índices mudam apenas de ordem, dentro do intervalo de cada shape.
+    glBindBuffer(GL_COPY_WRITE_BUFFER, gpu->indices_id);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, 0, indices.size() * sizeof(GLuint), indices.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void MeshCluster_ExtractPlanes(const float clip_from_model[16], MeshClusterView* view)
+{
+    FrustumCull_ExtractPlanes(clip_from_model, view->planes);
+}
+
+bool MeshCluster_IsVisible(const MeshCluster& cluster, const MeshClusterView& view)
+{
+    for (int p = 0; p < 6; ++p)
+    {
+        const float* plane = view.planes[p];
+        const float distance = plane[0]*cluster.center[0] + plane[1]*cluster.center[1] + plane[2]*cluster.center[2] + plane[3];
+        if ( distance < -cluster.radius )
+            return false;
+    }
+
+    if ( cluster.cone_cutoff >= 1.0f )
+        return true;
+
+    float d[3];
+    if ( view.perspective )
+    {
+        for (int j = 0; j < 3; ++j)
+            d[j] = cluster.cone_apex[j] - view.position[j];
+        const float length = std::sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+        if ( length == 0.0f )
+            return true;
+        for (int j = 0; j < 3; ++j)
+            d[j] /= length;
+    }
+    else
+    {
+        for (int j = 0; j < 3; ++j)
+            d[j] = view.direction[j];
+    }
+
+    return d[0]*cluster.cone_axis[0] + d[1]*cluster.cone_axis[1] + d[2]*cluster.cone_axis[2] < cluster.cone_cutoff;
+}
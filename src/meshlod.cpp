@@ -0,0 +1,434 @@
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+#include <stdint.h>
+
+#include "meshlod.h"
+#include "meshopt.h"
+
+// Quádrica de erro: Q(p) = p^T A p + 2 b.p + c, com A simétrica. A soma das
+// quádricas dos planos dos triângulos ao redor de um vértice mede a soma das
+// distâncias quadradas de um ponto a esses planos.
+struct Quadric
+{
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+};
+
+// Acumula em "q" a quádrica do plano n.p + d = 0, com peso "weight".
+static void AddPlaneQuadric(Quadric* q, const double n[3], double d, double weight)
+{
+    q->a00 += weight * n[0]*n[0];
+    q->a01 += weight * n[0]*n[1];
+    q->a02 += weight * n[0]*n[2];
+    q->a11 += weight * n[1]*n[1];
+    q->a12 += weight * n[1]*n[2];
+    q->a22 += weight * n[2]*n[2];
+    q->b0  += weight * n[0]*d;
+    q->b1  += weight * n[1]*d;
+    q->b2  += weight * n[2]*d;
+    q->c   += weight * d*d;
+}
+
+static void AddQuadric(Quadric* q, const Quadric& r)
+{
+    q->a00 += r.a00; q->a01 += r.a01; q->a02 += r.a02;
+    q->a11 += r.a11; q->a12 += r.a12; q->a22 += r.a22;
+    q->b0  += r.b0;  q->b1  += r.b1;  q->b2  += r.b2;
+    q->c   += r.c;
+}
+
+static double EvaluateQuadric(const Quadric& q, const float* p)
+{
+    const double x = p[0], y = p[1], z = p[2];
+    return x*(q.a00*x + 2.0*q.a01*y + 2.0*q.a02*z + 2.0*q.b0)
+         + y*(q.a11*y + 2.0*q.a12*z + 2.0*q.b1)
+         + z*(q.a22*z + 2.0*q.b2)
+         + q.c;
+}
+
+// Normal (não normalizada) do triângulo abc. "positions" tem 4 floats por
+// vértice.
+static void TriangleNormal(const float* positions, GLuint a, GLuint b, GLuint c, double n[3])
+{
+    const float* pa = &positions[4*a];
+    const float* pb = &positions[4*b];
+    const float* pc = &positions[4*c];
+    const double u[3] = { (double)pb[0] - pa[0], (double)pb[1] - pa[1], (double)pb[2] - pa[2] };
+    const double v[3] = { (double)pc[0] - pa[0], (double)pc[1] - pa[1], (double)pc[2] - pa[2] };
+    n[0] = u[1]*v[2] - u[2]*v[1];
+    n[1] = u[2]*v[0] - u[0]*v[2];
+    n[2] = u[0]*v[1] - u[1]*v[0];
+}
+
+// Colapso candidato da aresta from -> to.
+struct Collapse
+{
+    double cost;
+    GLuint from;
+    GLuint to;
+
+    bool operator<(const Collapse& other) const { return cost < other.cost; }
+};
+
+// Estado da simplificação de uma shape. Os mesmos vértices e quádricas são
+// usados em todos os níveis, de modo que o erro de cada nível é medido em
+// relação à superfície original.
+struct SimplifyState
+{
+    const float*               positions;    // 4 floats por vértice
+    size_t                     num_vertices;
+    std::vector<GLuint>        indices;      // Triângulos atuais
+    std::vector<Quadric>       quadrics;
+    std::vector<unsigned char> locked;       // Vértices que não podem ser removidos
+
+    // Vetores auxiliares, reaproveitados entre passadas.
+    std::vector<GLuint>        remap;
+    std::vector<unsigned char> touched;
+    std::vector<GLuint>        adjacency_offsets;
+    std::vector<GLuint>        adjacency;
+    std::vector<Collapse>      collapses;
+};
+
+// Compara as posições de dois vértices (para ordenação).
+struct PositionLess
+{
+    const float* positions;
+    bool operator()(GLuint a, GLuint b) const
+    {
+        const float* pa = &positions[4*a];
+        const float* pb = &positions[4*b];
+        if ( pa[0] != pb[0] ) return pa[0] < pb[0];
+        if ( pa[1] != pb[1] ) return pa[1] < pb[1];
+        return pa[2] < pb[2];
+    }
+};
+
+static void InitializeSimplify(SimplifyState* s, const GLuint* indices, size_t num_indices, const float* positions, size_t num_vertices)
+{
+    s->positions    = positions;
+    s->num_vertices = num_vertices;
+    s->indices.assign(indices, indices + num_indices);
+
+    const Quadric zero = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    s->quadrics.assign(num_vertices, zero);
+    s->locked.assign(num_vertices, 0);
+    s->touched.assign(num_vertices, 0);
+    s->remap.resize(num_vertices);
+    for (size_t v = 0; v < num_vertices; ++v)
+        s->remap[v] = v;
+
+    // Quádricas dos planos dos triângulos, com peso proporcional à área.
+    for (size_t i = 0; i < num_indices; i += 3)
+    {
+        double n[3];
+        TriangleNormal(positions, indices[i], indices[i+1], indices[i+2], n);
+        const double length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if ( length == 0.0 )
+            continue;
+
+        const double unit[3] = { n[0]/length, n[1]/length, n[2]/length };
+        const float* p = &positions[4*indices[i]];
+        const double d = -(unit[0]*p[0] + unit[1]*p[1] + unit[2]*p[2]);
+        for (int k = 0; k < 3; ++k)
+            AddPlaneQuadric(&s->quadrics[indices[i+k]], unit, d, 0.5 * length);
+    }
+
+    // Vértices de borda: arestas (a,b) sem a aresta oposta (b,a).
+    std::vector<uint64_t> edges;
+    edges.reserve(num_indices);
+    for (size_t i = 0; i < num_indices; i += 3)
+        for (int k = 0; k < 3; ++k)
+            edges.push_back(((uint64_t)indices[i+k] << 32) | indices[i + (k+1)%3]);
+    std::sort(edges.begin(), edges.end());
+
+    for (size_t e = 0; e < edges.size(); ++e)
+    {
+        const GLuint a = (GLuint)(edges[e] >> 32);
+        const GLuint b = (GLuint)(edges[e] & 0xFFFFFFFFu);
+        if ( !std::binary_search(edges.begin(), edges.end(), ((uint64_t)b << 32) | a) )
+            s->locked[a] = s->locked[b] = 1;
+    }
+
+    // Costuras: vértices diferentes com a mesma posição.
+    std::vector<GLuint> used(indices, indices + num_indices);
+    std::sort(used.begin(), used.end());
+    used.erase(std::unique(used.begin(), used.end()), used.end());
+
+    PositionLess less = { positions };
+    std::sort(used.begin(), used.end(), less);
+    for (size_t i = 1; i < used.size(); ++i)
+    {
+        if ( !less(used[i-1], used[i]) )
+            s->locked[used[i-1]] = s->locked[used[i]] = 1;
+    }
+}
+
+// Verifica se levar o vértice "from" até "to" inverte algum triângulo ao
+// redor de "from". Retorna o número de triângulos que seriam removidos, ou
+// -1 se o colapso não for permitido.
+static int CheckCollapse(const SimplifyState* s, GLuint from, GLuint to)
+{
+    int removed = 0;
+    for (GLuint j = s->adjacency_offsets[from]; j < s->adjacency_offsets[from+1]; ++j)
+    {
+        const GLuint* tri = &s->indices[3*s->adjacency[j]];
+        if ( tri[0] == to || tri[1] == to || tri[2] == to )
+        {
+            removed += 1;
+            continue;
+        }
+
+        GLuint moved[3] = { tri[0], tri[1], tri[2] };
+        for (int k = 0; k < 3; ++k)
+            if ( moved[k] == from )
+                moved[k] = to;
+
+        double before[3], after[3];
+        TriangleNormal(s->positions, tri[0], tri[1], tri[2], before);
+        TriangleNormal(s->positions, moved[0], moved[1], moved[2], after);
+        if ( before[0]*after[0] + before[1]*after[1] + before[2]*after[2] < 0.0 )
+            return -1;
+    }
+    return removed;
+}
+
+// Uma passada de colapsos independentes (nenhum vértice participa de mais de
+// um colapso). Retorna false se nenhum colapso foi possível.
+static bool SimplifyPass(SimplifyState* s, size_t target_triangles)
+{
+    const size_t num_triangles = s->indices.size() / 3;
+
+    // Lista de triângulos de cada vértice.
+    s->adjacency_offsets.assign(s->num_vertices + 1, 0);
+    for (size_t i = 0; i < s->indices.size(); ++i)
+        s->adjacency_offsets[s->indices[i] + 1] += 1;
+    for (size_t v = 0; v < s->num_vertices; ++v)
+        s->adjacency_offsets[v+1] += s->adjacency_offsets[v];
+    s->adjacency.resize(s->indices.size());
+    {
+        std::vector<GLuint> fill(s->adjacency_offsets.begin(), s->adjacency_offsets.end() - 1);
+        for (size_t i = 0; i < s->indices.size(); ++i)
+            s->adjacency[fill[s->indices[i]]++] = i / 3;
+    }
+
+    // Colapsos candidatos: cada aresta, nos dois sentidos, exceto a partir
+    // de vértices travados. O custo é a quádrica combinada avaliada na
+    // posição de destino.
+    s->collapses.clear();
+    for (size_t i = 0; i < s->indices.size(); i += 3)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            const GLuint a = s->indices[i+k];
+            const GLuint b = s->indices[i + (k+1)%3];
+            const float* pa = &s->positions[4*a];
+            const float* pb = &s->positions[4*b];
+
+            if ( !s->locked[a] )
+            {
+                Collapse c = { EvaluateQuadric(s->quadrics[a], pb) + EvaluateQuadric(s->quadrics[b], pb), a, b };
+                s->collapses.push_back(c);
+            }
+            if ( !s->locked[b] )
+            {
+                Collapse c = { EvaluateQuadric(s->quadrics[a], pa) + EvaluateQuadric(s->quadrics[b], pa), b, a };
+                s->collapses.push_back(c);
+            }
+        }
+    }
+    std::sort(s->collapses.begin(), s->collapses.end());
+
+    const size_t needed = num_triangles - target_triangles;
+    size_t removed = 0;
+    std::vector<GLuint> changed;
+
+    for (size_t i = 0; i < s->collapses.size() && removed < needed; ++i)
+    {
+        const Collapse& c = s->collapses[i];
+        if ( s->touched[c.from] || s->touched[c.to] )
+            continue;
+
+        const int collapse_removed = CheckCollapse(s, c.from, c.to);
+        if ( collapse_removed < 0 )
+            continue;
+
+        s->remap[c.from] = c.to;
+        changed.push_back(c.from);
+        AddQuadric(&s->quadrics[c.to], s->quadrics[c.from]);
+        removed += collapse_removed;
+
+        // Os triângulos ao redor de "from" mudaram; seus vértices não podem
+        // participar de outro colapso nesta passada.
+        for (GLuint j = s->adjacency_offsets[c.from]; j < s->adjacency_offsets[c.from+1]; ++j)
+        {
+            const GLuint* tri = &s->indices[3*s->adjacency[j]];
+            s->touched[tri[0]] = s->touched[tri[1]] = s->touched[tri[2]] = 1;
+            changed.push_back(tri[0]);
+            changed.push_back(tri[1]);
+            changed.push_back(tri[2]);
+        }
+    }
+
+    if ( changed.empty() )
+        return false;
+
+    // Aplica os colapsos e descarta os triângulos degenerados.
+    size_t output = 0;
+    for (size_t i = 0; i < s->indices.size(); i += 3)
+    {
+        const GLuint a = s->remap[s->indices[i+0]];
+        const GLuint b = s->remap[s->indices[i+1]];
+        const GLuint c = s->remap[s->indices[i+2]];
+        if ( a == b || b == c || a == c )
+            continue;
+        s->indices[output++] = a;
+        s->indices[output++] = b;
+        s->indices[output++] = c;
+    }
+    s->indices.resize(output);
+
+    for (size_t i = 0; i < changed.size(); ++i)
+    {
+        s->touched[changed[i]] = 0;
+        s->remap[changed[i]] = changed[i];
+    }
+    return true;
+}
+
+// Calcula a caixa e a esfera envolventes dos vértices usados por "indices":
+// a esfera tem o centro da caixa e raio até o vértice mais distante.
+static void ComputeBounds(const GLuint* indices, size_t num_indices, const float* positions, MeshShape* shape)
+{
+    if ( num_indices == 0 )
+        return;
+
+    float minimum[3], maximum[3];
+    for (int k = 0; k < 3; ++k)
+        minimum[k] = maximum[k] = positions[4*indices[0] + k];
+
+    for (size_t i = 1; i < num_indices; ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            minimum[k] = std::min(minimum[k], positions[4*indices[i] + k]);
+            maximum[k] = std::max(maximum[k], positions[4*indices[i] + k]);
+        }
+    }
+
+    float radius2 = 0.0f;
+    for (int k = 0; k < 3; ++k)
+    {
+        shape->bounds_min[k]    = minimum[k];
+        shape->bounds_max[k]    = maximum[k];
+        shape->bounds_center[k] = 0.5f * (minimum[k] + maximum[k]);
+    }
+    for (size_t i = 0; i < num_indices; ++i)
+    {
+        const float* p = &positions[4*indices[i]];
+        const float d[3] = { p[0] - shape->bounds_center[0], p[1] - shape->bounds_center[1], p[2] - shape->bounds_center[2] };
+        radius2 = std::max(radius2, d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+    }
+    shape->bounds_radius = std::sqrt(radius2);
+}
+
+// Calcula a esfera envolvente de uma shape e gera seus níveis de detalhe,
+// acrescentando os índices de cada nível ao final de "indices".
+static void GenerateShapeLods(std::vector<GLuint>* indices, MeshShape* shape, const float* positions, size_t num_vertices)
+{
+    shape->lods.clear();
+
+    const size_t count = shape->num_indices - shape->num_indices % 3;
+    ComputeBounds(indices->data() + shape->first_index, count, positions, shape);
+
+    if ( shape->rendering_mode != GL_TRIANGLES || count / 3 < MESHLOD_MIN_TRIANGLES * MESHLOD_REDUCTION )
+        return;
+
+    SimplifyState state;
+    InitializeSimplify(&state, indices->data() + shape->first_index, count, positions, num_vertices);
+
+    size_t previous_triangles = count / 3;
+    for (int level = 0; level < MESHLOD_MAX_LEVELS; ++level)
+    {
+        const size_t target = previous_triangles / MESHLOD_REDUCTION;
+        if ( target < MESHLOD_MIN_TRIANGLES )
+            break;
+
+        while (state.indices.size() / 3 > target)
+            if ( !SimplifyPass(&state, target) )
+                break;
+
+        // Nível que praticamente não reduz o anterior (por exemplo, quando
+        // quase todos os vértices estão travados) não vale a pena.
+        const size_t triangles = state.indices.size() / 3;
+        if ( 4 * triangles > 3 * previous_triangles )
+            break;
+
+        MeshLod lod;
+        lod.first_index = indices->size();
+        lod.num_indices = state.indices.size();
+        indices->insert(indices->end(), state.indices.begin(), state.indices.end());
+        MeshOpt_OptimizeVertexCache(indices->data() + lod.first_index, lod.num_indices, num_vertices);
+        shape->lods.push_back(lod);
+
+        previous_triangles = triangles;
+    }
+}
+
+void MeshLod_PrintLods(const std::vector<MeshShape>& shapes)
+{
+    for (size_t s = 0; s < shapes.size(); ++s)
+    {
+        const MeshShape& shape = shapes[s];
+        if ( shape.lods.empty() )
+            continue;
+
+        printf("Níveis de detalhe de \"%s\": %zu", shape.name.c_str(), shape.num_indices / 3);
+        for (size_t i = 0; i < shape.lods.size(); ++i)
+            printf(" -> %zu", shape.lods[i].num_indices / 3);
+        printf(" triângulos.\n");
+    }
+}
+
+void MeshLod_GenerateLods(MeshData* mesh)
+{
+    const size_t num_vertices = mesh->model_coefficients.size() / 4;
+    for (size_t s = 0; s < mesh->shapes.size(); ++s)
+        GenerateShapeLods(&mesh->indices, &mesh->shapes[s], mesh->model_coefficients.data(), num_vertices);
+}
+
+void MeshLod_GenerateGpuLods(MeshGpuBuffers* gpu)
+{
+    const size_t num_vertices = gpu->num_vertices;
+
+    std::vector<GLuint> indices(gpu->num_indices);
+    glBindBuffer(GL_COPY_READ_BUFFER, gpu->indices_id);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, indices.size() * sizeof(GLuint), indices.data());
+
+    std::vector<float> positions(4 * num_vertices);
+    glBindBuffer(GL_COPY_READ_BUFFER, gpu->model_coefficients_id);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, positions.size() * sizeof(float), positions.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    for (size_t s = 0; s < gpu->shapes.size(); ++s)
+        GenerateShapeLods(&indices, &gpu->shapes[s], positions.data(), num_vertices);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, gpu->indices_id);
+    glBufferData(GL_COPY_WRITE_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    gpu->num_indices = indices.size();
+}
+
+int MeshLod_SelectLevel(float projected_diameter, size_t num_lods)
+{
+    int   level     = 0;
+    float threshold = MESHLOD_FULL_DETAIL_PIXELS;
+    while ( (size_t)level < num_lods && projected_diameter < threshold )
+    {
+        level += 1;
+        threshold *= 0.5f;
+    }
+    return level;
+}
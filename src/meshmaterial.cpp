@@ -0,0 +1,112 @@
+#include <cassert>
+#include <cstdio>
+#include <vector>
+
+#include "meshmaterial.h"
+
+// Material no formato std140 de "struct Material" em "shader_fragment.glsl":
+// três vec4.
+struct MeshMaterialBlock
+{
+    float diffuse[4];  // Kd (w não é utilizado)
+    float specular[4]; // Ks, com w = q
+    float ambient[4];  // Ka (w não é utilizado)
+};
+
+static_assert(sizeof(MeshMaterialBlock) == 48, "MeshMaterialBlock deve seguir o layout std140");
+
+struct MeshMaterialState
+{
+    GLuint           buffer;
+    std::vector<int> references;     // Referências de cada posição já usada do UBO
+    std::vector<int> free_materials; // Posições sem referências, reutilizadas antes das novas
+    bool             warned;         // Aviso de UBO cheio já impresso
+};
+
+static MeshMaterialState g_MeshMaterial;
+
+void MeshMaterial_Init()
+{
+    glGenBuffers(1, &g_MeshMaterial.buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, g_MeshMaterial.buffer);
+    glBufferData(GL_UNIFORM_BUFFER, MESHMATERIAL_MAX_MATERIALS * sizeof(MeshMaterialBlock), NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, MESHMATERIAL_BINDING, g_MeshMaterial.buffer);
+    g_MeshMaterial.references.clear();
+    g_MeshMaterial.free_materials.clear();
+    g_MeshMaterial.warned = false;
+}
+
+void MeshMaterial_BindProgram(GLuint program_id)
+{
+    GLuint block = glGetUniformBlockIndex(program_id, "MaterialBlock");
+    if ( block != GL_INVALID_INDEX )
+        glUniformBlockBinding(program_id, block, MESHMATERIAL_BINDING);
+}
+
+int MeshMaterial_Add(const MeshMaterial& material)
+{
+    if ( g_MeshMaterial.free_materials.empty() && g_MeshMaterial.references.size() >= MESHMATERIAL_MAX_MATERIALS )
+    {
+        if ( !g_MeshMaterial.warned )
+            fprintf(stderr, "WARNING: More than %d materials; using default colors.\n", MESHMATERIAL_MAX_MATERIALS);
+        g_MeshMaterial.warned = true;
+        return -1;
+    }
+
+    MeshMaterialBlock block;
+    for (int i = 0; i < 3; ++i)
+    {
+        block.diffuse[i]  = material.diffuse[i];
+        block.specular[i] = material.specular[i];
+        block.ambient[i]  = material.ambient[i];
+    }
+    block.diffuse[3]  = 0.0f;
+    block.specular[3] = material.shininess;
+    block.ambient[3]  = 0.0f;
+
+    int index;
+    if ( !g_MeshMaterial.free_materials.empty() )
+    {
+        index = g_MeshMaterial.free_materials.back();
+        g_MeshMaterial.free_materials.pop_back();
+        g_MeshMaterial.references[index] = 1;
+    }
+    else
+    {
+        index = (int)g_MeshMaterial.references.size();
+        g_MeshMaterial.references.push_back(1);
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, g_MeshMaterial.buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, index * sizeof(MeshMaterialBlock), sizeof(MeshMaterialBlock), &block);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    return index;
+}
+
+void MeshMaterial_AddReference(int index)
+{
+    if ( index < 0 )
+        return;
+    assert(g_MeshMaterial.references[index] > 0);
+    g_MeshMaterial.references[index] += 1;
+}
+
+void MeshMaterial_Release(int index)
+{
+    if ( index < 0 )
+        return;
+    assert(g_MeshMaterial.references[index] > 0);
+    if ( --g_MeshMaterial.references[index] == 0 )
+        g_MeshMaterial.free_materials.push_back(index);
+}
+
+void MeshMaterial_Shutdown()
+{
+    if ( g_MeshMaterial.buffer != 0 )
+        glDeleteBuffers(1, &g_MeshMaterial.buffer);
+    g_MeshMaterial.buffer = 0;
+    g_MeshMaterial.references.clear();
+    g_MeshMaterial.free_materials.clear();
+}
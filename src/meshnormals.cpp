@@ -0,0 +1,240 @@
+#include <cassert>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MESHNORMALS_SSE 1
+#endif
+
+#include "meshnormals.h"
+
+// Buffer onde uma thread acumula as normais dos triângulos. As coordenadas
+// ficam em vetores separados (x[], y[] e z[]), para que a normalização possa
+// ler 4 vértices consecutivos com uma única instrução.
+struct NormalSums
+{
+    float* x;
+    float* y;
+    float* z;
+};
+
+// Soma a normal (nx,ny,nz) de um triângulo nos seus três vértices, e faz os
+// índices de normal apontarem para as normais das posições.
+static inline void AccumulateTriangle(tinyobj::index_t* triangle, float nx, float ny, float nz, const NormalSums& sums)
+{
+    for (int vertex = 0; vertex < 3; ++vertex)
+    {
+        int v = triangle[vertex].vertex_index;
+        sums.x[v] += nx;
+        sums.y[v] += ny;
+        sums.z[v] += nz;
+        triangle[vertex].normal_index = v;
+    }
+}
+
+// Acumula as normais de "num_triangles" triângulos consecutivos de uma shape.
+static void AccumulateTriangles(const float* positions, tinyobj::index_t* indices, size_t num_triangles, const NormalSums& sums)
+{
+    size_t triangle = 0;
+
+#ifdef MESHNORMALS_SSE
+    // Quatro triângulos por vez: cada registrador guarda a mesma coordenada
+    // de 4 triângulos diferentes, e o produto vetorial é calculado como no
+    // caso escalar, uma coordenada por instrução.
+    for (; triangle + 4 <= num_triangles; triangle += 4)
+    {
+        float p[3][3][4]; // [vértice][coordenada][triângulo]
+        for (int t = 0; t < 4; ++t)
+        {
+            for (int vertex = 0; vertex < 3; ++vertex)
+            {
+                const float* position = &positions[3*indices[3*(triangle + t) + vertex].vertex_index];
+                p[vertex][0][t] = position[0];
+                p[vertex][1][t] = position[1];
+                p[vertex][2][t] = position[2];
+            }
+        }
+
+        __m128 ax = _mm_loadu_ps(p[0][0]), ay = _mm_loadu_ps(p[0][1]), az = _mm_loadu_ps(p[0][2]);
+        __m128 ux = _mm_sub_ps(_mm_loadu_ps(p[1][0]), ax); // u = b - a
+        __m128 uy = _mm_sub_ps(_mm_loadu_ps(p[1][1]), ay);
+        __m128 uz = _mm_sub_ps(_mm_loadu_ps(p[1][2]), az);
+        __m128 vx = _mm_sub_ps(_mm_loadu_ps(p[2][0]), ax); // v = c - a
+        __m128 vy = _mm_sub_ps(_mm_loadu_ps(p[2][1]), ay);
+        __m128 vz = _mm_sub_ps(_mm_loadu_ps(p[2][2]), az);
+
+        float n[3][4];
+        _mm_storeu_ps(n[0], _mm_sub_ps(_mm_mul_ps(uy, vz), _mm_mul_ps(uz, vy)));
+        _mm_storeu_ps(n[1], _mm_sub_ps(_mm_mul_ps(uz, vx), _mm_mul_ps(ux, vz)));
+        _mm_storeu_ps(n[2], _mm_sub_ps(_mm_mul_ps(ux, vy), _mm_mul_ps(uy, vx)));
+
+        for (int t = 0; t < 4; ++t)
+            AccumulateTriangle(&indices[3*(triangle + t)], n[0][t], n[1][t], n[2][t], sums);
+    }
+#endif
+
+    for (; triangle < num_triangles; ++triangle)
+    {
+        const float* a = &positions[3*indices[3*triangle + 0].vertex_index];
+        const float* b = &positions[3*indices[3*triangle + 1].vertex_index];
+        const float* c = &positions[3*indices[3*triangle + 2].vertex_index];
+
+        float ux = b[0] - a[0], uy = b[1] - a[1], uz = b[2] - a[2];
+        float vx = c[0] - a[0], vy = c[1] - a[1], vz = c[2] - a[2];
+
+        AccumulateTriangle(&indices[3*triangle], uy*vz - uz*vy, uz*vx - ux*vz, ux*vy - uy*vx, sums);
+    }
+}
+
+// Primeira etapa, executada por cada thread: zera o seu buffer e acumula as
+// normais dos triângulos [first_triangle, end_triangle), numerados
+// consecutivamente através de todas as shapes.
+static void AccumulateThread(ObjModel* model, const std::vector<size_t>* shape_offsets,
+                             size_t first_triangle, size_t end_triangle, NormalSums sums)
+{
+    const size_t num_vertices = model->attrib.vertices.size() / 3;
+    std::fill(sums.x, sums.x + num_vertices, 0.0f);
+    std::fill(sums.y, sums.y + num_vertices, 0.0f);
+    std::fill(sums.z, sums.z + num_vertices, 0.0f);
+
+    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
+    {
+        size_t shape_first = (*shape_offsets)[shape];
+        size_t shape_end   = (*shape_offsets)[shape + 1];
+        size_t first = std::max(first_triangle, shape_first);
+        size_t end   = std::min(end_triangle, shape_end);
+        if ( first >= end )
+            continue;
+
+        tinyobj::mesh_t& mesh = model->shapes[shape].mesh;
+        AccumulateTriangles(model->attrib.vertices.data(), &mesh.indices[3*(first - shape_first)], end - first, sums);
+    }
+}
+
+// Segunda etapa, executada por cada thread: soma os buffers de todas as
+// threads para os vértices [first_vertex, end_vertex) e normaliza o
+// resultado.
+static void NormalizeThread(const std::vector<NormalSums>* all_sums, size_t first_vertex, size_t end_vertex, float* normals)
+{
+    const std::vector<NormalSums>& sums = *all_sums;
+    size_t i = first_vertex;
+
+#ifdef MESHNORMALS_SSE
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one  = _mm_set1_ps(1.0f);
+    for (; i + 4 <= end_vertex; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(sums[0].x + i);
+        __m128 y = _mm_loadu_ps(sums[0].y + i);
+        __m128 z = _mm_loadu_ps(sums[0].z + i);
+        for (size_t t = 1; t < sums.size(); ++t)
+        {
+            x = _mm_add_ps(x, _mm_loadu_ps(sums[t].x + i));
+            y = _mm_add_ps(y, _mm_loadu_ps(sums[t].y + i));
+            z = _mm_add_ps(z, _mm_loadu_ps(sums[t].z + i));
+        }
+
+        // Vetores nulos resultam em 1/0 = infinito, que é descartado pela
+        // máscara "length > 0".
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        __m128 scale  = _mm_and_ps(_mm_cmpgt_ps(length, zero), _mm_div_ps(one, length));
+
+        float n[3][4];
+        _mm_storeu_ps(n[0], _mm_mul_ps(x, scale));
+        _mm_storeu_ps(n[1], _mm_mul_ps(y, scale));
+        _mm_storeu_ps(n[2], _mm_mul_ps(z, scale));
+        for (int v = 0; v < 4; ++v)
+        {
+            normals[3*(i + v) + 0] = n[0][v];
+            normals[3*(i + v) + 1] = n[1][v];
+            normals[3*(i + v) + 2] = n[2][v];
+        }
+    }
+#endif
+
+    for (; i < end_vertex; ++i)
+    {
+        float x = 0.0f, y = 0.0f, z = 0.0f;
+        for (size_t t = 0; t < sums.size(); ++t)
+        {
+            x += sums[t].x[i];
+            y += sums[t].y[i];
+            z += sums[t].z[i];
+        }
+
+        float length = std::sqrt(x*x + y*y + z*z);
+        float scale  = (length > 0.0f) ? 1.0f / length : 0.0f;
+        normals[3*i + 0] = x * scale;
+        normals[3*i + 1] = y * scale;
+        normals[3*i + 2] = z * scale;
+    }
+}
+
+// Executa "function" para cada um dos "num_threads" intervalos de
+// [0, count), usando a thread atual para o primeiro. Os intervalos começam em
+// múltiplos de 4, para que os laços SSE trabalhem alinhados aos grupos.
+template <typename Function>
+static void RunInThreads(size_t num_threads, size_t count, Function function)
+{
+    size_t chunk = ((count + num_threads - 1) / num_threads + 3) & ~(size_t)3;
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < num_threads; ++t)
+    {
+        size_t first = std::min(t * chunk, count);
+        size_t end   = std::min(first + chunk, count);
+        threads.push_back(std::thread(function, t, first, end));
+    }
+    function(0, 0, std::min(chunk, count));
+
+    for (size_t t = 0; t < threads.size(); ++t)
+        threads[t].join();
+}
+
+void MeshNormals_Compute(ObjModel* model)
+{
+    if ( !model->attrib.normals.empty() )
+        return;
+
+    const size_t num_vertices = model->attrib.vertices.size() / 3;
+
+    // Numeramos os triângulos de todas as shapes consecutivamente, para
+    // dividi-los igualmente entre as threads.
+    std::vector<size_t> shape_offsets(1, 0);
+    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
+    {
+        const tinyobj::mesh_t& mesh = model->shapes[shape].mesh;
+        for (size_t face = 0; face < mesh.num_face_vertices.size(); ++face)
+            assert(mesh.num_face_vertices[face] == 3);
+        shape_offsets.push_back(shape_offsets.back() + mesh.num_face_vertices.size());
+    }
+    const size_t num_triangles = shape_offsets.back();
+
+    size_t num_threads = std::max((size_t)1, num_triangles / MESHNORMALS_MIN_TRIANGLES_PER_THREAD);
+    num_threads = std::min(num_threads, (size_t)std::max(1u, std::thread::hardware_concurrency()));
+    num_threads = std::min(num_threads, (size_t)MESHNORMALS_MAX_THREADS);
+
+    std::unique_ptr<float[]> buffer(new float[num_threads * 3 * num_vertices]);
+    std::vector<NormalSums> sums(num_threads);
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        sums[t].x = buffer.get() + (3*t + 0) * num_vertices;
+        sums[t].y = buffer.get() + (3*t + 1) * num_vertices;
+        sums[t].z = buffer.get() + (3*t + 2) * num_vertices;
+    }
+
+    RunInThreads(num_threads, num_triangles, [&](size_t t, size_t first, size_t end) {
+        AccumulateThread(model, &shape_offsets, first, end, sums[t]);
+    });
+
+    model->attrib.normals.resize(3*num_vertices);
+    float* normals = model->attrib.normals.data();
+
+    RunInThreads(num_threads, num_vertices, [&](size_t, size_t first, size_t end) {
+        NormalizeThread(&sums, first, end, normals);
+    });
+}
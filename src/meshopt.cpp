@@ -0,0 +1,461 @@
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+#include "meshopt.h"
+
+MeshOptStats MeshOpt_AnalyzeVertexCache(const GLuint* indices, size_t num_indices, size_t num_vertices, unsigned int cache_size)
+{
+    MeshOptStats stats = { 0.0f, 0.0f };
+    if ( num_indices < 3 )
+        return stats;
+
+    // Cada vértice guarda o instante em que entrou no cache. Em um cache FIFO
+    // de tamanho N, ele ainda está no cache se entraram menos de N vértices
+    // desde então.
+    std::vector<unsigned int> cache_time(num_vertices, 0);
+    unsigned int time = cache_size + 1;
+
+    size_t misses = 0;
+    size_t referenced = 0;
+    std::vector<bool> seen(num_vertices, false);
+
+    for (size_t i = 0; i < num_indices; ++i)
+    {
+        GLuint v = indices[i];
+        if ( time - cache_time[v] > cache_size )
+        {
+            cache_time[v] = time++;
+            misses += 1;
+        }
+        if ( !seen[v] )
+        {
+            seen[v] = true;
+            referenced += 1;
+        }
+    }
+
+    stats.acmr = (float)misses / (float)(num_indices / 3);
+    stats.atvr = (float)misses / (float)referenced;
+    return stats;
+}
+
+// Pontuação de um vértice no algoritmo de Forsyth, em função de sua posição
+// no cache LRU (-1 se fora do cache) e do número de triângulos ainda não
+// emitidos que o utilizam.
+static float ForsythVertexScore(int cache_position, unsigned int remaining)
+{
+    const float CACHE_DECAY_POWER   = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    if ( remaining == 0 )
+        return -1.0f; // Nenhum triângulo restante: o vértice não interessa mais
+
+    float score = 0.0f;
+    if ( cache_position >= 0 )
+    {
+        if ( cache_position < 3 )
+        {
+            // Os três vértices do último triângulo recebem uma pontuação fixa,
+            // para não favorecer faixas ("strips") longas e estreitas.
+            score = LAST_TRIANGLE_SCORE;
+        }
+        else
+        {
+            const float scaler = 1.0f / (MESHOPT_FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.0f - (cache_position - 3) * scaler, CACHE_DECAY_POWER);
+        }
+    }
+
+    // Vértices com poucos triângulos restantes são favorecidos, para que sejam
+    // terminados logo e não deixem triângulos isolados para trás.
+    score += VALENCE_BOOST_SCALE * std::pow((float)remaining, -VALENCE_BOOST_POWER);
+    return score;
+}
+
+// Etapa 1: reordena os triângulos de "indices" com o algoritmo de Forsyth.
+void MeshOpt_OptimizeVertexCache(GLuint* indices, size_t num_indices, size_t num_vertices)
+{
+    const size_t num_triangles = num_indices / 3;
+    if ( num_triangles < 2 )
+        return;
+
+    // Lista de triângulos de cada vértice: adjacency[offsets[v] ...
+    // offsets[v] + remaining[v]). Triângulos emitidos são removidos trocando
+    // de lugar com o último da lista.
+    std::vector<unsigned int> remaining(num_vertices, 0);
+    for (size_t i = 0; i < num_indices; ++i)
+        remaining[indices[i]] += 1;
+
+    std::vector<size_t> offsets(num_vertices + 1, 0);
+    for (size_t v = 0; v < num_vertices; ++v)
+        offsets[v+1] = offsets[v] + remaining[v];
+
+    std::vector<GLuint> adjacency(num_indices);
+    {
+        std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < num_indices; ++i)
+            adjacency[fill[indices[i]]++] = i / 3;
+    }
+
+    std::vector<int>   cache_position(num_vertices, -1);
+    std::vector<float> vertex_score(num_vertices);
+    for (size_t v = 0; v < num_vertices; ++v)
+        vertex_score[v] = ForsythVertexScore(-1, remaining[v]);
+
+    std::vector<bool>   emitted(num_triangles, false);
+    std::vector<GLuint> output;
+    output.reserve(num_indices);
+
+    GLuint cache[MESHOPT_FORSYTH_CACHE_SIZE + 3];
+    size_t cache_count = 0;
+
+    size_t next_unemitted = 0; // Cursor usado quando nenhum triângulo do cache é candidato
+    long   best = 0;
+
+    for (size_t emitted_count = 0; emitted_count < num_triangles; ++emitted_count)
+    {
+        if ( best < 0 )
+        {
+            // Beco sem saída: nenhum vértice do cache tem triângulos restantes.
+            while (emitted[next_unemitted])
+                next_unemitted += 1;
+            best = next_unemitted;
+        }
+
+        const GLuint* tri = &indices[3*best];
+        emitted[best] = true;
+        output.push_back(tri[0]);
+        output.push_back(tri[1]);
+        output.push_back(tri[2]);
+
+        // Remove o triângulo das listas de seus vértices.
+        for (int k = 0; k < 3; ++k)
+        {
+            const GLuint v = tri[k];
+            GLuint* list = &adjacency[offsets[v]];
+            for (unsigned int j = 0; j < remaining[v]; ++j)
+            {
+                if ( list[j] == (GLuint)best )
+                {
+                    list[j] = list[remaining[v] - 1];
+                    break;
+                }
+            }
+            remaining[v] -= 1;
+        }
+
+        // Novo cache LRU: os três vértices do triângulo na frente, seguidos
+        // pelos que já estavam no cache.
+        GLuint new_cache[MESHOPT_FORSYTH_CACHE_SIZE + 3];
+        size_t new_count = 0;
+        for (int k = 0; k < 3; ++k)
+            new_cache[new_count++] = tri[k];
+        for (size_t j = 0; j < cache_count; ++j)
+        {
+            const GLuint v = cache[j];
+            if ( v != tri[0] && v != tri[1] && v != tri[2] )
+                new_cache[new_count++] = v;
+        }
+
+        // Atualiza as pontuações dos vértices do cache (inclusive dos que
+        // acabaram de sair dele) e escolhe o melhor triângulo candidato.
+        for (size_t j = 0; j < new_count; ++j)
+        {
+            const GLuint v = new_cache[j];
+            const int position = (j < MESHOPT_FORSYTH_CACHE_SIZE) ? (int)j : -1;
+            cache_position[v] = position;
+            vertex_score[v] = ForsythVertexScore(position, remaining[v]);
+        }
+
+        best = -1;
+        float best_score = -1.0f;
+        cache_count = std::min(new_count, (size_t)MESHOPT_FORSYTH_CACHE_SIZE);
+        for (size_t j = 0; j < cache_count; ++j)
+        {
+            const GLuint v = new_cache[j];
+            cache[j] = v;
+
+            const GLuint* list = &adjacency[offsets[v]];
+            for (unsigned int k = 0; k < remaining[v]; ++k)
+            {
+                const GLuint t = list[k];
+                const float score = vertex_score[indices[3*t + 0]]
+                                  + vertex_score[indices[3*t + 1]]
+                                  + vertex_score[indices[3*t + 2]];
+                if ( score > best_score )
+                {
+                    best_score = score;
+                    best = t;
+                }
+            }
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+// Etapa 2: divide a sequência de triângulos (já otimizada para o cache) em
+// grupos e os ordena de forma que os voltados para fora do modelo sejam
+// desenhados antes. "positions" tem 4 floats por vértice.
+static void OptimizeOverdraw(GLuint* indices, size_t num_indices, const float* positions, size_t num_vertices, float threshold)
+{
+    const size_t num_triangles = num_indices / 3;
+    if ( num_triangles < 2 )
+        return;
+
+    const unsigned int cache_size = MESHOPT_ANALYSIS_CACHE_SIZE;
+    const float target_acmr = threshold * MeshOpt_AnalyzeVertexCache(indices, num_indices, num_vertices, cache_size).acmr;
+
+    // Primeiro definimos os grupos. Um grupo termina quando a simulação do
+    // cache mostra que ele foi "reiniciado" (triângulo com três faltas) ou
+    // quando o ACMR acumulado do grupo já é bom o suficiente; neste caso o
+    // cache simulado é esvaziado, pois o próximo grupo pode ser desenhado em
+    // qualquer outra posição.
+    std::vector<size_t> cluster_starts;
+    std::vector<unsigned int> cache_time(num_vertices, 0);
+    unsigned int time = cache_size + 1;
+    size_t cluster_start = 0;
+    size_t cluster_misses = 0;
+
+    cluster_starts.push_back(0);
+    for (size_t t = 0; t < num_triangles; ++t)
+    {
+        int misses = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            GLuint v = indices[3*t + k];
+            if ( time - cache_time[v] > cache_size )
+            {
+                cache_time[v] = time++;
+                misses += 1;
+            }
+        }
+
+        if ( misses == 3 && t > cluster_start )
+        {
+            cluster_starts.push_back(t);
+            cluster_start = t;
+            cluster_misses = 0;
+        }
+        cluster_misses += misses;
+
+        const size_t cluster_size = t - cluster_start + 1;
+        if ( t + 1 < num_triangles && cluster_misses <= target_acmr * cluster_size )
+        {
+            cluster_starts.push_back(t + 1);
+            cluster_start = t + 1;
+            cluster_misses = 0;
+            time += cache_size + 1; // Esvazia o cache simulado
+        }
+    }
+    cluster_starts.push_back(num_triangles);
+
+    const size_t num_clusters = cluster_starts.size() - 1;
+    if ( num_clusters < 2 )
+        return;
+
+    // Centróide e normal (não normalizada, proporcional à área) de cada
+    // triângulo, acumulados por grupo e para a shape inteira.
+    std::vector<float> cluster_data(6 * num_clusters, 0.0f); // centróide*área (3), normal (3)
+    std::vector<float> cluster_area(num_clusters, 0.0f);
+    float mesh_centroid[3] = { 0.0f, 0.0f, 0.0f };
+    float mesh_area = 0.0f;
+
+    for (size_t c = 0; c < num_clusters; ++c)
+    {
+        for (size_t t = cluster_starts[c]; t < cluster_starts[c+1]; ++t)
+        {
+            const float* a = &positions[4*indices[3*t + 0]];
+            const float* b = &positions[4*indices[3*t + 1]];
+            const float* d = &positions[4*indices[3*t + 2]];
+
+            const float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            const float w[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+            const float n[3] = { u[1]*w[2] - u[2]*w[1],
+                                 u[2]*w[0] - u[0]*w[2],
+                                 u[0]*w[1] - u[1]*w[0] };
+            const float area = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+
+            for (int k = 0; k < 3; ++k)
+            {
+                const float centroid = (a[k] + b[k] + d[k]) / 3.0f;
+                cluster_data[6*c + k]     += centroid * area;
+                cluster_data[6*c + 3 + k] += n[k];
+                mesh_centroid[k]          += centroid * area;
+            }
+            cluster_area[c] += area;
+            mesh_area += area;
+        }
+    }
+
+    if ( mesh_area > 0.0f )
+        for (int k = 0; k < 3; ++k)
+            mesh_centroid[k] /= mesh_area;
+
+    // Grupos cujo centróide está mais "à frente" na direção de sua própria
+    // normal tendem a ocultar os demais, e são desenhados primeiro.
+    std::vector<std::pair<float, size_t> > order(num_clusters);
+    for (size_t c = 0; c < num_clusters; ++c)
+    {
+        const float* data = &cluster_data[6*c];
+        float key = 0.0f;
+        if ( cluster_area[c] > 0.0f )
+        {
+            const float length = std::sqrt(data[3]*data[3] + data[4]*data[4] + data[5]*data[5]);
+            for (int k = 0; k < 3 && length > 0.0f; ++k)
+                key += (data[k] / cluster_area[c] - mesh_centroid[k]) * data[3 + k] / length;
+        }
+        order[c] = std::make_pair(-key, c); // Ordem decrescente de "key"
+    }
+    std::stable_sort(order.begin(), order.end());
+
+    std::vector<GLuint> output;
+    output.reserve(num_indices);
+    for (size_t i = 0; i < num_clusters; ++i)
+    {
+        const size_t c = order[i].second;
+        output.insert(output.end(), indices + 3*cluster_starts[c], indices + 3*cluster_starts[c+1]);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+// Aplica as etapas 1 e 2 em cada shape.
+static void OptimizeShapes(GLuint* indices, const std::vector<MeshShape>& shapes, const float* positions, size_t num_vertices)
+{
+    for (size_t s = 0; s < shapes.size(); ++s)
+    {
+        GLuint* shape_indices = indices + shapes[s].first_index;
+        const size_t count = shapes[s].num_indices - shapes[s].num_indices % 3;
+
+        MeshOpt_OptimizeVertexCache(shape_indices, count, num_vertices);
+        OptimizeOverdraw(shape_indices, count, positions, num_vertices, MESHOPT_OVERDRAW_THRESHOLD);
+    }
+}
+
+// Etapa 3: numera os vértices na ordem em que aparecem nos índices. Retorna
+// o novo número de vértices (vértices não referenciados são descartados) e
+// preenche remap[vértice antigo] = vértice novo.
+static size_t OptimizeVertexFetch(GLuint* indices, size_t num_indices, size_t num_vertices, std::vector<GLuint>* remap)
+{
+    const GLuint UNUSED = 0xFFFFFFFFu;
+    remap->assign(num_vertices, UNUSED);
+
+    GLuint next = 0;
+    for (size_t i = 0; i < num_indices; ++i)
+    {
+        GLuint& r = (*remap)[indices[i]];
+        if ( r == UNUSED )
+            r = next++;
+        indices[i] = r;
+    }
+    return next;
+}
+
+// Reordena um vetor de atributos com "components" floats por vértice.
+static void RemapAttributes(const float* input, size_t num_vertices, int components, const std::vector<GLuint>& remap, size_t new_num_vertices, float* output)
+{
+    for (size_t v = 0; v < num_vertices; ++v)
+    {
+        const GLuint r = remap[v];
+        if ( r < new_num_vertices )
+            std::copy(input + components*v, input + components*(v+1), output + components*r);
+    }
+}
+
+static void RemapVector(std::vector<float>* attributes, size_t num_vertices, int components, const std::vector<GLuint>& remap, size_t new_num_vertices)
+{
+    if ( attributes->empty() )
+        return;
+
+    std::vector<float> output(components * new_num_vertices);
+    RemapAttributes(attributes->data(), num_vertices, components, remap, new_num_vertices, output.data());
+    attributes->swap(output);
+}
+
+void MeshOpt_OptimizeMesh(MeshData* mesh, MeshOptReport* report)
+{
+    const size_t num_vertices = mesh->model_coefficients.size() / 4;
+
+    report->before = MeshOpt_AnalyzeVertexCache(mesh->indices.data(), mesh->indices.size(), num_vertices);
+
+    OptimizeShapes(mesh->indices.data(), mesh->shapes, mesh->model_coefficients.data(), num_vertices);
+
+    std::vector<GLuint> remap;
+    size_t new_num_vertices = OptimizeVertexFetch(mesh->indices.data(), mesh->indices.size(), num_vertices, &remap);
+    RemapVector(&mesh->model_coefficients, num_vertices, 4, remap, new_num_vertices);
+    RemapVector(&mesh->normal_coefficients, num_vertices, 4, remap, new_num_vertices);
+    RemapVector(&mesh->texture_coefficients, num_vertices, 2, remap, new_num_vertices);
+
+    report->after = MeshOpt_AnalyzeVertexCache(mesh->indices.data(), mesh->indices.size(), new_num_vertices);
+}
+
+// Lê um buffer inteiro da GPU.
+template <typename T>
+static void ReadGpuBuffer(GLuint buffer, size_t count, std::vector<T>* data)
+{
+    data->resize(count);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, count * sizeof(T), data->data());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+// Substitui o conteúdo (e possivelmente o tamanho) de um buffer da GPU.
+template <typename T>
+static void WriteGpuBuffer(GLuint buffer, const std::vector<T>& data)
+{
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, data.size() * sizeof(T), data.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+// Reordena um buffer de atributos da GPU. Apenas um atributo por vez é
+// copiado para a memória principal.
+static void RemapGpuBuffer(GLuint buffer, size_t num_vertices, int components, const std::vector<GLuint>& remap, size_t new_num_vertices)
+{
+    if ( buffer == 0 )
+        return;
+
+    std::vector<float> input;
+    ReadGpuBuffer(buffer, components * num_vertices, &input);
+    std::vector<float> output(components * new_num_vertices);
+    RemapAttributes(input.data(), num_vertices, components, remap, new_num_vertices, output.data());
+    std::vector<float>().swap(input);
+    WriteGpuBuffer(buffer, output);
+}
+
+void MeshOpt_OptimizeGpuMesh(MeshGpuBuffers* gpu, MeshOptReport* report)
+{
+    const size_t num_vertices = gpu->num_vertices;
+
+    std::vector<GLuint> indices;
+    ReadGpuBuffer(gpu->indices_id, gpu->num_indices, &indices);
+
+    report->before = MeshOpt_AnalyzeVertexCache(indices.data(), indices.size(), num_vertices);
+
+    {
+        std::vector<float> positions;
+        ReadGpuBuffer(gpu->model_coefficients_id, 4 * num_vertices, &positions);
+        OptimizeShapes(indices.data(), gpu->shapes, positions.data(), num_vertices);
+    }
+
+    std::vector<GLuint> remap;
+    size_t new_num_vertices = OptimizeVertexFetch(indices.data(), indices.size(), num_vertices, &remap);
+    WriteGpuBuffer(gpu->indices_id, indices);
+
+    report->after = MeshOpt_AnalyzeVertexCache(indices.data(), indices.size(), new_num_vertices);
+    std::vector<GLuint>().swap(indices);
+
+    RemapGpuBuffer(gpu->model_coefficients_id, num_vertices, 4, remap, new_num_vertices);
+    RemapGpuBuffer(gpu->normal_coefficients_id, num_vertices, 4, remap, new_num_vertices);
+    RemapGpuBuffer(gpu->texture_coefficients_id, num_vertices, 2, remap, new_num_vertices);
+    gpu->num_vertices = new_num_vertices;
+}
+
+void MeshOpt_PrintReport(const MeshOptReport& report)
+{
+    printf("Otimizando malha... ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (cache FIFO de %d vértices).\n",
+           report.before.acmr, report.after.acmr, report.before.atvr, report.after.atvr, MESHOPT_ANALYSIS_CACHE_SIZE);
+}
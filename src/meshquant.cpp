@@ -0,0 +1,403 @@
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include <stdint.h>
+
+#include "meshquant.h"
+
+// Converte um float para half float (IEEE 754 binary16), arredondando para o
+// mais próximo. Valores grandes demais viram infinito.
+static uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign     = (bits >> 16) & 0x8000u;
+    const int      exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t       mantissa = bits & 0x7FFFFFu;
+
+    if ( ((bits >> 23) & 0xFF) == 0xFF )
+        return (uint16_t)(sign | 0x7C00u | (mantissa ? 0x200u : 0)); // Infinito ou NaN
+
+    if ( exponent >= 31 )
+        return (uint16_t)(sign | 0x7C00u); // Infinito
+
+    if ( exponent <= 0 )
+    {
+        // Número subnormal em half float (ou zero).
+        if ( exponent < -10 )
+            return (uint16_t)sign;
+        mantissa |= 0x800000u;
+        const int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if ( rest > halfway || (rest == halfway && (half & 1)) )
+            half += 1;
+        return (uint16_t)(sign | half);
+    }
+
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+    const uint32_t rest = mantissa & 0x1FFFu;
+    if ( rest > 0x1000u || (rest == 0x1000u && (half & 1)) )
+        half += 1; // Pode propagar para o expoente, o que também é correto
+    return (uint16_t)(sign | half);
+}
+
+static float HalfToFloat(uint16_t half)
+{
+    const uint32_t sign     = (uint32_t)(half & 0x8000u) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1F;
+    const uint32_t mantissa = half & 0x3FFu;
+
+    uint32_t bits;
+    if ( exponent == 0 )
+    {
+        // Zero ou subnormal: mantissa * 2^-24.
+        float value = (float)mantissa * (1.0f / 16777216.0f);
+        return sign ? -value : value;
+    }
+    else if ( exponent == 31 )
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    else
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Define position_scale e position_offset a partir da caixa envolvente das
+// posições (4 floats por vértice).
+static void ChoosePositionTransform(const float* positions, size_t num_vertices, MeshVertexFormat* format)
+{
+    float minimum[3] = { 0.0f, 0.0f, 0.0f };
+    float maximum[3] = { 0.0f, 0.0f, 0.0f };
+    if ( num_vertices > 0 )
+    {
+        for (int k = 0; k < 3; ++k)
+            minimum[k] = maximum[k] = positions[k];
+    }
+
+    for (size_t v = 1; v < num_vertices; ++v)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            minimum[k] = std::min(minimum[k], positions[4*v + k]);
+            maximum[k] = std::max(maximum[k], positions[4*v + k]);
+        }
+    }
+
+    format->position_type = GL_UNSIGNED_SHORT;
+    for (int k = 0; k < 3; ++k)
+    {
+        format->position_scale[k]  = maximum[k] - minimum[k];
+        format->position_offset[k] = minimum[k];
+    }
+}
+
+// Verifica se todas as coordenadas de textura podem ser representadas como
+// half float com erro de no máximo MESHQUANT_MAX_TEXTURE_ERROR.
+static bool TextureFitsHalf(const float* texture_coefficients, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float value = texture_coefficients[i];
+        if ( std::fabs(HalfToFloat(FloatToHalf(value)) - value) > MESHQUANT_MAX_TEXTURE_ERROR )
+            return false;
+    }
+    return true;
+}
+
+static GLenum ChooseIndexType(size_t num_vertices)
+{
+    return (num_vertices <= 65536) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+// Define stride e deslocamentos do VBO intercalado a partir dos tipos já
+// escolhidos. Todos os deslocamentos são múltiplos de 4 bytes.
+static void ChooseLayout(bool has_normals, bool has_texture_coefficients, MeshVertexFormat* format)
+{
+    int offset = 4 * sizeof(uint16_t); // Posição
+
+    format->normal_offset = -1;
+    if ( has_normals )
+    {
+        format->normal_offset = offset;
+        offset += sizeof(uint32_t);
+    }
+
+    format->texture_offset = -1;
+    if ( has_texture_coefficients )
+    {
+        format->texture_offset = offset;
+        offset += (format->texture_type == GL_HALF_FLOAT) ? 2 * sizeof(uint16_t) : 2 * sizeof(float);
+    }
+
+    format->stride = offset;
+}
+
+MeshVertexFormat MeshQuant_ChooseFormat(const MeshBuffers& buffers)
+{
+    MeshVertexFormat format;
+    const size_t num_vertices = buffers.num_model_coefficients / 4;
+    const bool has_normals = buffers.num_normal_coefficients > 0;
+    const bool has_texture = buffers.num_texture_coefficients > 0;
+
+    ChoosePositionTransform(buffers.model_coefficients, num_vertices, &format);
+
+    if ( has_normals )
+        format.normal_type = GL_INT_2_10_10_10_REV;
+
+    if ( has_texture && TextureFitsHalf(buffers.texture_coefficients, buffers.num_texture_coefficients) )
+        format.texture_type = GL_HALF_FLOAT;
+
+    format.index_type = ChooseIndexType(num_vertices);
+    ChooseLayout(has_normals, has_texture, &format);
+    return format;
+}
+
+// Funções de conversão de cada atributo para o formato compacto. Todas
+// escrevem no vetor intercalado "vertices", que tem format.stride bytes por
+// vértice.
+
+static void EncodePositions(const float* positions, size_t num_vertices, const MeshVertexFormat& format, unsigned char* vertices)
+{
+    float inverse_scale[3];
+    for (int k = 0; k < 3; ++k)
+        inverse_scale[k] = (format.position_scale[k] > 0.0f) ? 65535.0f / format.position_scale[k] : 0.0f;
+
+    for (size_t v = 0; v < num_vertices; ++v)
+    {
+        uint16_t encoded[4] = { 0, 0, 0, 0 };
+        for (int k = 0; k < 3; ++k)
+        {
+            float q = (positions[4*v + k] - format.position_offset[k]) * inverse_scale[k];
+            q = std::min(std::max(q, 0.0f), 65535.0f);
+            encoded[k] = (uint16_t)(q + 0.5f);
+        }
+        memcpy(vertices + v*format.stride, encoded, sizeof(encoded));
+    }
+}
+
+static void EncodeNormals(const float* normals, size_t num_vertices, const MeshVertexFormat& format, unsigned char* vertices)
+{
+    for (size_t v = 0; v < num_vertices; ++v)
+    {
+        uint32_t packed = 0; // O componente w (2 bits) fica zero
+        for (int k = 0; k < 3; ++k)
+        {
+            const float n = std::min(std::max(normals[4*v + k], -1.0f), 1.0f);
+            const int   q = (int)std::floor(n * 511.0f + 0.5f);
+            packed |= ((uint32_t)q & 0x3FFu) << (10 * k);
+        }
+        memcpy(vertices + v*format.stride + format.normal_offset, &packed, sizeof(packed));
+    }
+}
+
+static void EncodeTexture(const float* texture_coefficients, size_t num_vertices, const MeshVertexFormat& format, unsigned char* vertices)
+{
+    for (size_t v = 0; v < num_vertices; ++v)
+    {
+        unsigned char* destination = vertices + v*format.stride + format.texture_offset;
+        if ( format.texture_type == GL_HALF_FLOAT )
+        {
+            const uint16_t encoded[2] = { FloatToHalf(texture_coefficients[2*v + 0]), FloatToHalf(texture_coefficients[2*v + 1]) };
+            memcpy(destination, encoded, sizeof(encoded));
+        }
+        else
+        {
+            memcpy(destination, &texture_coefficients[2*v], 2 * sizeof(float));
+        }
+    }
+}
+
+static void EncodeIndices(const GLuint* indices, size_t num_indices, std::vector<uint16_t>* output)
+{
+    output->resize(num_indices);
+    for (size_t i = 0; i < num_indices; ++i)
+        (*output)[i] = (uint16_t)indices[i];
+}
+
+// Substitui o conteúdo de "*buffer_id" (criando o buffer, se necessário).
+static void WriteGpuBuffer(GLuint* buffer_id, const void* data, size_t size)
+{
+    if ( *buffer_id == 0 )
+        glGenBuffers(1, buffer_id);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, *buffer_id);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, data, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+template <typename T>
+static void WriteGpuBuffer(GLuint* buffer_id, const std::vector<T>& data)
+{
+    WriteGpuBuffer(buffer_id, data.data(), data.size() * sizeof(T));
+}
+
+template <typename T>
+static void ReadGpuBuffer(GLuint buffer, size_t count, std::vector<T>* data)
+{
+    data->resize(count);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, count * sizeof(T), data->data());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+static void DeleteGpuBuffer(GLuint* buffer_id)
+{
+    if ( *buffer_id != 0 )
+        glDeleteBuffers(1, buffer_id);
+    *buffer_id = 0;
+}
+
+void MeshQuant_EncodeMesh(const MeshBuffers& buffers, MeshEncodedData* encoded)
+{
+    const size_t num_vertices = buffers.num_model_coefficients / 4;
+    const MeshVertexFormat format = MeshQuant_ChooseFormat(buffers);
+
+    encoded->num_vertices = num_vertices;
+    encoded->num_indices  = buffers.num_indices;
+    encoded->shapes       = buffers.shapes;
+    encoded->materials    = buffers.materials;
+    encoded->format       = format;
+
+    encoded->vertices.assign(num_vertices * format.stride, 0);
+    EncodePositions(buffers.model_coefficients, num_vertices, format, encoded->vertices.data());
+    if ( format.normal_offset >= 0 )
+        EncodeNormals(buffers.normal_coefficients, num_vertices, format, encoded->vertices.data());
+    if ( format.texture_offset >= 0 )
+        EncodeTexture(buffers.texture_coefficients, num_vertices, format, encoded->vertices.data());
+
+    const size_t index_size = MeshQuant_IndexSize(format.index_type);
+    encoded->indices.resize(buffers.num_indices * index_size);
+    if ( format.index_type == GL_UNSIGNED_SHORT )
+    {
+        std::vector<uint16_t> shorts;
+        EncodeIndices(buffers.indices, buffers.num_indices, &shorts);
+        memcpy(encoded->indices.data(), shorts.data(), encoded->indices.size());
+    }
+    else if ( buffers.num_indices > 0 )
+    {
+        memcpy(encoded->indices.data(), buffers.indices, encoded->indices.size());
+    }
+}
+
+void MeshQuant_CreateGpuBuffers(const MeshEncodedData& encoded, MeshGpuBuffers* gpu)
+{
+    *gpu = MeshGpuBuffers();
+    gpu->num_vertices = encoded.num_vertices;
+    gpu->num_indices  = encoded.num_indices;
+    gpu->shapes       = encoded.shapes;
+    gpu->materials    = encoded.materials;
+    gpu->format       = encoded.format;
+
+    WriteGpuBuffer(&gpu->vertices_id, NULL, encoded.vertices.size());
+    WriteGpuBuffer(&gpu->indices_id, NULL, encoded.indices.size());
+}
+
+void MeshQuant_UploadEncoded(const MeshEncodedData& encoded, MeshGpuBuffers* gpu)
+{
+    *gpu = MeshGpuBuffers();
+    gpu->num_vertices = encoded.num_vertices;
+    gpu->num_indices  = encoded.num_indices;
+    gpu->shapes       = encoded.shapes;
+    gpu->materials    = encoded.materials;
+    gpu->format       = encoded.format;
+
+    WriteGpuBuffer(&gpu->vertices_id, encoded.vertices);
+    WriteGpuBuffer(&gpu->indices_id, encoded.indices);
+}
+
+void MeshQuant_UploadMeshBuffers(const MeshBuffers& buffers, MeshGpuBuffers* gpu)
+{
+    MeshEncodedData encoded;
+    MeshQuant_EncodeMesh(buffers, &encoded);
+    MeshQuant_UploadEncoded(encoded, gpu);
+}
+
+void MeshQuant_QuantizeGpuMesh(MeshGpuBuffers* gpu)
+{
+    const size_t num_vertices = gpu->num_vertices;
+    const bool has_normals = gpu->normal_coefficients_id != 0;
+    const bool has_texture = gpu->texture_coefficients_id != 0;
+    MeshVertexFormat format;
+
+    // Posições e coordenadas de textura são lidas antes de definir o
+    // formato; as normais, depois. Cada atributo em float é descartado da
+    // GPU assim que é convertido.
+    std::vector<float> positions;
+    ReadGpuBuffer(gpu->model_coefficients_id, 4 * num_vertices, &positions);
+    DeleteGpuBuffer(&gpu->model_coefficients_id);
+    ChoosePositionTransform(positions.data(), num_vertices, &format);
+
+    std::vector<float> texture_coefficients;
+    if ( has_texture )
+    {
+        ReadGpuBuffer(gpu->texture_coefficients_id, 2 * num_vertices, &texture_coefficients);
+        DeleteGpuBuffer(&gpu->texture_coefficients_id);
+        if ( TextureFitsHalf(texture_coefficients.data(), texture_coefficients.size()) )
+            format.texture_type = GL_HALF_FLOAT;
+    }
+
+    if ( has_normals )
+        format.normal_type = GL_INT_2_10_10_10_REV;
+    format.index_type = ChooseIndexType(num_vertices);
+    ChooseLayout(has_normals, has_texture, &format);
+
+    std::vector<unsigned char> vertices(num_vertices * format.stride);
+    EncodePositions(positions.data(), num_vertices, format, vertices.data());
+    std::vector<float>().swap(positions);
+
+    if ( has_texture )
+    {
+        EncodeTexture(texture_coefficients.data(), num_vertices, format, vertices.data());
+        std::vector<float>().swap(texture_coefficients);
+    }
+
+    if ( has_normals )
+    {
+        std::vector<float> normals;
+        ReadGpuBuffer(gpu->normal_coefficients_id, 4 * num_vertices, &normals);
+        DeleteGpuBuffer(&gpu->normal_coefficients_id);
+        EncodeNormals(normals.data(), num_vertices, format, vertices.data());
+    }
+
+    WriteGpuBuffer(&gpu->vertices_id, vertices);
+
+    if ( format.index_type == GL_UNSIGNED_SHORT )
+    {
+        std::vector<GLuint> indices;
+        ReadGpuBuffer(gpu->indices_id, gpu->num_indices, &indices);
+        std::vector<uint16_t> shorts;
+        EncodeIndices(indices.data(), indices.size(), &shorts);
+        WriteGpuBuffer(&gpu->indices_id, shorts);
+    }
+
+    gpu->format = format;
+}
+
+size_t MeshQuant_IndexSize(GLenum index_type)
+{
+    return (index_type == GL_UNSIGNED_SHORT) ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+void MeshQuant_PrintFormat(const MeshGpuBuffers& gpu)
+{
+    // Tamanho no formato de MeshData: 4 floats por posição e normal, 2 por
+    // coordenada de textura e índices de 32 bits.
+    size_t float_vertex_size = 4 * sizeof(float);
+    if ( gpu.format.normal_offset >= 0 )
+        float_vertex_size += 4 * sizeof(float);
+    if ( gpu.format.texture_offset >= 0 )
+        float_vertex_size += 2 * sizeof(float);
+
+    const size_t before = gpu.num_vertices * float_vertex_size + gpu.num_indices * sizeof(GLuint);
+    const size_t after  = gpu.num_vertices * gpu.format.stride + gpu.num_indices * MeshQuant_IndexSize(gpu.format.index_type);
+
+    printf("Formato compacto: %d bytes por vértice, índices de %zu bits, %.1f KB -> %.1f KB.\n",
+           (int)gpu.format.stride, 8 * MeshQuant_IndexSize(gpu.format.index_type),
+           before / 1024.0, after / 1024.0);
+}
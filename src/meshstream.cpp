@@ -0,0 +1,557 @@
+#include <cstdio>
+#include <stdint.h>
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include <tiny_obj_loader.h>
+
+#include "meshstream.h"
+
+// Buffer da GPU que cresce conforme os blocos de dados chegam. Quando a
+// capacidade acaba, um buffer maior é criado e o conteúdo antigo é copiado
+// dentro da própria GPU com glCopyBufferSubData().
+struct StreamBuffer
+{
+    GLuint id;
+    size_t capacity; // Bytes alocados na GPU
+    size_t size;     // Bytes já enviados
+};
+
+// Entrada da tabela hash de vértices já emitidos. Como não guardamos os
+// atributos dos vértices emitidos em memória principal (eles já estão na
+// GPU), a tabela é indexada pelos índices do arquivo e não pelos valores dos
+// atributos, como em BuildMeshData().
+struct WeldEntry
+{
+    int    v, vt, vn; // Índices (a partir de 0) da posição, textura e normal
+    GLuint id;        // Vértice emitido, ou WELD_EMPTY
+};
+
+static const GLuint WELD_EMPTY = 0xFFFFFFFFu;
+
+// Estado do carregamento, passado como "user_data" para os callbacks da
+// tinyobjloader.
+struct MeshStreamBuilder
+{
+    // Atributos lidos do arquivo ("v", "vn" e "vt").
+    std::vector<float> vertices;  // 3 floats por posição
+    std::vector<float> normals;   // 3 floats por normal
+    std::vector<float> texcoords; // 2 floats por coordenada de textura
+
+    // Se o arquivo não tem normais (decidido na primeira face), somamos as
+    // normais das faces em cada posição e guardamos a posição de cada vértice
+    // emitido; o buffer de normais é enviado ao final.
+    bool                first_face;
+    bool                compute_normals;
+    std::vector<float>  normal_sums;       // 3 floats por posição
+    std::vector<GLuint> normal_positions;  // Posição de cada vértice emitido
+
+    // Vértices emitidos que ainda não foram enviados para a GPU, no formato
+    // de MeshData.
+    std::vector<float> model_staging;
+    std::vector<float> normal_staging;
+    std::vector<float> texture_staging;
+    size_t             staged_vertices;
+    size_t             flushed_vertices;
+    bool               has_normals;   // Alguma face tem normais
+    bool               has_texcoords; // Alguma face tem coordenadas de textura
+
+    StreamBuffer model;
+    StreamBuffer normal;
+    StreamBuffer texture;
+    StreamBuffer indices;
+    std::vector<GLuint> index_staging;
+    size_t              flushed_indices;
+
+    // Vértices já emitidos, indexados pela tupla de índices do arquivo
+    // (posição, textura, normal), para que cada tupla seja enviada uma única
+    // vez (veja BuildMeshData()).
+    std::vector<WeldEntry> weld_table;
+    size_t                 weld_count;
+
+    // Shape atual. Como em tinyobj::LoadObj(), uma nova shape começa a cada
+    // linha "g" ou "o"; além disso, cada linha "usemtl" termina a shape
+    // atual e começa outra com o mesmo nome e o novo material, já que cada
+    // MeshShape tem um único material (veja BuildMeshData()).
+    std::string            name;
+    int                    material;
+    size_t                 shape_first_index;
+    std::vector<MeshShape> shapes;
+    std::vector<MeshMaterial> materials;
+
+    std::string error;
+};
+
+static void ResizeStreamBuffer(StreamBuffer* buffer, size_t capacity)
+{
+    GLuint id = 0;
+    if ( capacity > 0 )
+    {
+        glGenBuffers(1, &id);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity, NULL, GL_STATIC_DRAW);
+
+        if ( buffer->size > 0 )
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer->id);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, buffer->size);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    if ( buffer->id != 0 )
+        glDeleteBuffers(1, &buffer->id);
+
+    buffer->id       = id;
+    buffer->capacity = capacity;
+}
+
+// Acrescenta "bytes" bytes ao final do buffer. Se "data" for NULL, escreve
+// zeros.
+static void AppendToStreamBuffer(StreamBuffer* buffer, const void* data, size_t bytes)
+{
+    if ( bytes == 0 )
+        return;
+
+    if ( buffer->size + bytes > buffer->capacity )
+    {
+        // Crescimento geométrico (1.5x), para que o número de cópias seja
+        // logarítmico no tamanho final.
+        size_t capacity = buffer->capacity + buffer->capacity / 2;
+        capacity = std::max(capacity, buffer->size + bytes);
+        capacity = std::max(capacity, (size_t)(1024*1024));
+        ResizeStreamBuffer(buffer, capacity);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer->id);
+    if ( data != NULL )
+    {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, buffer->size, bytes, data);
+    }
+    else
+    {
+        static const std::vector<unsigned char> zeros(64*1024, 0);
+        for (size_t offset = 0; offset < bytes; offset += zeros.size())
+            glBufferSubData(GL_COPY_WRITE_BUFFER, buffer->size + offset, std::min(zeros.size(), bytes - offset), zeros.data());
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    buffer->size += bytes;
+}
+
+// Libera a capacidade que sobrou ao final do carregamento.
+static void TrimStreamBuffer(StreamBuffer* buffer)
+{
+    if ( buffer->capacity != buffer->size )
+        ResizeStreamBuffer(buffer, buffer->size);
+}
+
+// Envia para a GPU todos os vértices acumulados.
+static void FlushStaging(MeshStreamBuilder* b)
+{
+    if ( b->staged_vertices == 0 )
+        return;
+
+    AppendToStreamBuffer(&b->model, b->model_staging.data(), b->model_staging.size() * sizeof(float));
+    AppendToStreamBuffer(&b->normal, b->normal_staging.data(), b->normal_staging.size() * sizeof(float));
+    AppendToStreamBuffer(&b->texture, b->texture_staging.data(), b->texture_staging.size() * sizeof(float));
+
+    b->flushed_vertices += b->staged_vertices;
+    b->staged_vertices = 0;
+    b->model_staging.clear();
+    b->normal_staging.clear();
+    b->texture_staging.clear();
+}
+
+// Envia para a GPU todos os índices acumulados.
+static void FlushIndices(MeshStreamBuilder* b)
+{
+    AppendToStreamBuffer(&b->indices, b->index_staging.data(), b->index_staging.size() * sizeof(GLuint));
+    b->flushed_indices += b->index_staging.size();
+    b->index_staging.clear();
+}
+
+static size_t HashIndexTuple(int v, int vt, int vn)
+{
+    uint32_t h = (uint32_t)v * 0x9E3779B1u;
+    h ^= (uint32_t)vt * 0x85EBCA77u + (h << 6) + (h >> 2);
+    h ^= (uint32_t)vn * 0xC2B2AE3Du + (h << 6) + (h >> 2);
+    h ^= h >> 15;
+    return h;
+}
+
+// Retorna a entrada da tabela correspondente à tupla (v, vt, vn): a entrada
+// já existente, ou a posição vazia onde ela deve ser inserida.
+static WeldEntry* FindWeldEntry(std::vector<WeldEntry>& table, int v, int vt, int vn)
+{
+    const size_t mask = table.size() - 1;
+    size_t slot = HashIndexTuple(v, vt, vn) & mask;
+    while (table[slot].id != WELD_EMPTY)
+    {
+        const WeldEntry& e = table[slot];
+        if ( e.v == v && e.vt == vt && e.vn == vn )
+            break;
+        slot = (slot + 1) & mask;
+    }
+    return &table[slot];
+}
+
+// Dobra o tamanho da tabela quando ela passa de metade ocupada.
+static void GrowWeldTable(MeshStreamBuilder* b)
+{
+    if ( 2*(b->weld_count + 1) <= b->weld_table.size() )
+        return;
+
+    const WeldEntry empty = { 0, 0, 0, WELD_EMPTY };
+    std::vector<WeldEntry> table(std::max((size_t)1024, 2*b->weld_table.size()), empty);
+    for (size_t i = 0; i < b->weld_table.size(); ++i)
+    {
+        const WeldEntry& e = b->weld_table[i];
+        if ( e.id != WELD_EMPTY )
+            *FindWeldEntry(table, e.v, e.vt, e.vn) = e;
+    }
+    b->weld_table.swap(table);
+}
+
+// Converte um índice do arquivo (1 em diante, negativo = relativo, 0 =
+// ausente) para a posição no vetor de atributos. Retorna -1 se o índice não
+// existir.
+static int ResolveIndex(int idx, size_t count)
+{
+    int i = (idx > 0) ? idx - 1 : (idx < 0) ? (int)count + idx : -1;
+    return (i >= 0 && (size_t)i < count) ? i : -1;
+}
+
+// Emite um novo vértice com a posição "v", a normal "n" e a coordenada de
+// textura "t" (-1 se ausentes) e retorna seu índice.
+static GLuint EmitVertex(MeshStreamBuilder* b, int v, int n, int t)
+{
+    if ( b->staged_vertices == MESHSTREAM_STAGING_VERTICES )
+        FlushStaging(b);
+
+    b->model_staging.push_back( b->vertices[3*v + 0] ); // X
+    b->model_staging.push_back( b->vertices[3*v + 1] ); // Y
+    b->model_staging.push_back( b->vertices[3*v + 2] ); // Z
+    b->model_staging.push_back( 1.0f ); // W
+
+    if ( b->compute_normals )
+    {
+        b->normal_positions.push_back(v);
+    }
+    else
+    {
+        if ( n != -1 && !b->has_normals )
+        {
+            // Primeiro vértice com normal: os anteriores recebem normal nula.
+            b->has_normals = true;
+            AppendToStreamBuffer(&b->normal, NULL, b->flushed_vertices * 4 * sizeof(float));
+            b->normal_staging.assign(b->staged_vertices * 4, 0.0f);
+        }
+        if ( b->has_normals )
+        {
+            b->normal_staging.push_back( n != -1 ? b->normals[3*n + 0] : 0.0f ); // X
+            b->normal_staging.push_back( n != -1 ? b->normals[3*n + 1] : 0.0f ); // Y
+            b->normal_staging.push_back( n != -1 ? b->normals[3*n + 2] : 0.0f ); // Z
+            b->normal_staging.push_back( 0.0f ); // W
+        }
+    }
+
+    if ( t != -1 && !b->has_texcoords )
+    {
+        b->has_texcoords = true;
+        AppendToStreamBuffer(&b->texture, NULL, b->flushed_vertices * 2 * sizeof(float));
+        b->texture_staging.assign(b->staged_vertices * 2, 0.0f);
+    }
+    if ( b->has_texcoords )
+    {
+        b->texture_staging.push_back( t != -1 ? b->texcoords[2*t + 0] : 0.0f ); // U
+        b->texture_staging.push_back( t != -1 ? b->texcoords[2*t + 1] : 0.0f ); // V
+    }
+
+    b->staged_vertices += 1;
+    return b->flushed_vertices + b->staged_vertices - 1;
+}
+
+// Adiciona o índice de um canto de triângulo, emitindo um novo vértice apenas
+// se a mesma tupla de índices ainda não apareceu.
+static void EmitCorner(MeshStreamBuilder* b, int v, const tinyobj::index_t& idx)
+{
+    int n = b->compute_normals ? -1 : ResolveIndex(idx.normal_index, b->normals.size() / 3);
+    int t = ResolveIndex(idx.texcoord_index, b->texcoords.size() / 2);
+
+    GrowWeldTable(b);
+    WeldEntry* entry = FindWeldEntry(b->weld_table, v, t, n);
+    if ( entry->id == WELD_EMPTY )
+    {
+        entry->v  = v;
+        entry->vt = t;
+        entry->vn = n;
+        entry->id = EmitVertex(b, v, n, t);
+        b->weld_count += 1;
+    }
+
+    b->index_staging.push_back(entry->id);
+    if ( b->index_staging.size() == 3*MESHSTREAM_STAGING_VERTICES )
+        FlushIndices(b);
+}
+
+static void EmitTriangle(MeshStreamBuilder* b, const tinyobj::index_t& i0, const tinyobj::index_t& i1, const tinyobj::index_t& i2)
+{
+    const size_t num_positions = b->vertices.size() / 3;
+    const int v[3] = { ResolveIndex(i0.vertex_index, num_positions),
+                       ResolveIndex(i1.vertex_index, num_positions),
+                       ResolveIndex(i2.vertex_index, num_positions) };
+
+    if ( v[0] == -1 || v[1] == -1 || v[2] == -1 )
+    {
+        // As faces só podem referenciar posições já lidas, pois os vértices
+        // são emitidos à medida que as faces aparecem.
+        b->error = "Face references a vertex that was not defined before it.";
+        return;
+    }
+
+    if ( b->compute_normals )
+    {
+        // Mesmo cálculo de MeshNormals_Compute(): produto vetorial (b - a) x (c - a)
+        // somado em cada posição. A normalização é feita ao final.
+        const float* a = &b->vertices[3*v[0]];
+        const float* p = &b->vertices[3*v[1]];
+        const float* c = &b->vertices[3*v[2]];
+        const float u[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+        const float w[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        const float n[3] = { u[1]*w[2] - u[2]*w[1],
+                             u[2]*w[0] - u[0]*w[2],
+                             u[0]*w[1] - u[1]*w[0] };
+
+        if ( b->normal_sums.size() < b->vertices.size() )
+            b->normal_sums.resize(b->vertices.size(), 0.0f);
+
+        for (int i = 0; i < 3; ++i)
+        {
+            b->normal_sums[3*v[i] + 0] += n[0];
+            b->normal_sums[3*v[i] + 1] += n[1];
+            b->normal_sums[3*v[i] + 2] += n[2];
+        }
+    }
+
+    EmitCorner(b, v[0], i0);
+    EmitCorner(b, v[1], i1);
+    EmitCorner(b, v[2], i2);
+}
+
+// Termina a shape atual, caso ela tenha algum triângulo.
+static void FinishShape(MeshStreamBuilder* b)
+{
+    const size_t num_indices = b->flushed_indices + b->index_staging.size();
+    if ( num_indices == b->shape_first_index )
+        return;
+
+    MeshShape theshape;
+    theshape.name           = b->name;
+    theshape.first_index    = b->shape_first_index;
+    theshape.num_indices    = num_indices - b->shape_first_index;
+    theshape.rendering_mode = GL_TRIANGLES;
+    theshape.material       = b->material;
+    b->shapes.push_back(theshape);
+
+    b->shape_first_index = num_indices;
+}
+
+static void VertexCallback(void* user_data, float x, float y, float z, float w)
+{
+    MeshStreamBuilder* b = static_cast<MeshStreamBuilder*>(user_data);
+    b->vertices.push_back(x);
+    b->vertices.push_back(y);
+    b->vertices.push_back(z);
+}
+
+static void NormalCallback(void* user_data, float x, float y, float z)
+{
+    MeshStreamBuilder* b = static_cast<MeshStreamBuilder*>(user_data);
+    b->normals.push_back(x);
+    b->normals.push_back(y);
+    b->normals.push_back(z);
+}
+
+static void TexcoordCallback(void* user_data, float x, float y, float z)
+{
+    MeshStreamBuilder* b = static_cast<MeshStreamBuilder*>(user_data);
+    b->texcoords.push_back(x);
+    b->texcoords.push_back(y);
+}
+
+static void IndexCallback(void* user_data, tinyobj::index_t* indices, int num_indices)
+{
+    MeshStreamBuilder* b = static_cast<MeshStreamBuilder*>(user_data);
+    if ( !b->error.empty() )
+        return;
+
+    if ( b->first_face )
+    {
+        // Assim como MeshNormals_Compute(), calculamos as normais apenas se o
+        // arquivo não define nenhuma.
+        b->first_face = false;
+        b->compute_normals = b->normals.empty();
+    }
+
+    // Triangulação em leque, igual à de tinyobj::LoadObj().
+    for (int k = 2; k < num_indices && b->error.empty(); ++k)
+        EmitTriangle(b, indices[0], indices[k-1], indices[k]);
+}
+
+static void GroupCallback(void* user_data, const char** names, int num_names)
+{
+    MeshStreamBuilder* b = static_cast<MeshStreamBuilder*>(user_data);
+    FinishShape(b);
+    b->name = (num_names > 0) ? names[0] : "";
+}
+
+static void ObjectCallback(void* user_data, const char* name)
+{
+    MeshStreamBuilder* b = static_cast<MeshStreamBuilder*>(user_data);
+    FinishShape(b);
+    b->name = name;
+}
+
+static void UsemtlCallback(void* user_data, const char* name, int material_id)
+{
+    MeshStreamBuilder* b = static_cast<MeshStreamBuilder*>(user_data);
+    FinishShape(b);
+    b->material = (material_id >= 0 && (size_t)material_id < b->materials.size()) ? material_id : -1;
+}
+
+static void MtllibCallback(void* user_data, const tinyobj::material_t* materials, int num_materials)
+{
+    MeshStreamBuilder* b = static_cast<MeshStreamBuilder*>(user_data);
+    BuildMeshMaterials(std::vector<tinyobj::material_t>(materials, materials + num_materials), &b->materials);
+}
+
+// Envia o buffer de normais calculadas a partir das somas de normais das
+// faces, em blocos de MESHSTREAM_STAGING_VERTICES vértices.
+static void UploadComputedNormals(MeshStreamBuilder* b)
+{
+    for (size_t i = 0; i + 2 < b->normal_sums.size(); i += 3)
+    {
+        float* n = &b->normal_sums[i];
+        float length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if ( length > 0.0f )
+        {
+            n[0] /= length;
+            n[1] /= length;
+            n[2] /= length;
+        }
+    }
+
+    const size_t num_vertices = b->normal_positions.size();
+    for (size_t first = 0; first < num_vertices; first += MESHSTREAM_STAGING_VERTICES)
+    {
+        size_t last = std::min(first + MESHSTREAM_STAGING_VERTICES, num_vertices);
+
+        b->normal_staging.clear();
+        for (size_t i = first; i < last; ++i)
+        {
+            const float* n = &b->normal_sums[3*b->normal_positions[i]];
+            b->normal_staging.push_back( n[0] ); // X
+            b->normal_staging.push_back( n[1] ); // Y
+            b->normal_staging.push_back( n[2] ); // Z
+            b->normal_staging.push_back( 0.0f ); // W
+        }
+        AppendToStreamBuffer(&b->normal, b->normal_staging.data(), b->normal_staging.size() * sizeof(float));
+    }
+
+    b->has_normals = num_vertices > 0;
+}
+
+void MeshStream_LoadObj(const char* filename, MeshGpuBuffers* gpu)
+{
+    printf("Carregando modelo \"%s\" (streaming)... ", filename);
+    fflush(stdout);
+
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    if ( !file )
+    {
+        fprintf(stderr, "\nCannot open file [%s]\n", filename);
+        throw std::runtime_error("Erro ao carregar modelo.");
+    }
+
+    MeshStreamBuilder b;
+    b.first_face        = true;
+    b.compute_normals   = false;
+    b.staged_vertices   = 0;
+    b.flushed_vertices  = 0;
+    b.flushed_indices   = 0;
+    b.weld_count        = 0;
+    b.has_normals       = false;
+    b.has_texcoords     = false;
+    b.model             = StreamBuffer();
+    b.normal            = StreamBuffer();
+    b.texture           = StreamBuffer();
+    b.indices           = StreamBuffer();
+    b.material          = -1;
+    b.shape_first_index = 0;
+
+    b.model_staging.reserve(4 * MESHSTREAM_STAGING_VERTICES);
+
+    tinyobj::callback_t callback;
+    callback.vertex_cb   = VertexCallback;
+    callback.normal_cb   = NormalCallback;
+    callback.texcoord_cb = TexcoordCallback;
+    callback.index_cb    = IndexCallback;
+    callback.group_cb    = GroupCallback;
+    callback.object_cb   = ObjectCallback;
+    callback.usemtl_cb   = UsemtlCallback;
+    callback.mtllib_cb   = MtllibCallback;
+
+    // Os arquivos ".mtl" são procurados no diretório do ".obj", como em ObjModel.
+    tinyobj::MaterialFileReader material_reader(MeshDirectory(filename));
+
+    std::string err;
+    bool ret = tinyobj::LoadObjWithCallback(file, callback, &b, &material_reader, &err);
+
+    if ( !err.empty() )
+        fprintf(stderr, "\n%s\n", err.c_str());
+
+    if ( !ret || !b.error.empty() )
+    {
+        if ( !b.error.empty() )
+            fprintf(stderr, "\n%s\n", b.error.c_str());
+
+        ResizeStreamBuffer(&b.model, 0);
+        ResizeStreamBuffer(&b.normal, 0);
+        ResizeStreamBuffer(&b.texture, 0);
+        ResizeStreamBuffer(&b.indices, 0);
+        throw std::runtime_error("Erro ao carregar modelo.");
+    }
+
+    FinishShape(&b);
+    FlushStaging(&b);
+    FlushIndices(&b);
+
+    // Os atributos do arquivo e a tabela de vértices não são mais necessários.
+    std::vector<WeldEntry>().swap(b.weld_table);
+    std::vector<float>().swap(b.vertices);
+    std::vector<float>().swap(b.normals);
+    std::vector<float>().swap(b.texcoords);
+
+    if ( b.compute_normals )
+        UploadComputedNormals(&b);
+
+    TrimStreamBuffer(&b.model);
+    TrimStreamBuffer(&b.normal);
+    TrimStreamBuffer(&b.texture);
+    TrimStreamBuffer(&b.indices);
+
+    gpu->model_coefficients_id   = b.model.id;
+    gpu->normal_coefficients_id  = b.normal.id;
+    gpu->texture_coefficients_id = b.texture.id;
+    gpu->indices_id              = b.indices.id;
+    gpu->num_vertices            = b.flushed_vertices;
+    gpu->num_indices             = b.flushed_indices;
+    gpu->shapes.swap(b.shapes);
+    gpu->materials.swap(b.materials);
+
+    printf("OK.\n");
+}
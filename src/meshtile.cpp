@@ -0,0 +1,866 @@
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <cfloat>
+#include <map>
+#include <mutex>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <tiny_obj_loader.h>
+
+#include "meshtile.h"
+#include "meshnormals.h"
+#include "mappedfile.h"
+
+struct MeshTileHeader
+{
+    char     magic[8];     // "FCGTILE"
+    uint32_t version;      // MESHTILE_VERSION
+    uint32_t header_size;  // sizeof(MeshTileHeader)
+    uint64_t path_hash;    // Hash do caminho do ".obj"
+    uint64_t source_size;  // Tamanho do ".obj" em bytes
+    int64_t  source_mtime; // Data de modificação do ".obj" ao gravar o índice, que também a recebe
+    uint64_t source_hash;  // Hash do conteúdo do ".obj"
+    uint64_t num_tiles;    // Número de MeshTileInfo após o cabeçalho
+    uint64_t reserved;     // Mantém o cabeçalho com tamanho múltiplo de 16 bytes
+};
+
+static const char MESHTILE_MAGIC[8] = "FCGTILE";
+
+static_assert(sizeof(MeshTileHeader) % 16 == 0, "MeshTileHeader deve ser alinhado");
+static_assert(sizeof(MeshTileInfo) == 32, "MeshTileInfo é gravado diretamente no índice");
+
+// Triângulo guardado no arquivo temporário da segunda leitura: apenas os
+// índices (a partir de 0, ou -1 se ausentes) dos atributos de cada canto.
+struct MeshTileTriangle
+{
+    int32_t group;    // Posição do nome da shape em MeshTileSorter::group_names
+    int32_t material; // Material do "usemtl" atual, ou -1
+    int32_t v[3];
+    int32_t vt[3];
+    int32_t vn[3];
+};
+
+// Bloco de triângulos de um único tile no arquivo temporário.
+struct MeshTileChunk
+{
+    uint64_t offset; // Posição do bloco, em bytes
+    size_t   count;  // Número de triângulos
+};
+
+// Número de floats acumulados antes de cada escrita nos arquivos temporários.
+static const size_t STAGING_FLOATS = 3*65536;
+
+// Estado do módulo: apenas uma divisão em tiles é executada por vez, para
+// que o uso de memória não seja multiplicado pelo número de threads de
+// trabalho de "assetloader.h".
+struct MeshTileState
+{
+    std::mutex build_mutex;
+};
+
+static MeshTileState g_MeshTile;
+
+static uint64_t HashString(const char* str)
+{
+    return HashBytes(str, strlen(str));
+}
+
+// Computa o hash do conteúdo de um arquivo. Retorna false se o arquivo não
+// puder ser lido.
+static bool HashFileContents(const char* filename, uint64_t* hash)
+{
+    MappedFile source;
+    if ( !MapFile(filename, &source) )
+        return false;
+
+    *hash = HashBytes(source.data, source.size);
+    UnmapFile(&source);
+    return true;
+}
+
+std::string MeshTile_IndexPath(const char* source_filename)
+{
+    return std::string(source_filename) + ".tiles";
+}
+
+std::string MeshTile_TilePath(const char* source_filename, size_t tile)
+{
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".tile%zu.meshcache", tile);
+    return std::string(source_filename) + suffix;
+}
+
+// Converte um índice do arquivo (1 em diante, negativo = relativo, 0 =
+// ausente) para a posição no vetor de atributos. Retorna -1 se o índice não
+// existir (como em "meshstream.cpp").
+static int ResolveIndex(int idx, uint64_t count)
+{
+    int64_t i = (idx > 0) ? (int64_t)idx - 1 : (idx < 0) ? (int64_t)count + idx : -1;
+    return (i >= 0 && (uint64_t)i < count) ? (int)i : -1;
+}
+
+// Arquivo temporário de floats escrito sequencialmente, em blocos de
+// STAGING_FLOATS floats.
+struct TempFloatFile
+{
+    std::string        path;
+    FILE*              file;
+    std::vector<float> staging;
+    bool               ok;
+};
+
+static void OpenTempFloatFile(TempFloatFile* f, const std::string& path)
+{
+    f->path = path;
+    f->file = fopen(path.c_str(), "wb");
+    f->ok   = f->file != NULL;
+    f->staging.reserve(STAGING_FLOATS);
+}
+
+static void FlushTempFloatFile(TempFloatFile* f)
+{
+    if ( f->ok && !f->staging.empty() )
+        f->ok = fwrite(f->staging.data(), sizeof(float), f->staging.size(), f->file) == f->staging.size();
+    f->staging.clear();
+}
+
+static void AppendFloats(TempFloatFile* f, const float* values, int count)
+{
+    f->staging.insert(f->staging.end(), values, values + count);
+    if ( f->staging.size() >= STAGING_FLOATS )
+        FlushTempFloatFile(f);
+}
+
+// Termina a escrita. Retorna false se houve algum erro.
+static bool CloseTempFloatFile(TempFloatFile* f)
+{
+    FlushTempFloatFile(f);
+    if ( f->file != NULL )
+        f->ok = (fclose(f->file) == 0) && f->ok;
+    f->file = NULL;
+    std::vector<float>().swap(f->staging);
+    return f->ok;
+}
+
+// Primeira leitura: copia os atributos para arquivos temporários.
+struct MeshTileScanner
+{
+    TempFloatFile vertices;  // 3 floats por posição
+    TempFloatFile normals;   // 3 floats por normal
+    TempFloatFile texcoords; // 2 floats por coordenada de textura
+    uint64_t      num_vertices;
+    uint64_t      num_normals;
+    uint64_t      num_texcoords;
+    uint64_t      num_triangles;
+    float         bounds_min[3];
+    float         bounds_max[3];
+    std::vector<tinyobj::material_t> materials;
+};
+
+static void ScanVertexCallback(void* user_data, float x, float y, float z, float w)
+{
+    MeshTileScanner* s = static_cast<MeshTileScanner*>(user_data);
+    const float p[3] = { x, y, z };
+    AppendFloats(&s->vertices, p, 3);
+    for (int i = 0; i < 3; ++i)
+    {
+        s->bounds_min[i] = std::min(s->bounds_min[i], p[i]);
+        s->bounds_max[i] = std::max(s->bounds_max[i], p[i]);
+    }
+    s->num_vertices += 1;
+}
+
+static void ScanNormalCallback(void* user_data, float x, float y, float z)
+{
+    MeshTileScanner* s = static_cast<MeshTileScanner*>(user_data);
+    const float n[3] = { x, y, z };
+    AppendFloats(&s->normals, n, 3);
+    s->num_normals += 1;
+}
+
+static void ScanTexcoordCallback(void* user_data, float x, float y, float z)
+{
+    MeshTileScanner* s = static_cast<MeshTileScanner*>(user_data);
+    const float t[2] = { x, y };
+    AppendFloats(&s->texcoords, t, 2);
+    s->num_texcoords += 1;
+}
+
+static void ScanIndexCallback(void* user_data, tinyobj::index_t* indices, int num_indices)
+{
+    MeshTileScanner* s = static_cast<MeshTileScanner*>(user_data);
+    if ( num_indices >= 3 )
+        s->num_triangles += num_indices - 2;
+}
+
+static void ScanMtllibCallback(void* user_data, const tinyobj::material_t* materials, int num_materials)
+{
+    MeshTileScanner* s = static_cast<MeshTileScanner*>(user_data);
+    s->materials.assign(materials, materials + num_materials);
+}
+
+// Grade uniforme sobre a caixa envolvente das posições. Cada célula pertence
+// a uma região (tile) da divisão.
+struct MeshTileGrid
+{
+    float bounds_min[3];
+    float inv_cell_size[3]; // 0 nos eixos em que a caixa não tem espessura
+    int   dims[3];
+    std::vector<uint32_t> counts;      // Número de posições em cada célula
+    std::vector<int32_t>  cell_region; // Região de cada célula
+};
+
+static size_t CellIndex(const MeshTileGrid& grid, const float* p)
+{
+    int c[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        float f = (p[i] - grid.bounds_min[i]) * grid.inv_cell_size[i];
+        c[i] = (f > 0.0f) ? std::min((int)f, grid.dims[i] - 1) : 0;
+    }
+    return ((size_t)c[2] * grid.dims[1] + c[1]) * grid.dims[0] + c[0];
+}
+
+static void BuildGrid(const MeshTileScanner& scan, const float* positions, MeshTileGrid* grid)
+{
+    float extent[3];
+    float longest = 0.0f;
+    for (int i = 0; i < 3; ++i)
+    {
+        grid->bounds_min[i] = scan.bounds_min[i];
+        extent[i] = scan.bounds_max[i] - scan.bounds_min[i];
+        longest = std::max(longest, extent[i]);
+    }
+
+    // Células aproximadamente cúbicas: MESHTILE_GRID_SIZE células no eixo
+    // mais longo e proporcionalmente menos nos demais.
+    for (int i = 0; i < 3; ++i)
+    {
+        int dims = (longest > 0.0f) ? (int)(MESHTILE_GRID_SIZE * extent[i] / longest + 0.5f) : 1;
+        grid->dims[i] = std::max(1, std::min(dims, MESHTILE_GRID_SIZE));
+        grid->inv_cell_size[i] = (extent[i] > 0.0f) ? grid->dims[i] / extent[i] : 0.0f;
+    }
+
+    grid->counts.assign((size_t)grid->dims[0] * grid->dims[1] * grid->dims[2], 0);
+    for (uint64_t v = 0; v < scan.num_vertices; ++v)
+        grid->counts[CellIndex(*grid, &positions[3*v])] += 1;
+}
+
+// Conjunto de células [lo, hi) em cada eixo.
+struct MeshTileRegion
+{
+    int lo[3];
+    int hi[3];
+};
+
+// Divide "region" na mediana do eixo mais longo (em células) até que cada
+// parte tenha no máximo "max_vertices" posições, ou uma única célula, e
+// atribui um número de região a cada célula de cada parte.
+static void SplitRegion(MeshTileGrid* grid, const MeshTileRegion& region, uint64_t max_vertices, int* num_regions)
+{
+    const int* dims = grid->dims;
+
+    uint64_t total = 0;
+    for (int z = region.lo[2]; z < region.hi[2]; ++z)
+        for (int y = region.lo[1]; y < region.hi[1]; ++y)
+            for (int x = region.lo[0]; x < region.hi[0]; ++x)
+                total += grid->counts[((size_t)z * dims[1] + y) * dims[0] + x];
+
+    int axis = 0;
+    for (int i = 1; i < 3; ++i)
+        if ( region.hi[i] - region.lo[i] > region.hi[axis] - region.lo[axis] )
+            axis = i;
+
+    if ( total <= max_vertices || region.hi[axis] - region.lo[axis] == 1 )
+    {
+        const int id = (*num_regions)++;
+        for (int z = region.lo[2]; z < region.hi[2]; ++z)
+            for (int y = region.lo[1]; y < region.hi[1]; ++y)
+                for (int x = region.lo[0]; x < region.hi[0]; ++x)
+                    grid->cell_region[((size_t)z * dims[1] + y) * dims[0] + x] = id;
+        return;
+    }
+
+    // Número de posições em cada fatia perpendicular ao eixo escolhido.
+    std::vector<uint64_t> slabs(region.hi[axis] - region.lo[axis], 0);
+    for (int z = region.lo[2]; z < region.hi[2]; ++z)
+        for (int y = region.lo[1]; y < region.hi[1]; ++y)
+            for (int x = region.lo[0]; x < region.hi[0]; ++x)
+            {
+                const int c[3] = { x, y, z };
+                slabs[c[axis] - region.lo[axis]] += grid->counts[((size_t)z * dims[1] + y) * dims[0] + x];
+            }
+
+    int split = region.lo[axis] + 1;
+    uint64_t below = slabs[0];
+    while (split < region.hi[axis] - 1 && 2*below < total)
+        below += slabs[split++ - region.lo[axis]];
+
+    MeshTileRegion low = region, high = region;
+    low.hi[axis]  = split;
+    high.lo[axis] = split;
+    SplitRegion(grid, low, max_vertices, num_regions);
+    SplitRegion(grid, high, max_vertices, num_regions);
+}
+
+// Segunda leitura: distribui os triângulos entre as regiões.
+struct MeshTileSorter
+{
+    const float*        positions; // Posições da primeira leitura (mapeadas)
+    const MeshTileGrid* grid;
+    uint64_t            num_vertices; // Atributos já lidos nesta leitura
+    uint64_t            num_normals;
+    uint64_t            num_texcoords;
+
+    // Shape atual, como em MeshStream_LoadObj().
+    int32_t                    group;
+    int32_t                    material;
+    std::map<std::string, int> group_ids;
+    std::vector<std::string>   group_names;
+
+    // Triângulos de cada região ainda não escritos no arquivo temporário.
+    std::vector< std::vector<MeshTileTriangle> > pending;
+    size_t                     num_pending;
+    size_t                     max_pending;
+
+    FILE*                      file;
+    uint64_t                   file_size;
+    bool                       ok;
+    std::vector< std::vector<MeshTileChunk> > chunks; // Blocos de cada região
+    std::vector<uint64_t>      region_triangles;
+
+    std::string error;
+};
+
+// Escreve os triângulos pendentes de todas as regiões, um bloco por região.
+static void FlushPendingTriangles(MeshTileSorter* s)
+{
+    for (size_t r = 0; r < s->pending.size(); ++r)
+    {
+        std::vector<MeshTileTriangle>& triangles = s->pending[r];
+        if ( triangles.empty() )
+            continue;
+
+        if ( s->ok )
+            s->ok = fwrite(triangles.data(), sizeof(MeshTileTriangle), triangles.size(), s->file) == triangles.size();
+
+        MeshTileChunk chunk = { s->file_size, triangles.size() };
+        s->chunks[r].push_back(chunk);
+        s->file_size += triangles.size() * sizeof(MeshTileTriangle);
+
+        // Liberamos a memória (clear() manteria a capacidade de cada região).
+        std::vector<MeshTileTriangle>().swap(triangles);
+    }
+    s->num_pending = 0;
+}
+
+static void AddTriangle(MeshTileSorter* s, const tinyobj::index_t& i0, const tinyobj::index_t& i1, const tinyobj::index_t& i2)
+{
+    const tinyobj::index_t* corners[3] = { &i0, &i1, &i2 };
+
+    MeshTileTriangle triangle;
+    triangle.group    = s->group;
+    triangle.material = s->material;
+
+    float centroid[3] = { 0.0f, 0.0f, 0.0f };
+    for (int k = 0; k < 3; ++k)
+    {
+        triangle.v[k]  = ResolveIndex(corners[k]->vertex_index, s->num_vertices);
+        triangle.vt[k] = ResolveIndex(corners[k]->texcoord_index, s->num_texcoords);
+        triangle.vn[k] = ResolveIndex(corners[k]->normal_index, s->num_normals);
+        if ( triangle.v[k] == -1 )
+        {
+            s->error = "Face references a vertex that was not defined before it.";
+            return;
+        }
+
+        for (int i = 0; i < 3; ++i)
+            centroid[i] += s->positions[3*(size_t)triangle.v[k] + i] / 3.0f;
+    }
+
+    const int region = s->grid->cell_region[CellIndex(*s->grid, centroid)];
+    s->pending[region].push_back(triangle);
+    s->region_triangles[region] += 1;
+
+    if ( ++s->num_pending == s->max_pending )
+        FlushPendingTriangles(s);
+}
+
+static void SortVertexCallback(void* user_data, float x, float y, float z, float w)
+{
+    static_cast<MeshTileSorter*>(user_data)->num_vertices += 1;
+}
+
+static void SortNormalCallback(void* user_data, float x, float y, float z)
+{
+    static_cast<MeshTileSorter*>(user_data)->num_normals += 1;
+}
+
+static void SortTexcoordCallback(void* user_data, float x, float y, float z)
+{
+    static_cast<MeshTileSorter*>(user_data)->num_texcoords += 1;
+}
+
+static void SortIndexCallback(void* user_data, tinyobj::index_t* indices, int num_indices)
+{
+    MeshTileSorter* s = static_cast<MeshTileSorter*>(user_data);
+
+    // Triangulação em leque, igual à de tinyobj::LoadObj().
+    for (int k = 2; k < num_indices && s->error.empty(); ++k)
+        AddTriangle(s, indices[0], indices[k-1], indices[k]);
+}
+
+static void SetGroup(MeshTileSorter* s, const std::string& name)
+{
+    std::map<std::string, int>::const_iterator it = s->group_ids.find(name);
+    if ( it != s->group_ids.end() )
+    {
+        s->group = it->second;
+        return;
+    }
+
+    s->group = s->group_names.size();
+    s->group_ids[name] = s->group;
+    s->group_names.push_back(name);
+}
+
+static void SortGroupCallback(void* user_data, const char** names, int num_names)
+{
+    SetGroup(static_cast<MeshTileSorter*>(user_data), (num_names > 0) ? names[0] : "");
+}
+
+static void SortObjectCallback(void* user_data, const char* name)
+{
+    SetGroup(static_cast<MeshTileSorter*>(user_data), name);
+}
+
+static void SortUsemtlCallback(void* user_data, const char* name, int material_id)
+{
+    static_cast<MeshTileSorter*>(user_data)->material = material_id;
+}
+
+// Lê "filename" com LoadObjWithCallback(). Lança std::runtime_error em caso
+// de erro.
+static void ReadObj(const char* filename, const tinyobj::callback_t& callback, void* user_data)
+{
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    if ( !file )
+        throw std::runtime_error("Cannot open file");
+
+    tinyobj::MaterialFileReader material_reader(MeshDirectory(filename));
+
+    std::string err;
+    bool ret = tinyobj::LoadObjWithCallback(file, callback, user_data, &material_reader, &err);
+
+    if ( !err.empty() )
+        fprintf(stderr, "\n%s\n", err.c_str());
+
+    if ( !ret )
+        throw std::runtime_error("Erro ao carregar modelo.");
+}
+
+// Retorna a posição local do atributo "global" (de "components" floats em
+// "source"), acrescentando-o a "attributes" na primeira vez em que aparece.
+static int LocalAttribute(std::unordered_map<int32_t, int>* locals, int32_t global, const float* source, int components,
+                          std::vector<float>* attributes)
+{
+    if ( global == -1 )
+        return -1;
+
+    std::unordered_map<int32_t, int>::const_iterator it = locals->find(global);
+    if ( it != locals->end() )
+        return it->second;
+
+    int local = attributes->size() / components;
+    attributes->insert(attributes->end(), source + (size_t)components * global, source + (size_t)components * (global + 1));
+    (*locals)[global] = local;
+    return local;
+}
+
+// Monta o ObjModel de uma região a partir dos seus blocos de triângulos.
+// Cada nome de shape recebe o sufixo "#<tile>", para que os tiles sejam
+// objetos distintos em g_VirtualScene.
+static void BuildTileModel(const MeshTileSorter& sorter, const std::vector<MeshTileChunk>& chunks, const unsigned char* triangles,
+                           const float* vertices, const float* normals, const float* texcoords, size_t tile, ObjModel* model)
+{
+    std::unordered_map<int32_t, int> local_vertices, local_normals, local_texcoords;
+    std::vector<int> group_shapes(sorter.group_names.size() + 1, -1);
+
+    for (size_t c = 0; c < chunks.size(); ++c)
+    {
+        const MeshTileTriangle* chunk = reinterpret_cast<const MeshTileTriangle*>(triangles + chunks[c].offset);
+        for (size_t t = 0; t < chunks[c].count; ++t)
+        {
+            const MeshTileTriangle& triangle = chunk[t];
+
+            // Faces anteriores à primeira linha "g" ou "o" (group == -1)
+            // ficam na shape sem nome, como em tinyobj::LoadObj().
+            int& shape = group_shapes[triangle.group + 1];
+            if ( shape == -1 )
+            {
+                shape = model->shapes.size();
+                model->shapes.push_back(tinyobj::shape_t());
+                std::string name = (triangle.group >= 0) ? sorter.group_names[triangle.group] : std::string();
+                model->shapes.back().name = name + "#" + std::to_string(tile);
+            }
+
+            tinyobj::mesh_t& mesh = model->shapes[shape].mesh;
+            for (int k = 0; k < 3; ++k)
+            {
+                tinyobj::index_t idx;
+                idx.vertex_index   = LocalAttribute(&local_vertices, triangle.v[k], vertices, 3, &model->attrib.vertices);
+                idx.normal_index   = LocalAttribute(&local_normals, triangle.vn[k], normals, 3, &model->attrib.normals);
+                idx.texcoord_index = LocalAttribute(&local_texcoords, triangle.vt[k], texcoords, 2, &model->attrib.texcoords);
+                mesh.indices.push_back(idx);
+            }
+            mesh.num_face_vertices.push_back(3);
+            mesh.material_ids.push_back(triangle.material);
+        }
+    }
+}
+
+// Grava o índice de tiles, em um arquivo temporário renomeado ao final, como
+// em MeshCache_Store().
+static bool StoreIndex(const char* source_filename, const FileStamp& stamp, const MeshTileIndex& index)
+{
+    MeshTileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESHTILE_MAGIC, sizeof(MESHTILE_MAGIC));
+    header.version      = MESHTILE_VERSION;
+    header.header_size  = sizeof(MeshTileHeader);
+    header.path_hash    = HashString(source_filename);
+    header.source_size  = stamp.size;
+    header.source_mtime = stamp.mtime;
+    header.source_hash  = index.source_hash;
+    header.num_tiles    = index.tiles.size();
+
+    std::string index_path = MeshTile_IndexPath(source_filename);
+    std::string temp_path  = index_path + ".tmp";
+
+    FILE* f = fopen(temp_path.c_str(), "wb");
+    if ( f == NULL )
+        return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = ok && (index.tiles.empty() || fwrite(index.tiles.data(), sizeof(MeshTileInfo), index.tiles.size(), f) == index.tiles.size());
+    ok = (fclose(f) == 0) && ok;
+    ok = ok && SetFileMtime(temp_path.c_str(), stamp.mtime);
+
+    if ( ok )
+    {
+        remove(index_path.c_str()); // rename() não sobrescreve arquivos no Windows
+        ok = rename(temp_path.c_str(), index_path.c_str()) == 0;
+    }
+
+    if ( !ok )
+        remove(temp_path.c_str());
+
+    return ok;
+}
+
+bool MeshTile_LoadIndex(const char* source_filename, MeshTileIndex* index)
+{
+    FileStamp stamp;
+    if ( !GetFileStamp(source_filename, &stamp) )
+        return false;
+
+    std::string index_path = MeshTile_IndexPath(source_filename);
+    MappedFile file;
+    if ( !MapFile(index_path.c_str(), &file) )
+        return false;
+
+    const MeshTileHeader* header = reinterpret_cast<const MeshTileHeader*>(file.data);
+    bool ok =    file.size >= sizeof(MeshTileHeader)
+              && memcmp(header->magic, MESHTILE_MAGIC, sizeof(MESHTILE_MAGIC)) == 0
+              && header->version     == MESHTILE_VERSION
+              && header->header_size == sizeof(MeshTileHeader)
+              && header->num_tiles   == (file.size - sizeof(MeshTileHeader)) / sizeof(MeshTileInfo)
+              && file.size           == sizeof(MeshTileHeader) + header->num_tiles * sizeof(MeshTileInfo)
+              && header->path_hash   == HashString(source_filename)
+              && header->source_size == stamp.size;
+
+    // O índice tem a data de modificação do ".obj" (veja StoreIndex()). Se
+    // as datas diferem, conferimos o conteúdo do ".obj" e atualizamos a data
+    // do índice, como em MeshCache_Load().
+    FileStamp index_stamp;
+    bool update_mtime = false;
+    if ( ok && (!GetFileStamp(index_path.c_str(), &index_stamp) || index_stamp.mtime != stamp.mtime) )
+    {
+        uint64_t hash;
+        ok = HashFileContents(source_filename, &hash) && hash == header->source_hash;
+        update_mtime = ok;
+    }
+
+    if ( ok )
+    {
+        const MeshTileInfo* tiles = reinterpret_cast<const MeshTileInfo*>(file.data + sizeof(MeshTileHeader));
+        index->source_hash = header->source_hash;
+        index->tiles.assign(tiles, tiles + header->num_tiles);
+    }
+    UnmapFile(&file);
+
+    if ( update_mtime )
+        SetFileMtime(index_path.c_str(), stamp.mtime);
+
+    return ok;
+}
+
+bool MeshTile_LoadTile(const char* source_filename, size_t tile, MeshCacheEntry* entry)
+{
+    MeshTileIndex index;
+    if ( !MeshTile_LoadIndex(source_filename, &index) || tile >= index.tiles.size() )
+        return false;
+
+    return MeshCache_LoadTile(MeshTile_TilePath(source_filename, tile).c_str(), index.source_hash, entry);
+}
+
+// Arquivos temporários de uma divisão em tiles: posições, normais,
+// coordenadas de textura e triângulos.
+struct MeshTileTempFiles
+{
+    std::string paths[4];
+    MappedFile  mapped[4];
+
+    MeshTileTempFiles()
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            mapped[i].data   = NULL;
+            mapped[i].size   = 0;
+            mapped[i].handle = NULL;
+        }
+    }
+};
+
+static void RemoveTempFiles(MeshTileTempFiles* temp)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        UnmapFile(&temp->mapped[i]);
+        if ( !temp->paths[i].empty() )
+            remove(temp->paths[i].c_str());
+    }
+}
+
+// Mapeia um arquivo temporário já completo.
+static void MapTempFile(const std::string& path, MappedFile* file)
+{
+    if ( !MapFile(path.c_str(), file) )
+        throw std::runtime_error("Cannot map temporary file \"" + path + "\"");
+}
+
+static void BuildTiles(const char* filename, size_t memory_budget, void (*process)(MeshData* mesh), MeshTileTempFiles* temp,
+                       MeshTileIndex* index)
+{
+    // Primeira leitura: atributos para os arquivos temporários.
+    const std::string temp_prefix = MeshTile_IndexPath(filename);
+    MeshTileScanner scan;
+    OpenTempFloatFile(&scan.vertices, temp_prefix + ".v.tmp");
+    OpenTempFloatFile(&scan.normals, temp_prefix + ".vn.tmp");
+    OpenTempFloatFile(&scan.texcoords, temp_prefix + ".vt.tmp");
+    scan.num_vertices  = 0;
+    scan.num_normals   = 0;
+    scan.num_texcoords = 0;
+    scan.num_triangles = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        scan.bounds_min[i] = FLT_MAX;
+        scan.bounds_max[i] = -FLT_MAX;
+    }
+    temp->paths[0] = scan.vertices.path;
+    temp->paths[1] = scan.normals.path;
+    temp->paths[2] = scan.texcoords.path;
+
+    tinyobj::callback_t scan_callback;
+    scan_callback.vertex_cb   = ScanVertexCallback;
+    scan_callback.normal_cb   = ScanNormalCallback;
+    scan_callback.texcoord_cb = ScanTexcoordCallback;
+    scan_callback.index_cb    = ScanIndexCallback;
+    scan_callback.mtllib_cb   = ScanMtllibCallback;
+    try
+    {
+        ReadObj(filename, scan_callback, &scan);
+    }
+    catch ( const std::exception& )
+    {
+        CloseTempFloatFile(&scan.vertices);
+        CloseTempFloatFile(&scan.normals);
+        CloseTempFloatFile(&scan.texcoords);
+        throw;
+    }
+
+    bool written = CloseTempFloatFile(&scan.vertices);
+    written = CloseTempFloatFile(&scan.normals) && written;
+    written = CloseTempFloatFile(&scan.texcoords) && written;
+    if ( !written )
+        throw std::runtime_error("Cannot write temporary files next to \"" + std::string(filename) + "\"");
+    if ( scan.num_triangles == 0 || scan.num_vertices > (uint64_t)INT32_MAX )
+        throw std::runtime_error("Modelo sem triângulos ou com vértices demais.");
+
+    for (int i = 0; i < 3; ++i)
+        MapTempFile(temp->paths[i], &temp->mapped[i]);
+    const float* positions = reinterpret_cast<const float*>(temp->mapped[0].data);
+
+    // Divisão da caixa envolvente. Metade do orçamento fica para o
+    // processamento de cada tile e um quarto para os triângulos pendentes da
+    // segunda leitura; como o histograma conta posições, estimamos o número
+    // de triângulos de cada região pela razão triângulos/posições do modelo.
+    const uint64_t max_tile_triangles = std::max((uint64_t)1, (uint64_t)(memory_budget / 2 / MESHTILE_BYTES_PER_TRIANGLE));
+    const double   triangles_per_vertex = (double)scan.num_triangles / std::max((uint64_t)1, scan.num_vertices);
+    const uint64_t max_vertices = std::max((uint64_t)1, (uint64_t)(max_tile_triangles / triangles_per_vertex));
+
+    MeshTileGrid grid;
+    BuildGrid(scan, positions, &grid);
+    grid.cell_region.assign(grid.counts.size(), 0);
+
+    MeshTileRegion all;
+    for (int i = 0; i < 3; ++i)
+    {
+        all.lo[i] = 0;
+        all.hi[i] = grid.dims[i];
+    }
+    int num_regions = 0;
+    SplitRegion(&grid, all, max_vertices, &num_regions);
+
+    printf("  %llu posições, %llu triângulos, %d regiões.\n", (unsigned long long)scan.num_vertices,
+           (unsigned long long)scan.num_triangles, num_regions);
+    fflush(stdout);
+
+    // Segunda leitura: triângulos de cada região para o arquivo temporário.
+    MeshTileSorter sorter;
+    sorter.positions     = positions;
+    sorter.grid          = &grid;
+    sorter.num_vertices  = 0;
+    sorter.num_normals   = 0;
+    sorter.num_texcoords = 0;
+    sorter.group         = -1;
+    sorter.material      = -1;
+    sorter.pending.resize(num_regions);
+    sorter.num_pending   = 0;
+    sorter.max_pending   = std::max((size_t)1, memory_budget / 4 / sizeof(MeshTileTriangle));
+    sorter.file_size     = 0;
+    sorter.chunks.resize(num_regions);
+    sorter.region_triangles.assign(num_regions, 0);
+
+    temp->paths[3] = temp_prefix + ".tri.tmp";
+    sorter.file = fopen(temp->paths[3].c_str(), "wb");
+    sorter.ok   = sorter.file != NULL;
+    if ( !sorter.ok )
+        throw std::runtime_error("Cannot write temporary files next to \"" + std::string(filename) + "\"");
+
+    tinyobj::callback_t sort_callback;
+    sort_callback.vertex_cb   = SortVertexCallback;
+    sort_callback.normal_cb   = SortNormalCallback;
+    sort_callback.texcoord_cb = SortTexcoordCallback;
+    sort_callback.index_cb    = SortIndexCallback;
+    sort_callback.group_cb    = SortGroupCallback;
+    sort_callback.object_cb   = SortObjectCallback;
+    sort_callback.usemtl_cb   = SortUsemtlCallback;
+    try
+    {
+        ReadObj(filename, sort_callback, &sorter);
+    }
+    catch ( const std::exception& )
+    {
+        fclose(sorter.file);
+        throw;
+    }
+
+    FlushPendingTriangles(&sorter);
+    sorter.ok = (fclose(sorter.file) == 0) && sorter.ok;
+    if ( !sorter.error.empty() )
+        throw std::runtime_error(sorter.error);
+    if ( !sorter.ok )
+        throw std::runtime_error("Cannot write temporary files next to \"" + std::string(filename) + "\"");
+
+    MapTempFile(temp->paths[3], &temp->mapped[3]);
+    const float* normals   = reinterpret_cast<const float*>(temp->mapped[1].data);
+    const float* texcoords = reinterpret_cast<const float*>(temp->mapped[2].data);
+
+    // Cada região com triângulos vira um tile.
+    const bool compute_normals = scan.num_normals == 0;
+    index->tiles.clear();
+    for (int region = 0; region < num_regions; ++region)
+    {
+        if ( sorter.region_triangles[region] == 0 )
+            continue;
+
+        if ( sorter.region_triangles[region] > max_tile_triangles )
+            fprintf(stderr, "WARNING: Tile %zu of \"%s\" has %llu triangles and may exceed the memory budget.\n",
+                    index->tiles.size(), filename, (unsigned long long)sorter.region_triangles[region]);
+
+        const size_t tile = index->tiles.size();
+        MeshData mesh;
+        MeshTileInfo info;
+        {
+            ObjModel model;
+            model.materials = scan.materials;
+            BuildTileModel(sorter, sorter.chunks[region], temp->mapped[3].data, positions, normals, texcoords, tile, &model);
+
+            for (int i = 0; i < 3; ++i)
+            {
+                info.bounds_min[i] = FLT_MAX;
+                info.bounds_max[i] = -FLT_MAX;
+            }
+            for (size_t v = 0; v + 2 < model.attrib.vertices.size(); v += 3)
+            {
+                for (int i = 0; i < 3; ++i)
+                {
+                    info.bounds_min[i] = std::min(info.bounds_min[i], model.attrib.vertices[v + i]);
+                    info.bounds_max[i] = std::max(info.bounds_max[i], model.attrib.vertices[v + i]);
+                }
+            }
+            info.num_triangles = sorter.region_triangles[region];
+
+            if ( compute_normals )
+                MeshNormals_Compute(&model);
+            BuildMeshData(&model, &mesh);
+        }
+
+        if ( process != NULL )
+            process(&mesh);
+
+        std::string tile_path = MeshTile_TilePath(filename, tile);
+        if ( !MeshCache_StoreTile(tile_path.c_str(), index->source_hash, mesh) )
+            throw std::runtime_error("Cannot write tile \"" + tile_path + "\"");
+
+        index->tiles.push_back(info);
+    }
+}
+
+void MeshTile_Build(const char* source_filename, size_t memory_budget, void (*process)(MeshData* mesh), MeshTileIndex* index)
+{
+    std::lock_guard<std::mutex> lock(g_MeshTile.build_mutex);
+
+    // Outra thread pode ter dividido o mesmo arquivo enquanto esperávamos.
+    if ( MeshTile_LoadIndex(source_filename, index) )
+        return;
+
+    printf("Dividindo modelo \"%s\" em tiles (até %.0f MB de memória)...\n", source_filename, memory_budget / (1024.0 * 1024.0));
+    fflush(stdout);
+
+    FileStamp stamp;
+    if ( !GetFileStamp(source_filename, &stamp) || !HashFileContents(source_filename, &index->source_hash) )
+        throw std::runtime_error("Cannot open file");
+
+    MeshTileTempFiles temp;
+    try
+    {
+        BuildTiles(source_filename, memory_budget, process, &temp, index);
+    }
+    catch ( const std::exception& )
+    {
+        RemoveTempFiles(&temp);
+        throw;
+    }
+    RemoveTempFiles(&temp);
+
+    if ( !StoreIndex(source_filename, stamp, *index) )
+        throw std::runtime_error("Cannot write tile index \"" + MeshTile_IndexPath(source_filename) + "\"");
+
+    printf("  %zu tiles gravados.\n", index->tiles.size());
+}
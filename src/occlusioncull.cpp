@@ -0,0 +1,329 @@
+#include <cstdio>
+#include <vector>
+
+#include "occlusioncull.h"
+
+GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id); // Função definida em main.cpp
+
+// Cada caixa é uma instância do cubo unitário [0,1]^3, levado para
+// [box_minimum, box_maximum] (atributos por instância). O Fragment Shader não
+// escreve nada: só importa se algum fragmento passa no teste de
+// profundidade.
+static const GLchar* const occlusion_vertex_shader_source = ""
+"#version 330 core\n"
+"layout (location = 0) in vec3 position;\n"
+"layout (location = 1) in vec3 box_minimum;\n"
+"layout (location = 2) in vec3 box_maximum;\n"
+"uniform mat4 clip_from_world;\n"
+"void main()\n"
+"{\n"
+"    gl_Position = clip_from_world * vec4(mix(box_minimum, box_maximum, position), 1.0);\n"
+"}\n";
+
+static const GLchar* const occlusion_fragment_shader_source = ""
+"#version 330 core\n"
+"void main()\n"
+"{\n"
+"}\n";
+
+// Estado de um objeto.
+struct OcclusionCullObject
+{
+    bool         visible;         // Último resultado lido
+    unsigned int pending;         // Número de consultas com o objeto ainda sem resultado lido
+    unsigned int next_test_frame; // Quadro a partir do qual um objeto visível é consultado de novo
+};
+
+// Consulta de um grupo de objetos. As consultas são reaproveitadas depois que
+// seus resultados são lidos, assim como os vetores de objetos.
+struct OcclusionCullQuery
+{
+    GLuint              query;
+    std::vector<size_t> objects;
+    size_t              first_box; // Primeira caixa do grupo no buffer do quadro
+};
+
+// Caixa no buffer de caixas, nos atributos 1 e 2 do Vertex Shader.
+struct OcclusionCullBox
+{
+    float minimum[3];
+    float maximum[3];
+};
+
+struct OcclusionCullState
+{
+    GLuint program_id;
+    GLint  clip_from_world_uniform;
+    GLuint vertex_array_object_id;
+    GLuint vertex_buffer_id;
+    GLuint index_buffer_id;
+    GLuint box_buffer_id;
+
+    std::vector<OcclusionCullObject> objects;
+    std::vector<OcclusionCullQuery>  queries;
+    std::vector<int>                 free_queries; // Consultas que podem ser reaproveitadas
+    std::vector<int>                 pending;      // Consultas sem resultado lido, na ordem em que foram feitas
+    std::vector<int>                 groups;       // Consultas fechadas no quadro, ainda não desenhadas
+    std::vector<OcclusionCullBox>    boxes;        // Caixas do quadro
+    std::vector<size_t>              group_objects; // Objetos do grupo atual
+    unsigned int                     frame;
+};
+
+static OcclusionCullState g_OcclusionCull;
+
+static GLuint CompileShader(GLenum type, const GLchar* source)
+{
+    GLuint shader_id = glCreateShader(type);
+    glShaderSource(shader_id, 1, &source, NULL);
+    glCompileShader(shader_id);
+
+    GLint compiled_ok = GL_FALSE;
+    glGetShaderiv(shader_id, GL_COMPILE_STATUS, &compiled_ok);
+    if ( compiled_ok == GL_FALSE )
+    {
+        GLchar log[1024];
+        glGetShaderInfoLog(shader_id, sizeof(log), NULL, log);
+        fprintf(stderr, "ERROR: OpenGL compilation of occlusion shader failed.\n%s\n", log);
+    }
+    return shader_id;
+}
+
+void OcclusionCull_Init()
+{
+    GLuint vertex_shader_id   = CompileShader(GL_VERTEX_SHADER, occlusion_vertex_shader_source);
+    GLuint fragment_shader_id = CompileShader(GL_FRAGMENT_SHADER, occlusion_fragment_shader_source);
+    g_OcclusionCull.program_id = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
+    g_OcclusionCull.clip_from_world_uniform = glGetUniformLocation(g_OcclusionCull.program_id, "clip_from_world");
+
+    // Os 8 vértices do cubo unitário e seus 12 triângulos, com os vértices
+    // em sentido anti-horário vistos de fora.
+    static const GLfloat corners[8*3] = {
+        0,0,0,  1,0,0,  1,1,0,  0,1,0,
+        0,0,1,  1,0,1,  1,1,1,  0,1,1,
+    };
+    static const GLubyte indices[36] = {
+        0,2,1, 0,3,2, // z = 0
+        4,5,6, 4,6,7, // z = 1
+        0,1,5, 0,5,4, // y = 0
+        3,6,2, 3,7,6, // y = 1
+        0,4,7, 0,7,3, // x = 0
+        1,2,6, 1,6,5, // x = 1
+    };
+
+    glGenVertexArrays(1, &g_OcclusionCull.vertex_array_object_id);
+    glBindVertexArray(g_OcclusionCull.vertex_array_object_id);
+
+    glGenBuffers(1, &g_OcclusionCull.vertex_buffer_id);
+    glBindBuffer(GL_ARRAY_BUFFER, g_OcclusionCull.vertex_buffer_id);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(0);
+
+    // As caixas mudam a cada quadro; os ponteiros dos atributos 1 e 2 são
+    // definidos por OcclusionCull_IssueQueries(), no início de cada grupo.
+    glGenBuffers(1, &g_OcclusionCull.box_buffer_id);
+    glBindBuffer(GL_ARRAY_BUFFER, g_OcclusionCull.box_buffer_id);
+    for (GLuint location = 1; location <= 2; ++location)
+    {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+
+    glGenBuffers(1, &g_OcclusionCull.index_buffer_id);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_OcclusionCull.index_buffer_id);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    g_OcclusionCull.objects.clear();
+    g_OcclusionCull.queries.clear();
+    g_OcclusionCull.free_queries.clear();
+    g_OcclusionCull.pending.clear();
+    g_OcclusionCull.groups.clear();
+    g_OcclusionCull.boxes.clear();
+    g_OcclusionCull.group_objects.clear();
+    g_OcclusionCull.frame = 0;
+}
+
+void OcclusionCull_BeginFrame(size_t num_objects)
+{
+    ++g_OcclusionCull.frame;
+
+    // Objetos novos começam visíveis, com a primeira consulta em um quadro
+    // que depende da posição do objeto.
+    std::vector<OcclusionCullObject>& objects = g_OcclusionCull.objects;
+    while ( objects.size() < num_objects )
+    {
+        OcclusionCullObject object;
+        object.visible         = true;
+        object.pending         = 0;
+        object.next_test_frame = g_OcclusionCull.frame + (unsigned int)(objects.size() % OCCLUSIONCULL_VISIBLE_FRAMES);
+        objects.push_back(object);
+    }
+
+    // Lemos os resultados em ordem, para que o resultado mais recente de um
+    // objeto seja o último aplicado, e paramos na primeira consulta que
+    // ainda não terminou.
+    std::vector<int>& pending = g_OcclusionCull.pending;
+    size_t num_read = 0;
+    for (; num_read < pending.size(); ++num_read)
+    {
+        OcclusionCullQuery& query = g_OcclusionCull.queries[pending[num_read]];
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(query.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if ( !available )
+            break;
+
+        GLuint any_samples = GL_FALSE;
+        glGetQueryObjectuiv(query.query, GL_QUERY_RESULT, &any_samples);
+
+        // Um grupo visível não diz quais de seus objetos estão visíveis:
+        // todos passam a ser desenhados e são consultados sozinhos assim que
+        // possível.
+        const bool visible = (any_samples != GL_FALSE);
+        const unsigned int next_test_frame = g_OcclusionCull.frame + ((query.objects.size() == 1) ? OCCLUSIONCULL_VISIBLE_FRAMES : 0);
+        for (size_t i = 0; i < query.objects.size(); ++i)
+        {
+            OcclusionCullObject& object = objects[query.objects[i]];
+            object.pending -= 1;
+            object.visible  = visible;
+            if ( visible )
+                object.next_test_frame = next_test_frame;
+        }
+        g_OcclusionCull.free_queries.push_back(pending[num_read]);
+    }
+    pending.erase(pending.begin(), pending.begin() + num_read);
+}
+
+bool OcclusionCull_IsVisible(size_t object)
+{
+    return object >= g_OcclusionCull.objects.size() || g_OcclusionCull.objects[object].visible;
+}
+
+bool OcclusionCull_NeedsQuery(size_t object)
+{
+    if ( object >= g_OcclusionCull.objects.size() )
+        return false;
+
+    const OcclusionCullObject& state = g_OcclusionCull.objects[object];
+    return !state.visible || (state.pending == 0 && g_OcclusionCull.frame >= state.next_test_frame);
+}
+
+void OcclusionCull_AddBox(size_t object, const float minimum[3], const float maximum[3])
+{
+    OcclusionCullBox box;
+    for (int k = 0; k < 3; ++k)
+    {
+        box.minimum[k] = minimum[k];
+        box.maximum[k] = maximum[k];
+    }
+    g_OcclusionCull.boxes.push_back(box);
+    g_OcclusionCull.group_objects.push_back(object);
+}
+
+GLuint OcclusionCull_EndGroup()
+{
+    std::vector<size_t>& group_objects = g_OcclusionCull.group_objects;
+    if ( group_objects.empty() )
+        return 0;
+
+    int index;
+    if ( !g_OcclusionCull.free_queries.empty() )
+    {
+        index = g_OcclusionCull.free_queries.back();
+        g_OcclusionCull.free_queries.pop_back();
+    }
+    else
+    {
+        index = (int)g_OcclusionCull.queries.size();
+        g_OcclusionCull.queries.push_back(OcclusionCullQuery());
+        glGenQueries(1, &g_OcclusionCull.queries[index].query);
+    }
+
+    OcclusionCullQuery& query = g_OcclusionCull.queries[index];
+    query.objects.assign(group_objects.begin(), group_objects.end());
+    query.first_box = g_OcclusionCull.boxes.size() - group_objects.size();
+    for (size_t i = 0; i < group_objects.size(); ++i)
+        g_OcclusionCull.objects[group_objects[i]].pending += 1;
+    group_objects.clear();
+
+    g_OcclusionCull.groups.push_back(index);
+    g_OcclusionCull.pending.push_back(index);
+    return query.query;
+}
+
+void OcclusionCull_IssueQueries(const float clip_from_world[16])
+{
+    // Um grupo não fechado é descartado junto com suas caixas.
+    g_OcclusionCull.boxes.resize(g_OcclusionCull.boxes.size() - g_OcclusionCull.group_objects.size());
+    g_OcclusionCull.group_objects.clear();
+
+    std::vector<int>& groups = g_OcclusionCull.groups;
+    if ( groups.empty() )
+        return;
+
+    glUseProgram(g_OcclusionCull.program_id);
+    glUniformMatrix4fv(g_OcclusionCull.clip_from_world_uniform, 1, GL_FALSE, clip_from_world);
+    glBindVertexArray(g_OcclusionCull.vertex_array_object_id);
+
+    // Todas as caixas do quadro de uma vez. Com glBufferData(NULL) o driver
+    // nos dá uma nova região de memória, sem esperar que a GPU termine as
+    // consultas do quadro anterior.
+    const std::vector<OcclusionCullBox>& boxes = g_OcclusionCull.boxes;
+    glBindBuffer(GL_ARRAY_BUFFER, g_OcclusionCull.box_buffer_id);
+    glBufferData(GL_ARRAY_BUFFER, boxes.size() * sizeof(OcclusionCullBox), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, boxes.size() * sizeof(OcclusionCullBox), &boxes[0]);
+
+    // As caixas não aparecem na imagem nem escondem outros objetos. Suas
+    // faces de trás também são desenhadas, para que uma caixa cortada pelo
+    // plano near ainda produza fragmentos.
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    const GLboolean cull_face_enabled = glIsEnabled(GL_CULL_FACE);
+    glDisable(GL_CULL_FACE);
+
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+        const OcclusionCullQuery& query = g_OcclusionCull.queries[groups[g]];
+        const size_t offset = query.first_box * sizeof(OcclusionCullBox);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(OcclusionCullBox), (void*)(offset + offsetof(OcclusionCullBox, minimum)));
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(OcclusionCullBox), (void*)(offset + offsetof(OcclusionCullBox, maximum)));
+
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, query.query);
+        glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, 0, (GLsizei)query.objects.size());
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+    }
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_TRUE);
+    if ( cull_face_enabled )
+        glEnable(GL_CULL_FACE);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(0);
+
+    groups.clear();
+    g_OcclusionCull.boxes.clear();
+}
+
+void OcclusionCull_Shutdown()
+{
+    for (size_t i = 0; i < g_OcclusionCull.queries.size(); ++i)
+        glDeleteQueries(1, &g_OcclusionCull.queries[i].query);
+    g_OcclusionCull.objects.clear();
+    g_OcclusionCull.queries.clear();
+    g_OcclusionCull.free_queries.clear();
+    g_OcclusionCull.pending.clear();
+    g_OcclusionCull.groups.clear();
+    g_OcclusionCull.boxes.clear();
+    g_OcclusionCull.group_objects.clear();
+
+    glDeleteBuffers(1, &g_OcclusionCull.vertex_buffer_id);
+    glDeleteBuffers(1, &g_OcclusionCull.index_buffer_id);
+    glDeleteBuffers(1, &g_OcclusionCull.box_buffer_id);
+    glDeleteVertexArrays(1, &g_OcclusionCull.vertex_array_object_id);
+    glDeleteProgram(g_OcclusionCull.program_id);
+}
@@ -0,0 +1,88 @@
+#include <cstring>
+
+#include "renderqueue.h"
+
+// Coloca "value" no campo de "bits" bits que começa no bit "shift".
+static uint64_t KeyField(uint64_t value, int bits, int shift)
+{
+    return (value & ((uint64_t(1) << bits) - 1)) << shift;
+}
+
+uint64_t RenderQueue_MakeKey(unsigned int pass, unsigned int program, unsigned int vertex_array, int material, float depth)
+{
+    // Para floats não negativos, a ordem dos bits como inteiro sem sinal é a
+    // mesma ordem dos valores, então a profundidade não precisa ser
+    // quantizada.
+    uint32_t depth_bits = 0;
+    if ( depth > 0.0f )
+        memcpy(&depth_bits, &depth, sizeof(depth_bits));
+
+    int shift = 0;
+    uint64_t key = KeyField(depth_bits, RENDERQUEUE_DEPTH_BITS, shift);
+    shift += RENDERQUEUE_DEPTH_BITS;
+    key |= KeyField((uint64_t)(material + 1), RENDERQUEUE_MATERIAL_BITS, shift);
+    shift += RENDERQUEUE_MATERIAL_BITS;
+    key |= KeyField(vertex_array, RENDERQUEUE_VERTEX_ARRAY_BITS, shift);
+    shift += RENDERQUEUE_VERTEX_ARRAY_BITS;
+    key |= KeyField(program, RENDERQUEUE_PROGRAM_BITS, shift);
+    shift += RENDERQUEUE_PROGRAM_BITS;
+    key |= KeyField(pass, RENDERQUEUE_PASS_BITS, shift);
+    return key;
+}
+
+void RenderQueue_Clear(RenderQueue* queue)
+{
+    queue->items.clear();
+}
+
+void RenderQueue_Submit(RenderQueue* queue, uint64_t key, size_t packet)
+{
+    RenderQueueItem item = { key, packet };
+    queue->items.push_back(item);
+}
+
+void RenderQueue_Sort(RenderQueue* queue)
+{
+    std::vector<RenderQueueItem>& items   = queue->items;
+    std::vector<RenderQueueItem>& scratch = queue->scratch;
+    const size_t count = items.size();
+    if ( count < 2 )
+        return;
+
+    // "Radix sort" LSD com dígitos de 8 bits: uma passada por byte da
+    // chave, do menos significativo para o mais significativo. Os
+    // histogramas dos 8 bytes são contados em uma única leitura das chaves.
+    size_t histogram[8][256];
+    memset(histogram, 0, sizeof(histogram));
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64_t key = items[i].key;
+        for (int byte = 0; byte < 8; ++byte)
+            histogram[byte][(key >> (8*byte)) & 0xFF] += 1;
+    }
+
+    scratch.resize(count);
+    for (int byte = 0; byte < 8; ++byte)
+    {
+        // Se todas as chaves têm o mesmo valor neste byte (por exemplo, um
+        // único passo ou um único programa), a passada não muda nada.
+        const unsigned int digit = (items[0].key >> (8*byte)) & 0xFF;
+        if ( histogram[byte][digit] == count )
+            continue;
+
+        size_t offsets[256];
+        size_t total = 0;
+        for (int d = 0; d < 256; ++d)
+        {
+            offsets[d] = total;
+            total += histogram[byte][d];
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            unsigned int d = (items[i].key >> (8*byte)) & 0xFF;
+            scratch[offsets[d]++] = items[i];
+        }
+        items.swap(scratch);
+    }
+}
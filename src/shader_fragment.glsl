@@ -6,17 +6,43 @@
 // "shader_vertex.glsl" e "main.cpp".
 in vec4 position_world;
 in vec4 normal;
+in vec2 texcoords;
 
 // Matrizes computadas no cdigo C++ e enviadas para a GPU
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
-// Identificador que define qual objeto est sendo desenhado no momento
+// Identificador que define qual objeto est sendo desenhado no momento,
+// escolhido em "shader_vertex.glsl" (o mesmo para todos os vrtices de uma
+// instncia, ento no  interpolado).
 #define SPHERE 0
 #define BUNNY  1
 #define PLANE  2
-uniform int object_id;
+flat in int fragment_object_id;
+
+// Materiais dos modelos carregados de arquivos ".obj" com ".mtl" (veja
+// "meshmaterial.h"). "material_index"  a posio do material da parte do
+// objeto sendo desenhada, ou -1 se ela no tiver material: nesse caso as
+// propriedades so escolhidas por "fragment_object_id".
+#define MAX_MATERIALS 256
+struct Material
+{
+    vec4 Kd; // Refletncia difusa (w no utilizado)
+    vec4 Ks; // Refletncia especular, com o expoente q em w
+    vec4 Ka; // Refletncia ambiente (w no utilizado)
+};
+layout (std140) uniform MaterialBlock
+{
+    Material materials[MAX_MATERIALS];
+};
+uniform int material_index;
+
+// Textura difusa do material (veja "texture.h"), multiplicada por Kd. Se
+// "texture_enabled" for 0, o material no tem textura ou ela ainda est
+// sendo carregada.
+uniform sampler2D diffuse_texture;
+uniform int texture_enabled;
 
 // O valor de sada ("out") de um Fragment Shader  a cor final do fragmento.
 out vec3 color;
@@ -54,7 +80,18 @@ void main()
     vec3 Ka; // Refletncia ambiente
     float q; // Expoente especular para o modelo de iluminao de Phong
 
-    if ( object_id == SPHERE )
+    if ( material_index >= 0 )
+    {
+        // Propriedades lidas do arquivo ".mtl"
+        Kd = materials[material_index].Kd.rgb;
+        Ks = materials[material_index].Ks.rgb;
+        Ka = materials[material_index].Ka.rgb;
+        q  = materials[material_index].Ks.w;
+
+        if ( texture_enabled != 0 )
+            Kd *= texture(diffuse_texture, texcoords).rgb;
+    }
+    else if ( fragment_object_id == SPHERE )
     {
         // PREENCHA AQUI
         // Propriedades espectrais da esfera
@@ -63,7 +100,7 @@ void main()
         Ka = Kd/2;
         q = 1.0;
     }
-    else if ( object_id == BUNNY )
+    else if ( fragment_object_id == BUNNY )
     {
         // PREENCHA AQUI
         // Propriedades espectrais do coelho
@@ -72,7 +109,7 @@ void main()
         Ka = Kd/2;
         q = 32.0;
     }
-    else if ( object_id == PLANE )
+    else if ( fragment_object_id == PLANE )
     {
         // PREENCHA AQUI
         // Propriedades espectrais do plano
@@ -6,20 +6,49 @@ layout (location = 0) in vec4 model_coefficients;
 layout (location = 1) in vec4 normal_coefficients;
 layout (location = 2) in vec2 texture_coefficients;
 
+// Atributos de cada instncia, usados quando "instanced" != 0 (veja
+// DrawVirtualObjectInstanced() em "main.cpp"). Cada coluna da matriz de
+// modelagem ocupa uma posio (3 a 6); o identificador do objeto fica na 7.
+layout (location = 3) in mat4 instance_model;
+layout (location = 7) in int  instance_object_id;
+
 // Matrizes computadas no cdigo C++ e enviadas para a GPU
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// Identificador que define qual objeto est sendo desenhado no momento, e se
+// a matriz de modelagem e o identificador vm das variveis acima ou dos
+// atributos da instncia.
+uniform int object_id;
+uniform int instanced;
+
+// Transformao que reconstri as posies quantizadas de uma malha (veja
+// "meshquant.h"). Para malhas com posies em float, scale = (1,1,1) e
+// offset = (0,0,0).
+uniform vec3 position_scale;
+uniform vec3 position_offset;
+
 // Atributos de vrtice que sero gerados como sada ("out") pelo Vertex Shader.
 // ** Estes sero interpolados pelo rasterizador! ** gerando, assim, valores
 // para cada fragmento, os quais sero recebidos como entrada pelo Fragment
 // Shader. Veja o arquivo "shader_fragment.glsl".
 out vec4 position_world;
 out vec4 normal;
+out vec2 texcoords;
+flat out int fragment_object_id;
 
 void main()
 {
+    // Matriz de modelagem deste vrtice: a mesma para todo o objeto, ou uma
+    // por instncia.
+    mat4 M = (instanced != 0) ? instance_model : model;
+    fragment_object_id = (instanced != 0) ? instance_object_id : object_id;
+
+    // Posio do vrtice em coordenadas locais do modelo. O componente w das
+    // posies quantizadas no  utilizado.
+    vec4 position_model = vec4(model_coefficients.xyz * position_scale + position_offset, 1.0);
+
     // A varivel gl_Position define a posio final de cada vrtice
     // OBRIGATORIAMENTE em "normalized device coordinates" (NDC), onde cada
     // coeficiente estar entre -1 e 1 aps diviso por w.
@@ -32,7 +61,7 @@ void main()
     // deste Vertex Shader, a placa de vdeo (GPU) far a diviso por W. Veja
     // slide 189 do documento "Aula_09_Projecoes.pdf".
 
-    gl_Position = projection * view * model * model_coefficients;
+    gl_Position = projection * view * M * position_model;
 
     // Como as variveis acima  (tipo vec4) so vetores com 4 coeficientes,
     // tambm  possvel acessar e modificar cada coeficiente de maneira
@@ -49,11 +78,15 @@ void main()
     // rasterizador para gerar atributos nicos para cada fragmento gerado.
 
     // Posio do vrtice atual no sistema de coordenadas global (World).
-    position_world = model * model_coefficients;
+    position_world = M * position_model;
 
     // Normal do vrtice atual no sistema de coordenadas global (World).
     // Veja slide 107 do documento "Aula_07_Transformacoes_Geometricas_3D.pdf".
-    normal = inverse(transpose(model)) * normal_coefficients;
+    normal = inverse(transpose(M)) * vec4(normal_coefficients.xyz, 0.0);
     normal.w = 0.0;
+
+    // Coordenadas de textura do vrtice, usadas pela textura difusa dos
+    // materiais (veja "shader_fragment.glsl").
+    texcoords = texture_coefficients;
 }
 
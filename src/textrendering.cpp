@@ -10,8 +10,10 @@
 
 #include "utils.h"
 #include "dejavufont.h"
+#include "assetpack.h"
 
 GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id); // Função definida em main.cpp
+extern AssetPack g_AssetPack; // Variável definida em main.cpp
 
 const GLchar* const textvertexshader_source = ""
 "#version 330\n"
@@ -87,10 +89,25 @@ GLuint textVBO;
 GLuint textprogram_id;
 GLuint texttexture_id;
 
+// Fonte utilizada: a do pacote de assets, se existir, ou a compilada no
+// programa ("dejavufont.h").
+const texture_font_t* textfont = &dejavufont;
+
 void TextRendering_Init()
 {
     GLuint sampler;
 
+    // O asset guarda a estrutura texture_font_t exatamente como está na
+    // memória, então só pode ser usado se foi gerado para esta plataforma.
+    AssetData asset;
+    if ( AssetPack_Find(g_AssetPack, "fonts/dejavu", &asset) )
+    {
+        if ( asset.type == ASSET_FONT && asset.size == sizeof(texture_font_t) )
+            textfont = reinterpret_cast<const texture_font_t*>(asset.data);
+        else
+            fprintf(stderr, "WARNING: Font in asset pack does not match this build; using the built-in font.\n");
+    }
+
     glGenBuffers(1, &textVBO);
     glGenVertexArrays(1, &textVAO);
     glGenTextures(1, &texttexture_id);
@@ -119,7 +136,7 @@ void TextRendering_Init()
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, texttexture_id);
-    glTexImage2D( GL_TEXTURE_2D, 0, GL_R8, dejavufont.tex_width, dejavufont.tex_height, 0, GL_RED, GL_UNSIGNED_BYTE, dejavufont.tex_data);
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_R8, textfont->tex_width, textfont->tex_height, 0, GL_RED, GL_UNSIGNED_BYTE, textfont->tex_data);
     glBindSampler(0, sampler);
     glCheckError();
 
@@ -154,12 +171,12 @@ void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float
     for (size_t i = 0; i < str.size(); i++)
     {
         // Find the glyph for the character we are looking for
-        texture_glyph_t *glyph = 0;
-        for (size_t j = 0; j < dejavufont.glyphs_count; ++j)
+        const texture_glyph_t *glyph = 0;
+        for (size_t j = 0; j < textfont->glyphs_count; ++j)
         {
-            if (dejavufont.glyphs[j].codepoint == (uint32_t)str[i])
+            if (textfont->glyphs[j].codepoint == (uint32_t)str[i])
             {
-                glyph = &dejavufont.glyphs[j];
+                glyph = &textfont->glyphs[j];
                 break;
             }
         }
@@ -172,10 +189,10 @@ void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float
         float x1 = (float) (x0 + glyph->width * sx);
         float y1 = (float) (y0 - glyph->height * sy);
 
-        float s0 = glyph->s0 - 0.5f/dejavufont.tex_width;
-        float t0 = glyph->t0 - 0.5f/dejavufont.tex_height;
-        float s1 = glyph->s1 - 0.5f/dejavufont.tex_width;
-        float t1 = glyph->t1 - 0.5f/dejavufont.tex_height;
+        float s0 = glyph->s0 - 0.5f/textfont->tex_width;
+        float t0 = glyph->t0 - 0.5f/textfont->tex_height;
+        float s1 = glyph->s1 - 0.5f/textfont->tex_width;
+        float t1 = glyph->t1 - 0.5f/textfont->tex_height;
 
         struct {float x, y, s, t;} data[6] = {
             { x0, y0, s0, t0 },
@@ -216,14 +233,14 @@ float TextRendering_LineHeight(GLFWwindow* window)
 {
     int width, height;
     glfwGetWindowSize(window, &width, &height);
-    return dejavufont.height / height * textscale;
+    return textfont->height / height * textscale;
 }
 
 float TextRendering_CharWidth(GLFWwindow* window)
 {
     int width, height;
     glfwGetWindowSize(window, &width, &height);
-    return dejavufont.glyphs[32].advance_x / width * textscale;
+    return textfont->glyphs[32].advance_x / width * textscale;
 }
 
 void TextRendering_PrintMatrix(GLFWwindow* window, glm::mat4 M, float x, float y, float scale = 1.0f)
@@ -0,0 +1,807 @@
+#include <cstdio>
+#include <cctype>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+
+#include "texture.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEXTURE_SSE 1
+#endif
+
+struct TextureState
+{
+    bool                supports_bc1;
+    std::atomic<size_t> memory_used; // Soma dos tamanhos reservados por Texture_ReserveMemory()
+};
+
+static TextureState g_Texture;
+
+// Procura "name" na lista de extensões do contexto atual.
+static bool HasExtension(const char* name)
+{
+    GLint num_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+    for (GLint i = 0; i < num_extensions; ++i)
+    {
+        const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if ( extension != NULL && strcmp(extension, name) == 0 )
+            return true;
+    }
+    return false;
+}
+
+void Texture_Init()
+{
+    g_Texture.supports_bc1 = HasExtension("GL_EXT_texture_compression_s3tc") && HasExtension("GL_EXT_texture_sRGB");
+    g_Texture.memory_used  = 0;
+    if ( !g_Texture.supports_bc1 )
+        fprintf(stderr, "WARNING: S3TC textures not supported; compressed textures will be decompressed.\n");
+}
+
+bool Texture_SupportsBC1()
+{
+    return g_Texture.supports_bc1;
+}
+
+// ---------------------------------------------------------------------------
+// Decodificação
+
+static uint16_t ReadU16(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t ReadU32(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void DecodeError(const char* filename, const char* message)
+{
+    throw std::runtime_error(std::string("Cannot decode image \"") + filename + "\": " + message);
+}
+
+// Confere as dimensões e aloca os pixels da imagem.
+static void AllocateImage(int width, int height, const char* filename, TextureImage* image)
+{
+    if ( width <= 0 || height <= 0 || width > 32768 || height > 32768 )
+        DecodeError(filename, "invalid size");
+
+    image->width  = width;
+    image->height = height;
+    image->has_alpha = false;
+    image->pixels.assign((size_t)width * height * 4, 255);
+}
+
+// Inverte a ordem das linhas (para imagens guardadas de cima para baixo).
+static void FlipRows(TextureImage* image)
+{
+    const size_t row_size = (size_t)image->width * 4;
+    for (int y = 0; y < image->height / 2; ++y)
+    {
+        unsigned char* a = &image->pixels[y * row_size];
+        unsigned char* b = &image->pixels[(image->height - 1 - y) * row_size];
+        std::swap_ranges(a, a + row_size, b);
+    }
+}
+
+static void UpdateHasAlpha(TextureImage* image)
+{
+    image->has_alpha = false;
+    for (size_t i = 3; i < image->pixels.size(); i += 4)
+    {
+        if ( image->pixels[i] != 255 )
+        {
+            image->has_alpha = true;
+            return;
+        }
+    }
+}
+
+// TGA: tipos 2 (cores), 3 (tons de cinza) e suas versões RLE, 10 e 11.
+static void DecodeTga(const unsigned char* data, size_t size, const char* filename, TextureImage* image)
+{
+    if ( size < 18 )
+        DecodeError(filename, "truncated TGA header");
+
+    const int  id_length     = data[0];
+    const int  colormap_type = data[1];
+    const int  image_type    = data[2];
+    const int  colormap_size = ReadU16(data + 5) * ((data[7] + 7) / 8);
+    const int  width         = ReadU16(data + 12);
+    const int  height        = ReadU16(data + 14);
+    const int  bpp           = data[16];
+    const bool top_down      = (data[17] & 0x20) != 0;
+
+    const bool rle  = (image_type == 10 || image_type == 11);
+    const bool gray = (image_type == 3 || image_type == 11);
+    if ( image_type != 2 && image_type != 3 && image_type != 10 && image_type != 11 )
+        DecodeError(filename, "unsupported TGA type (only true-color and grayscale)");
+    if ( gray ? (bpp != 8) : (bpp != 24 && bpp != 32) )
+        DecodeError(filename, "unsupported TGA pixel size");
+
+    AllocateImage(width, height, filename, image);
+
+    const size_t bytes_per_pixel = bpp / 8;
+    size_t position = 18 + id_length + (colormap_type == 1 ? colormap_size : 0);
+    const size_t num_pixels = (size_t)width * height;
+    unsigned char* out = image->pixels.data();
+
+    size_t pixel = 0;
+    while ( pixel < num_pixels )
+    {
+        // Sem RLE, todos os pixels formam uma única sequência literal.
+        size_t count = num_pixels - pixel;
+        bool   repeat = false;
+        if ( rle )
+        {
+            if ( position >= size )
+                DecodeError(filename, "truncated TGA data");
+            const unsigned char packet = data[position++];
+            count  = std::min((size_t)(packet & 0x7F) + 1, num_pixels - pixel);
+            repeat = (packet & 0x80) != 0;
+        }
+
+        const size_t needed = (repeat ? 1 : count) * bytes_per_pixel;
+        if ( position > size || needed > size - position )
+            DecodeError(filename, "truncated TGA data");
+
+        for (size_t i = 0; i < count; ++i, ++pixel)
+        {
+            const unsigned char* p = &data[position + (repeat ? 0 : i * bytes_per_pixel)];
+            unsigned char* q = &out[4 * pixel];
+            if ( gray )
+            {
+                q[0] = q[1] = q[2] = p[0];
+            }
+            else
+            {
+                q[0] = p[2];
+                q[1] = p[1];
+                q[2] = p[0];
+                if ( bpp == 32 )
+                    q[3] = p[3];
+            }
+        }
+        position += needed;
+    }
+
+    if ( top_down )
+        FlipRows(image);
+}
+
+// BMP: 24 ou 32 bits por pixel, sem compressão.
+static void DecodeBmp(const unsigned char* data, size_t size, const char* filename, TextureImage* image)
+{
+    if ( size < 54 )
+        DecodeError(filename, "truncated BMP header");
+
+    const uint32_t pixel_offset = ReadU32(data + 10);
+    const int32_t  width        = (int32_t)ReadU32(data + 18);
+    const int32_t  raw_height   = (int32_t)ReadU32(data + 22);
+    const int      bpp          = ReadU16(data + 28);
+    const uint32_t compression  = ReadU32(data + 30);
+
+    if ( compression != 0 || (bpp != 24 && bpp != 32) )
+        DecodeError(filename, "unsupported BMP format (only uncompressed 24 and 32 bits)");
+
+    // Altura negativa indica linhas de cima para baixo.
+    const bool top_down = raw_height < 0;
+    const int  height   = top_down ? -raw_height : raw_height;
+    AllocateImage(width, height, filename, image);
+
+    const size_t bytes_per_pixel = bpp / 8;
+    const size_t row_size = ((size_t)width * bytes_per_pixel + 3) & ~(size_t)3;
+    if ( pixel_offset > size || row_size * height > size - pixel_offset )
+        DecodeError(filename, "truncated BMP data");
+
+    for (int y = 0; y < height; ++y)
+    {
+        const unsigned char* row = data + pixel_offset + y * row_size;
+        unsigned char* out = &image->pixels[(size_t)y * width * 4];
+        for (int x = 0; x < width; ++x)
+        {
+            // O quarto byte de BMPs de 32 bits sem compressão não é usado.
+            out[4*x + 0] = row[bytes_per_pixel*x + 2];
+            out[4*x + 1] = row[bytes_per_pixel*x + 1];
+            out[4*x + 2] = row[bytes_per_pixel*x + 0];
+        }
+    }
+
+    if ( top_down )
+        FlipRows(image);
+}
+
+// Lê um número do cabeçalho de um PPM/PGM, ignorando espaços e comentários.
+static int ReadPnmNumber(const unsigned char* data, size_t size, size_t* position, const char* filename)
+{
+    size_t& p = *position;
+    for (;;)
+    {
+        while ( p < size && (data[p] == ' ' || data[p] == '\t' || data[p] == '\r' || data[p] == '\n') )
+            ++p;
+        if ( p < size && data[p] == '#' )
+        {
+            while ( p < size && data[p] != '\n' )
+                ++p;
+            continue;
+        }
+        break;
+    }
+
+    if ( p >= size || data[p] < '0' || data[p] > '9' )
+        DecodeError(filename, "invalid PNM header");
+
+    int value = 0;
+    while ( p < size && data[p] >= '0' && data[p] <= '9' && value < 1000000 )
+        value = value * 10 + (data[p++] - '0');
+    return value;
+}
+
+// PPM (P6) e PGM (P5) binários, com valores de até 255.
+static void DecodePnm(const unsigned char* data, size_t size, const char* filename, TextureImage* image)
+{
+    const bool gray = data[1] == '5';
+    size_t position = 2;
+    const int width  = ReadPnmNumber(data, size, &position, filename);
+    const int height = ReadPnmNumber(data, size, &position, filename);
+    const int maxval = ReadPnmNumber(data, size, &position, filename);
+    position += 1; // Um único espaço separa o cabeçalho dos pixels
+
+    if ( maxval <= 0 || maxval > 255 )
+        DecodeError(filename, "unsupported PNM depth (only 8 bits)");
+
+    AllocateImage(width, height, filename, image);
+
+    const size_t channels = gray ? 1 : 3;
+    const size_t num_pixels = (size_t)width * height;
+    if ( position > size || num_pixels * channels > size - position )
+        DecodeError(filename, "truncated PNM data");
+
+    const unsigned char* p = data + position;
+    unsigned char* out = image->pixels.data();
+    for (size_t i = 0; i < num_pixels; ++i)
+    {
+        for (int c = 0; c < 3; ++c)
+            out[4*i + c] = (unsigned char)(p[channels*i + (gray ? 0 : c)] * 255 / maxval);
+    }
+
+    // PNM guarda as linhas de cima para baixo.
+    FlipRows(image);
+}
+
+static bool HasTgaExtension(const char* filename)
+{
+    const size_t n = strlen(filename);
+    if ( n < 4 || filename[n-4] != '.' )
+        return false;
+    return tolower(filename[n-3]) == 't' && tolower(filename[n-2]) == 'g' && tolower(filename[n-1]) == 'a';
+}
+
+void Texture_Decode(const unsigned char* data, size_t size, const char* filename, TextureImage* image)
+{
+    if ( size >= 2 && data[0] == 'B' && data[1] == 'M' )
+        DecodeBmp(data, size, filename, image);
+    else if ( size >= 2 && data[0] == 'P' && (data[1] == '5' || data[1] == '6') )
+        DecodePnm(data, size, filename, image);
+    else if ( HasTgaExtension(filename) )
+        DecodeTga(data, size, filename, image); // TGA não tem assinatura no início
+    else
+        DecodeError(filename, "unsupported format (use TGA, BMP or PPM)");
+
+    UpdateHasAlpha(image);
+}
+
+// ---------------------------------------------------------------------------
+// Mipmaps
+
+// Os pixels estão em sRGB (veja GL_SRGB8_ALPHA8 em "texture.h"): a média de
+// um bloco é feita com as cores lineares, como a GPU faz ao filtrar a
+// textura. Fazer a média dos bytes sRGB escureceria cada nível. Cada cor é
+// convertida para linear com 16 bits e a média volta para sRGB por uma
+// tabela com 12 bits de entrada. O alpha já é linear.
+#define TEXTURE_LINEAR_BITS 12
+
+struct SrgbTables
+{
+    uint16_t to_linear[256];                         // sRGB -> linear, de 0 a 65535
+    unsigned char to_srgb[1 << TEXTURE_LINEAR_BITS]; // Linear com 12 bits -> sRGB
+
+    SrgbTables()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            const double c = i / 255.0;
+            const double linear = (c <= 0.04045) ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+            to_linear[i] = (uint16_t)(linear * 65535.0 + 0.5);
+        }
+        const int max_index = (1 << TEXTURE_LINEAR_BITS) - 1;
+        for (int i = 0; i <= max_index; ++i)
+        {
+            const double linear = (double)i / max_index;
+            const double c = (linear <= 0.0031308) ? linear * 12.92 : 1.055 * pow(linear, 1.0 / 2.4) - 0.055;
+            to_srgb[i] = (unsigned char)(c * 255.0 + 0.5);
+        }
+    }
+};
+
+// As tabelas são criadas na primeira chamada (as texturas são geradas por
+// várias threads; a inicialização de variáveis estáticas locais é segura).
+static const SrgbTables& GetSrgbTables()
+{
+    static const SrgbTables tables;
+    return tables;
+}
+
+// Reduz uma imagem RGBA8 à metade em cada dimensão (no mínimo 1 pixel), com
+// a média de cada bloco de 2x2 pixels, em cores lineares. Em dimensões
+// ímpares, a última linha ou coluna é ignorada; em dimensões iguais a 1, o
+// pixel é repetido.
+//
+// As conversões para linear e de volta para sRGB são consultas às tabelas.
+// Com SSE2, as somas, o arredondamento e o limite das médias são feitos para
+// 2 pixels de saída (8 canais) de uma vez, com o mesmo resultado do código
+// sem SSE2. O alpha entra nas mesmas contas multiplicado por
+// 2^(shift - 2), de forma que (soma + arredondamento) >> shift dá a média
+// dos 4 bytes de alpha com o mesmo arredondamento.
+static void Downsample(const unsigned char* in, int width, int height, unsigned char* out)
+{
+    const SrgbTables& tables = GetSrgbTables();
+    const int out_width  = std::max(width / 2, 1);
+    const int out_height = std::max(height / 2, 1);
+    const int dx = (width  > 1) ? 4 : 0; // Distância, em bytes, até o pixel da direita
+    const size_t row_size = (size_t)width * 4;
+    const int shift = 2 + 16 - TEXTURE_LINEAR_BITS; // Média de 4 valores de 16 bits, com 12 bits
+
+    for (int y = 0; y < out_height; ++y)
+    {
+        const unsigned char* row0 = in + (size_t)(2*y) * row_size;
+        const unsigned char* row1 = (height > 1) ? row0 + row_size : row0;
+        unsigned char* dst = out + (size_t)y * out_width * 4;
+
+        int x = 0;
+#ifdef TEXTURE_SSE
+        if ( dx == 4 )
+        {
+            const __m128i zero      = _mm_setzero_si128();
+            const __m128i round     = _mm_set1_epi32(1 << (shift - 1));
+            const __m128i max_index = _mm_set1_epi16((1 << TEXTURE_LINEAR_BITS) - 1);
+            for (; x + 2 <= out_width; x += 2)
+            {
+                // Valores lineares de 16 bits dos 4 pixels de cada linha; cada
+                // vetor tem 2 pixels vizinhos, R G B A R G B A.
+                __m128i linear[2][2];
+                for (int r = 0; r < 2; ++r)
+                {
+                    const unsigned char* p = ((r == 0) ? row0 : row1) + 8*x;
+                    for (int half = 0; half < 2; ++half, p += 8)
+                        linear[r][half] = _mm_setr_epi16(
+                            (short)tables.to_linear[p[0]], (short)tables.to_linear[p[1]], (short)tables.to_linear[p[2]], (short)(p[3] << (shift - 2)),
+                            (short)tables.to_linear[p[4]], (short)tables.to_linear[p[5]], (short)tables.to_linear[p[6]], (short)(p[7] << (shift - 2)));
+                }
+
+                // Somas de 32 bits dos 4 pixels de cada bloco: a metade baixa
+                // de cada vetor é o pixel da esquerda, a alta o da direita.
+                __m128i average[2];
+                for (int half = 0; half < 2; ++half)
+                {
+                    const __m128i a = linear[0][half];
+                    const __m128i b = linear[1][half];
+                    __m128i sum = _mm_add_epi32(_mm_unpacklo_epi16(a, zero), _mm_unpackhi_epi16(a, zero));
+                    sum = _mm_add_epi32(sum, _mm_add_epi32(_mm_unpacklo_epi16(b, zero), _mm_unpackhi_epi16(b, zero)));
+                    average[half] = _mm_srli_epi32(_mm_add_epi32(sum, round), shift);
+                }
+
+                // As médias cabem em 16 bits com sinal (no máximo 2^12).
+                uint16_t result[8];
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(result), _mm_min_epi16(_mm_packs_epi32(average[0], average[1]), max_index));
+                for (int i = 0; i < 8; ++i)
+                    dst[4*x + i] = ((i & 3) == 3) ? (unsigned char)result[i] : tables.to_srgb[result[i]];
+            }
+        }
+#endif
+        for (; x < out_width; ++x)
+        {
+            const unsigned char* p0 = row0 + 8*x;
+            const unsigned char* p1 = row1 + 8*x;
+            for (int c = 0; c < 3; ++c)
+            {
+                const uint32_t sum = (uint32_t)tables.to_linear[p0[c]] + tables.to_linear[p0[dx + c]]
+                                   + tables.to_linear[p1[c]] + tables.to_linear[p1[dx + c]];
+                const uint32_t linear = std::min((sum + (1u << (shift - 1))) >> shift, (1u << TEXTURE_LINEAR_BITS) - 1);
+                dst[4*x + c] = tables.to_srgb[linear];
+            }
+            dst[4*x + 3] = (unsigned char)((p0[3] + p0[dx + 3] + p1[3] + p1[dx + 3] + 2) >> 2);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// BC1
+
+static uint16_t PackRgb565(const unsigned char* c)
+{
+    return (uint16_t)(((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+}
+
+static void UnpackRgb565(uint16_t v, unsigned char* c)
+{
+    const int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+    c[0] = (unsigned char)((r << 3) | (r >> 2));
+    c[1] = (unsigned char)((g << 2) | (g >> 4));
+    c[2] = (unsigned char)((b << 3) | (b >> 2));
+    c[3] = 255;
+}
+
+// As quatro cores de um bloco no modo opaco (color0 > color1).
+static void BuildPalette(uint16_t color0, uint16_t color1, unsigned char palette[4][4])
+{
+    UnpackRgb565(color0, palette[0]);
+    UnpackRgb565(color1, palette[1]);
+    for (int c = 0; c < 4; ++c)
+    {
+        palette[2][c] = (unsigned char)((2 * palette[0][c] + palette[1][c]) / 3);
+        palette[3][c] = (unsigned char)((palette[0][c] + 2 * palette[1][c]) / 3);
+    }
+}
+
+// Comprime um bloco de 4x4 pixels RGBA (64 bytes) em 8 bytes. As cores
+// extremas são os cantos da caixa envolvente dos pixels, encolhida em 1/16
+// e com a diagonal escolhida pelo sinal da covariância, como em
+// "Real-Time DXT Compression" (J.M.P. van Waveren, 2006).
+static void CompressBlock(const unsigned char block[64], unsigned char out[8])
+{
+    int min_c[3] = { 255, 255, 255 };
+    int max_c[3] = { 0, 0, 0 };
+    int mean[3]  = { 0, 0, 0 };
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            min_c[c] = std::min(min_c[c], (int)block[4*i + c]);
+            max_c[c] = std::max(max_c[c], (int)block[4*i + c]);
+            mean[c] += block[4*i + c];
+        }
+    }
+
+    // Covariância de vermelho e azul em relação ao verde, o canal com mais
+    // bits: define qual diagonal da caixa segue a distribuição das cores.
+    int cov_rg = 0, cov_bg = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        const int g = 16 * block[4*i + 1] - mean[1];
+        cov_rg += (16 * block[4*i + 0] - mean[0]) * g;
+        cov_bg += (16 * block[4*i + 2] - mean[2]) * g;
+    }
+
+    unsigned char color0[3], color1[3];
+    for (int c = 0; c < 3; ++c)
+    {
+        const int inset = (max_c[c] - min_c[c]) >> 4;
+        color0[c] = (unsigned char)(max_c[c] - inset);
+        color1[c] = (unsigned char)(min_c[c] + inset);
+    }
+    if ( cov_rg < 0 )
+        std::swap(color0[0], color1[0]);
+    if ( cov_bg < 0 )
+        std::swap(color0[2], color1[2]);
+
+    uint16_t c0 = PackRgb565(color0);
+    uint16_t c1 = PackRgb565(color1);
+    if ( c0 < c1 )
+        std::swap(c0, c1);
+
+    uint32_t indices = 0;
+    if ( c0 != c1 )
+    {
+        unsigned char palette[4][4];
+        BuildPalette(c0, c1, palette);
+        for (int i = 0; i < 16; ++i)
+        {
+            int best = 0, best_distance = 1 << 30;
+            for (int k = 0; k < 4; ++k)
+            {
+                int distance = 0;
+                for (int c = 0; c < 3; ++c)
+                {
+                    const int d = block[4*i + c] - palette[k][c];
+                    distance += d * d;
+                }
+                if ( distance < best_distance )
+                {
+                    best = k;
+                    best_distance = distance;
+                }
+            }
+            indices |= (uint32_t)best << (2*i);
+        }
+    }
+
+    out[0] = c0 & 0xFF;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF;
+    out[3] = c1 >> 8;
+    out[4] = indices & 0xFF;
+    out[5] = (indices >> 8) & 0xFF;
+    out[6] = (indices >> 16) & 0xFF;
+    out[7] = indices >> 24;
+}
+
+static void DecompressBlock(const unsigned char in[8], unsigned char block[64])
+{
+    const uint16_t c0 = ReadU16(in);
+    const uint16_t c1 = ReadU16(in + 2);
+    const uint32_t indices = ReadU32(in + 4);
+
+    unsigned char palette[4][4];
+    BuildPalette(c0, c1, palette);
+    if ( c0 <= c1 )
+    {
+        // Modo de 3 cores, que CompressBlock() não gera: a terceira cor é a
+        // média e a quarta é preta (transparente).
+        for (int c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (unsigned char)((palette[0][c] + palette[1][c]) / 2);
+            palette[3][c] = 0;
+        }
+    }
+
+    for (int i = 0; i < 16; ++i)
+        memcpy(&block[4*i], palette[(indices >> (2*i)) & 3], 4);
+}
+
+static size_t BlocksAcross(int size)
+{
+    return (size + 3) / 4;
+}
+
+// Comprime um nível RGBA8. Nos blocos que passam da borda, os pixels da
+// borda são repetidos.
+static void CompressLevel(const unsigned char* pixels, int width, int height, unsigned char* out)
+{
+    unsigned char block[64];
+    for (size_t by = 0; by < BlocksAcross(height); ++by)
+    {
+        for (size_t bx = 0; bx < BlocksAcross(width); ++bx)
+        {
+            for (int i = 0; i < 16; ++i)
+            {
+                const int x = std::min((int)(4*bx) + i % 4, width - 1);
+                const int y = std::min((int)(4*by) + i / 4, height - 1);
+                memcpy(&block[4*i], &pixels[4*((size_t)y * width + x)], 4);
+            }
+            CompressBlock(block, out);
+            out += 8;
+        }
+    }
+}
+
+size_t Texture_LevelSize(TextureFormat format, int width, int height)
+{
+    if ( format == TEXTURE_FORMAT_BC1 )
+        return BlocksAcross(width) * BlocksAcross(height) * 8;
+    return (size_t)width * height * 4;
+}
+
+// Calcula as posições dos níveis e aloca TextureData::data.
+static void LayoutLevels(TextureData* texture, int width, int height)
+{
+    texture->levels.clear();
+    size_t offset = 0;
+    for (;;)
+    {
+        TextureLevel level;
+        level.width  = width;
+        level.height = height;
+        level.offset = offset;
+        level.size   = Texture_LevelSize(texture->format, width, height);
+        texture->levels.push_back(level);
+        offset += level.size;
+
+        if ( width == 1 && height == 1 )
+            break;
+        width  = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    texture->data.resize(offset);
+}
+
+void Texture_Build(const TextureImage& image, bool compress, TextureData* texture)
+{
+    // Reduzimos imagens maiores que TEXTURE_MAX_SIZE antes de gerar os níveis.
+    std::vector<unsigned char> current(image.pixels);
+    std::vector<unsigned char> next;
+    int width = image.width, height = image.height;
+    while ( width > TEXTURE_MAX_SIZE || height > TEXTURE_MAX_SIZE )
+    {
+        next.resize((size_t)std::max(width / 2, 1) * std::max(height / 2, 1) * 4);
+        Downsample(current.data(), width, height, next.data());
+        current.swap(next);
+        width  = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+
+    texture->format = (compress && !image.has_alpha) ? TEXTURE_FORMAT_BC1 : TEXTURE_FORMAT_RGBA8;
+    LayoutLevels(texture, width, height);
+
+    for (size_t l = 0; l < texture->levels.size(); ++l)
+    {
+        const TextureLevel& level = texture->levels[l];
+        if ( l > 0 )
+        {
+            const TextureLevel& previous = texture->levels[l-1];
+            next.resize((size_t)level.width * level.height * 4);
+            Downsample(current.data(), previous.width, previous.height, next.data());
+            current.swap(next);
+        }
+
+        unsigned char* out = &texture->data[level.offset];
+        if ( texture->format == TEXTURE_FORMAT_BC1 )
+            CompressLevel(current.data(), level.width, level.height, out);
+        else
+            memcpy(out, current.data(), level.size);
+    }
+}
+
+void Texture_Decompress(TextureData* texture)
+{
+    if ( texture->format != TEXTURE_FORMAT_BC1 )
+        return;
+
+    TextureData result;
+    result.format = TEXTURE_FORMAT_RGBA8;
+    LayoutLevels(&result, texture->levels[0].width, texture->levels[0].height);
+
+    unsigned char block[64];
+    for (size_t l = 0; l < result.levels.size(); ++l)
+    {
+        const TextureLevel& level = result.levels[l];
+        const unsigned char* in = &texture->data[texture->levels[l].offset];
+        unsigned char* out = &result.data[level.offset];
+        for (size_t by = 0; by < BlocksAcross(level.height); ++by)
+        {
+            for (size_t bx = 0; bx < BlocksAcross(level.width); ++bx, in += 8)
+            {
+                DecompressBlock(in, block);
+                for (int i = 0; i < 16; ++i)
+                {
+                    const size_t x = 4*bx + i % 4;
+                    const size_t y = 4*by + i / 4;
+                    if ( x < (size_t)level.width && y < (size_t)level.height )
+                        memcpy(&out[4*(y * level.width + x)], &block[4*i], 4);
+                }
+            }
+        }
+    }
+
+    std::swap(*texture, result);
+}
+
+// ---------------------------------------------------------------------------
+// Memória
+
+size_t Texture_ReserveMemory(TextureData* texture)
+{
+    size_t first = 0;
+    size_t size  = texture->data.size();
+    size_t used  = g_Texture.memory_used.load();
+    for (;;)
+    {
+        first = 0;
+        size  = texture->data.size();
+        while ( first + 1 < texture->levels.size() && used + size > TEXTURE_MEMORY_BUDGET )
+            size -= texture->levels[first++].size;
+
+        if ( g_Texture.memory_used.compare_exchange_weak(used, used + size) )
+            break;
+    }
+
+    if ( first > 0 )
+    {
+        // Os níveis restantes passam a começar na posição 0 de "data".
+        const size_t skipped = texture->levels[first].offset;
+        texture->levels.erase(texture->levels.begin(), texture->levels.begin() + first);
+        for (size_t l = 0; l < texture->levels.size(); ++l)
+            texture->levels[l].offset -= skipped;
+        texture->data.erase(texture->data.begin(), texture->data.begin() + skipped);
+    }
+    return size;
+}
+
+void Texture_ReleaseMemory(size_t size)
+{
+    g_Texture.memory_used -= size;
+}
+
+size_t Texture_MemoryUsed()
+{
+    return g_Texture.memory_used.load();
+}
+
+// ---------------------------------------------------------------------------
+// GPU
+
+GLuint Texture_CreateGpuTexture(const TextureData& texture)
+{
+    const GLenum internal_format = (texture.format == TEXTURE_FORMAT_BC1) ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_SRGB8_ALPHA8;
+
+    GLuint texture_id;
+    glGenTextures(1, &texture_id);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+
+    // Alocamos todos os níveis sem dados; eles são preenchidos depois com
+    // glTexSubImage2D() ou glCompressedTexSubImage2D().
+    for (size_t l = 0; l < texture.levels.size(); ++l)
+        glTexImage2D(GL_TEXTURE_2D, l, internal_format, texture.levels[l].width, texture.levels[l].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levels.size() - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture_id;
+}
+
+bool Texture_UploadChunk(const TextureData& texture, GLuint texture_id, TextureUpload* upload, size_t max_bytes)
+{
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+
+    size_t sent = 0;
+    while ( upload->level < texture.levels.size() && (sent == 0 || sent < max_bytes) )
+    {
+        const TextureLevel& level = texture.levels[upload->level];
+        const unsigned char* data = &texture.data[level.offset];
+
+        if ( texture.format == TEXTURE_FORMAT_BC1 )
+        {
+            // Linhas de blocos inteiras (4 linhas de pixels cada).
+            const size_t row_size = BlocksAcross(level.width) * 8;
+            const size_t rows = std::max((max_bytes - sent) / row_size, (size_t)1);
+            const int first = upload->row;
+            const int count = (int)std::min(4 * std::min(rows, BlocksAcross(level.height)), (size_t)(level.height - first));
+            const size_t size = BlocksAcross(count) * row_size;
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, upload->level, 0, first, level.width, count,
+                                      GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, size, data + (first / 4) * row_size);
+            upload->row += count;
+            sent += size;
+        }
+        else
+        {
+            const size_t row_size = (size_t)level.width * 4;
+            const size_t rows = std::max((max_bytes - sent) / row_size, (size_t)1);
+            const int first = upload->row;
+            const int count = (int)std::min(rows, (size_t)(level.height - first));
+            glTexSubImage2D(GL_TEXTURE_2D, upload->level, 0, first, level.width, count,
+                            GL_RGBA, GL_UNSIGNED_BYTE, data + first * row_size);
+            upload->row += count;
+            sent += count * row_size;
+        }
+
+        if ( upload->row >= level.height )
+        {
+            upload->level += 1;
+            upload->row = 0;
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return upload->level >= texture.levels.size();
+}
+
+GLuint Texture_Upload(const TextureData& texture)
+{
+    GLuint texture_id = Texture_CreateGpuTexture(texture);
+    TextureUpload upload;
+    while ( !Texture_UploadChunk(texture, texture_id, &upload, (size_t)-1) )
+        ;
+    return texture_id;
+}
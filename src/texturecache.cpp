@@ -0,0 +1,227 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+#include "texturecache.h"
+#include "mappedfile.h"
+
+struct TextureCacheLevel
+{
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset; // Posição do nível dentro do arquivo, em bytes
+    uint64_t size;   // Tamanho do nível, em bytes
+};
+
+struct TextureCacheHeader
+{
+    char              magic[8];     // "FCGTEX"
+    uint32_t          version;      // TEXTURECACHE_VERSION
+    uint32_t          header_size;  // sizeof(TextureCacheHeader)
+    uint64_t          path_hash;    // Hash do caminho da imagem
+    uint64_t          source_size;  // Tamanho da imagem em bytes
+    int64_t           source_mtime; // Data de modificação da imagem ao gravar o cache, que também a recebe
+    uint64_t          source_hash;  // Hash do conteúdo da imagem
+    uint64_t          file_size;    // Tamanho total do arquivo de cache
+    uint32_t          format;       // TextureFormat
+    uint32_t          num_levels;
+    TextureCacheLevel levels[TEXTURE_MAX_LEVELS];
+};
+
+static const char   TEXTURECACHE_MAGIC[8] = "FCGTEX";
+static const size_t TEXTURECACHE_ALIGNMENT = 16;
+
+static_assert(sizeof(TextureCacheHeader) % TEXTURECACHE_ALIGNMENT == 0, "TextureCacheHeader deve ser alinhado");
+
+static uint64_t HashString(const char* str)
+{
+    return HashBytes(str, strlen(str));
+}
+
+// Computa o hash do conteúdo de um arquivo. Retorna false se o arquivo não
+// puder ser lido.
+static bool HashFileContents(const char* filename, uint64_t* hash)
+{
+    MappedFile source;
+    if ( !MapFile(filename, &source) )
+        return false;
+
+    *hash = HashBytes(source.data, source.size);
+    UnmapFile(&source);
+    return true;
+}
+
+std::string TextureCache_Path(const char* source_filename)
+{
+    return std::string(source_filename) + ".texcache";
+}
+
+// Confere o cabeçalho e os níveis de "base" e copia a textura para
+// "texture". Cada nível deve ter metade do tamanho do anterior, terminando
+// em 1x1, e estar inteiro dentro do arquivo.
+static bool ParseCacheData(const unsigned char* base, size_t size, TextureData* texture)
+{
+    if ( size < sizeof(TextureCacheHeader) )
+        return false;
+
+    const TextureCacheHeader* header = reinterpret_cast<const TextureCacheHeader*>(base);
+
+    if (    memcmp(header->magic, TEXTURECACHE_MAGIC, sizeof(TEXTURECACHE_MAGIC)) != 0
+         || header->version     != TEXTURECACHE_VERSION
+         || header->header_size != sizeof(TextureCacheHeader)
+         || header->file_size   != size
+         || header->format      >  TEXTURE_FORMAT_BC1
+         || header->num_levels  == 0
+         || header->num_levels  >  TEXTURE_MAX_LEVELS )
+        return false;
+
+    const TextureFormat format = (TextureFormat)header->format;
+    const TextureCacheLevel& first = header->levels[0];
+    if ( first.width == 0 || first.height == 0 || first.width > TEXTURE_MAX_SIZE || first.height > TEXTURE_MAX_SIZE )
+        return false;
+
+    uint32_t width = first.width, height = first.height;
+    for (uint32_t l = 0; l < header->num_levels; ++l)
+    {
+        const TextureCacheLevel& level = header->levels[l];
+        const bool last = (l + 1 == header->num_levels);
+        if (    level.width  != width
+             || level.height != height
+             || level.size   != Texture_LevelSize(format, width, height)
+             || level.offset > size
+             || level.size   > size - level.offset
+             || last != (width == 1 && height == 1) )
+            return false;
+
+        width  = (width  > 1) ? width / 2 : 1;
+        height = (height > 1) ? height / 2 : 1;
+    }
+
+    // Os níveis são copiados para um único vetor, como em Texture_Build():
+    // Texture_ReserveMemory() e Texture_Decompress() podem modificá-los.
+    texture->format = format;
+    texture->levels.resize(header->num_levels);
+    size_t offset = 0;
+    for (uint32_t l = 0; l < header->num_levels; ++l)
+    {
+        texture->levels[l].width  = header->levels[l].width;
+        texture->levels[l].height = header->levels[l].height;
+        texture->levels[l].offset = offset;
+        texture->levels[l].size   = header->levels[l].size;
+        offset += header->levels[l].size;
+    }
+    texture->data.resize(offset);
+    for (uint32_t l = 0; l < header->num_levels; ++l)
+        memcpy(&texture->data[texture->levels[l].offset], base + header->levels[l].offset, header->levels[l].size);
+
+    return true;
+}
+
+bool TextureCache_Load(const char* source_filename, TextureData* texture)
+{
+    FileStamp stamp;
+    if ( !GetFileStamp(source_filename, &stamp) )
+        return false;
+
+    std::string cache_path = TextureCache_Path(source_filename);
+    MappedFile file;
+    if ( !MapFile(cache_path.c_str(), &file) )
+        return false;
+
+    const TextureCacheHeader* header = reinterpret_cast<const TextureCacheHeader*>(file.data);
+    bool ok = file.size >= sizeof(TextureCacheHeader)
+           && header->path_hash   == HashString(source_filename)
+           && header->source_size == stamp.size;
+
+    // O cache tem a data de modificação da imagem (veja
+    // TextureCache_Store()). Se as datas diferem, conferimos o conteúdo da
+    // imagem e atualizamos a data do cache, como em MeshCache_Load().
+    FileStamp cache_stamp;
+    bool update_mtime = false;
+    if ( ok && (!GetFileStamp(cache_path.c_str(), &cache_stamp) || cache_stamp.mtime != stamp.mtime) )
+    {
+        uint64_t hash;
+        ok = HashFileContents(source_filename, &hash) && hash == header->source_hash;
+        update_mtime = ok;
+    }
+
+    ok = ok && ParseCacheData(file.data, file.size, texture);
+    UnmapFile(&file);
+
+    if ( ok && update_mtime )
+        SetFileMtime(cache_path.c_str(), stamp.mtime);
+
+    return ok;
+}
+
+bool TextureCache_LoadFromMemory(const void* data, size_t size, TextureData* texture)
+{
+    return ParseCacheData(static_cast<const unsigned char*>(data), size, texture);
+}
+
+bool TextureCache_Store(const char* source_filename, const TextureData& texture)
+{
+    if ( texture.levels.empty() || texture.levels.size() > TEXTURE_MAX_LEVELS )
+        return false;
+
+    TextureCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TEXTURECACHE_MAGIC, sizeof(TEXTURECACHE_MAGIC));
+    header.version     = TEXTURECACHE_VERSION;
+    header.header_size = sizeof(TextureCacheHeader);
+    header.path_hash   = HashString(source_filename);
+    header.format      = texture.format;
+    header.num_levels  = texture.levels.size();
+
+    FileStamp stamp;
+    if ( !GetFileStamp(source_filename, &stamp) || !HashFileContents(source_filename, &header.source_hash) )
+        return false;
+    header.source_size  = stamp.size;
+    header.source_mtime = stamp.mtime;
+
+    // Os níveis ficam logo após o cabeçalho, cada um alinhado em
+    // TEXTURECACHE_ALIGNMENT bytes.
+    uint64_t offset = sizeof(TextureCacheHeader);
+    for (size_t l = 0; l < texture.levels.size(); ++l)
+    {
+        header.levels[l].width  = texture.levels[l].width;
+        header.levels[l].height = texture.levels[l].height;
+        header.levels[l].offset = offset;
+        header.levels[l].size   = texture.levels[l].size;
+        offset += (texture.levels[l].size + TEXTURECACHE_ALIGNMENT - 1) / TEXTURECACHE_ALIGNMENT * TEXTURECACHE_ALIGNMENT;
+    }
+    header.file_size = offset;
+
+    // Escrevemos em um arquivo temporário e o renomeamos ao final, como em
+    // MeshCache_Store().
+    std::string cache_path = TextureCache_Path(source_filename);
+    std::string temp_path  = cache_path + ".tmp";
+
+    FILE* f = fopen(temp_path.c_str(), "wb");
+    if ( f == NULL )
+        return false;
+
+    static const unsigned char zeros[TEXTURECACHE_ALIGNMENT] = {0};
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    for (size_t l = 0; ok && l < texture.levels.size(); ++l)
+    {
+        const TextureLevel& level = texture.levels[l];
+        const size_t padding = (TEXTURECACHE_ALIGNMENT - level.size % TEXTURECACHE_ALIGNMENT) % TEXTURECACHE_ALIGNMENT;
+        ok = fwrite(&texture.data[level.offset], 1, level.size, f) == level.size;
+        ok = ok && (padding == 0 || fwrite(zeros, 1, padding, f) == padding);
+    }
+    ok = (fclose(f) == 0) && ok;
+    ok = ok && SetFileMtime(temp_path.c_str(), stamp.mtime);
+
+    if ( ok )
+    {
+        remove(cache_path.c_str()); // rename() não sobrescreve arquivos no Windows
+        ok = rename(temp_path.c_str(), cache_path.c_str()) == 0;
+    }
+
+    if ( !ok )
+        remove(temp_path.c_str());
+
+    return ok;
+}
@@ -0,0 +1,228 @@
+// Gera o pacote de assets lido por main() (veja "assetpack.h").
+//
+// Cada arquivo passado na linha de comando vira um asset, com nome dado por
+// AssetPack_Name() (por exemplo, "../../data/bunny.obj" vira
+// "data/bunny.obj"). O tipo é escolhido pela extensão:
+//
+//   - ".obj": a malha é processada como em PrepareModel() (normais,
+//     otimização, níveis de detalhe e clusters) e guardada no formato de
+//     "meshcache.h". Se já existir um cache válido ao lado do ".obj", ele é
+//     reaproveitado. As texturas dos materiais também são incluídas;
+//   - ".glsl", ".vert" e ".frag": código-fonte de shaders;
+//   - ".tga", ".bmp", ".ppm" e ".pgm": texturas, já com mipmaps e
+//     comprimidas, no formato de "texturecache.h" (como em PrepareTexture());
+//   - outros: bytes do arquivo, sem interpretação.
+//
+// A fonte de "dejavufont.h" é sempre incluída, como "fonts/dejavu".
+//
+// Uso: assetpack [-o saída] arquivo ...   (saída padrão: "assets.pack")
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "assetpack.h"
+#include "mesh.h"
+#include "meshcache.h"
+#include "meshnormals.h"
+#include "meshopt.h"
+#include "meshlod.h"
+#include "meshcluster.h"
+#include "texture.h"
+#include "texturecache.h"
+#include "dejavufont.h"
+
+// Lê um arquivo inteiro para "data".
+static bool ReadFile(const char* filename, std::vector<unsigned char>* data)
+{
+    MappedFile file;
+    if ( !MapFile(filename, &file) )
+        return false;
+
+    data->assign(file.data, file.data + file.size);
+    UnmapFile(&file);
+    return true;
+}
+
+static bool HasExtension(const std::string& filename, const char* extension)
+{
+    size_t n = strlen(extension);
+    return filename.size() >= n && filename.compare(filename.size() - n, n, extension) == 0;
+}
+
+static AssetType AssetTypeFromFilename(const std::string& filename)
+{
+    static const char* textures[] = { ".tga", ".bmp", ".ppm", ".pgm" };
+
+    if ( HasExtension(filename, ".obj") )
+        return ASSET_MESH;
+    if ( HasExtension(filename, ".glsl") || HasExtension(filename, ".vert") || HasExtension(filename, ".frag") )
+        return ASSET_SHADER;
+    for (size_t i = 0; i < sizeof(textures)/sizeof(textures[0]); ++i)
+        if ( HasExtension(filename, textures[i]) )
+            return ASSET_TEXTURE;
+    return ASSET_RAW;
+}
+
+// Gera (ou reaproveita) o cache de malha de um ".obj" e o lê para "data".
+static bool BuildMeshAsset(const char* filename, std::vector<unsigned char>* data)
+{
+    MeshCacheEntry cached;
+    if ( MeshCache_Load(filename, &cached) )
+    {
+        MeshCache_Close(&cached);
+    }
+    else
+    {
+        ObjModel model(filename);
+        MeshNormals_Compute(&model);
+
+        MeshData mesh;
+        BuildMeshData(&model, &mesh);
+
+        MeshOptReport report;
+        MeshOpt_OptimizeMesh(&mesh, &report);
+        MeshOpt_PrintReport(report);
+        MeshLod_GenerateLods(&mesh);
+        MeshCluster_GenerateClusters(&mesh);
+
+        if ( !MeshCache_Store(filename, mesh) )
+            return false;
+    }
+
+    return ReadFile(MeshCache_Path(filename).c_str(), data);
+}
+
+// Gera (ou reaproveita) o cache de textura de uma imagem e o lê para "data".
+// O cache é sempre comprimido quando possível; a GPU que não suportar BC1
+// o descomprime ao carregar (veja PrepareTexture() em "main.cpp").
+static bool BuildTextureAsset(const char* filename, std::vector<unsigned char>* data)
+{
+    TextureData texture;
+    if ( !TextureCache_Load(filename, &texture) )
+    {
+        std::vector<unsigned char> file;
+        if ( !ReadFile(filename, &file) )
+            return false;
+
+        TextureImage image;
+        Texture_Decode(file.data(), file.size(), filename, &image);
+        Texture_Build(image, true, &texture);
+
+        if ( !TextureCache_Store(filename, texture) )
+            return false;
+    }
+
+    return ReadFile(TextureCache_Path(filename).c_str(), data);
+}
+
+// Acrescenta a "files" as texturas dos materiais de uma malha já convertida
+// por BuildMeshAsset(), se os arquivos existirem.
+static void AddMaterialTextures(const char* mesh_filename, const std::vector<unsigned char>& mesh_data, std::vector<std::string>* files)
+{
+    MeshCacheEntry cached;
+    if ( !MeshCache_LoadFromMemory(mesh_data.data(), mesh_data.size(), &cached) )
+        return;
+
+    for (size_t m = 0; m < cached.buffers.materials.size(); ++m)
+    {
+        const std::string& texname = cached.buffers.materials[m].diffuse_texname;
+        if ( texname.empty() )
+            continue;
+
+        std::string path = MeshDirectory(mesh_filename) + texname;
+        FileStamp stamp;
+        if ( GetFileStamp(path.c_str(), &stamp) )
+            files->push_back(path);
+        else
+            fprintf(stderr, "WARNING: Texture \"%s\" of \"%s\" not found.\n", path.c_str(), mesh_filename);
+    }
+    MeshCache_Close(&cached);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* output = ASSETPACK_DEFAULT_FILENAME;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if ( strcmp(argv[i], "-o") == 0 && i + 1 < argc )
+            output = argv[++i];
+        else
+            files.push_back(argv[i]);
+    }
+
+    if ( files.empty() )
+    {
+        fprintf(stderr, "Uso: assetpack [-o saída] arquivo ...\n");
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::vector<AssetPackInput> assets;
+    std::set<std::string> names;
+    size_t total_size = 0;
+
+    // "files" cresce durante o laço com as texturas dos materiais.
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        const std::string path = files[i]; // Cópia: "files" pode ser realocado
+        const char* filename = path.c_str();
+
+        AssetPackInput asset;
+        asset.name = AssetPack_Name(filename);
+        asset.type = AssetTypeFromFilename(asset.name);
+        if ( !names.insert(asset.name).second )
+            continue;
+
+        bool ok;
+        try
+        {
+            if ( asset.type == ASSET_MESH )
+                ok = BuildMeshAsset(filename, &asset.data);
+            else if ( asset.type == ASSET_TEXTURE )
+                ok = BuildTextureAsset(filename, &asset.data);
+            else
+                ok = ReadFile(filename, &asset.data);
+        }
+        catch ( const std::exception& e )
+        {
+            fprintf(stderr, "ERROR: %s\n", e.what());
+            ok = false;
+        }
+
+        if ( !ok )
+        {
+            fprintf(stderr, "ERROR: Cannot add file \"%s\".\n", filename);
+            std::exit(EXIT_FAILURE);
+        }
+
+        if ( asset.type == ASSET_MESH )
+            AddMaterialTextures(filename, asset.data, &files);
+
+        printf("%-40s %10zu bytes\n", asset.name.c_str(), asset.data.size());
+        total_size += asset.data.size();
+        assets.push_back(asset);
+    }
+
+    AssetPackInput font;
+    font.name = "fonts/dejavu";
+    font.type = ASSET_FONT;
+    font.data.assign(reinterpret_cast<const unsigned char*>(&dejavufont), reinterpret_cast<const unsigned char*>(&dejavufont + 1));
+    printf("%-40s %10zu bytes\n", font.name.c_str(), font.data.size());
+    total_size += font.data.size();
+    assets.push_back(font);
+
+    if ( !AssetPack_Write(output, assets) )
+    {
+        fprintf(stderr, "ERROR: Cannot write asset pack \"%s\".\n", output);
+        std::exit(EXIT_FAILURE);
+    }
+
+    printf("%zu assets (%zu bytes) gravados em \"%s\".\n", assets.size(), total_size, output);
+    return 0;
+}
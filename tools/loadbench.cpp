@@ -0,0 +1,486 @@
+// Benchmark das etapas de carregamento de modelos, sem janela e sem OpenGL.
+//
+// Para cada arquivo ".obj" passado na linha de comando (por padrão,
+// "../../data/bunny.obj") e para um conjunto de arquivos sintéticos (veja
+// WriteSyntheticObj()), mede separadamente cada etapa de PrepareModel() em
+// "main.cpp":
+//
+//   - "parse":          tinyobj::LoadObj(), em uma única thread;
+//   - "parse_parallel": tinyobj::LoadObjParallel(), usada por ObjModel;
+//   - "normals":        MeshNormals_Compute(), sempre sobre o modelo sem as
+//                       normais do arquivo;
+//   - "build":          BuildMeshData(), a parte da construção dos buffers
+//                       que não usa OpenGL;
+//   - "optimize", "lods" e "clusters": MeshOpt_OptimizeMesh(),
+//                       MeshLod_GenerateLods() e MeshCluster_GenerateClusters();
+//   - "encode":         MeshQuant_EncodeMesh(), a conversão para o formato
+//                       da GPU (o envio em si precisa de um contexto OpenGL);
+//   - "cache_store" e "cache_load": gravação e leitura do cache de malha.
+//
+// Cada etapa é executada "repetições" vezes e o menor tempo é mantido. Os
+// resultados são gravados em JSON, com a vazão de cada etapa em MB/s (do
+// arquivo ".obj") e em triângulos/s, para acompanhar o desempenho do
+// carregamento entre versões. Um resumo é impresso na saída padrão.
+//
+// Uso: loadbench [-r repetições] [-o saída] [-v vértices] [arquivo.obj ...]
+//      (saída padrão: "loadbench.json"; "-v" é o número de vértices de cada
+//      arquivo sintético)
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <thread>
+#include <stdexcept>
+
+#include "mesh.h"
+#include "meshcache.h"
+#include "meshnormals.h"
+#include "meshopt.h"
+#include "meshlod.h"
+#include "meshcluster.h"
+#include "meshquant.h"
+#include "mappedfile.h"
+
+// Etapas medidas, na ordem em que são executadas.
+enum BenchStage
+{
+    STAGE_PARSE,
+    STAGE_PARSE_PARALLEL,
+    STAGE_NORMALS,
+    STAGE_BUILD,
+    STAGE_OPTIMIZE,
+    STAGE_LODS,
+    STAGE_CLUSTERS,
+    STAGE_ENCODE,
+    STAGE_CACHE_STORE,
+    STAGE_CACHE_LOAD,
+    NUM_STAGES
+};
+
+static const char* g_StageNames[NUM_STAGES] = {
+    "parse", "parse_parallel", "normals", "build", "optimize", "lods", "clusters", "encode", "cache_store", "cache_load"
+};
+
+// Parâmetros de um arquivo ".obj" sintético.
+struct SyntheticObj
+{
+    const char* name;
+    size_t      num_vertices;     // Aproximado: os vértices formam uma grade
+    int         face_arity;       // Número de vértices de cada face (>= 3)
+    bool        normals;          // Escreve linhas "vn"
+    bool        texcoords;        // Escreve linhas "vt"
+    bool        negative_indices; // Índices relativos ao fim da lista
+};
+
+// Resultado de um arquivo de entrada.
+struct BenchResult
+{
+    std::string         name;
+    std::string         filename;
+    const SyntheticObj* synthetic; // NULL para arquivos da linha de comando
+    uint64_t            bytes;
+    size_t              num_vertices;
+    size_t              num_triangles;
+    double              seconds[NUM_STAGES];
+
+    BenchResult() : synthetic(NULL), bytes(0), num_vertices(0), num_triangles(0)
+    {
+        for (int s = 0; s < NUM_STAGES; ++s)
+            seconds[s] = 1e30;
+    }
+};
+
+// Destino dos resultados, para que o compilador não elimine a leitura do
+// cache.
+static volatile uint64_t g_Sink;
+
+static double NowSeconds()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Mantém em "best" o menor tempo desde "start".
+static void RecordTime(double start, double* best)
+{
+    double elapsed = NowSeconds() - start;
+    if ( elapsed < *best )
+        *best = elapsed;
+}
+
+// Altura do terreno dos arquivos sintéticos em (x, z), e suas derivadas
+// (para as normais).
+static float TerrainHeight(float x, float z, float* dx, float* dz)
+{
+    *dx =  0.3f * cosf(3.0f*x) * cosf(2.0f*z);
+    *dz = -0.2f * sinf(3.0f*x) * sinf(2.0f*z);
+    return 0.1f * sinf(3.0f*x) * cosf(2.0f*z);
+}
+
+// Escreve um índice de face "v", "v/vt", "v//vn" ou "v/vt/vn". Todos os
+// atributos têm o mesmo índice, já que existe um de cada por vértice.
+static void WriteFaceIndex(FILE* f, const SyntheticObj& params, long index, long num_vertices)
+{
+    long i = params.negative_indices ? index - num_vertices - 1 : index;
+
+    if ( params.texcoords && params.normals )
+        fprintf(f, " %ld/%ld/%ld", i, i, i);
+    else if ( params.texcoords )
+        fprintf(f, " %ld/%ld", i, i);
+    else if ( params.normals )
+        fprintf(f, " %ld//%ld", i, i);
+    else
+        fprintf(f, " %ld", i);
+}
+
+// Gera um terreno em grade com os parâmetros de "params". O arquivo é sempre
+// o mesmo para os mesmos parâmetros: as perturbações das posições vêm de um
+// gerador com semente fixa.
+//
+// Faces de 3 vértices dividem cada célula da grade em dois triângulos. Faces
+// com k >= 4 vértices cobrem (k-1)/2 células vizinhas de uma linha da grade,
+// passando pelos vértices das duas bordas da faixa; se k for ímpar, um
+// vértice interno da borda superior é omitido. As células que sobram no fim
+// de cada linha ficam sem faces.
+static bool WriteSyntheticObj(const char* filename, const SyntheticObj& params)
+{
+    FILE* f = fopen(filename, "wb");
+    if ( f == NULL )
+        return false;
+
+    long width  = std::max(2L, (long)ceil(sqrt((double)params.num_vertices)));
+    long height = std::max(2L, (long)((params.num_vertices + width - 1) / width));
+    long num_vertices = width * height;
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> jitter(-0.001f, 0.001f);
+
+    fprintf(f, "# loadbench: %s\no %s\n", params.name, params.name);
+
+    for (long j = 0; j < height; ++j)
+        for (long i = 0; i < width; ++i)
+        {
+            float x = (float)i / (width - 1), z = (float)j / (height - 1), dx, dz;
+            float y = TerrainHeight(x, z, &dx, &dz);
+            fprintf(f, "v %.6f %.6f %.6f\n", x + jitter(rng), y + jitter(rng), z + jitter(rng));
+        }
+
+    if ( params.texcoords )
+        for (long j = 0; j < height; ++j)
+            for (long i = 0; i < width; ++i)
+                fprintf(f, "vt %.6f %.6f\n", (float)i / (width - 1), (float)j / (height - 1));
+
+    if ( params.normals )
+        for (long j = 0; j < height; ++j)
+            for (long i = 0; i < width; ++i)
+            {
+                float dx, dz;
+                TerrainHeight((float)i / (width - 1), (float)j / (height - 1), &dx, &dz);
+                float length = sqrtf(dx*dx + 1.0f + dz*dz);
+                fprintf(f, "vn %.4f %.4f %.4f\n", -dx/length, 1.0f/length, -dz/length);
+            }
+
+    int arity = std::max(3, params.face_arity);
+    long cells = (arity == 3) ? 1 : (arity - 1) / 2;
+    bool odd   = (arity > 3) && (arity % 2 == 1);
+
+    for (long j = 0; j + 1 < height; ++j)
+    {
+        long bottom = j*width + 1;    // Índice (a partir de 1) do vértice (0, j)
+        long top    = bottom + width; // Vértice (0, j+1)
+
+        for (long i = 0; i + cells < width; i += cells)
+        {
+            if ( arity == 3 )
+            {
+                fputc('f', f);
+                WriteFaceIndex(f, params, bottom + i,     num_vertices);
+                WriteFaceIndex(f, params, top + i + 1,    num_vertices);
+                WriteFaceIndex(f, params, bottom + i + 1, num_vertices);
+                fputs("\nf", f);
+                WriteFaceIndex(f, params, bottom + i,     num_vertices);
+                WriteFaceIndex(f, params, top + i,        num_vertices);
+                WriteFaceIndex(f, params, top + i + 1,    num_vertices);
+                fputc('\n', f);
+                continue;
+            }
+
+            fputc('f', f);
+            for (long k = cells; k >= 0; --k)
+                WriteFaceIndex(f, params, bottom + i + k, num_vertices);
+            for (long k = 0; k <= cells; ++k)
+                if ( !(odd && k == 1) )
+                    WriteFaceIndex(f, params, top + i + k, num_vertices);
+            fputc('\n', f);
+        }
+    }
+
+    bool ok = ferror(f) == 0;
+    ok = (fclose(f) == 0) && ok;
+    return ok;
+}
+
+// Remove as normais lidas do arquivo, para que MeshNormals_Compute() sempre
+// tenha trabalho a fazer.
+static void RemoveNormals(ObjModel* model)
+{
+    model->attrib.normals.clear();
+    for (size_t s = 0; s < model->shapes.size(); ++s)
+    {
+        std::vector<tinyobj::index_t>& indices = model->shapes[s].mesh.indices;
+        for (size_t i = 0; i < indices.size(); ++i)
+            indices[i].normal_index = -1;
+    }
+}
+
+// Executa todas as etapas "repetitions" vezes sobre "filename".
+static void BenchmarkFile(const char* filename, int repetitions, BenchResult* result)
+{
+    FileStamp stamp;
+    if ( !GetFileStamp(filename, &stamp) )
+        throw std::runtime_error("Cannot open file \"" + std::string(filename) + "\"");
+    result->bytes = stamp.size;
+
+    std::string directory  = MeshDirectory(filename);
+    std::string cache_path = std::string(filename) + ".loadbench";
+
+    for (int r = 0; r < repetitions; ++r)
+    {
+        std::string err;
+
+        ObjModel serial;
+        double start = NowSeconds();
+        bool ok = tinyobj::LoadObj(&serial.attrib, &serial.shapes, &serial.materials, &err, filename, directory.c_str());
+        RecordTime(start, &result->seconds[STAGE_PARSE]);
+        if ( !ok )
+            throw std::runtime_error("Cannot load \"" + std::string(filename) + "\": " + err);
+
+        ObjModel model;
+        start = NowSeconds();
+        ok = tinyobj::LoadObjParallel(&model.attrib, &model.shapes, &model.materials, &err, filename, directory.c_str());
+        RecordTime(start, &result->seconds[STAGE_PARSE_PARALLEL]);
+        if ( !ok )
+            throw std::runtime_error("Cannot load \"" + std::string(filename) + "\": " + err);
+
+        // Libera a memória antes das próximas etapas.
+        serial = ObjModel();
+
+        // Se o arquivo tem normais, elas são mantidas nas etapas seguintes,
+        // como em PrepareModel().
+        bool has_normals = !model.attrib.normals.empty();
+        ObjModel without_normals;
+        if ( has_normals )
+        {
+            without_normals = model;
+            RemoveNormals(&without_normals);
+        }
+        ObjModel* normals_model = has_normals ? &without_normals : &model;
+
+        start = NowSeconds();
+        MeshNormals_Compute(normals_model);
+        RecordTime(start, &result->seconds[STAGE_NORMALS]);
+        without_normals = ObjModel();
+
+        MeshData mesh;
+        start = NowSeconds();
+        BuildMeshData(&model, &mesh);
+        RecordTime(start, &result->seconds[STAGE_BUILD]);
+
+        result->num_vertices  = model.attrib.vertices.size() / 3;
+        result->num_triangles = mesh.indices.size() / 3;
+        model = ObjModel();
+
+        MeshOptReport report;
+        start = NowSeconds();
+        MeshOpt_OptimizeMesh(&mesh, &report);
+        RecordTime(start, &result->seconds[STAGE_OPTIMIZE]);
+
+        start = NowSeconds();
+        MeshLod_GenerateLods(&mesh);
+        RecordTime(start, &result->seconds[STAGE_LODS]);
+
+        start = NowSeconds();
+        MeshCluster_GenerateClusters(&mesh);
+        RecordTime(start, &result->seconds[STAGE_CLUSTERS]);
+
+        MeshEncodedData encoded;
+        start = NowSeconds();
+        MeshQuant_EncodeMesh(GetMeshBuffers(mesh), &encoded);
+        RecordTime(start, &result->seconds[STAGE_ENCODE]);
+
+        start = NowSeconds();
+        ok = MeshCache_StoreTile(cache_path.c_str(), 0, mesh);
+        RecordTime(start, &result->seconds[STAGE_CACHE_STORE]);
+        if ( !ok )
+            throw std::runtime_error("Cannot write \"" + cache_path + "\"");
+
+        // A leitura inclui percorrer os dados, já que as páginas do arquivo
+        // mapeado só são lidas quando acessadas.
+        MeshCacheEntry entry;
+        start = NowSeconds();
+        ok = MeshCache_LoadTile(cache_path.c_str(), 0, &entry);
+        if ( ok )
+            g_Sink = HashBytes(entry.file.data, entry.file.size);
+        RecordTime(start, &result->seconds[STAGE_CACHE_LOAD]);
+        MeshCache_Close(&entry);
+        remove(cache_path.c_str());
+        if ( !ok )
+            throw std::runtime_error("Cannot read \"" + cache_path + "\"");
+    }
+}
+
+// Escreve "s" como uma string JSON.
+static void WriteJsonString(FILE* f, const std::string& s)
+{
+    fputc('"', f);
+    for (size_t i = 0; i < s.size(); ++i)
+    {
+        unsigned char c = s[i];
+        if ( c == '"' || c == '\\' )
+            fprintf(f, "\\%c", c);
+        else if ( c < 0x20 )
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+static bool WriteJson(const char* filename, const std::vector<BenchResult>& results, int repetitions)
+{
+    FILE* f = fopen(filename, "wb");
+    if ( f == NULL )
+        return false;
+
+    fprintf(f, "{\n  \"repetitions\": %d,\n  \"threads\": %u,\n  \"inputs\": [", repetitions, std::thread::hardware_concurrency());
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchResult& r = results[i];
+
+        fprintf(f, "%s\n    {\n      \"name\": ", (i > 0) ? "," : "");
+        WriteJsonString(f, r.name);
+        fprintf(f, ",\n      \"file\": ");
+        WriteJsonString(f, r.filename);
+        fprintf(f, ",\n");
+
+        if ( r.synthetic != NULL )
+            fprintf(f, "      \"synthetic\": { \"face_arity\": %d, \"normals\": %s, \"texcoords\": %s, \"negative_indices\": %s },\n",
+                    r.synthetic->face_arity, r.synthetic->normals ? "true" : "false", r.synthetic->texcoords ? "true" : "false",
+                    r.synthetic->negative_indices ? "true" : "false");
+
+        fprintf(f, "      \"bytes\": %llu,\n      \"vertices\": %zu,\n      \"triangles\": %zu,\n      \"stages\": {",
+                (unsigned long long)r.bytes, r.num_vertices, r.num_triangles);
+
+        for (int s = 0; s < NUM_STAGES; ++s)
+        {
+            double seconds = r.seconds[s];
+            fprintf(f, "%s\n        \"%s\": { \"seconds\": %.6f, \"mb_per_s\": %.2f, \"triangles_per_s\": %.0f }",
+                    (s > 0) ? "," : "", g_StageNames[s], seconds, r.bytes / seconds / 1e6, r.num_triangles / seconds);
+        }
+
+        fprintf(f, "\n      }\n    }");
+    }
+
+    fprintf(f, "\n  ]\n}\n");
+
+    bool ok = ferror(f) == 0;
+    ok = (fclose(f) == 0) && ok;
+    return ok;
+}
+
+static void PrintResult(const BenchResult& r)
+{
+    printf("%s: %.1f MB, %zu vértices, %zu triângulos\n", r.name.c_str(), r.bytes / 1e6, r.num_vertices, r.num_triangles);
+    for (int s = 0; s < NUM_STAGES; ++s)
+        printf("    %-15s %9.2f ms %9.1f MB/s %8.2f Mtri/s\n", g_StageNames[s], 1e3*r.seconds[s],
+               r.bytes / r.seconds[s] / 1e6, r.num_triangles / r.seconds[s] / 1e6);
+}
+
+int main(int argc, char* argv[])
+{
+    int repetitions = 3;
+    const char* output = "loadbench.json";
+    size_t synthetic_vertices = 250000;
+    std::vector<const char*> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if ( strcmp(argv[i], "-r") == 0 && i + 1 < argc )
+            repetitions = atoi(argv[++i]);
+        else if ( strcmp(argv[i], "-o") == 0 && i + 1 < argc )
+            output = argv[++i];
+        else if ( strcmp(argv[i], "-v") == 0 && i + 1 < argc )
+            synthetic_vertices = strtoul(argv[++i], NULL, 10);
+        else
+            files.push_back(argv[i]);
+    }
+
+    if ( files.empty() )
+        files.push_back("../../data/bunny.obj");
+
+    if ( repetitions < 1 )
+        repetitions = 1;
+
+    // Combinações comuns em arquivos exportados.
+    static SyntheticObj synthetic[] = {
+        { "sintetico_tri_v",        0, 3, false, false, false },
+        { "sintetico_tri_vt_vn",    0, 3, true,  true,  false },
+        { "sintetico_quad_vt",      0, 4, false, true,  false },
+        { "sintetico_quad_vn_neg",  0, 4, true,  false, true  },
+        { "sintetico_poly5_vt_neg", 0, 5, false, true,  true  },
+        { "sintetico_poly8_vt_vn",  0, 8, true,  true,  false },
+    };
+
+    std::vector<BenchResult> results;
+
+    try
+    {
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            BenchResult result;
+            result.name = result.filename = files[i];
+            BenchmarkFile(files[i], repetitions, &result);
+            PrintResult(result);
+            results.push_back(result);
+        }
+
+        for (size_t i = 0; i < sizeof(synthetic)/sizeof(synthetic[0]); ++i)
+        {
+            synthetic[i].num_vertices = synthetic_vertices;
+
+            BenchResult result;
+            result.name      = synthetic[i].name;
+            result.filename  = std::string(synthetic[i].name) + ".obj";
+            result.synthetic = &synthetic[i];
+
+            if ( !WriteSyntheticObj(result.filename.c_str(), synthetic[i]) )
+                throw std::runtime_error("Cannot write \"" + result.filename + "\"");
+
+            BenchmarkFile(result.filename.c_str(), repetitions, &result);
+            remove(result.filename.c_str());
+            PrintResult(result);
+            results.push_back(result);
+        }
+    }
+    catch ( const std::exception& e )
+    {
+        fprintf(stderr, "ERROR: %s\n", e.what());
+        std::exit(EXIT_FAILURE);
+    }
+
+    if ( !WriteJson(output, results, repetitions) )
+    {
+        fprintf(stderr, "ERROR: Cannot write \"%s\".\n", output);
+        std::exit(EXIT_FAILURE);
+    }
+
+    printf("Resultados gravados em \"%s\".\n", output);
+    return 0;
+}
@@ -0,0 +1,331 @@
+// Microbenchmark do interpretador de números da tinyobjloader.
+//
+// Compara o interpretador antigo (tryParseDouble() seguido de conversão para
+// float, e atoi() para índices) com o novo (tryParseFloat() e
+// parseIntBounded()) sobre:
+//
+//   - os números de cada arquivo ".obj" passado na linha de comando (por
+//     padrão, "../../data/bunny.obj");
+//   - conjuntos sintéticos de floats aleatórios escritos em formatos comuns.
+//
+// Para cada conjunto são informados o tempo por número, a vazão em MB/s e
+// quantos resultados diferem de strtof() (que arredonda corretamente).
+//
+// Uso: objbench [-r repetições] [arquivo.obj ...]
+//
+// Compile com -DTINYOBJLOADER_USE_SSE2 para medir a varredura de dígitos com
+// SSE2 (veja "tiny_obj_loader.h").
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+// Um número dentro de um texto: [begin, end).
+struct Token
+{
+    const char* begin;
+    const char* end;
+};
+
+// Conjunto de números a serem interpretados. "text" mantém os caracteres
+// vivos enquanto os tokens apontam para ele.
+struct TokenSet
+{
+    std::string        name;
+    std::string        text;
+    std::vector<Token> floats;
+    std::vector<Token> ints;
+};
+
+// Destino dos resultados, para que o compilador não elimine nem mova os
+// laços medidos para fora do intervalo cronometrado.
+static volatile double g_Sink;
+
+static double NowSeconds()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Separa os tokens de "set.text": coordenadas de linhas "v", "vn" e "vt" vão
+// para set.floats e índices de linhas "f" vão para set.ints.
+static void CollectObjTokens(TokenSet* set)
+{
+    const char* p   = set->text.data();
+    const char* end = p + set->text.size();
+
+    while (p < end)
+    {
+        const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (line_end == NULL)
+            line_end = end;
+
+        const char* q = p;
+        while (q < line_end && (*q == ' ' || *q == '\t'))
+            ++q;
+
+        bool is_float = (line_end - q > 2) && q[0] == 'v' && (q[1] == ' ' || ((q[1] == 'n' || q[1] == 't') && q[2] == ' '));
+        bool is_face  = (line_end - q > 1) && q[0] == 'f' && q[1] == ' ';
+
+        if ( is_float || is_face )
+        {
+            q += (q[1] == ' ') ? 2 : 3;
+            while (q < line_end)
+            {
+                while (q < line_end && (*q == ' ' || *q == '\t' || *q == '\r'))
+                    ++q;
+                if (q == line_end)
+                    break;
+
+                const char* token_end = q;
+                while (token_end < line_end && *token_end != ' ' && *token_end != '\t' && *token_end != '\r')
+                    ++token_end;
+
+                if ( is_float )
+                {
+                    Token t = { q, token_end };
+                    set->floats.push_back(t);
+                }
+                else
+                {
+                    // Índices "v/vt/vn": cada componente é um inteiro.
+                    const char* i = q;
+                    while (i < token_end)
+                    {
+                        const char* j = i;
+                        while (j < token_end && *j != '/')
+                            ++j;
+                        if (j > i)
+                        {
+                            Token t = { i, j };
+                            set->ints.push_back(t);
+                        }
+                        i = j + 1;
+                    }
+                }
+                q = token_end;
+            }
+        }
+
+        p = line_end + 1;
+    }
+}
+
+static bool LoadObjTokens(const char* filename, TokenSet* set)
+{
+    FILE* f = fopen(filename, "rb");
+    if ( f == NULL )
+        return false;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    set->name = filename;
+    set->text.resize(size);
+    bool ok = size == 0 || fread(&set->text[0], 1, size, f) == (size_t)size;
+    fclose(f);
+
+    if ( ok )
+        CollectObjTokens(set);
+    return ok;
+}
+
+// Gera "count" floats aleatórios escritos com o formato "format" de printf.
+static void MakeSyntheticTokens(const char* name, const char* format, float scale, size_t count, TokenSet* set)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> dist(-scale, scale);
+
+    set->name = name;
+
+    std::vector<size_t> offsets;
+    char buffer[64];
+    for (size_t i = 0; i < count; ++i)
+    {
+        int n = snprintf(buffer, sizeof(buffer), format, dist(rng));
+        offsets.push_back(set->text.size());
+        set->text.append(buffer, n);
+        offsets.push_back(set->text.size());
+        set->text.push_back(' ');
+    }
+
+    // Só montamos os ponteiros depois que "text" parou de crescer.
+    const char* base = set->text.data();
+    for (size_t i = 0; i < offsets.size(); i += 2)
+    {
+        Token t = { base + offsets[i], base + offsets[i+1] };
+        set->floats.push_back(t);
+    }
+}
+
+static float ParseFloatOld(const Token& t)
+{
+    double value = 0.0;
+    tinyobj::tryParseDouble(t.begin, t.end, &value);
+    return static_cast<float>(value);
+}
+
+static float ParseFloatNew(const Token& t)
+{
+    float value = 0.0f;
+    tinyobj::tryParseFloat(t.begin, t.end, &value);
+    return value;
+}
+
+// Referência com arredondamento correto.
+static float ParseFloatReference(const Token& t)
+{
+    std::string s(t.begin, t.end);
+    return strtof(s.c_str(), NULL);
+}
+
+static int ParseIntOld(const Token& t)
+{
+    // atoi() exige um terminador; as linhas originais terminam em ' ', '/'
+    // ou '\n', então podemos ler diretamente do texto.
+    return atoi(t.begin);
+}
+
+static int ParseIntNew(const Token& t)
+{
+    const char* p = t.begin;
+    return tinyobj::parseIntBounded(&p, t.end);
+}
+
+// Executa "parse" sobre todos os tokens "repetitions" vezes e retorna o
+// menor tempo de uma passada, em segundos.
+template <typename T, typename F>
+static double TimeParser(const std::vector<Token>& tokens, int repetitions, F parse)
+{
+    double best = 1e30;
+    for (int r = 0; r < repetitions; ++r)
+    {
+        T sum = 0;
+        double start = NowSeconds();
+        for (size_t i = 0; i < tokens.size(); ++i)
+            sum += parse(tokens[i]);
+        g_Sink = sum;
+        double elapsed = NowSeconds() - start;
+        if (elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+static size_t TokenBytes(const std::vector<Token>& tokens)
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < tokens.size(); ++i)
+        bytes += tokens[i].end - tokens[i].begin;
+    return bytes;
+}
+
+static void PrintTiming(const char* label, double seconds, size_t count, size_t bytes)
+{
+    printf("    %-6s %8.2f ns/num %9.1f MB/s\n", label, 1e9*seconds/count, bytes/seconds/1e6);
+}
+
+static void BenchmarkSet(const TokenSet& set, int repetitions)
+{
+    printf("%s\n", set.name.c_str());
+
+    if ( !set.floats.empty() )
+    {
+        size_t bytes = TokenBytes(set.floats);
+
+        size_t old_errors = 0, new_errors = 0;
+        for (size_t i = 0; i < set.floats.size(); ++i)
+        {
+            float reference = ParseFloatReference(set.floats[i]);
+            if ( ParseFloatOld(set.floats[i]) != reference ) ++old_errors;
+            if ( ParseFloatNew(set.floats[i]) != reference ) ++new_errors;
+        }
+
+        double t_old = TimeParser<float>(set.floats, repetitions, ParseFloatOld);
+        double t_new = TimeParser<float>(set.floats, repetitions, ParseFloatNew);
+
+        printf("  floats: %zu (%.1f MB)\n", set.floats.size(), bytes/1e6);
+        PrintTiming("antigo", t_old, set.floats.size(), bytes);
+        PrintTiming("novo",   t_new, set.floats.size(), bytes);
+        printf("    speedup %.2fx, diferentes de strtof: antigo %zu, novo %zu\n", t_old/t_new, old_errors, new_errors);
+    }
+
+    if ( !set.ints.empty() )
+    {
+        size_t bytes = TokenBytes(set.ints);
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < set.ints.size(); ++i)
+            if ( ParseIntOld(set.ints[i]) != ParseIntNew(set.ints[i]) )
+                ++mismatches;
+
+        double t_old = TimeParser<long long>(set.ints, repetitions, ParseIntOld);
+        double t_new = TimeParser<long long>(set.ints, repetitions, ParseIntNew);
+
+        printf("  inteiros: %zu\n", set.ints.size());
+        PrintTiming("atoi", t_old, set.ints.size(), bytes);
+        PrintTiming("novo", t_new, set.ints.size(), bytes);
+        printf("    speedup %.2fx, resultados diferentes: %zu\n", t_old/t_new, mismatches);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int repetitions = 5;
+    std::vector<const char*> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if ( strcmp(argv[i], "-r") == 0 && i + 1 < argc )
+            repetitions = atoi(argv[++i]);
+        else
+            files.push_back(argv[i]);
+    }
+
+    if ( files.empty() )
+        files.push_back("../../data/bunny.obj");
+
+#ifdef TINYOBJLOADER_USE_SSE2
+    printf("SIMD: SSE2\n");
+#else
+    printf("SIMD: desabilitado\n");
+#endif
+
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        TokenSet set;
+        if ( !LoadObjTokens(files[i], &set) )
+        {
+            fprintf(stderr, "ERROR: Cannot open file \"%s\".\n", files[i]);
+            std::exit(EXIT_FAILURE);
+        }
+        BenchmarkSet(set, repetitions);
+    }
+
+    // Conjuntos sintéticos, imitando o que exportadores costumam escrever.
+    static const struct { const char* name; const char* format; float scale; } synthetic[] = {
+        { "sintetico %.6f (coordenadas)",   "%.6f", 10.0f   },
+        { "sintetico %.4f (normais)",       "%.4f", 1.0f    },
+        { "sintetico %g",                   "%g",   1000.0f },
+        { "sintetico %e",                   "%e",   1e6f    },
+        { "sintetico %.9g (round-trip)",    "%.9g", 100.0f  },
+    };
+
+    for (size_t i = 0; i < sizeof(synthetic)/sizeof(synthetic[0]); ++i)
+    {
+        TokenSet set;
+        MakeSyntheticTokens(synthetic[i].name, synthetic[i].format, synthetic[i].scale, 1000000, &set);
+        BenchmarkSet(set, repetitions);
+    }
+
+    return 0;
+}
@@ -0,0 +1,748 @@
+// Verificações automáticas das estruturas de dados do renderizador que não
+// precisam de janela nem de OpenGL. Cada verificação compara uma estrutura
+// com uma implementação ingênua, sobre entradas aleatórias com semente
+// fixa, de forma que uma falha pode ser reproduzida:
+//
+//   - "arena": o alocador de intervalos de "mesharena.h" (união de
+//              intervalos livres vizinhos, reaproveitamento e crescimento),
+//              contra um mapa de bytes ocupados;
+//   - "queue": a ordenação da fila de desenhos de "renderqueue.h", contra
+//              std::stable_sort(), e a ordem dos campos da chave;
+//   - "frustum": FrustumCull_Test() (com SSE, se disponível) contra
+//              FrustumCull_TestScalar(), sobre esferas e caixas aleatórias;
+//   - "aabbtree": a estrutura da árvore de "aabbtree.h" (ligações entre pais
+//              e filhos, alturas e caixas dos nós internos contendo as dos
+//              filhos) após inserções, remoções e movimentos aleatórios, e
+//              as consultas por frustum, raio e caixa, contra um teste de
+//              cada folha, também em uma árvore mais alta que a pilha local
+//              das consultas.
+//
+// Cada falha é impressa com o arquivo e a linha da verificação. O programa
+// retorna 0 se todas as verificações passaram e 1 caso contrário.
+//
+// Uso: selfcheck
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "aabbtree.h"
+#include "frustumcull.h"
+#include "mesharena.h"
+#include "renderqueue.h"
+
+static int g_NumChecks   = 0;
+static int g_NumFailures = 0;
+
+#define SELFCHECK(condition) \
+    do \
+    { \
+        ++g_NumChecks; \
+        if ( !(condition) ) \
+        { \
+            ++g_NumFailures; \
+            fprintf(stderr, "FAILED: %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+        } \
+    } while (0)
+
+// ---------------------------------------------------------------------------
+// Alocador da arena
+
+// Intervalo alocado, como retornado por MeshArenaAllocator_Alloc().
+struct ArenaAllocation
+{
+    size_t offset;
+    size_t size;
+};
+
+// Confere a lista de intervalos livres contra "used", com um byte por
+// posição do alocador: os intervalos estão ordenados, não são vazios, não se
+// tocam (vizinhos livres foram unidos) e cobrem exatamente os bytes não
+// usados.
+static void CheckArenaFreeList(const MeshArenaAllocator& allocator, const std::vector<unsigned char>& used)
+{
+    const std::vector<MeshArenaRange>& ranges = allocator.free_ranges;
+    std::vector<unsigned char> free_bytes(allocator.capacity, 0);
+
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+        SELFCHECK(ranges[i].size > 0);
+        SELFCHECK(ranges[i].offset + ranges[i].size <= allocator.capacity);
+        if ( i > 0 )
+            SELFCHECK(ranges[i-1].offset + ranges[i-1].size < ranges[i].offset);
+
+        for (size_t b = ranges[i].offset; b < ranges[i].offset + ranges[i].size && b < allocator.capacity; ++b)
+            free_bytes[b] = 1;
+    }
+
+    size_t mismatches = 0;
+    for (size_t b = 0; b < allocator.capacity; ++b)
+        if ( free_bytes[b] == used[b] )
+            ++mismatches;
+    SELFCHECK(mismatches == 0);
+}
+
+// Marca em "used" os bytes de uma alocação, conferindo que nenhum deles já
+// estava em uso.
+static void MarkArenaAllocation(std::vector<unsigned char>* used, const ArenaAllocation& allocation, unsigned char value)
+{
+    size_t overlaps = 0;
+    for (size_t b = allocation.offset; b < allocation.offset + allocation.size; ++b)
+    {
+        if ( (*used)[b] == value )
+            ++overlaps;
+        (*used)[b] = value;
+    }
+    SELFCHECK(overlaps == 0);
+}
+
+static void CheckArenaAllocator()
+{
+    // Reaproveitamento: um intervalo liberado no meio da arena é o menor que
+    // comporta uma alocação do mesmo tamanho ("best fit").
+    {
+        MeshArenaAllocator allocator;
+        MeshArenaAllocator_Init(&allocator, 1000);
+
+        size_t a, b, c;
+        SELFCHECK(MeshArenaAllocator_Alloc(&allocator, 100, 1, &a) && a == 0);
+        SELFCHECK(MeshArenaAllocator_Alloc(&allocator, 50, 1, &b) && b == 100);
+        SELFCHECK(MeshArenaAllocator_Alloc(&allocator, 100, 1, &c) && c == 150);
+
+        MeshArenaAllocator_Free(&allocator, b, 50);
+        SELFCHECK(allocator.free_ranges.size() == 2);
+
+        size_t d;
+        SELFCHECK(MeshArenaAllocator_Alloc(&allocator, 40, 1, &d) && d == 100);
+        MeshArenaAllocator_Free(&allocator, d, 40);
+
+        // União com os dois vizinhos: liberar tudo volta a um único
+        // intervalo, em qualquer ordem.
+        MeshArenaAllocator_Free(&allocator, a, 100);
+        MeshArenaAllocator_Free(&allocator, c, 100);
+        SELFCHECK(allocator.free_ranges.size() == 1);
+        SELFCHECK(allocator.free_ranges[0].offset == 0 && allocator.free_ranges[0].size == 1000);
+    }
+
+    // Alinhamento: o espaço perdido antes de uma alocação alinhada continua
+    // livre.
+    {
+        MeshArenaAllocator allocator;
+        MeshArenaAllocator_Init(&allocator, 64);
+
+        size_t a, b;
+        SELFCHECK(MeshArenaAllocator_Alloc(&allocator, 3, 1, &a) && a == 0);
+        SELFCHECK(MeshArenaAllocator_Alloc(&allocator, 8, 4, &b) && b == 4);
+        SELFCHECK(allocator.free_ranges.size() == 2);
+        SELFCHECK(allocator.free_ranges[0].offset == 3 && allocator.free_ranges[0].size == 1);
+    }
+
+    // Crescimento: sem espaço, a alocação falha; depois de
+    // MeshArenaAllocator_Grow(), o novo espaço é unido ao intervalo livre do
+    // fim e as posições já alocadas não mudam.
+    {
+        MeshArenaAllocator allocator;
+        MeshArenaAllocator_Init(&allocator, 100);
+
+        size_t a, b;
+        SELFCHECK(MeshArenaAllocator_Alloc(&allocator, 90, 1, &a) && a == 0);
+        SELFCHECK(!MeshArenaAllocator_Alloc(&allocator, 20, 1, &b));
+
+        MeshArenaAllocator_Grow(&allocator, 200);
+        SELFCHECK(allocator.capacity == 200);
+        SELFCHECK(allocator.free_ranges.size() == 1);
+        SELFCHECK(allocator.free_ranges[0].offset == 90 && allocator.free_ranges[0].size == 110);
+        SELFCHECK(MeshArenaAllocator_Alloc(&allocator, 20, 1, &b) && b == 90);
+
+        // Um tamanho menor que o atual não muda nada.
+        MeshArenaAllocator_Grow(&allocator, 150);
+        SELFCHECK(allocator.capacity == 200);
+
+        // Uma arena vazia também cresce.
+        MeshArenaAllocator empty;
+        MeshArenaAllocator_Init(&empty, 0);
+        SELFCHECK(empty.free_ranges.empty());
+        MeshArenaAllocator_Grow(&empty, 16);
+        SELFCHECK(empty.free_ranges.size() == 1 && empty.free_ranges[0].size == 16);
+    }
+
+    // Sequência aleatória de alocações, liberações e crescimentos, com a
+    // lista livre conferida contra o mapa de bytes após cada operação.
+    {
+        std::mt19937 rng(2024);
+        MeshArenaAllocator allocator;
+        MeshArenaAllocator_Init(&allocator, 256);
+        std::vector<unsigned char> used(allocator.capacity, 0);
+        std::vector<ArenaAllocation> allocations;
+
+        for (int step = 0; step < 4000; ++step)
+        {
+            const unsigned int operation = rng() % 10;
+            if ( operation < 6 )
+            {
+                ArenaAllocation allocation;
+                allocation.size = 1 + rng() % 48;
+                const size_t alignment = (rng() % 2 == 0) ? 1 : MESHARENA_INDEX_ALIGNMENT;
+                if ( MeshArenaAllocator_Alloc(&allocator, allocation.size, alignment, &allocation.offset) )
+                {
+                    SELFCHECK(allocation.offset % alignment == 0);
+                    SELFCHECK(allocation.offset + allocation.size <= allocator.capacity);
+                    MarkArenaAllocation(&used, allocation, 1);
+                    allocations.push_back(allocation);
+                }
+                else if ( allocator.capacity < 4096 )
+                {
+                    MeshArenaAllocator_Grow(&allocator, allocator.capacity * 2);
+                    used.resize(allocator.capacity, 0);
+                }
+            }
+            else if ( !allocations.empty() )
+            {
+                const size_t i = rng() % allocations.size();
+                MeshArenaAllocator_Free(&allocator, allocations[i].offset, allocations[i].size);
+                MarkArenaAllocation(&used, allocations[i], 0);
+                allocations[i] = allocations.back();
+                allocations.pop_back();
+            }
+            CheckArenaFreeList(allocator, used);
+        }
+
+        for (size_t i = 0; i < allocations.size(); ++i)
+            MeshArenaAllocator_Free(&allocator, allocations[i].offset, allocations[i].size);
+        SELFCHECK(allocator.free_ranges.size() == 1);
+        SELFCHECK(allocator.free_ranges[0].offset == 0 && allocator.free_ranges[0].size == allocator.capacity);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Fila de desenhos
+
+static bool RenderQueueItemLess(const RenderQueueItem& a, const RenderQueueItem& b)
+{
+    return a.key < b.key;
+}
+
+// Ordena "count" chaves geradas por "make_key" com RenderQueue_Sort() e com
+// std::stable_sort() e confere que as duas ordens são iguais, inclusive
+// entre chaves iguais (a posição do pacote é a ordem de envio).
+template <typename MakeKey>
+static void CheckRenderQueueSort(RenderQueue* queue, size_t count, MakeKey make_key)
+{
+    RenderQueue_Clear(queue);
+    for (size_t i = 0; i < count; ++i)
+        RenderQueue_Submit(queue, make_key(), i);
+
+    std::vector<RenderQueueItem> expected = queue->items;
+    std::stable_sort(expected.begin(), expected.end(), RenderQueueItemLess);
+    RenderQueue_Sort(queue);
+
+    SELFCHECK(queue->items.size() == expected.size());
+    size_t mismatches = 0;
+    for (size_t i = 0; i < expected.size() && i < queue->items.size(); ++i)
+        if ( queue->items[i].key != expected[i].key || queue->items[i].packet != expected[i].packet )
+            ++mismatches;
+    SELFCHECK(mismatches == 0);
+}
+
+static void CheckRenderQueue()
+{
+    std::mt19937_64 rng(2024);
+    RenderQueue queue; // Reaproveitada entre as ordenações, como em "main.cpp"
+
+    static const size_t counts[] = { 0, 1, 2, 3, 255, 256, 257, 1000, 20000 };
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+    {
+        const size_t count = counts[c];
+
+        // Chaves quaisquer: todas as passadas são feitas.
+        CheckRenderQueueSort(&queue, count, [&]() { return (uint64_t)rng(); });
+
+        // Poucas chaves distintas: muitas chaves iguais, que devem manter a
+        // ordem de envio.
+        CheckRenderQueueSort(&queue, count, [&]() { return (uint64_t)(rng() % 7) << 40; });
+
+        // Chaves montadas como em "main.cpp": poucos programas, VAOs e
+        // materiais, de forma que várias passadas são puladas.
+        CheckRenderQueueSort(&queue, count, [&]() {
+            return RenderQueue_MakeKey(0, (unsigned int)(rng() % 2), (unsigned int)(rng() % 3), (int)(rng() % 5) - 1, (float)(rng() % 1000) * 0.01f);
+        });
+
+        // Todas as chaves iguais: nenhuma passada é feita.
+        CheckRenderQueueSort(&queue, count, [&]() { return (uint64_t)12345; });
+    }
+
+    // Ordem dos campos da chave: o passo vale mais que o programa, que vale
+    // mais que o VAO, o material e a profundidade.
+    SELFCHECK(RenderQueue_MakeKey(0, 255, 255, 4000, 1e30f) < RenderQueue_MakeKey(1, 0, 0, -1, 0.0f));
+    SELFCHECK(RenderQueue_MakeKey(0, 0, 255, 4000, 1e30f) < RenderQueue_MakeKey(0, 1, 0, -1, 0.0f));
+    SELFCHECK(RenderQueue_MakeKey(0, 0, 0, 4000, 1e30f) < RenderQueue_MakeKey(0, 0, 1, -1, 0.0f));
+    SELFCHECK(RenderQueue_MakeKey(0, 0, 0, -1, 1e30f) < RenderQueue_MakeKey(0, 0, 0, 0, 0.0f));
+    SELFCHECK(RenderQueue_MakeKey(0, 0, 0, 0, 0.5f) < RenderQueue_MakeKey(0, 0, 0, 0, 2.0f));
+    SELFCHECK(RenderQueue_MakeKey(0, 0, 0, 0, -3.0f) == RenderQueue_MakeKey(0, 0, 0, 0, 0.0f));
+}
+
+// ---------------------------------------------------------------------------
+// Frustum culling
+
+// Testa "batch" contra "planes" pelos dois caminhos de "frustumcull.h" e
+// confere que as máscaras de visibilidade e as contagens são iguais.
+static void CheckFrustumCullBatch(const FrustumCullBatch& batch, const float planes[6][4])
+{
+    std::vector<unsigned char> visible, visible_scalar;
+    const size_t num_visible        = FrustumCull_Test(batch, planes, &visible);
+    const size_t num_visible_scalar = FrustumCull_TestScalar(batch, planes, &visible_scalar);
+
+    SELFCHECK(num_visible == num_visible_scalar);
+    SELFCHECK(visible == visible_scalar);
+}
+
+static void CheckFrustumCull()
+{
+    std::mt19937 rng(2024);
+    std::uniform_real_distribution<float> coordinate(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> extent(0.0f, 3.0f);
+    FrustumCullBatch batch;
+
+    for (int round = 0; round < 200; ++round)
+    {
+        // Planos quaisquer, normalizados como por FrustumCull_ExtractPlanes().
+        float planes[6][4];
+        for (int p = 0; p < 6; ++p)
+        {
+            float length = 0.0f;
+            while ( length < 1e-3f )
+            {
+                for (int j = 0; j < 3; ++j)
+                    planes[p][j] = coordinate(rng);
+                length = std::sqrt(planes[p][0]*planes[p][0] + planes[p][1]*planes[p][1] + planes[p][2]*planes[p][2]);
+            }
+            for (int j = 0; j < 3; ++j)
+                planes[p][j] /= length;
+            planes[p][3] = coordinate(rng);
+        }
+
+        // Um número de objetos que não é múltiplo de 4, para que os objetos
+        // restantes do caminho com SSE também sejam testados.
+        FrustumCull_Clear(&batch);
+        const size_t count = 1 + rng() % 203;
+        for (size_t i = 0; i < count; ++i)
+        {
+            float sphere_center[3] = { coordinate(rng), coordinate(rng), coordinate(rng) };
+            float box_center[3]    = { coordinate(rng), coordinate(rng), coordinate(rng) };
+            float box_extent[3]    = { extent(rng), extent(rng), extent(rng) };
+            FrustumCull_Add(&batch, sphere_center, extent(rng), box_center, box_extent);
+        }
+        CheckFrustumCullBatch(batch, planes);
+
+        // Caixa alinhada aos eixos e volumes com coordenadas inteiras: muitos
+        // volumes encostam exatamente em um plano, o caso em que uma conta
+        // feita em outra ordem mudaria o resultado.
+        float box_planes[6][4];
+        for (int p = 0; p < 6; ++p)
+        {
+            const float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+            for (int j = 0; j < 3; ++j)
+                box_planes[p][j] = (j == p / 2) ? sign : 0.0f;
+            box_planes[p][3] = (float)(1 + rng() % 5);
+        }
+
+        FrustumCull_Clear(&batch);
+        for (size_t i = 0; i < count; ++i)
+        {
+            float sphere_center[3] = { (float)((int)(rng() % 15) - 7), (float)((int)(rng() % 15) - 7), (float)((int)(rng() % 15) - 7) };
+            float box_center[3]    = { (float)((int)(rng() % 15) - 7), (float)((int)(rng() % 15) - 7), (float)((int)(rng() % 15) - 7) };
+            float box_extent[3]    = { (float)(rng() % 3), (float)(rng() % 3), (float)(rng() % 3) };
+            FrustumCull_Add(&batch, sphere_center, (float)(rng() % 4), box_center, box_extent);
+        }
+        CheckFrustumCullBatch(batch, box_planes);
+    }
+
+    // Lote vazio.
+    float planes[6][4] = {};
+    FrustumCull_Clear(&batch);
+    CheckFrustumCullBatch(batch, planes);
+}
+
+// ---------------------------------------------------------------------------
+// Árvore de caixas envolventes
+
+// Objeto inserido na árvore. O valor ("data") de sua folha é sua posição no
+// vetor de objetos.
+struct AabbTreeObject
+{
+    int   proxy; // AABBTREE_NULL se o objeto foi removido
+    float minimum[3];
+    float maximum[3];
+};
+
+static bool BoxContains(const float outer_minimum[3], const float outer_maximum[3], const float inner_minimum[3], const float inner_maximum[3])
+{
+    bool inside = true;
+    for (int k = 0; k < 3; ++k)
+        inside = inside && outer_minimum[k] <= inner_minimum[k] && inner_maximum[k] <= outer_maximum[k];
+    return inside;
+}
+
+// Percorre a árvore a partir da raiz e confere as ligações entre pais e
+// filhos, as alturas e as caixas dos nós internos. Cada objeto não removido
+// deve ser exatamente uma das folhas alcançadas, com o seu valor e com uma
+// caixa que contém a caixa do objeto; os demais nós estão na lista de nós
+// livres.
+static void CheckAabbTreeStructure(const AabbTree& tree, const std::vector<AabbTreeObject>& objects)
+{
+    size_t num_objects = 0;
+    for (size_t i = 0; i < objects.size(); ++i)
+        if ( objects[i].proxy != AABBTREE_NULL )
+            ++num_objects;
+
+    size_t num_leaves = 0, num_reached = 0;
+    size_t bad_links = 0, bad_heights = 0, bad_bounds = 0;
+    std::vector<int> stack;
+    if ( tree.root != AABBTREE_NULL )
+    {
+        SELFCHECK(tree.nodes[tree.root].parent == AABBTREE_NULL);
+        stack.push_back(tree.root);
+    }
+    while ( !stack.empty() )
+    {
+        const int index = stack.back();
+        stack.pop_back();
+        const AabbTreeNode& node = tree.nodes[index];
+        ++num_reached;
+
+        if ( node.left == AABBTREE_NULL )
+        {
+            ++num_leaves;
+            const bool known = (node.data >= 0 && (size_t)node.data < objects.size() && objects[node.data].proxy == index);
+            SELFCHECK(known);
+            if ( known && !BoxContains(node.minimum, node.maximum, objects[node.data].minimum, objects[node.data].maximum) )
+                ++bad_bounds;
+            if ( node.height != 0 || node.right != AABBTREE_NULL )
+                ++bad_heights;
+            continue;
+        }
+
+        const AabbTreeNode& left  = tree.nodes[node.left];
+        const AabbTreeNode& right = tree.nodes[node.right];
+        if ( left.parent != index || right.parent != index )
+            ++bad_links;
+        if ( node.height != 1 + std::max(left.height, right.height) )
+            ++bad_heights;
+        if ( !BoxContains(node.minimum, node.maximum, left.minimum, left.maximum) || !BoxContains(node.minimum, node.maximum, right.minimum, right.maximum) )
+            ++bad_bounds;
+        stack.push_back(node.left);
+        stack.push_back(node.right);
+    }
+
+    SELFCHECK(bad_links == 0);
+    SELFCHECK(bad_heights == 0);
+    SELFCHECK(bad_bounds == 0);
+    SELFCHECK(num_leaves == num_objects);
+
+    size_t num_free = 0;
+    for (int index = tree.free_list; index != AABBTREE_NULL && num_free <= tree.nodes.size(); index = tree.nodes[index].parent)
+    {
+        SELFCHECK(tree.nodes[index].height == -1);
+        ++num_free;
+    }
+    SELFCHECK(num_reached + num_free == tree.nodes.size());
+}
+
+static void RandomAabbTreeBox(std::mt19937* rng, float minimum[3], float maximum[3])
+{
+    std::uniform_real_distribution<float> coordinate(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> size(0.0f, 4.0f);
+    for (int k = 0; k < 3; ++k)
+    {
+        minimum[k] = coordinate(*rng);
+        maximum[k] = minimum[k] + size(*rng);
+    }
+}
+
+// Confere as três consultas contra um teste de cada folha, com as mesmas
+// contas da árvore: a árvore só pode descartar uma folha se ela também seria
+// descartada sozinha.
+static void CheckAabbTreeQueries(const AabbTree& tree, const std::vector<AabbTreeObject>& objects, std::mt19937* rng)
+{
+    std::uniform_real_distribution<float> coordinate(-60.0f, 60.0f);
+    std::vector<int> found, expected;
+
+    // Caixa.
+    float box_minimum[3], box_maximum[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        box_minimum[k] = coordinate(*rng);
+        box_maximum[k] = box_minimum[k] + 30.0f * (float)((*rng)() % 1000) / 1000.0f;
+    }
+    found.clear();
+    expected.clear();
+    AabbTree_QueryBox(tree, box_minimum, box_maximum, &found);
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        if ( objects[i].proxy == AABBTREE_NULL )
+            continue;
+        const AabbTreeNode& leaf = tree.nodes[objects[i].proxy];
+        bool overlaps = true;
+        for (int k = 0; k < 3; ++k)
+            overlaps = overlaps && leaf.minimum[k] <= box_maximum[k] && box_minimum[k] <= leaf.maximum[k];
+        if ( overlaps )
+            expected.push_back((int)i);
+    }
+    std::sort(found.begin(), found.end());
+    SELFCHECK(found == expected);
+
+    // Frustum: seis planos quaisquer, normalizados.
+    float planes[6][4];
+    for (int p = 0; p < 6; ++p)
+    {
+        float length = 0.0f;
+        while ( length < 1e-3f )
+        {
+            for (int j = 0; j < 3; ++j)
+                planes[p][j] = coordinate(*rng);
+            length = std::sqrt(planes[p][0]*planes[p][0] + planes[p][1]*planes[p][1] + planes[p][2]*planes[p][2]);
+        }
+        for (int j = 0; j < 3; ++j)
+            planes[p][j] /= length;
+        planes[p][3] = 0.5f * coordinate(*rng) + 30.0f;
+    }
+    found.clear();
+    expected.clear();
+    AabbTree_QueryFrustum(tree, planes, &found);
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        if ( objects[i].proxy == AABBTREE_NULL )
+            continue;
+        const AabbTreeNode& leaf = tree.nodes[objects[i].proxy];
+        bool outside = false;
+        for (int p = 0; p < 6 && !outside; ++p)
+        {
+            float distance = planes[p][3];
+            float radius   = 0.0f;
+            for (int k = 0; k < 3; ++k)
+            {
+                distance += planes[p][k] * 0.5f * (leaf.minimum[k] + leaf.maximum[k]);
+                radius   += std::fabs(planes[p][k]) * 0.5f * (leaf.maximum[k] - leaf.minimum[k]);
+            }
+            outside = (distance < -radius);
+        }
+        if ( !outside )
+            expected.push_back((int)i);
+    }
+    std::sort(found.begin(), found.end());
+    SELFCHECK(found == expected);
+
+    // Raio, com algumas direções paralelas aos eixos.
+    float origin[3], direction[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        origin[k]    = coordinate(*rng);
+        direction[k] = ((*rng)() % 4 == 0) ? 0.0f : coordinate(*rng);
+    }
+    if ( direction[0] == 0.0f && direction[1] == 0.0f && direction[2] == 0.0f )
+        direction[0] = 1.0f;
+    const float max_distance = 2.0f;
+
+    std::vector<AabbTreeHit> hits;
+    AabbTree_QueryRay(tree, origin, direction, max_distance, &hits);
+    size_t unsorted = 0;
+    for (size_t i = 1; i < hits.size(); ++i)
+        if ( hits[i].distance < hits[i-1].distance )
+            ++unsorted;
+    SELFCHECK(unsorted == 0);
+
+    found.clear();
+    expected.clear();
+    for (size_t i = 0; i < hits.size(); ++i)
+        found.push_back(hits[i].data);
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        if ( objects[i].proxy == AABBTREE_NULL )
+            continue;
+        const AabbTreeNode& leaf = tree.nodes[objects[i].proxy];
+        float t_min = 0.0f;
+        float t_max = max_distance;
+        for (int k = 0; k < 3 && t_min <= t_max; ++k)
+        {
+            if ( direction[k] == 0.0f )
+            {
+                if ( origin[k] < leaf.minimum[k] || origin[k] > leaf.maximum[k] )
+                    t_max = -1.0f;
+                continue;
+            }
+            float t0 = (leaf.minimum[k] - origin[k]) * (1.0f / direction[k]);
+            float t1 = (leaf.maximum[k] - origin[k]) * (1.0f / direction[k]);
+            if ( t0 > t1 )
+                std::swap(t0, t1);
+            t_min = std::max(t_min, t0);
+            t_max = std::min(t_max, t1);
+        }
+        if ( t_min <= t_max )
+            expected.push_back((int)i);
+    }
+    std::sort(found.begin(), found.end());
+    SELFCHECK(found == expected);
+}
+
+static void CheckAabbTree()
+{
+    std::mt19937 rng(2024);
+    AabbTree tree;
+    std::vector<AabbTreeObject> objects;
+
+    for (int step = 0; step < 3000; ++step)
+    {
+        const unsigned int operation = rng() % 10;
+        const size_t i = objects.empty() ? 0 : rng() % objects.size();
+
+        if ( operation < 4 || objects.empty() )
+        {
+            AabbTreeObject object;
+            RandomAabbTreeBox(&rng, object.minimum, object.maximum);
+            object.proxy = AabbTree_Insert(&tree, object.minimum, object.maximum, (int)objects.size());
+            objects.push_back(object);
+        }
+        else if ( operation < 6 )
+        {
+            if ( objects[i].proxy != AABBTREE_NULL )
+                AabbTree_Remove(&tree, objects[i].proxy);
+            objects[i].proxy = AABBTREE_NULL;
+        }
+        else if ( objects[i].proxy != AABBTREE_NULL )
+        {
+            // Movimentos pequenos, dentro da margem da folha, não mudam a
+            // árvore; os demais reinserem a folha com o mesmo proxy.
+            AabbTreeObject& object = objects[i];
+            const float step_size = (operation < 8) ? 0.5f * AABBTREE_MARGIN : 10.0f;
+            float minimum[3], maximum[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                const float offset = step_size * ((float)(rng() % 2001) / 1000.0f - 1.0f);
+                minimum[k] = object.minimum[k] + offset;
+                maximum[k] = object.maximum[k] + offset;
+            }
+
+            const AabbTreeNode before = tree.nodes[object.proxy];
+            const bool moved = AabbTree_Move(&tree, object.proxy, minimum, maximum);
+            SELFCHECK(moved == !BoxContains(before.minimum, before.maximum, minimum, maximum));
+            for (int k = 0; k < 3; ++k)
+            {
+                object.minimum[k] = minimum[k];
+                object.maximum[k] = maximum[k];
+            }
+        }
+
+        if ( step % 10 == 0 )
+        {
+            CheckAabbTreeStructure(tree, objects);
+            CheckAabbTreeQueries(tree, objects, &rng);
+        }
+    }
+    CheckAabbTreeStructure(tree, objects);
+
+    // Removendo todos os objetos, a árvore fica vazia, e as consultas não
+    // encontram nada.
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        if ( objects[i].proxy != AABBTREE_NULL )
+            AabbTree_Remove(&tree, objects[i].proxy);
+        objects[i].proxy = AABBTREE_NULL;
+    }
+    SELFCHECK(tree.root == AABBTREE_NULL);
+    CheckAabbTreeStructure(tree, objects);
+    CheckAabbTreeQueries(tree, objects, &rng);
+
+    // Uma árvore em forma de lista, montada à mão (as rotações nunca deixam
+    // a árvore tão alta), faz a pilha das consultas passar de
+    // AABBTREE_STACK_SIZE nós: cada nó interno tem uma folha à esquerda e o
+    // resto da lista à direita.
+    const int num_leaves = 4 * AABBTREE_STACK_SIZE;
+    AabbTree chain;
+    chain.nodes.resize(2 * num_leaves - 1);
+    objects.assign(num_leaves, AabbTreeObject());
+    for (int i = 0; i < num_leaves; ++i)
+    {
+        AabbTreeNode& leaf = chain.nodes[i];
+        RandomAabbTreeBox(&rng, leaf.minimum, leaf.maximum);
+        leaf.left = leaf.right = AABBTREE_NULL;
+        leaf.height = 0;
+        leaf.data = i;
+        objects[i].proxy = i;
+        for (int k = 0; k < 3; ++k)
+        {
+            objects[i].minimum[k] = leaf.minimum[k];
+            objects[i].maximum[k] = leaf.maximum[k];
+        }
+    }
+    for (int level = num_leaves - 2; level >= 0; --level)
+    {
+        const int index = num_leaves + level;
+        const int rest  = (level == num_leaves - 2) ? num_leaves - 1 : index + 1;
+        AabbTreeNode& node = chain.nodes[index];
+        node.left   = level;
+        node.right  = rest;
+        node.height = chain.nodes[rest].height + 1;
+        node.data   = -1;
+        for (int k = 0; k < 3; ++k)
+        {
+            node.minimum[k] = std::min(chain.nodes[level].minimum[k], chain.nodes[rest].minimum[k]);
+            node.maximum[k] = std::max(chain.nodes[level].maximum[k], chain.nodes[rest].maximum[k]);
+        }
+        chain.nodes[level].parent = chain.nodes[rest].parent = index;
+    }
+    chain.root = num_leaves;
+    chain.nodes[chain.root].parent = AABBTREE_NULL;
+    CheckAabbTreeStructure(chain, objects);
+    for (int i = 0; i < 20; ++i)
+        CheckAabbTreeQueries(chain, objects, &rng);
+
+    // Um frustum que contém todas as caixas percorre a lista inteira de uma
+    // vez (CollectLeaves() em "aabbtree.cpp").
+    float planes[6][4] = {
+        { 1, 0, 0, 100 }, { -1, 0, 0, 100 }, { 0, 1, 0, 100 },
+        { 0, -1, 0, 100 }, { 0, 0, 1, 100 }, { 0, 0, -1, 100 },
+    };
+    std::vector<int> found;
+    AabbTree_QueryFrustum(chain, planes, &found);
+    std::sort(found.begin(), found.end());
+    SELFCHECK(found.size() == (size_t)num_leaves);
+    for (size_t i = 0; i < found.size(); ++i)
+        SELFCHECK(found[i] == (int)i);
+}
+
+// ---------------------------------------------------------------------------
+
+struct SelfCheck
+{
+    const char* name;
+    void (*run)();
+};
+
+int main()
+{
+    static const SelfCheck checks[] = {
+        { "arena", CheckArenaAllocator },
+        { "queue", CheckRenderQueue },
+        { "frustum", CheckFrustumCull },
+        { "aabbtree", CheckAabbTree },
+    };
+
+    for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); ++i)
+    {
+        const int failures = g_NumFailures;
+        const int num_checks = g_NumChecks;
+        checks[i].run();
+        printf("%-10s %8d checks  %s\n", checks[i].name, g_NumChecks - num_checks, (g_NumFailures == failures) ? "ok" : "FAILED");
+    }
+
+    if ( g_NumFailures > 0 )
+    {
+        fprintf(stderr, "%d of %d checks failed.\n", g_NumFailures, g_NumChecks);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}